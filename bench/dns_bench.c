@@ -0,0 +1,344 @@
+/*
+ * DNS cache benchmark
+ *
+ * Points the resolver (dns_init) at a stub DNS server on 127.0.0.1 and
+ * looks up a few names every 10 ms, as probes would, while the stub
+ * answers each one its own way: an A record with a 2 s TTL, a CNAME chain
+ * whose CNAME has the lowest TTL (1 s), NXDOMAIN with an SOA whose TTL or
+ * minimum is 1 s and the other 10 s, and two names that answer, then fail
+ * (SERVFAIL, or no answer) for both of the resolver's attempts, then answer
+ * again. From when the stub sees each query, checks that:
+ *   - the first lookup of a name is DNS_PENDING
+ *   - a positive answer is refreshed at DNS_REFRESH_PCT of its TTL, the
+ *     lowest along the CNAME chain
+ *   - NXDOMAIN is cached for min(SOA TTL, SOA minimum)
+ *   - after SERVFAIL or a timeout the last address is still served, and
+ *     the name is retried DNS_FAILURE_TTL_S later
+ * Reports each expected and measured interval. Takes about 8 s.
+ *
+ *   make bench && ./build/dns_bench
+ */
+
+#include "net/dns.h"
+#include "platform/platform.h"
+#include <arpa/inet.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_LOOKUP_MS     10
+#define BENCH_DEADLINE_MS   20000
+#define BENCH_EARLY_MS      20      // Lookups are 10 ms apart
+#define BENCH_LATE_MS       250     // Thread wakeups on a loaded machine
+#define BENCH_QUERIES_MAX   16
+#define BENCH_STEPS_MAX     5
+
+typedef enum {
+    STUB_A,             // A record, TTL ttl
+    STUB_CNAME,         // CNAME with TTL ttl to an A record with TTL ttl2
+    STUB_NXDOMAIN,      // SOA with TTL ttl and minimum ttl2
+    STUB_SERVFAIL,
+    STUB_DROP           // No answer
+} stub_kind_t;
+
+typedef struct {
+    stub_kind_t kind;
+    uint32_t ttl;
+    uint32_t ttl2;
+} stub_step_t;
+
+// A name the stub knows: the nth query for it gets steps[n] (the last
+// step repeats)
+typedef struct {
+    const char *name;
+    stub_step_t steps[BENCH_STEPS_MAX];
+    int step_count;
+} stub_name_t;
+
+// What the lookups of a name saw
+typedef struct {
+    dns_status_t first;
+    uint64_t ok_ms;         // First DNS_OK, 0 if none
+    uint64_t failed_ms;     // First DNS_FAILED, 0 if none
+    int lapses;             // Lookups that were not DNS_OK after the first
+    int wrong;              // DNS_OK with another address
+} bench_seen_t;
+
+static const stub_name_t names[] = {
+    { "fresh.test", { { STUB_A, 2, 0 } }, 1 },
+    { "chain.test", { { STUB_CNAME, 1, 30 } }, 1 },
+    { "nx-min.test", { { STUB_NXDOMAIN, 10, 1 } }, 1 },
+    { "nx-ttl.test", { { STUB_NXDOMAIN, 1, 10 } }, 1 },
+    { "servfail.test", { { STUB_A, 1, 0 }, { STUB_SERVFAIL, 0, 0 }, { STUB_SERVFAIL, 0, 0 },
+                         { STUB_A, 1, 0 } }, 4 },
+    { "timeout.test", { { STUB_A, 1, 0 }, { STUB_DROP, 0, 0 }, { STUB_DROP, 0, 0 },
+                        { STUB_A, 1, 0 } }, 4 },
+};
+enum { NAME_COUNT = sizeof(names) / sizeof(names[0]) };
+
+// When the stub saw each query for names[i]
+static uint64_t query_times[NAME_COUNT][BENCH_QUERIES_MAX];
+static atomic_int query_counts[NAME_COUNT];
+
+static int stub_fd = -1;
+static atomic_bool stub_running;
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    put_u16(p, (uint16_t)(v >> 16));
+    put_u16(p + 2, (uint16_t)v);
+}
+
+// Address the stub gives names[i]
+static struct in_addr name_addr(int i) {
+    struct in_addr a = { .s_addr = htonl(0x0A000001u + (uint32_t)i) };
+    return a;
+}
+
+// Resource record header at p; returns the length written
+static size_t put_rr(uint8_t *p, uint16_t name_ptr, uint16_t type, uint32_t ttl, uint16_t rdlen) {
+    put_u16(p, 0xC000 | name_ptr);
+    put_u16(p + 2, type);
+    put_u16(p + 4, 1);      // IN
+    put_u32(p + 6, ttl);
+    put_u16(p + 10, rdlen);
+    return 12;
+}
+
+// Answer for step, after the query's question (which ends at pos)
+static size_t build_answer(uint8_t *buf, size_t pos, const stub_step_t *step, struct in_addr addr) {
+    static const uint8_t target[] = "\x06target\x04test";  // With its terminating 0
+    uint16_t rcode = step->kind == STUB_NXDOMAIN ? 3 : step->kind == STUB_SERVFAIL ? 2 : 0;
+    put_u16(buf + 2, 0x8180 | rcode);   // Response, recursion desired and available
+    memset(buf + 6, 0, 6);
+
+    switch (step->kind) {
+        case STUB_A:
+            put_u16(buf + 6, 1);
+            pos += put_rr(buf + pos, 12, 1, step->ttl, 4);
+            memcpy(buf + pos, &addr, 4);
+            return pos + 4;
+
+        case STUB_CNAME: {
+            put_u16(buf + 6, 2);
+            pos += put_rr(buf + pos, 12, 5, step->ttl, sizeof(target));
+            size_t target_pos = pos;
+            memcpy(buf + pos, target, sizeof(target));
+            pos += sizeof(target);
+            pos += put_rr(buf + pos, (uint16_t)target_pos, 1, step->ttl2, 4);
+            memcpy(buf + pos, &addr, 4);
+            return pos + 4;
+        }
+
+        case STUB_NXDOMAIN:
+            // Root as the owner, MNAME and RNAME; then serial..minimum
+            put_u16(buf + 8, 1);
+            buf[pos++] = 0;
+            put_u16(buf + pos, 6);
+            put_u16(buf + pos + 2, 1);
+            put_u32(buf + pos + 4, step->ttl);
+            put_u16(buf + pos + 8, 22);
+            pos += 10;
+            buf[pos++] = 0;
+            buf[pos++] = 0;
+            memset(buf + pos, 0, 16);
+            put_u32(buf + pos + 16, step->ttl2);
+            return pos + 20;
+
+        default:
+            return pos;
+    }
+}
+
+static void *stub_main(void *arg) {
+    (void)arg;
+    while (atomic_load(&stub_running)) {
+        struct pollfd pfd = { .fd = stub_fd, .events = POLLIN };
+        if (poll(&pfd, 1, 50) <= 0) {
+            continue;
+        }
+        uint8_t buf[512];
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(stub_fd, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+        if (n < 12 + 5) {
+            continue;
+        }
+
+        // The question's name, dotted
+        char qname[256];
+        size_t pos = 12, out = 0;
+        while (pos < (size_t)n && buf[pos] != 0 && out + buf[pos] + 1 < sizeof(qname)) {
+            size_t len = buf[pos];
+            if (out > 0) {
+                qname[out++] = '.';
+            }
+            memcpy(qname + out, buf + pos + 1, len);
+            out += len;
+            pos += len + 1;
+        }
+        qname[out] = '\0';
+        pos += 1 + 4;   // Root label, QTYPE, QCLASS
+        if (pos > (size_t)n) {
+            continue;
+        }
+
+        for (int i = 0; i < NAME_COUNT; i++) {
+            const stub_name_t *sn = &names[i];
+            if (strcmp(sn->name, qname) != 0) {
+                continue;
+            }
+            int q = atomic_load(&query_counts[i]);
+            if (q < BENCH_QUERIES_MAX) {
+                query_times[i][q] = now_ms();
+                atomic_store(&query_counts[i], q + 1);
+            }
+            const stub_step_t *step = &sn->steps[q < sn->step_count ? q : sn->step_count - 1];
+            if (step->kind != STUB_DROP) {
+                size_t len = build_answer(buf, pos, step, name_addr(i));
+                sendto(stub_fd, buf, len, 0, (struct sockaddr *)&from, from_len);
+            }
+        }
+    }
+    return NULL;
+}
+
+// Whether interval (ms) is what was expected, give or take the lookup
+// period and thread wakeups; slack_ms covers the getaddrinfo() fallback
+static bool check(const char *name, const char *what, int64_t expected_ms, int64_t slack_ms,
+                  int64_t measured_ms) {
+    bool ok = measured_ms >= expected_ms - BENCH_EARLY_MS &&
+              measured_ms <= expected_ms + slack_ms + BENCH_LATE_MS;
+    printf("%-14s %-28s %8lld ms %8lld ms %5s\n", name, what, (long long)expected_ms,
+           (long long)measured_ms, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+static bool check_flag(const char *name, const char *what, bool ok) {
+    printf("%-14s %-28s %11s %11s %5s\n", name, what, "", "", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Query time n of names[i], or 0 if the stub has not seen it
+static int64_t query_ms(int i, int n) {
+    return atomic_load(&query_counts[i]) > n ? (int64_t)query_times[i][n] : 0;
+}
+
+int main(void) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+    stub_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (stub_fd < 0 || bind(stub_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        getsockname(stub_fd, (struct sockaddr *)&addr, &len) != 0) {
+        fprintf(stderr, "cannot bind a UDP socket on 127.0.0.1\n");
+        return 2;
+    }
+    atomic_init(&stub_running, true);
+    pthread_t stub_thread;
+    if (pthread_create(&stub_thread, NULL, stub_main, NULL) != 0) {
+        fprintf(stderr, "cannot start the stub server\n");
+        return 2;
+    }
+
+    // Failed DNS answers fall back to getaddrinfo(); allow for how long
+    // that takes to fail here
+    uint64_t start_ms = now_ms();
+    struct addrinfo *ai = dns_resolve("servfail.test", 0);
+    if (ai != NULL) {
+        freeaddrinfo(ai);
+    }
+    int64_t fallback_ms = (int64_t)(now_ms() - start_ms);
+
+    char server[32];
+    snprintf(server, sizeof(server), "127.0.0.1:%u", ntohs(addr.sin_port));
+    if (dns_init(server) != 0) {
+        fprintf(stderr, "dns_init(%s) failed\n", server);
+        return 2;
+    }
+
+    bench_seen_t seen[NAME_COUNT];
+    memset(seen, 0, sizeof(seen));
+    uint64_t deadline_ms = now_ms() + BENCH_DEADLINE_MS;
+    for (int round = 0; now_ms() < deadline_ms; round++) {
+        bool done = true;
+        for (int i = 0; i < NAME_COUNT; i++) {
+            struct sockaddr_in got;
+            dns_status_t status = dns_lookup(names[i].name, 80, &got);
+            bench_seen_t *s = &seen[i];
+            uint64_t now = now_ms();
+            if (round == 0) {
+                s->first = status;
+            }
+            if (s->ok_ms != 0 && status != DNS_OK) {
+                s->lapses++;
+            }
+            if (status == DNS_OK) {
+                s->wrong += got.sin_addr.s_addr != name_addr(i).s_addr;
+                s->ok_ms = s->ok_ms != 0 ? s->ok_ms : now;
+            } else if (status == DNS_FAILED && s->failed_ms == 0) {
+                s->failed_ms = now;
+            }
+            int wanted = names[i].step_count > 1 ? names[i].step_count : 2;
+            done = done && atomic_load(&query_counts[i]) >= wanted;
+        }
+        if (done) {
+            break;
+        }
+        struct timespec pause = { .tv_nsec = BENCH_LOOKUP_MS * 1000000L };
+        nanosleep(&pause, NULL);
+    }
+
+    dns_shutdown();
+    atomic_store(&stub_running, false);
+    pthread_join(stub_thread, NULL);
+    close(stub_fd);
+
+    printf("stub DNS server on %s; getaddrinfo() fallback fails in %lld ms\n", server,
+           (long long)fallback_ms);
+    printf("%-14s %-28s %11s %11s %5s\n", "name", "check", "expected", "measured", "");
+    bool ok = true;
+    for (int i = 0; i < NAME_COUNT; i++) {
+        ok = check_flag(names[i].name, "first lookup DNS_PENDING", seen[i].first == DNS_PENDING) && ok;
+    }
+
+    // Refreshes, from when the answer was first served
+    int64_t refresh_2s = 2000 * DNS_REFRESH_PCT / 100;
+    int64_t refresh_1s = 1000 * DNS_REFRESH_PCT / 100;
+    ok = check("fresh.test", "TTL 2 s refreshed after", refresh_2s, 0,
+               query_ms(0, 1) - (int64_t)seen[0].ok_ms) && ok;
+    ok = check("chain.test", "CNAME TTL 1 s refreshed after", refresh_1s, 0,
+               query_ms(1, 1) - (int64_t)seen[1].ok_ms) && ok;
+
+    // Negative answers, from when DNS_FAILED was first returned
+    ok = check("nx-min.test", "SOA min 1 s cached for", 1000, 0,
+               query_ms(2, 1) - (int64_t)seen[2].failed_ms) && ok;
+    ok = check("nx-ttl.test", "SOA TTL 1 s cached for", 1000, 0,
+               query_ms(3, 1) - (int64_t)seen[3].failed_ms) && ok;
+
+    // Failures, from the resolver's last attempt: SERVFAIL is answered at
+    // once, a timeout takes DNS_TIMEOUT_MS (1 s)
+    ok = check("servfail.test", "retry after SERVFAIL", DNS_FAILURE_TTL_S * 1000, fallback_ms,
+               query_ms(4, 3) - query_ms(4, 2)) && ok;
+    ok = check("timeout.test", "retry after timeout", 1000 + DNS_FAILURE_TTL_S * 1000, fallback_ms,
+               query_ms(5, 3) - query_ms(5, 2)) && ok;
+
+    for (int i = 0; i < NAME_COUNT; i++) {
+        if (seen[i].ok_ms != 0) {
+            ok = check_flag(names[i].name, "address served throughout",
+                            seen[i].lapses == 0 && seen[i].wrong == 0) && ok;
+        }
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+/*
+ * Probe engine benchmark
+ *
+ * Runs TCP connect probes through each probe engine (poll, and io_uring if
+ * it is built in and usable), with the engine watched by a reactor as the
+ * scheduler has it and 256 probes kept in flight, against two local
+ * targets: a closed port (every connect refused) and a listener on another
+ * thread that accepts and closes. Reports probes/s, CPU per probe of the
+ * probing thread, and (on Linux, see syscall_count.h) syscalls per probe.
+ * Fails if over 1% of probes end other than expected (refused, or
+ * connected with the time the engine sent the connect ahead of when it
+ * completed).
+ *
+ *   make bench && ./build/engine_bench [probes]
+ */
+
+#define _GNU_SOURCE  // RUSAGE_THREAD
+#include "net/probe_engine.h"
+#include "platform/platform.h"
+#include "platform/reactor.h"
+#include "syscall_count.h"
+#include <arpa/inet.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define BENCH_IN_FLIGHT     256
+#define BENCH_TIMEOUT_MS    1000
+
+typedef struct {
+    probe_engine_t *engine;
+    probe_result_t expect;
+    int in_flight;
+    uint64_t done;
+    uint64_t unexpected;
+} bench_t;
+
+typedef struct {
+    int fd;
+    atomic_bool running;
+} bench_listener_t;
+
+static void on_done(int handle, probe_result_t result, uint64_t sent_ns, uint64_t done_ns, void *ctx) {
+    bench_t *b = ctx;
+    b->unexpected += result != b->expect ||
+                     (result == PROBE_SUCCESS && (sent_ns == 0 || sent_ns > done_ns));
+    b->done++;
+    b->in_flight--;
+    probe_engine_release(b->engine, handle);
+}
+
+static void *listen_loop(void *arg) {
+    bench_listener_t *l = arg;
+    while (atomic_load(&l->running)) {
+        struct pollfd pfd = { .fd = l->fd, .events = POLLIN };
+        if (poll(&pfd, 1, 100) > 0) {
+            int c;
+            while ((c = accept(l->fd, NULL, NULL)) >= 0) {
+                close(c);
+            }
+        }
+    }
+    return NULL;
+}
+
+// A 127.0.0.1 socket bound to a free port, listening if backlog > 0.
+// Returns the fd (addr filled in), or -1.
+static int bind_local(struct sockaddr_in *addr, int backlog) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    *addr = (struct sockaddr_in){ .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(*addr);
+    if (fd < 0 || bind(fd, (struct sockaddr *)addr, sizeof(*addr)) != 0 ||
+        (backlog > 0 && listen(fd, backlog) != 0) ||
+        getsockname(fd, (struct sockaddr *)addr, &len) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static uint64_t thread_cpu_ns(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return ((uint64_t)ru.ru_utime.tv_sec + (uint64_t)ru.ru_stime.tv_sec) * 1000000000ULL +
+           ((uint64_t)ru.ru_utime.tv_usec + (uint64_t)ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+// Probe addr count times. Returns false if the engine is not available.
+static bool run(const char *engine_name, const char *target_name, const struct sockaddr_in *addr,
+                probe_result_t expect, uint64_t count, uint64_t *unexpected) {
+    bench_t b = { .expect = expect };
+    bool uring = engine_name[0] == 'i';
+    b.engine = uring ? probe_engine_uring_create(on_done, &b) : probe_engine_poll_create(on_done, &b);
+    if (b.engine == NULL) {
+        return false;
+    }
+    reactor_t reactor;
+    if (reactor_init(&reactor) != 0) {
+        probe_engine_destroy(b.engine);
+        return false;
+    }
+    probe_engine_set_reactor(b.engine, &reactor);
+
+    uint64_t started = 0;
+    syscall_count_reset();
+    uint64_t start_ns = now_ns();
+    uint64_t start_cpu = thread_cpu_ns();
+    while (b.done < count) {
+        while (b.in_flight < BENCH_IN_FLIGHT && started < count) {
+            if (probe_engine_start(b.engine, addr, BENCH_TIMEOUT_MS) < 0) {
+                b.unexpected++;
+                b.done++;
+            } else {
+                b.in_flight++;
+            }
+            started++;
+        }
+        probe_engine_flush(b.engine);
+        reactor_wait(&reactor, 100);
+    }
+    uint64_t cpu = thread_cpu_ns() - start_cpu;
+    uint64_t ns = now_ns() - start_ns;
+    uint64_t syscalls = syscall_count();
+
+    printf("%-9s %-10s %10.1fk %9.1f us", engine_name, target_name,
+           (double)count * 1e6 / (double)ns, (double)cpu / 1e3 / (double)count);
+    if (syscall_count_available()) {
+        printf(" %14.2f", (double)syscalls / (double)count);
+    }
+    printf("\n");
+
+    probe_engine_set_reactor(b.engine, NULL);
+    probe_engine_destroy(b.engine);
+    reactor_free(&reactor);
+    *unexpected += b.unexpected;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    long long count = argc > 1 ? atoll(argv[1]) : 100000;
+    if (count <= 0) {
+        fprintf(stderr, "usage: %s [probes]\n", argv[0]);
+        return 2;
+    }
+
+    // A port nothing listens on: bound, then closed
+    struct sockaddr_in refused;
+    int fd = bind_local(&refused, 0);
+    if (fd < 0) {
+        fprintf(stderr, "cannot bind to 127.0.0.1\n");
+        return 2;
+    }
+    close(fd);
+
+    struct sockaddr_in listening;
+    bench_listener_t listener;
+    atomic_init(&listener.running, true);
+    listener.fd = bind_local(&listening, 4096);
+    pthread_t listen_thread;
+    if (listener.fd < 0 || pthread_create(&listen_thread, NULL, listen_loop, &listener) != 0) {
+        fprintf(stderr, "cannot listen on 127.0.0.1\n");
+        return 2;
+    }
+
+    printf("%lld probes per case, %d in flight\n", count, BENCH_IN_FLIGHT);
+    printf("%-9s %-10s %11s %12s%s\n", "engine", "target", "probes/s", "CPU/probe",
+           syscall_count_available() ? " syscalls/probe" : "");
+    static const char *engines[] = { "poll", "io_uring" };
+    uint64_t unexpected = 0;
+    uint64_t total = 0;
+    for (int e = 0; e < 2; e++) {
+        if (!run(engines[e], "refused", &refused, PROBE_ERROR, (uint64_t)count, &unexpected)) {
+            printf("%-9s (not available)\n", engines[e]);
+            continue;
+        }
+        run(engines[e], "listener", &listening, PROBE_SUCCESS, (uint64_t)count, &unexpected);
+        total += 2 * (uint64_t)count;
+    }
+
+    atomic_store(&listener.running, false);
+    pthread_join(listen_thread, NULL);
+    close(listener.fd);
+
+    bool ok = total > 0 && unexpected * 100 <= total;
+    printf("%s (%llu of %llu probes ended unexpectedly)\n", ok ? "PASS" : "FAIL",
+           (unsigned long long)unexpected, (unsigned long long)total);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,180 @@
+/*
+ * Gorilla codec benchmark
+ *
+ * Encodes synthetic probe traces in blocks of 60, 256 and 4096 samples and
+ * decodes them back. There are five targets, with base RTTs of 0.05, 4, 12,
+ * 35 and 140 ms. Jitter is right-skewed, with 1% spikes of 2-8x. Loss is
+ * bursty (Gilbert model, ~0.5%). Probes are 500 ms apart with 0-2 ms of
+ * timer slop. Reports bytes per sample as stored (the 32 B block header and
+ * an 8 B id included), the ratio to a 24 B sample_t, and encode and decode
+ * ns per sample. Fails unless every sample decodes exactly: timestamp,
+ * success flag and RTT (to the codec's 1 us).
+ *
+ *   make bench && ./build/gorilla_bench [samples_per_target]
+ */
+
+#include "store/gorilla.h"
+#include "platform/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_TARGETS       5
+#define BENCH_INTERVAL_MS   500
+#define BENCH_BLOCK_MAX     4096
+#define BENCH_BLOCK_HEADER  (32 + 8)    // Store block header and series id
+
+static const double base_rtts_ms[BENCH_TARGETS] = { 0.05, 4.0, 12.0, 35.0, 140.0 };
+
+typedef struct {
+    uint64_t bytes;
+    uint64_t encode_ns;
+    uint64_t decode_ns;
+    uint64_t mismatches;
+} bench_result_t;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Uniform in [0, 1)
+static double next_uniform(void) {
+    return (double)(next_random() >> 11) / 9007199254740992.0;
+}
+
+static void make_trace(sample_t *trace, size_t count, double base_ms) {
+    bool lossy = false;     // Gilbert model: the bad state loses every probe
+    for (size_t i = 0; i < count; i++) {
+        lossy = lossy ? next_uniform() >= 0.2 : next_uniform() < 0.001;
+        trace[i] = (sample_t){
+            .timestamp_ms = 1700000000000ULL + i * BENCH_INTERVAL_MS + next_random() % 3,
+            .success = !lossy,
+        };
+        if (lossy) {
+            continue;
+        }
+
+        double u = next_uniform();
+        double rtt_ms = base_ms * (1.0 + 0.3 * u * u * u);
+        if (next_random() % 100 == 0) {
+            rtt_ms *= 2.0 + 6.0 * next_uniform();
+        }
+        trace[i].rtt_ms = (double)(uint64_t)(rtt_ms * 1000.0 + 0.5) / 1000.0;
+    }
+}
+
+static bool same_sample(const sample_t *a, const sample_t *b) {
+    return a->timestamp_ms == b->timestamp_ms && a->success == b->success &&
+           (!a->success || a->rtt_ms == b->rtt_ms);
+}
+
+// Encode and decode trace in blocks of block_size, adding to r
+static bool run(const sample_t *trace, size_t count, size_t block_size, uint8_t *buf, size_t buf_size,
+                sample_t *decoded, bench_result_t *r) {
+    gorilla_encoder_t enc;
+    gorilla_encoder_init(&enc);
+    for (size_t first = 0; first < count; first += block_size) {
+        size_t n = count - first < block_size ? count - first : block_size;
+
+        uint64_t start_ns = now_ns();
+        for (size_t i = 0; i < n; i++) {
+            if (gorilla_encoder_append(&enc, &trace[first + i]) != 0) {
+                gorilla_encoder_free(&enc);
+                return false;
+            }
+        }
+        size_t stream_bytes = gorilla_encoder_stream_bytes(&enc);
+        size_t runs_bytes = gorilla_encoder_runs_bytes(&enc);
+        if (stream_bytes + runs_bytes > buf_size) {
+            gorilla_encoder_free(&enc);
+            return false;
+        }
+        gorilla_encoder_finish(&enc, buf, buf + stream_bytes);
+        uint64_t mid_ns = now_ns();
+
+        gorilla_block_t block = {
+            .stream = buf,
+            .stream_bytes = stream_bytes,
+            .runs = buf + stream_bytes,
+            .runs_bytes = runs_bytes,
+            .first_ts_ms = enc.first_ts_ms,
+            .count = enc.count,
+            .first_ok = enc.first_ok,
+        };
+        size_t got = gorilla_decode(&block, decoded);
+        r->decode_ns += now_ns() - mid_ns;
+        r->encode_ns += mid_ns - start_ns;
+
+        r->bytes += (BENCH_BLOCK_HEADER + stream_bytes + runs_bytes + 7) & ~(size_t)7;
+        r->mismatches += got != n;
+        for (size_t i = 0; i < got && i < n; i++) {
+            r->mismatches += !same_sample(&decoded[i], &trace[first + i]);
+        }
+        gorilla_encoder_reset(&enc);
+    }
+    gorilla_encoder_free(&enc);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    static const size_t block_sizes[] = { 60, 256, BENCH_BLOCK_MAX };
+    long long per_target = argc > 1 ? atoll(argv[1]) : 1000000;
+    if (per_target <= 0) {
+        fprintf(stderr, "usage: %s [samples_per_target]\n", argv[0]);
+        return 2;
+    }
+    size_t count = (size_t)per_target;
+
+    size_t buf_size = BENCH_BLOCK_MAX * 2 * sizeof(sample_t);
+    sample_t *traces[BENCH_TARGETS];
+    sample_t *decoded = malloc(BENCH_BLOCK_MAX * sizeof(*decoded));
+    uint8_t *buf = malloc(buf_size);
+    if (decoded == NULL || buf == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    for (int t = 0; t < BENCH_TARGETS; t++) {
+        traces[t] = malloc(count * sizeof(sample_t));
+        if (traces[t] == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 2;
+        }
+        make_trace(traces[t], count, base_rtts_ms[t]);
+    }
+
+    printf("%d targets x %zu samples, %d ms apart\n", BENCH_TARGETS, count, BENCH_INTERVAL_MS);
+    printf("%6s %10s %14s %11s %11s\n", "block", "B/sample", "ratio vs 24 B", "encode", "decode");
+    uint64_t mismatches = 0;
+    for (size_t b = 0; b < sizeof(block_sizes) / sizeof(block_sizes[0]); b++) {
+        bench_result_t r = { 0 };
+        for (int t = 0; t < BENCH_TARGETS; t++) {
+            if (!run(traces[t], count, block_sizes[b], buf, buf_size, decoded, &r)) {
+                fprintf(stderr, "encoding failed\n");
+                return 2;
+            }
+        }
+        mismatches += r.mismatches;
+
+        double total = (double)count * BENCH_TARGETS;
+        double per_sample = (double)r.bytes / total;
+        printf("%6zu %10.2f %13.1fx %8.1f ns %8.1f ns\n", block_sizes[b], per_sample,
+               (double)sizeof(sample_t) / per_sample, (double)r.encode_ns / total,
+               (double)r.decode_ns / total);
+    }
+
+    for (int t = 0; t < BENCH_TARGETS; t++) {
+        free(traces[t]);
+    }
+    free(decoded);
+    free(buf);
+
+    bool ok = mismatches == 0;
+    printf("%s (%llu samples did not decode exactly)\n", ok ? "PASS" : "FAIL",
+           (unsigned long long)mismatches);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,185 @@
+/*
+ * WebSocket broadcast benchmark
+ *
+ * Broadcasts 110 B and 900 B text messages to 11, 65, 218 and 1019 fake
+ * WebSocket connections, two ways: with mg_ws_send on every connection of
+ * the list marked 'W', as server_broadcast_ws used to, and through a
+ * ws_hub_t, as it does now. Every 16 broadcasts the send buffers are
+ * drained, as the socket would, and the hub's clients flushed. Reports
+ * CPU per broadcast (draining excluded). Fails unless both ways put the
+ * same bytes in every client's send buffer.
+ *
+ *   make bench && ./build/hub_bench [broadcasts]
+ */
+
+#include "server/ws_hub.h"
+#include "platform/platform.h"
+#include "mongoose.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_DRAIN_EVERY   16
+
+typedef struct {
+    struct mg_connection *conns;    // Linked through next, as mgr->conns
+    uint64_t *hashes;               // Of what each connection was sent
+    uint64_t bytes;
+    uint64_t ns;
+} bench_run_t;
+
+// FNV-1a, continued from h
+static uint64_t hash_bytes(uint64_t h, const uint8_t *p, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Take what every connection has to send, as its socket would
+static void drain(bench_run_t *run, int clients) {
+    for (int i = 0; i < clients; i++) {
+        struct mg_connection *c = &run->conns[i];
+        run->hashes[i] = hash_bytes(run->hashes[i], c->send.buf, c->send.len);
+        run->bytes += c->send.len;
+        c->send.len = 0;
+    }
+}
+
+static bool run_init(bench_run_t *run, int clients) {
+    memset(run, 0, sizeof(*run));
+    run->conns = calloc((size_t)clients, sizeof(*run->conns));
+    run->hashes = malloc((size_t)clients * sizeof(*run->hashes));
+    if (run->conns == NULL || run->hashes == NULL) {
+        return false;
+    }
+    for (int i = 0; i < clients; i++) {
+        struct mg_connection *c = &run->conns[i];
+        c->next = i + 1 < clients ? &run->conns[i + 1] : NULL;
+        c->id = (unsigned long)i + 1;
+        c->data[0] = 'W';
+        c->send.align = MG_IO_SIZE;
+        run->hashes[i] = 0xcbf29ce484222325ULL;
+    }
+    return true;
+}
+
+static void run_free(bench_run_t *run, int clients) {
+    for (int i = 0; i < clients; i++) {
+        mg_iobuf_free(&run->conns[i].send);
+    }
+    free(run->conns);
+    free(run->hashes);
+}
+
+// The walk server_broadcast_ws used to do
+static void broadcast_each(struct mg_connection *conns, const char *msg, size_t len) {
+    for (struct mg_connection *c = conns; c != NULL; c = c->next) {
+        if (c->data[0] == 'W') {
+            mg_ws_send(c, msg, len, WEBSOCKET_OP_TEXT);
+        }
+    }
+}
+
+static bool run_each(int clients, const char *msg, size_t len, int broadcasts, bench_run_t *run) {
+    if (!run_init(run, clients)) {
+        return false;
+    }
+    for (int b = 0; b < broadcasts; b += BENCH_DRAIN_EVERY) {
+        uint64_t start_ns = now_ns();
+        for (int k = b; k < b + BENCH_DRAIN_EVERY && k < broadcasts; k++) {
+            broadcast_each(run->conns, msg, len);
+        }
+        run->ns += now_ns() - start_ns;
+        drain(run, clients);
+    }
+    return true;
+}
+
+static bool run_hub(int clients, const char *msg, size_t len, int broadcasts, bench_run_t *run) {
+    ws_hub_t hub;
+    memset(&hub, 0, sizeof(hub));
+    ws_client_t **subscribers = malloc((size_t)clients * sizeof(*subscribers));
+    if (subscribers == NULL || !run_init(run, clients)) {
+        free(subscribers);
+        return false;
+    }
+    for (int i = 0; i < clients; i++) {
+        subscribers[i] = ws_hub_join(&hub, &run->conns[i], WS_PROTOCOL_JSON, WS_DEFLATE_OFF);
+        if (subscribers[i] == NULL) {
+            free(subscribers);
+            ws_hub_free(&hub);
+            return false;
+        }
+    }
+
+    for (int b = 0; b < broadcasts; b += BENCH_DRAIN_EVERY) {
+        uint64_t start_ns = now_ns();
+        for (int i = 0; i < clients; i++) {
+            ws_hub_flush(&hub, subscribers[i]);
+        }
+        for (int k = b; k < b + BENCH_DRAIN_EVERY && k < broadcasts; k++) {
+            ws_hub_broadcast(&hub, WS_PROTOCOL_ANY, msg, len, WEBSOCKET_OP_TEXT);
+        }
+        run->ns += now_ns() - start_ns;
+        drain(run, clients);
+    }
+
+    // Whatever is still queued
+    size_t backlog;
+    do {
+        backlog = 0;
+        for (int i = 0; i < clients; i++) {
+            ws_hub_flush(&hub, subscribers[i]);
+            backlog += ws_hub_backlog(subscribers[i]);
+        }
+        drain(run, clients);
+    } while (backlog > 0);
+
+    ws_hub_free(&hub);
+    free(subscribers);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    static const int client_counts[] = { 11, 65, 218, 1019 };
+    static const size_t sizes[] = { 110, 900 };
+    int broadcasts = argc > 1 ? atoi(argv[1]) : 4096;
+    if (broadcasts <= 0) {
+        fprintf(stderr, "usage: %s [broadcasts]\n", argv[0]);
+        return 2;
+    }
+
+    char msg[900];
+    for (size_t i = 0; i < sizeof(msg); i++) {
+        msg[i] = (char)('a' + i % 26);
+    }
+
+    printf("%d broadcasts, drained every %d\n", broadcasts, BENCH_DRAIN_EVERY);
+    printf("%8s %10s %12s %12s\n", "clients", "message", "each", "hub");
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(client_counts) / sizeof(client_counts[0]); i++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            int clients = client_counts[i];
+            bench_run_t each, hub;
+            if (!run_each(clients, msg, sizes[s], broadcasts, &each) ||
+                !run_hub(clients, msg, sizes[s], broadcasts, &hub)) {
+                fprintf(stderr, "out of memory at %d clients\n", clients);
+                return 2;
+            }
+            bool same = each.bytes == hub.bytes &&
+                        memcmp(each.hashes, hub.hashes, (size_t)clients * sizeof(uint64_t)) == 0;
+            if (!same) {
+                fprintf(stderr, "%d clients, %zu B: hub sent different bytes\n", clients, sizes[s]);
+                ok = false;
+            }
+            printf("%8d %8zu B %9.2f us %9.2f us\n", clients, sizes[s],
+                   (double)each.ns / 1e3 / broadcasts, (double)hub.ns / 1e3 / broadcasts);
+            run_free(&each, clients);
+            run_free(&hub, clients);
+        }
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+ * ICMP batching benchmark
+ *
+ * Pings 127.0.0.1 in rounds of N Echo Requests (16 to 1000), waiting for
+ * each round's replies before the next. Each round is done two ways: sent
+ * one icmp_probe_send() each and read one icmp_probe_recv() each, and sent
+ * icmp_probe_queue()/icmp_probe_flush() and read with icmp_probe_recv_batch(),
+ * as the scheduler does. Reports probes/s and (on Linux, see
+ * syscall_count.h) syscalls per probe. Fails if more than 1% of replies go
+ * missing. Needs raw sockets (root or CAP_NET_RAW); skipped without them.
+ *
+ *   make bench && ./build/icmp_bench [probes]
+ */
+
+#include "net/icmp_probe.h"
+#include "platform/platform.h"
+#include "syscall_count.h"
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_HOST          "127.0.0.1"
+#define BENCH_WAIT_MS       100     // For a round's replies, after the last one
+
+typedef struct {
+    double probes_per_s;
+    double syscalls_per_probe;
+    uint64_t probes;
+    uint64_t lost;
+} bench_result_t;
+
+// Read replies until count arrived or none for BENCH_WAIT_MS. Returns the
+// number that never came.
+static uint64_t collect(icmp_probe_state_t *icmp, int count, bool batched) {
+    int got = 0;
+    while (got < count) {
+        int n;
+        if (batched) {
+            icmp_reply_t replies[ICMP_BATCH_MAX];
+            n = icmp_probe_recv_batch(icmp, replies, ICMP_BATCH_MAX);
+        } else {
+            icmp_reply_t reply;
+            n = icmp_probe_recv(icmp, &reply);
+        }
+        if (n > 0) {
+            got += n;
+            continue;
+        }
+
+        struct pollfd pfd = { .fd = icmp->sock, .events = POLLIN };
+        if (n < 0 || poll(&pfd, 1, BENCH_WAIT_MS) <= 0) {
+            break;
+        }
+    }
+    return (uint64_t)(count - got);
+}
+
+static bench_result_t run(icmp_probe_state_t *icmp, int round, int probes, bool batched) {
+    bench_result_t r = { 0 };
+    int rounds = probes / round > 0 ? probes / round : 1;
+    uint16_t seq;
+    uint32_t addr;
+
+    syscall_count_reset();
+    uint64_t start_ns = now_ns();
+    for (int k = 0; k < rounds; k++) {
+        int sent = 0;
+        for (int i = 0; i < round; i++) {
+            if (batched) {
+                if (icmp_probe_queue(icmp, BENCH_HOST, &seq, &addr) == 0) {
+                    sent++;
+                }
+                if (icmp_probe_queued(icmp) == ICMP_BATCH_MAX) {
+                    icmp_probe_flush(icmp, NULL, NULL);
+                }
+            } else if (icmp_probe_send(icmp, BENCH_HOST, &seq, &addr) == 0) {
+                sent++;
+            }
+        }
+        if (batched) {
+            icmp_probe_flush(icmp, NULL, NULL);
+        }
+        r.lost += (uint64_t)(round - sent) + collect(icmp, sent, batched);
+    }
+    uint64_t ns = now_ns() - start_ns;
+
+    r.probes = (uint64_t)rounds * (uint64_t)round;
+    r.probes_per_s = (double)r.probes * 1e9 / (double)ns;
+    r.syscalls_per_probe = (double)syscall_count() / (double)r.probes;
+    return r;
+}
+
+int main(int argc, char **argv) {
+    static const int rounds[] = { 16, 64, 256, 1000 };
+    int probes = argc > 1 ? atoi(argv[1]) : 200000;
+    if (probes <= 0) {
+        fprintf(stderr, "usage: %s [probes]\n", argv[0]);
+        return 2;
+    }
+
+    icmp_probe_state_t icmp;
+    if (icmp_probe_init(&icmp) != 0) {
+        printf("SKIP (ICMP not available: %s)\n", icmp_probe_unavailable_reason());
+        icmp_probe_cleanup(&icmp);
+        return 0;
+    }
+
+    bool counted = syscall_count_available();
+    printf("%d Echo Requests to %s per case, in rounds of N\n", probes, BENCH_HOST);
+    printf("%6s %16s %16s %16s %16s\n", "N", "single probes/s", "batched probes/s",
+           counted ? "single sys/probe" : "", counted ? "batched sys/probe" : "");
+
+    uint64_t lost = 0;
+    uint64_t total = 0;
+    for (size_t i = 0; i < sizeof(rounds) / sizeof(rounds[0]); i++) {
+        bench_result_t single = run(&icmp, rounds[i], probes, false);
+        bench_result_t batched = run(&icmp, rounds[i], probes, true);
+        lost += single.lost + batched.lost;
+        total += single.probes + batched.probes;
+
+        printf("%6d %16.0f %16.0f", rounds[i], single.probes_per_s, batched.probes_per_s);
+        if (counted) {
+            printf(" %16.2f %16.2f", single.syscalls_per_probe, batched.syscalls_per_probe);
+        }
+        printf("\n");
+    }
+    icmp_probe_cleanup(&icmp);
+
+    bool ok = lost * 100 <= total;
+    printf("%s (%llu of %llu replies missing)\n", ok ? "PASS" : "FAIL",
+           (unsigned long long)lost, (unsigned long long)total);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+/*
+ * Snapshot JSON benchmark
+ *
+ * Builds the WebSocket snapshot message with ws_build_snapshot_msg for 2
+ * (the default targets), 10, 100 and 1000 targets with full sample windows,
+ * and reports its size and best and median build time. One target label
+ * holds a quote and a backslash. Fails unless every message parses as JSON
+ * with every target in it and that label read back intact.
+ *
+ *   make bench && ./build/json_bench
+ */
+
+#include "core/config.h"
+#include "core/scheduler.h"
+#include "server/json_writer.h"
+#include "server/ws_handlers.h"
+#include "server/target_view.h"
+#include "platform/platform.h"
+#include "mongoose.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_RUNS_MAX      2001
+#define BENCH_LABEL         "bench \"quoted\" \\ label"
+
+typedef struct {
+    int targets;
+    size_t bytes;
+    uint64_t best_ns;
+    uint64_t median_ns;
+    bool valid;
+} bench_result_t;
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// A window's worth of samples for every target, as the server gets them
+static void fill_windows(scheduler_t *sched, target_view_t *view) {
+    for (uint64_t round = 0; round < DEFAULT_WINDOW_SIZE; round++) {
+        for (int i = 0; i < sched->target_count; i++) {
+            target_state_t *ts = &sched->targets[i];
+            uint64_t j = round + (uint64_t)i;
+            sample_t s = {
+                .timestamp_ms = 1700000000000ULL + round * 500,
+                .success = j % 25 != 0,
+                .rtt_ms = j % 25 != 0 ? 0.5 + (double)(j * 7919 % 150000) / 1000.0 : 0.0,
+            };
+            stats_window_push(&ts->window, &s);
+            stats_compute(&ts->window, &ts->metrics);
+            target_view_push_sample(view, i, &s);
+            target_view_set_metrics(view, i, &ts->metrics);
+        }
+    }
+}
+
+// Whether msg is one JSON value holding count targets, the last one
+// labelled BENCH_LABEL if there are more than the defaults
+static bool check_message(const char *msg, size_t len, int count) {
+    struct mg_str json = mg_str_n(msg, len);
+    int toklen = 0;
+    if (mg_json_get(json, "$", &toklen) != 0 || (size_t)toklen != len) {
+        return false;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "$.targets[%d]", count - 1);
+    bool ok = mg_json_get(json, path, &toklen) > 0;
+    snprintf(path, sizeof(path), "$.targets[%d]", count);
+    ok = ok && mg_json_get(json, path, &toklen) < 0;
+    if (ok && count > 2) {
+        snprintf(path, sizeof(path), "$.targets[%d].label", count - 1);
+        char *label = mg_json_get_str(json, path);
+        ok = label != NULL && strcmp(label, BENCH_LABEL) == 0;
+        free(label);
+    }
+    return ok;
+}
+
+static bool run(int targets, bench_result_t *out) {
+    config_t config;
+    config_init(&config);
+    for (int k = config.target_count; k < targets; k++) {
+        char label[MAX_LABEL_LEN];
+        if (k == targets - 1) {
+            snprintf(label, sizeof(label), "%s", BENCH_LABEL);
+        } else {
+            snprintf(label, sizeof(label), "bench-%d", k);
+        }
+        config_add_target(&config, "127.0.0.1", 9, label);
+    }
+    scheduler_t scheduler;
+    if (scheduler_init(&scheduler, &config) != 0) {
+        config_free(&config);
+        return false;
+    }
+    target_view_t view;
+    target_view_init(&view);
+    if (target_view_load(&view, &scheduler) != 0) {
+        scheduler_free(&scheduler);
+        config_free(&config);
+        return false;
+    }
+    fill_windows(&scheduler, &view);
+
+    // Each run takes the writer from the pool, as a handler does
+    static uint64_t runs[BENCH_RUNS_MAX];
+    int count = 2000 / targets < 10 ? 11 : (2000 / targets) | 1;
+    bench_result_t r = { .targets = view.count, .valid = true };
+    for (int i = 0; i < count; i++) {
+        json_writer_t w;
+        uint64_t start_ns = now_ns();
+        json_writer_init(&w);
+        int rc = ws_build_snapshot_msg(&w, &config, &view, "bench", 1);
+        runs[i] = now_ns() - start_ns;
+        if (i == 0) {
+            r.bytes = w.len;
+            r.valid = rc == 0 && check_message(w.buf, w.len, view.count);
+        }
+        json_writer_free(&w);
+    }
+    qsort(runs, (size_t)count, sizeof(runs[0]), compare_u64);
+    r.best_ns = runs[0];
+    r.median_ns = runs[count / 2];
+
+    target_view_free(&view);
+    scheduler_free(&scheduler);
+    config_free(&config);
+    *out = r;
+    return true;
+}
+
+int main(void) {
+    static const int sizes[] = { 2, 10, 100, 1000 };
+    enum { SIZE_COUNT = sizeof(sizes) / sizeof(sizes[0]) };
+
+    bench_result_t results[SIZE_COUNT];
+    for (size_t i = 0; i < SIZE_COUNT; i++) {
+        if (!run(sizes[i], &results[i])) {
+            fprintf(stderr, "cannot set up %d targets\n", sizes[i]);
+            return 2;
+        }
+    }
+
+    printf("snapshot with %d samples per target\n", DEFAULT_WINDOW_SIZE);
+    printf("%8s %10s %12s %12s %6s\n", "targets", "bytes", "best", "median", "JSON");
+    bool ok = true;
+    for (size_t i = 0; i < SIZE_COUNT; i++) {
+        const bench_result_t *r = &results[i];
+        ok = ok && r->valid;
+        printf("%8d %10zu %9.1f us %9.1f us %6s\n", r->targets, r->bytes, (double)r->best_ns / 1e3,
+               (double)r->median_ns / 1e3, r->valid ? "ok" : "BAD");
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,336 @@
+/*
+ * Probe accuracy under server load benchmark
+ *
+ * Probes targets on a local listener (true RTT well under a millisecond)
+ * while the server side is kept busy building dashboard snapshots of 500
+ * full targets back to back, as a storm of WebSocket connects does. Run
+ * three ways for the same time:
+ *   idle          probe thread, no load (the baseline)
+ *   one thread    scheduler ticks between snapshot builds on one thread,
+ *                 as before the probe thread
+ *   probe thread  the scheduler on its probe thread, the snapshot builds
+ *                 and update drains on this one
+ * and reports the RTT percentiles and the timestamp skew: how much later
+ * than one interval after a target's previous sample each sample came.
+ * Fails if, with the probe thread under load, the p99 of either is over
+ * the bound.
+ *
+ *   make bench && ./build/probe_bench [targets] [seconds] [bound_ms]
+ */
+
+#include "core/config.h"
+#include "core/scheduler.h"
+#include "core/probe_thread.h"
+#include "server/ws_handlers.h"
+#include "server/target_view.h"
+#include "platform/platform.h"
+#include "platform/reactor.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define BENCH_INTERVAL_MS   200
+#define BENCH_LOAD_TARGETS  500
+#define BENCH_WARMUP_MS     1000    // Samples before this are not counted
+
+typedef struct {
+    double *rtts;
+    double *skews;
+    size_t count;
+    size_t capacity;
+    size_t failures;
+    uint64_t *last_ms;              // Per target: previous sample's timestamp
+    uint64_t counted_from_ms;       // Wall clock: samples from here on count
+} bench_samples_t;
+
+typedef struct {
+    int fd;
+    atomic_bool running;
+} bench_listener_t;
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Accept and close connections until stopped
+static void *listen_loop(void *arg) {
+    bench_listener_t *l = arg;
+    while (atomic_load(&l->running)) {
+        struct pollfd pfd = { .fd = l->fd, .events = POLLIN };
+        if (poll(&pfd, 1, 100) > 0) {
+            int c;
+            while ((c = accept(l->fd, NULL, NULL)) >= 0) {
+                close(c);
+            }
+        }
+    }
+    return NULL;
+}
+
+// Listening socket on 127.0.0.1, any port. Returns the port, or 0.
+static uint16_t listen_local(bench_listener_t *l) {
+    l->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+    if (l->fd < 0 || bind(l->fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(l->fd, 4096) != 0 || getsockname(l->fd, (struct sockaddr *)&addr, &len) != 0) {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+static void record_sample(bench_samples_t *b, int index, const sample_t *sample) {
+    uint64_t last = b->last_ms[index];
+    b->last_ms[index] = sample->timestamp_ms;
+    if (sample->timestamp_ms < b->counted_from_ms || last == 0) {
+        return;
+    }
+    if (!sample->success) {
+        b->failures++;
+        return;
+    }
+
+    if (b->count == b->capacity) {
+        size_t capacity = b->capacity > 0 ? b->capacity * 2 : 4096;
+        double *rtts = realloc(b->rtts, capacity * sizeof(*rtts));
+        double *skews = rtts != NULL ? realloc(b->skews, capacity * sizeof(*skews)) : NULL;
+        if (skews == NULL) {
+            b->rtts = rtts != NULL ? rtts : b->rtts;
+            return;
+        }
+        b->rtts = rtts;
+        b->skews = skews;
+        b->capacity = capacity;
+    }
+    b->rtts[b->count] = sample->rtt_ms;
+    b->skews[b->count] = (double)sample->timestamp_ms - (double)last - BENCH_INTERVAL_MS;
+    b->count++;
+}
+
+static void on_bench_sample(int index, const char *target_id, const sample_t *sample, void *ctx) {
+    (void)target_id;
+    record_sample(ctx, index, sample);
+}
+
+static void on_probe_msg(const probe_msg_t *msg, void *ctx) {
+    if (msg->type == PROBE_MSG_SAMPLE) {
+        record_sample(ctx, msg->index, &msg->u.sample);
+    }
+}
+
+static double percentile(double *sorted, size_t count, double pct) {
+    if (count == 0) {
+        return 0.0;
+    }
+    size_t i = (size_t)(pct / 100.0 * (double)(count - 1) + 0.5);
+    return sorted[i];
+}
+
+// Print a run's results; returns the larger of the RTT and skew p99
+static double report(const char *name, bench_samples_t *b, uint64_t builds) {
+    qsort(b->rtts, b->count, sizeof(*b->rtts), compare_doubles);
+    qsort(b->skews, b->count, sizeof(*b->skews), compare_doubles);
+    size_t slow = 0;
+    for (size_t i = 0; i < b->count; i++) {
+        slow += b->rtts[i] > 5.0;
+    }
+
+    double rtt_p99 = percentile(b->rtts, b->count, 99.0);
+    double skew_p99 = percentile(b->skews, b->count, 99.0);
+    printf("%-13s %7zu %5zu %6llu %8.2f %8.2f %8.2f %6.1f%% %9.2f %9.2f\n",
+           name, b->count, b->failures, (unsigned long long)builds,
+           percentile(b->rtts, b->count, 50.0), rtt_p99, percentile(b->rtts, b->count, 99.9),
+           b->count > 0 ? 100.0 * (double)slow / (double)b->count : 0.0,
+           percentile(b->skews, b->count, 50.0), skew_p99);
+    return rtt_p99 > skew_p99 ? rtt_p99 : skew_p99;
+}
+
+static void samples_init(bench_samples_t *b, int targets) {
+    memset(b, 0, sizeof(*b));
+    b->last_ms = calloc((size_t)targets + 1, sizeof(*b->last_ms));
+    b->counted_from_ms = wall_clock_ms() + BENCH_WARMUP_MS;
+}
+
+static void samples_free(bench_samples_t *b) {
+    free(b->rtts);
+    free(b->skews);
+    free(b->last_ms);
+}
+
+// One snapshot of the loaded view, as a connecting client gets
+static void build_snapshot(json_writer_t *w, config_t *config, target_view_t *view) {
+    w->len = 0;
+    ws_build_snapshot_msg(w, config, view, "bench", 1);
+}
+
+// The scheduler on this thread, ticking between snapshot builds
+static bool run_one_thread(config_t *probe_config, int seconds, bench_samples_t *b,
+                           config_t *load_config, target_view_t *view, json_writer_t *w,
+                           uint64_t *builds) {
+    scheduler_t sched;
+    reactor_t reactor;
+    if (scheduler_init(&sched, probe_config) != 0) {
+        return false;
+    }
+    if (reactor_init(&reactor) != 0) {
+        scheduler_free(&sched);
+        return false;
+    }
+    scheduler_set_reactor(&sched, &reactor);
+    scheduler_set_sample_callback(&sched, on_bench_sample, b);
+
+    uint64_t end_ms = now_ms() + (uint64_t)seconds * 1000;
+    while (now_ms() < end_ms) {
+        scheduler_tick(&sched);
+        build_snapshot(w, load_config, view);
+        (*builds)++;
+        reactor_wait(&reactor, 0);
+    }
+
+    scheduler_set_sample_callback(&sched, NULL, NULL);
+    scheduler_set_reactor(&sched, NULL);
+    reactor_free(&reactor);
+    scheduler_free(&sched);
+    return true;
+}
+
+// The scheduler on its probe thread; this one builds snapshots (if load)
+// and drains the updates
+static bool run_probe_thread(config_t *probe_config, int seconds, bench_samples_t *b, bool load,
+                             config_t *load_config, target_view_t *view, json_writer_t *w,
+                             uint64_t *builds) {
+    scheduler_t sched;
+    probe_thread_t *pt = aligned_alloc(SPSC_RING_CACHE_LINE, sizeof(probe_thread_t));
+    if (pt == NULL || scheduler_init(&sched, probe_config) != 0) {
+        free(pt);
+        return false;
+    }
+    if (probe_thread_init(pt, &sched, -1) != 0 || probe_thread_start(pt, NULL, NULL) != 0) {
+        probe_thread_free(pt);
+        scheduler_free(&sched);
+        free(pt);
+        return false;
+    }
+
+    uint64_t end_ms = now_ms() + (uint64_t)seconds * 1000;
+    while (now_ms() < end_ms) {
+        if (load) {
+            build_snapshot(w, load_config, view);
+            (*builds)++;
+        } else {
+            poll(NULL, 0, 1);
+        }
+        probe_thread_drain(pt, on_probe_msg, b);
+    }
+
+    probe_thread_stop(pt);
+    probe_thread_drain(pt, on_probe_msg, b);
+    probe_thread_free(pt);
+    scheduler_free(&sched);
+    free(pt);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int targets = argc > 1 ? atoi(argv[1]) : 200;
+    int seconds = argc > 2 ? atoi(argv[2]) : 5;
+    double bound_ms = argc > 3 ? atof(argv[3]) : 25.0;
+    if (targets <= 0 || targets > 10000 || seconds <= 1) {
+        fprintf(stderr, "usage: %s [targets 1-10000] [seconds > 1] [bound_ms]\n", argv[0]);
+        return 2;
+    }
+
+    bench_listener_t listener;
+    atomic_init(&listener.running, true);
+    uint16_t port = listen_local(&listener);
+    pthread_t listen_thread;
+    if (port == 0 || pthread_create(&listen_thread, NULL, listen_loop, &listener) != 0) {
+        fprintf(stderr, "cannot listen on 127.0.0.1\n");
+        return 2;
+    }
+
+    // Probed: targets on the listener, no defaults
+    config_t probe_config;
+    config_init(&probe_config);
+    while (probe_config.target_count > 0) {
+        config_remove_target(&probe_config, probe_config.targets[0].id);
+    }
+    for (int k = 0; k < targets; k++) {
+        char label[32];
+        snprintf(label, sizeof(label), "local-%d", k);
+        config_add_target(&probe_config, "127.0.0.1", port, label);
+    }
+    probe_config.probe_interval_ms = BENCH_INTERVAL_MS;
+
+    // Snapshot load: 500 targets with full windows
+    config_t load_config;
+    config_init(&load_config);
+    target_view_t view;
+    target_view_init(&view);
+    for (int k = 0; k < BENCH_LOAD_TARGETS; k++) {
+        char label[32];
+        snprintf(label, sizeof(label), "load-%d", k);
+        config_add_target(&load_config, "127.0.0.1", 9, label);
+    }
+    for (int k = 0; k < load_config.target_count; k++) {
+        int index = target_view_add(&view, &load_config.targets[k]);
+        for (uint64_t r = 0; index >= 0 && r < DEFAULT_WINDOW_SIZE; r++) {
+            uint64_t j = r + (uint64_t)k;
+            sample_t s = {
+                .timestamp_ms = 1700000000000ULL + r * 500,
+                .success = j % 25 != 0,
+                .rtt_ms = j % 25 != 0 ? 0.5 + (double)(j * 7919 % 150000) / 1000.0 : 0.0,
+            };
+            target_view_push_sample(&view, index, &s);
+        }
+    }
+    json_writer_t w;
+    json_writer_init(&w);
+    build_snapshot(&w, &load_config, &view);
+
+    printf("%d targets on 127.0.0.1:%u every %d ms, %d s each; load: %zu byte snapshots of %d targets\n",
+           targets, port, BENCH_INTERVAL_MS, seconds, w.len, view.count);
+    printf("%-13s %7s %5s %6s %8s %8s %8s %7s %9s %9s\n", "", "samples", "fails", "builds",
+           "rtt p50", "p99", "p99.9", ">5ms", "skew p50", "p99");
+
+    bench_samples_t idle, one, probe;
+    uint64_t idle_builds = 0, one_builds = 0, probe_builds = 0;
+    samples_init(&idle, targets);
+    samples_init(&one, targets);
+    samples_init(&probe, targets);
+    bool ran = run_probe_thread(&probe_config, seconds, &idle, false, &load_config, &view, &w, &idle_builds);
+    report("idle", &idle, idle_builds);
+    one.counted_from_ms = wall_clock_ms() + BENCH_WARMUP_MS;
+    ran = ran && run_one_thread(&probe_config, seconds, &one, &load_config, &view, &w, &one_builds);
+    report("one thread", &one, one_builds);
+    probe.counted_from_ms = wall_clock_ms() + BENCH_WARMUP_MS;
+    ran = ran && run_probe_thread(&probe_config, seconds, &probe, true, &load_config, &view, &w, &probe_builds);
+    double worst = report("probe thread", &probe, probe_builds);
+
+    // Enough samples to go by: at least half of those due
+    size_t expected = (size_t)targets * (size_t)(seconds * 1000 - BENCH_WARMUP_MS) / BENCH_INTERVAL_MS;
+    bool ok = ran && probe.count >= expected / 2 && probe.failures == 0 && worst <= bound_ms;
+
+    atomic_store(&listener.running, false);
+    pthread_join(listen_thread, NULL);
+    close(listener.fd);
+    samples_free(&idle);
+    samples_free(&one);
+    samples_free(&probe);
+    json_writer_free(&w);
+    target_view_free(&view);
+    config_free(&load_config);
+    config_free(&probe_config);
+
+    printf("%s (probe thread under load: p99 RTT and skew within %.0f ms)\n",
+           ok ? "PASS" : "FAIL", bound_ms);
+    return ok ? 0 : 1;
+}
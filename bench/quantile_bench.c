@@ -0,0 +1,236 @@
+/*
+ * RTT percentile benchmark
+ *
+ * Pushes lognormal RTTs (median 15 ms, a tenth of them around 50 us, 2%
+ * failures) through stats windows of 120, 1200 and 12000 samples, three
+ * windows' worth so the sketch also follows evictions. Every so often after
+ * the window fills, p50/p95/p99/p99.9 read from the window's quantile
+ * sketch are compared with stats_compute_percentile(), the exact qsort
+ * reference. Fails if any is off by more than the bound in core/quantile.h:
+ * 1/64 (1.6%) relative, or 0.5 us. Also fails if a percentile published by
+ * stats_compute() or long_windows_compute() is above that window's max,
+ * checked there and on windows holding one RTT over and over (sketch
+ * answers are bucket midpoints).
+ *
+ * Then times, per window size: the qsort reference for p50 and p95 (what
+ * stats_compute used to do), the sketch query for all four, and the sketch
+ * upkeep per push (one remove, one add).
+ *
+ *   make bench && ./build/quantile_bench
+ */
+
+#include "core/quantile.h"
+#include "core/stats.h"
+#include "platform/platform.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_LOSS_PCT      2
+#define BENCH_CHECKS        200     // Comparisons per window size
+#define BENCH_ABS_BOUND     0.0005  // ms
+#define BENCH_REL_BOUND     (1.0 / 64.0)
+
+static const double percentiles[] = { 50.0, 95.0, 99.0, 99.9 };
+#define PERCENTILE_COUNT    (sizeof(percentiles) / sizeof(percentiles[0]))
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Uniform in (0, 1)
+static double next_uniform(void) {
+    return ((double)(next_random() >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static sample_t make_sample(uint64_t i) {
+    sample_t s = { .timestamp_ms = 1700000000000ULL + i * 500, .success = true };
+    if (next_random() % 100 < BENCH_LOSS_PCT) {
+        s.success = false;
+        return s;
+    }
+
+    // Box-Muller normal, then exp: lognormal around the chosen median
+    double normal = sqrt(-2.0 * log(next_uniform())) * cos(2.0 * M_PI * next_uniform());
+    double median_ms = next_random() % 10 == 0 ? 0.05 : 15.0;
+    s.rtt_ms = median_ms * exp(0.6 * normal);
+    return s;
+}
+
+typedef struct {
+    double max_rel_err;
+    uint64_t violations;
+    uint64_t above_max;         // Published percentiles above the max
+    double qsort_ns;            // p50 + p95
+    double sketch_ns;           // p50, p95, p99, p99.9
+    double upkeep_ns;           // Per push
+} bench_result_t;
+
+// Published percentiles of w and lw that are above their max
+static uint64_t count_above_max(const stats_window_t *w, long_windows_t *lw, uint64_t now_ms) {
+    metrics_t m;
+    stats_compute(w, &m);
+    uint64_t above = (m.p50_ms > m.max_rtt_ms) + (m.p95_ms > m.max_rtt_ms) +
+                     (m.p99_ms > m.max_rtt_ms) + (m.p999_ms > m.max_rtt_ms);
+
+    window_metrics_t lm[LONG_WINDOW_COUNT];
+    long_windows_compute(lw, now_ms, lm);
+    for (int i = 0; i < LONG_WINDOW_COUNT; i++) {
+        above += (lm[i].p50_ms > lm[i].max_rtt_ms) + (lm[i].p95_ms > lm[i].max_rtt_ms) +
+                 (lm[i].p99_ms > lm[i].max_rtt_ms);
+    }
+    return above;
+}
+
+// Windows of capacity samples all with RTT rtt_ms
+static uint64_t run_constant(size_t capacity, double rtt_ms) {
+    static long_windows_t lw;
+    void *storage = calloc(1, stats_window_storage_size(capacity));
+    stats_window_t w;
+    if (storage == NULL || stats_window_init(&w, capacity, storage) != 0) {
+        free(storage);
+        return 1;
+    }
+    memset(&lw, 0, sizeof(lw));
+    sample_t s = { .success = true, .rtt_ms = rtt_ms };
+    for (size_t i = 0; i < capacity; i++) {
+        s.timestamp_ms = 1700000000000ULL + i * 500;
+        stats_window_push(&w, &s);
+        long_windows_push(&lw, true, rtt_ms, i * 500);
+    }
+    uint64_t above = count_above_max(&w, &lw, capacity * 500);
+    free(storage);
+    return above;
+}
+
+static bool run(size_t capacity, bench_result_t *out) {
+    static long_windows_t lw;
+    memset(&lw, 0, sizeof(lw));
+    bench_result_t r = { 0 };
+    void *storage = calloc(1, stats_window_storage_size(capacity));
+    double *scratch = malloc(capacity * sizeof(*scratch));
+    size_t pushes = 3 * capacity;
+    sample_t *stream = malloc(pushes * sizeof(*stream));
+    stats_window_t w;
+    if (storage == NULL || scratch == NULL || stream == NULL ||
+        stats_window_init(&w, capacity, storage) != 0) {
+        free(storage);
+        free(scratch);
+        free(stream);
+        return false;
+    }
+    for (size_t i = 0; i < pushes; i++) {
+        stream[i] = make_sample(i);
+    }
+
+    // Accuracy, and the time of both ways of reading percentiles
+    size_t stride = (pushes - capacity) / BENCH_CHECKS;
+    uint64_t qsort_ns = 0;
+    uint64_t sketch_ns = 0;
+    uint64_t checks = 0;
+    double sink = 0;
+    for (size_t i = 0; i < pushes; i++) {
+        stats_window_push(&w, &stream[i]);
+        long_windows_push(&lw, stream[i].success, stream[i].rtt_ms, i * 500);
+        if (i + 1 < capacity || (i + 1 - capacity) % stride != 0) {
+            continue;
+        }
+
+        double exact[PERCENTILE_COUNT];
+        double sketched[PERCENTILE_COUNT];
+        for (size_t p = 0; p < PERCENTILE_COUNT; p++) {
+            exact[p] = stats_compute_percentile(&w.samples, percentiles[p], scratch, capacity);
+        }
+
+        uint64_t start_ns = now_ns();
+        sink += stats_compute_percentile(&w.samples, 50.0, scratch, capacity);
+        sink += stats_compute_percentile(&w.samples, 95.0, scratch, capacity);
+        uint64_t mid_ns = now_ns();
+        for (size_t p = 0; p < PERCENTILE_COUNT; p++) {
+            sketched[p] = quantile_sketch_query(w.rtt_sketch, percentiles[p]);
+        }
+        sketch_ns += now_ns() - mid_ns;
+        qsort_ns += mid_ns - start_ns;
+        checks++;
+        r.above_max += count_above_max(&w, &lw, i * 500);
+
+        for (size_t p = 0; p < PERCENTILE_COUNT; p++) {
+            double err = fabs(sketched[p] - exact[p]);
+            if (err > exact[p] * BENCH_REL_BOUND + BENCH_ABS_BOUND + 1e-12) {
+                r.violations++;
+            }
+            if (exact[p] > 0) {
+                r.max_rel_err = fmax(r.max_rel_err, err / exact[p]);
+            }
+        }
+    }
+    r.qsort_ns = (double)qsort_ns / (double)checks;
+    r.sketch_ns = (double)sketch_ns / (double)checks;
+
+    // Sketch upkeep: the remove and add a push past full makes
+    static quantile_sketch_t qs;
+    quantile_sketch_clear(&qs);
+    for (size_t i = 0; i < capacity; i++) {
+        if (stream[i].success) {
+            quantile_sketch_add(&qs, stream[i].rtt_ms);
+        }
+    }
+    uint64_t start_ns = now_ns();
+    for (size_t i = capacity; i < pushes; i++) {
+        if (stream[i - capacity].success) {
+            quantile_sketch_remove(&qs, stream[i - capacity].rtt_ms);
+        }
+        if (stream[i].success) {
+            quantile_sketch_add(&qs, stream[i].rtt_ms);
+        }
+    }
+    r.upkeep_ns = (double)(now_ns() - start_ns) / (double)(pushes - capacity);
+    sink += quantile_sketch_query(&qs, 50.0);
+
+    if (sink < 0) {
+        printf("%f\n", sink);  // Keep the timed calls
+    }
+    free(storage);
+    free(scratch);
+    free(stream);
+    *out = r;
+    return true;
+}
+
+int main(void) {
+    static const size_t windows[] = { 120, 1200, 12000 };
+
+    printf("lognormal RTTs, %d%% loss; sketch vs exact p50/p95/p99/p99.9\n", BENCH_LOSS_PCT);
+    printf("%7s %15s %15s %13s %11s\n", "window", "qsort p50+p95", "sketch 4 pcts",
+           "upkeep/push", "max err");
+    uint64_t violations = 0;
+    uint64_t above_max = 0;
+    for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+        bench_result_t r;
+        if (!run(windows[i], &r)) {
+            fprintf(stderr, "out of memory at window %zu\n", windows[i]);
+            return 2;
+        }
+        violations += r.violations;
+        above_max += r.above_max;
+        printf("%7zu %12.2f us %12.2f us %10.0f ns %10.2f%%\n", windows[i], r.qsort_ns / 1e3,
+               r.sketch_ns / 1e3, r.upkeep_ns, r.max_rel_err * 100.0);
+    }
+
+    // One RTT throughout, at and between bucket edges
+    static const double constant_rtts[] = { 0.001, 0.0015, 0.002, 0.0137, 1.0001, 15.3, 997.0 };
+    for (size_t i = 0; i < sizeof(constant_rtts) / sizeof(constant_rtts[0]); i++) {
+        above_max += run_constant(120, constant_rtts[i]);
+    }
+
+    bool ok = violations == 0 && above_max == 0;
+    printf("%s (%llu percentiles outside 1.6%% / 0.5 us, %llu published above the max)\n",
+           ok ? "PASS" : "FAIL", (unsigned long long)violations, (unsigned long long)above_max);
+    return ok ? 0 : 1;
+}
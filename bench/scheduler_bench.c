@@ -0,0 +1,126 @@
+/*
+ * Scheduler deadline benchmark
+ *
+ * Simulates the scheduler's ticks for 10 to 100000 targets spread evenly
+ * over a 500 ms probe interval: every 1 ms tick, each due target is probed
+ * and given its next deadline, and the tick ends with the time to the next
+ * one. Done two ways: with the timer_heap_t the scheduler keeps, which pops
+ * only due targets, and with the scan of every target it replaced (over a
+ * bare array of deadlines, so if anything the scan is flattered). Reports
+ * ns per tick and per due target, and fails if the two ever disagree on
+ * which targets were due or when the next one is.
+ *
+ *   make bench && ./build/scheduler_bench [simulated_s]
+ */
+
+#include "core/timer_heap.h"
+#include "platform/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_INTERVAL_MS   500
+#define BENCH_START_MS      1000000ULL
+
+typedef struct {
+    uint64_t due;               // Targets probed
+    uint64_t checksum;          // Of their ids and the next wake-ups
+    uint64_t ns;
+} bench_result_t;
+
+static uint64_t first_deadline(uint32_t id, uint32_t targets) {
+    return BENCH_START_MS + (uint64_t)id * BENCH_INTERVAL_MS / targets;
+}
+
+static bool run_heap(uint32_t targets, uint64_t ticks, bench_result_t *out) {
+    timer_heap_t heap;
+    if (timer_heap_init(&heap, targets) != 0) {
+        return false;
+    }
+    for (uint32_t id = 0; id < targets; id++) {
+        timer_heap_schedule(&heap, id, first_deadline(id, targets));
+    }
+
+    bench_result_t r = { 0 };
+    uint64_t start_ns = now_ns();
+    for (uint64_t now = BENCH_START_MS; now < BENCH_START_MS + ticks; now++) {
+        uint32_t id;
+        while (timer_heap_pop_due(&heap, now, &id)) {
+            timer_heap_schedule(&heap, id, now + BENCH_INTERVAL_MS);
+            r.due++;
+            r.checksum += id;
+        }
+        timer_entry_t next;
+        if (timer_heap_peek(&heap, &next)) {
+            r.checksum += next.deadline_ms - now;
+        }
+    }
+    r.ns = now_ns() - start_ns;
+
+    timer_heap_free(&heap);
+    *out = r;
+    return true;
+}
+
+static bool run_scan(uint32_t targets, uint64_t ticks, bench_result_t *out) {
+    uint64_t *next_probe_ms = malloc(targets * sizeof(*next_probe_ms));
+    if (next_probe_ms == NULL) {
+        return false;
+    }
+    for (uint32_t id = 0; id < targets; id++) {
+        next_probe_ms[id] = first_deadline(id, targets);
+    }
+
+    bench_result_t r = { 0 };
+    uint64_t start_ns = now_ns();
+    for (uint64_t now = BENCH_START_MS; now < BENCH_START_MS + ticks; now++) {
+        uint64_t wait = UINT64_MAX;
+        for (uint32_t id = 0; id < targets; id++) {
+            if (now >= next_probe_ms[id]) {
+                next_probe_ms[id] = now + BENCH_INTERVAL_MS;
+                r.due++;
+                r.checksum += id;
+            }
+            if (next_probe_ms[id] - now < wait) {
+                wait = next_probe_ms[id] - now;
+            }
+        }
+        r.checksum += wait;
+    }
+    r.ns = now_ns() - start_ns;
+
+    free(next_probe_ms);
+    *out = r;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    static const uint32_t counts[] = { 10, 100, 1000, 10000, 100000 };
+    double seconds = argc > 1 ? atof(argv[1]) : 20.0;
+    if (seconds <= 0) {
+        fprintf(stderr, "usage: %s [simulated_s]\n", argv[0]);
+        return 2;
+    }
+    uint64_t ticks = (uint64_t)(seconds * 1000.0);
+
+    printf("%.0f s simulated, 1 ms ticks, %d ms interval\n", seconds, BENCH_INTERVAL_MS);
+    printf("%8s %10s %13s %12s %13s %12s\n",
+           "targets", "due", "heap ns/tick", "heap ns/due", "scan ns/tick", "scan ns/due");
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+        bench_result_t heap, scan;
+        if (!run_heap(counts[i], ticks, &heap) || !run_scan(counts[i], ticks, &scan)) {
+            fprintf(stderr, "out of memory at %u targets\n", counts[i]);
+            return 2;
+        }
+        if (heap.due != scan.due || heap.checksum != scan.checksum) {
+            fprintf(stderr, "%u targets: heap and scan disagree\n", counts[i]);
+            ok = false;
+        }
+        printf("%8u %10llu %13.0f %12.0f %13.0f %12.0f\n", counts[i], (unsigned long long)heap.due,
+               (double)heap.ns / (double)ticks, (double)heap.ns / (double)heap.due,
+               (double)scan.ns / (double)ticks, (double)scan.ns / (double)scan.due);
+    }
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+/*
+ * Series API benchmark
+ *
+ * Fills a temporary sample store with a day of one-second samples for 100
+ * targets, then times GET /api/series?from=&to=&step=60000 for all of them
+ * through http_handle_request: query, aggregation, JSON and chunked sending
+ * (the socket is drained between sends). Fails if the median run is over
+ * the budget. Then adds a loopback-like target (RTTs of 1-1.3 us) and asks
+ * for it at 1 min and 10 min steps; fails if a row's p50, p95 or p99 is
+ * above its max or out of order.
+ *
+ *   make bench && ./build/series_bench [targets] [budget_ms]
+ */
+
+#define _XOPEN_SOURCE 700
+#include "core/config.h"
+#include "server/server.h"
+#include "store/sample_store.h"
+#include "server/http_handlers.h"
+#include "platform/platform.h"
+#include "mongoose.h"
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_DAY_MS    86400000ULL
+#define BENCH_RUNS      11
+
+static int remove_entry(const char *path, const struct stat *sb, int flag, struct FTW *ftw) {
+    (void)sb;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Run one request to completion; returns the response size. The response
+// is appended to body unless that is NULL.
+static size_t run_request(const char *request, config_t *config, server_t *server,
+                          struct mg_iobuf *body) {
+    struct mg_http_message hm;
+    if (mg_http_parse(request, strlen(request), &hm) <= 0) {
+        return 0;
+    }
+
+    struct mg_connection c;
+    memset(&c, 0, sizeof(c));
+    c.send.align = MG_IO_SIZE;
+    size_t total = 0;
+
+    http_handle_request(&c, &hm, config, server, 0);
+    for (;;) {
+        total += c.send.len;
+        if (body != NULL) {
+            mg_iobuf_add(body, body->len, c.send.buf, c.send.len);
+        }
+        c.send.len = 0;         // The socket took it all
+        if (!http_series_active(&c)) {
+            break;
+        }
+        http_series_continue(&c);
+    }
+    mg_iobuf_free(&c.send);
+    return total;
+}
+
+// Rows of a /api/series response whose percentiles are above the max or out
+// of order. Rows are [ts,count,loss_pct,p50,p95,p99,max] and never split
+// across chunks.
+static size_t check_rows(const struct mg_iobuf *body, size_t *rows) {
+    size_t bad = 0;
+    *rows = 0;
+    for (size_t i = 0; i + 1 < body->len; i++) {
+        if (body->buf[i] != '[' || body->buf[i + 1] < '0' || body->buf[i + 1] > '9') {
+            continue;
+        }
+        unsigned long long ts;
+        unsigned count;
+        double loss, p50, p95, p99, max;
+        if (sscanf((const char *)body->buf + i, "[%llu,%u,%lf,%lf,%lf,%lf,%lf]", &ts, &count, &loss,
+                   &p50, &p95, &p99, &max) != 7) {
+            bad++;
+            continue;
+        }
+        (*rows)++;
+        bad += !(p50 <= p95 && p95 <= p99 && p99 <= max);
+    }
+    return bad;
+}
+
+int main(int argc, char **argv) {
+    int targets = argc > 1 ? atoi(argv[1]) : 100;
+    double budget_ms = argc > 2 ? atof(argv[2]) : 50.0;
+    if (targets <= 0 || targets > 1000) {
+        fprintf(stderr, "usage: %s [targets 1-1000] [budget_ms]\n", argv[0]);
+        return 2;
+    }
+
+    char dir[] = "/tmp/netpulse-bench-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return 2;
+    }
+
+    config_t config;
+    config_init(&config);
+    server_t server;
+    memset(&server, 0, sizeof(server));
+    server.store = sample_store_open(dir, 7 * BENCH_DAY_MS);
+    if (server.store == NULL) {
+        fprintf(stderr, "cannot open store in %s\n", dir);
+        return 2;
+    }
+
+    // A day of samples ending at the last full hour
+    uint64_t to_ms = wall_clock_ms() / 3600000ULL * 3600000ULL;
+    uint64_t from_ms = to_ms - BENCH_DAY_MS;
+    int *series = malloc((size_t)targets * sizeof(*series));
+    for (int k = 0; k < targets; k++) {
+        char label[32];
+        snprintf(label, sizeof(label), "bench-%d", k);
+        config_add_target(&config, "127.0.0.1", 9, label);
+        series[k] = sample_store_series(server.store, config.targets[k].id);
+    }
+
+    uint64_t start_ns = now_ns();
+    for (uint64_t ts = from_ms; ts < to_ms; ts += 1000) {
+        for (int k = 0; k < targets; k++) {
+            uint64_t j = ts / 1000 + (uint64_t)k;
+            sample_t s = {
+                .timestamp_ms = ts,
+                .success = j % 25 != 0,
+                .rtt_ms = j % 25 != 0 ? 10.0 + (double)(j * 7919 % 50000) / 1000.0 : 0.0,
+            };
+            sample_store_append(server.store, series[k], &s);
+        }
+    }
+    sample_store_flush(server.store);
+    printf("filled %d targets x 24h of 1 s samples in %.1f s\n",
+           targets, (double)(now_ns() - start_ns) / 1e9);
+
+    char request[256];
+    snprintf(request, sizeof(request),
+             "GET /api/series?from=%llu&to=%llu&step=60000 HTTP/1.1\r\nHost: bench\r\n\r\n",
+             (unsigned long long)from_ms, (unsigned long long)to_ms);
+
+    uint64_t runs[BENCH_RUNS];
+    size_t bytes = 0;
+    for (int r = 0; r < BENCH_RUNS; r++) {
+        uint64_t t0 = now_ns();
+        bytes = run_request(request, &config, &server, NULL);
+        runs[r] = now_ns() - t0;
+    }
+    qsort(runs, BENCH_RUNS, sizeof(runs[0]), compare_u64);
+
+    double median_ms = (double)runs[BENCH_RUNS / 2] / 1e6;
+    printf("GET /api/series 24h/1m x %d targets: %zu bytes, best %.1f ms, median %.1f ms, worst %.1f ms\n",
+           targets, bytes, (double)runs[0] / 1e6, median_ms, (double)runs[BENCH_RUNS - 1] / 1e6);
+
+    // Loopback RTTs sit in the sketch's lowest buckets, whose midpoints can
+    // be above every sample
+    config_add_target(&config, "127.0.0.1", 9, "bench-loopback");
+    const char *loopback_id = config.targets[config.target_count - 1].id;
+    int loopback = sample_store_series(server.store, loopback_id);
+    for (uint64_t ts = from_ms; ts < to_ms; ts += 1000) {
+        uint64_t j = ts / 1000;
+        sample_t s = {
+            .timestamp_ms = ts,
+            .success = j % 50 != 0,
+            .rtt_ms = j % 50 != 0 ? 0.001 + (double)(j % 4) * 0.0001 : 0.0,
+        };
+        sample_store_append(server.store, loopback, &s);
+    }
+    sample_store_flush(server.store);
+
+    size_t rows = 0;
+    size_t bad_rows = 0;
+    static const unsigned long long steps[] = { 60000, 600000 };
+    for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        snprintf(request, sizeof(request),
+                 "GET /api/series?from=%llu&to=%llu&step=%llu&targets=%s HTTP/1.1\r\nHost: bench\r\n\r\n",
+                 (unsigned long long)from_ms, (unsigned long long)to_ms, steps[i], loopback_id);
+        struct mg_iobuf body = { .align = MG_IO_SIZE };
+        run_request(request, &config, &server, &body);
+        size_t step_rows;
+        bad_rows += check_rows(&body, &step_rows);
+        rows += step_rows;
+        mg_iobuf_free(&body);
+    }
+    printf("loopback target at 1 min and 10 min steps: %zu rows, %zu with percentiles above max or out of order\n",
+           rows, bad_rows);
+
+    sample_store_close(server.store);
+    config_free(&config);
+    free(series);
+    nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+    bool ok = bytes > 0 && median_ms <= budget_ms && rows > 0 && bad_rows == 0;
+    printf("%s (budget %.0f ms)\n", ok ? "PASS" : "FAIL", budget_ms);
+    return ok ? 0 : 1;
+}
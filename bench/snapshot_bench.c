@@ -0,0 +1,191 @@
+/*
+ * Snapshot cache benchmark
+ *
+ * Fills the sample windows of 500 targets (plus the default ones), then has
+ * 500 clients connect at once, twice: each one building its snapshot with
+ * ws_build_snapshot_msg, and each one taking it from a ws_snapshot_t after
+ * one more sample per target arrived (the first connect patches every
+ * target, the rest reuse the message). A connect also copies the message
+ * once, as into a send buffer. Then checks the cached message against the
+ * built one over two windows' worth of samples and a target removal, and
+ * after a target is removed and added back under the same label, and fails
+ * if they ever differ. Snapshots come from the server's copy of the
+ * targets, kept in step with the scheduler as the probe thread's updates
+ * keep it.
+ *
+ *   make bench && ./build/snapshot_bench [targets] [connects]
+ */
+
+#include "core/config.h"
+#include "core/scheduler.h"
+#include "server/ws_handlers.h"
+#include "server/target_view.h"
+#include "platform/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_ROUNDS    5
+#define CHECK_ROUNDS    (2 * DEFAULT_WINDOW_SIZE)
+
+// One more sample (and fresh metrics) for every target, as a probe round
+// does, passed on to the view as the server gets it
+static void probe_round(scheduler_t *sched, target_view_t *view, uint64_t round) {
+    for (int i = 0; i < sched->target_count; i++) {
+        target_state_t *ts = &sched->targets[i];
+        uint64_t j = round + (uint64_t)i;
+        sample_t s = {
+            .timestamp_ms = 1700000000000ULL + round * 500,
+            .success = j % 25 != 0,
+            .rtt_ms = j % 25 != 0 ? 0.5 + (double)(j * 7919 % 150000) / 1000.0 : 0.0,
+        };
+        stats_window_push(&ts->window, &s);
+        stats_compute(&ts->window, &ts->metrics);
+        ts->version = ++sched->versions;
+        target_view_push_sample(view, i, &s);
+        target_view_set_metrics(view, i, &ts->metrics);
+    }
+}
+
+int main(int argc, char **argv) {
+    int targets = argc > 1 ? atoi(argv[1]) : 500;
+    int connects = argc > 2 ? atoi(argv[2]) : 500;
+    if (targets <= 0 || targets > 10000 || connects <= 0) {
+        fprintf(stderr, "usage: %s [targets 1-10000] [connects]\n", argv[0]);
+        return 2;
+    }
+
+    config_t config;
+    config_init(&config);
+    for (int k = 0; k < targets; k++) {
+        char label[32];
+        snprintf(label, sizeof(label), "bench-%d", k);
+        config_add_target(&config, "127.0.0.1", 9, label);
+    }
+    scheduler_t scheduler;
+    if (scheduler_init(&scheduler, &config) != 0) {
+        fprintf(stderr, "cannot set up %d targets\n", targets);
+        return 2;
+    }
+
+    target_view_t view;
+    target_view_init(&view);
+    if (target_view_load(&view, &scheduler) != 0) {
+        fprintf(stderr, "cannot copy %d targets\n", targets);
+        return 2;
+    }
+
+    uint64_t round = 0;
+    for (; round < DEFAULT_WINDOW_SIZE; round++) {
+        probe_round(&scheduler, &view, round);
+    }
+
+    json_writer_t w;
+    json_writer_init(&w);
+    char *sent = NULL;
+
+    // Every connect formats the whole snapshot
+    uint64_t start_ns = now_ns();
+    for (int c = 0; c < connects; c++) {
+        w.len = 0;
+        ws_build_snapshot_msg(&w, &config, &view, "bench", 1);
+        if (sent == NULL) {
+            sent = malloc(w.len);
+        }
+        memcpy(sent, w.buf, w.len);
+    }
+    double built_ms = (double)(now_ns() - start_ns) / 1e6;
+    size_t bytes = w.len;
+    printf("%d targets, %zu byte snapshot\n", view.count, bytes);
+    printf("%d connects, built each time:  %8.1f ms (%.3f ms each)\n",
+           connects, built_ms, built_ms / connects);
+
+    ws_snapshot_t snap;
+    ws_snapshot_init(&snap);
+    start_ns = now_ns();
+    ws_snapshot_update(&snap, &config, &view, "bench", 1);
+    double cold_ms = (double)(now_ns() - start_ns) / 1e6;
+
+    // After each probe round: the first connect patches, the rest copy
+    bool same = true;
+    double first_ms = 0;
+    double cached_ms = 0;
+    for (int r = 0; r < BENCH_ROUNDS; r++, round++) {
+        probe_round(&scheduler, &view, round);
+        uint64_t seq = 2 + (uint64_t)r;
+        start_ns = now_ns();
+        for (int c = 0; c < connects; c++) {
+            if (ws_snapshot_update(&snap, &config, &view, "bench", seq) < 0) {
+                same = false;
+                break;
+            }
+            memcpy(sent, snap.msg.buf, snap.msg.len < bytes ? snap.msg.len : bytes);
+            if (c == 0) {
+                first_ms += (double)(now_ns() - start_ns) / 1e6;
+            }
+        }
+        cached_ms += (double)(now_ns() - start_ns) / 1e6;
+
+        w.len = 0;
+        ws_build_snapshot_msg(&w, &config, &view, "bench", seq);
+        same = same && w.len == snap.msg.len && memcmp(w.buf, snap.msg.buf, w.len) == 0;
+    }
+    // Long enough for every sample list to wrap and compact
+    for (int r = 0; r < CHECK_ROUNDS && same; r++, round++) {
+        if (r == CHECK_ROUNDS / 2) {
+            int index = config.target_count / 2;
+            config_remove_target(&config, config.targets[index].id);
+            scheduler_sync_targets(&scheduler);
+            target_view_remove(&view, index);
+        }
+        probe_round(&scheduler, &view, round);
+        uint64_t seq = 2 + BENCH_ROUNDS + (uint64_t)r;
+        w.len = 0;
+        ws_build_snapshot_msg(&w, &config, &view, "bench", seq);
+        same = ws_snapshot_update(&snap, &config, &view, "bench", seq) >= 0 &&
+               w.len == snap.msg.len && memcmp(w.buf, snap.msg.buf, w.len) == 0;
+    }
+
+    // Remove the last target and add it back under the same label: same id,
+    // same index, and once it has pushed as many samples as the one it
+    // replaced, nothing but its creation tells the two apart
+    if (same) {
+        int index = config.target_count - 1;
+        char label[MAX_LABEL_LEN];
+        snprintf(label, sizeof(label), "%s", config.targets[index].label);
+        uint64_t old_pushes = view.targets[index].pushes;
+        config_remove_target(&config, config.targets[index].id);
+        scheduler_sync_targets(&scheduler);
+        target_view_remove(&view, index);
+        config_add_target(&config, "127.0.0.1", 9, label);
+        scheduler_sync_targets(&scheduler);
+        same = target_view_add(&view, &config.targets[index]) == index;
+        for (uint64_t r = 0; r <= old_pushes && same; r++, round++) {
+            probe_round(&scheduler, &view, round);
+        }
+        uint64_t seq = 2 + BENCH_ROUNDS + CHECK_ROUNDS;
+        w.len = 0;
+        ws_build_snapshot_msg(&w, &config, &view, "bench", seq);
+        same = same && ws_snapshot_update(&snap, &config, &view, "bench", seq) >= 0 &&
+               w.len == snap.msg.len && memcmp(w.buf, snap.msg.buf, w.len) == 0;
+    }
+
+    cached_ms /= BENCH_ROUNDS;
+    first_ms /= BENCH_ROUNDS;
+    printf("%d connects, cached:           %8.1f ms (first %.2f ms patching, %.3f ms each after)\n",
+           connects, cached_ms, first_ms, (cached_ms - first_ms) / (connects > 1 ? connects - 1 : 1));
+    printf("cache built cold in %.1f ms; %llu target parts built, %llu patched, %llu messages assembled\n",
+           cold_ms, (unsigned long long)snap.builds, (unsigned long long)snap.patches,
+           (unsigned long long)snap.assemblies);
+
+    ws_snapshot_free(&snap);
+    json_writer_free(&w);
+    free(sent);
+    target_view_free(&view);
+    scheduler_free(&scheduler);
+    config_free(&config);
+
+    printf("%s (cached snapshot %s the built one)\n", same ? "PASS" : "FAIL",
+           same ? "matches" : "differs from");
+    return same ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+/*
+ * SPSC ring benchmark
+ *
+ * Stress: a producer thread pushes count samples, numbered in timestamp_ms,
+ * through a 64-element spsc_ring_t in bursts of random size, and a consumer
+ * thread pops them in bursts of random size; fails on any sample missing,
+ * repeated, out of order or torn. Then times handing samples between the
+ * two threads one at a time and in bulk, and (for comparison) one at a time
+ * through an spsc_queue_t.
+ *
+ *   make bench && ./build/spsc_bench [count]
+ *   make tsan      (the stress test under ThreadSanitizer)
+ */
+
+#include "core/spsc_ring.h"
+#include "core/spsc_queue.h"
+#include "core/stats.h"
+#include "platform/platform.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_STRESS_CAPACITY   64
+#define BENCH_CAPACITY          4096
+#define BENCH_BULK              32
+
+typedef enum {
+    BENCH_RING,
+    BENCH_QUEUE,
+} bench_kind_t;
+
+typedef struct {
+    bench_kind_t kind;
+    spsc_ring_t ring;
+    spsc_queue_t queue;
+    uint64_t count;             // Samples to hand over
+    size_t bulk;                // Per push/pop (0: random, 1 to BENCH_BULK)
+    uint64_t errors;            // Consumer: samples not as expected
+} bench_t;
+
+// xorshift64: burst sizes without sharing rand()'s state between threads
+static size_t next_burst(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return 1 + (size_t)(*state % BENCH_BULK);
+}
+
+static sample_t make_sample(uint64_t seq) {
+    return (sample_t){
+        .timestamp_ms = seq,
+        .rtt_ms = (double)(seq % 1000),
+        .success = seq % 7 != 0,
+    };
+}
+
+static void *produce(void *arg) {
+    bench_t *b = arg;
+    uint64_t rng = 0x9e3779b97f4a7c15ULL;
+    sample_t batch[BENCH_BULK];
+    uint64_t seq = 0;
+
+    while (seq < b->count) {
+        size_t n = b->bulk != 0 ? b->bulk : next_burst(&rng);
+        if (n > b->count - seq) {
+            n = (size_t)(b->count - seq);
+        }
+        for (size_t i = 0; i < n; i++) {
+            batch[i] = make_sample(seq + i);
+        }
+
+        size_t done = 0;
+        while (done < n) {
+            size_t pushed = 0;
+            if (b->kind == BENCH_RING) {
+                pushed = spsc_ring_push(&b->ring, batch + done, n - done);
+            } else {
+                sample_t *slot = spsc_queue_reserve(&b->queue, sizeof(*slot));
+                if (slot != NULL) {
+                    *slot = batch[done];
+                    spsc_queue_commit(&b->queue);
+                    pushed = 1;
+                }
+            }
+            if (pushed == 0) {
+                sched_yield();
+            }
+            done += pushed;
+        }
+        seq += n;
+    }
+    return NULL;
+}
+
+static void *consume(void *arg) {
+    bench_t *b = arg;
+    uint64_t rng = 0x2545f4914f6cdd1dULL;
+    sample_t batch[BENCH_BULK];
+    uint64_t seq = 0;
+
+    while (seq < b->count) {
+        size_t want = b->bulk != 0 ? b->bulk : next_burst(&rng);
+        size_t n = 0;
+        if (b->kind == BENCH_RING) {
+            n = spsc_ring_pop(&b->ring, batch, want);
+        } else {
+            size_t len;
+            const sample_t *msg = spsc_queue_peek(&b->queue, &len);
+            if (msg != NULL) {
+                batch[0] = *msg;
+                spsc_queue_release(&b->queue);
+                n = 1;
+            }
+        }
+        if (n == 0) {
+            sched_yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            sample_t want_sample = make_sample(seq + i);
+            if (batch[i].timestamp_ms != want_sample.timestamp_ms ||
+                batch[i].rtt_ms != want_sample.rtt_ms ||
+                batch[i].success != want_sample.success) {
+                if (b->errors++ < 5) {
+                    fprintf(stderr, "sample %llu: got seq %llu\n",
+                            (unsigned long long)(seq + i),
+                            (unsigned long long)batch[i].timestamp_ms);
+                }
+            }
+        }
+        seq += n;
+    }
+    return NULL;
+}
+
+// Hand count samples from a producer thread to a consumer thread.
+// Returns the elapsed ns, or 0 if no thread could be started.
+static uint64_t run(bench_t *b) {
+    pthread_t producer, consumer;
+    uint64_t start_ns = now_ns();
+    if (pthread_create(&consumer, NULL, consume, b) != 0) {
+        return 0;
+    }
+    if (pthread_create(&producer, NULL, produce, b) != 0) {
+        produce(b);                     // The consumer is waiting for them
+    } else {
+        pthread_join(producer, NULL);
+    }
+    pthread_join(consumer, NULL);
+    return now_ns() - start_ns;
+}
+
+static bool time_case(const char *name, bench_kind_t kind, size_t bulk, uint64_t count) {
+    bench_t *b = aligned_alloc(SPSC_RING_CACHE_LINE, sizeof(bench_t));
+    if (b == NULL) {
+        return false;
+    }
+    memset(b, 0, sizeof(*b));
+    b->kind = kind;
+    b->count = count;
+    b->bulk = bulk;
+    int rc = kind == BENCH_RING
+        ? spsc_ring_init(&b->ring, sizeof(sample_t), BENCH_CAPACITY)
+        : spsc_queue_init(&b->queue, BENCH_CAPACITY * 32);
+    if (rc != 0) {
+        free(b);
+        return false;
+    }
+
+    uint64_t ns = run(b);
+    bool ok = ns > 0 && b->errors == 0;
+    if (ok) {
+        printf("%-28s %8.1f M samples/s (%.1f ns each)\n",
+               name, (double)count * 1e3 / (double)ns, (double)ns / (double)count);
+    }
+
+    if (kind == BENCH_RING) {
+        spsc_ring_free(&b->ring);
+    } else {
+        spsc_queue_free(&b->queue);
+    }
+    free(b);
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    long long count = argc > 1 ? atoll(argv[1]) : 10000000;
+    if (count <= 0) {
+        fprintf(stderr, "usage: %s [count]\n", argv[0]);
+        return 2;
+    }
+
+    // Stress: a small ring, so both sides keep wrapping, filling and emptying
+    bench_t *b = aligned_alloc(SPSC_RING_CACHE_LINE, sizeof(bench_t));
+    if (b == NULL) {
+        return 2;
+    }
+    memset(b, 0, sizeof(*b));
+    b->kind = BENCH_RING;
+    b->count = (uint64_t)count;
+    if (spsc_ring_init(&b->ring, sizeof(sample_t), BENCH_STRESS_CAPACITY) != 0) {
+        fprintf(stderr, "cannot allocate ring\n");
+        return 2;
+    }
+    uint64_t ns = run(b);
+    bool ok = ns > 0 && b->errors == 0 && spsc_ring_count(&b->ring) == 0;
+    printf("stress: %lld samples through %zu slots, random bursts of 1-%d: %llu errors, %.1f s\n",
+           count, b->ring.capacity, BENCH_BULK, (unsigned long long)b->errors, (double)ns / 1e9);
+    spsc_ring_free(&b->ring);
+    free(b);
+
+    ok = ok && time_case("spsc_ring, 1 at a time", BENCH_RING, 1, (uint64_t)count);
+    ok = ok && time_case("spsc_ring, 32 at a time", BENCH_RING, BENCH_BULK, (uint64_t)count);
+    ok = ok && time_case("spsc_queue, 1 at a time", BENCH_QUEUE, 1, (uint64_t)count);
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+/*
+ * Sample window statistics benchmark
+ *
+ * Checks stats_window_t against the full-scan reference functions: pushes
+ * random sample streams (random, tied, falling, rising and microsecond RTTs,
+ * 0-90% failures) through windows of 1 to 4096 samples, well past full so
+ * every push also evicts, and after each push (every few, in the largest)
+ * compares loss, jitter, max and current RTT from stats_compute() with the
+ * scans, bit for bit. Fails on any difference.
+ *
+ * The reference jitter sums whole-nanosecond deltas, as the window does (a
+ * running double sum cannot match a fresh one bit for bit). The original
+ * double formula is also computed here, and the largest gap to it reported
+ * and bounded.
+ *
+ * Then times a 120-sample window: the full scans, stats_compute() and a push.
+ *
+ *   make bench && ./build/stats_bench
+ */
+
+#include "core/config.h"
+#include "core/stats.h"
+#include "platform/platform.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_TIMING_RUNS   200000
+#define BENCH_JITTER_BOUND  1e-6    // ms: half a nanosecond per delta, and rounding
+
+typedef enum {
+    STREAM_RANDOM,
+    STREAM_TIES,
+    STREAM_FALLING,
+    STREAM_RISING,
+    STREAM_MICROS,
+    STREAM_COUNT,
+} stream_t;
+
+static const char *stream_names[STREAM_COUNT] = {
+    "random", "ties", "falling", "rising", "micros",
+};
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static sample_t make_sample(stream_t stream, uint64_t i, unsigned loss_pct) {
+    sample_t s = { .timestamp_ms = 1700000000000ULL + i * 500, .success = true };
+    if (next_random() % 100 < loss_pct) {
+        s.success = false;
+        return s;
+    }
+
+    switch (stream) {
+        case STREAM_RANDOM:
+            s.rtt_ms = 0.1 + (double)(next_random() % 200000000) / 1e6;
+            break;
+        case STREAM_TIES: {
+            static const double ties[] = { 1.0, 2.0, 3.0, 5.0 };
+            s.rtt_ms = ties[next_random() % 4];
+            break;
+        }
+        case STREAM_FALLING:
+            s.rtt_ms = 1000.0 - (double)i * 0.01;
+            break;
+        case STREAM_RISING:
+            s.rtt_ms = 0.1 + (double)i * 0.01;
+            break;
+        default:
+            s.rtt_ms = (double)(next_random() % 2000) / 1000.0;
+            break;
+    }
+    return s;
+}
+
+// Newest successful RTT, by scan
+static double scan_current_rtt(ring_buffer_t *samples) {
+    for (size_t i = ring_buffer_count(samples); i > 0; i--) {
+        const sample_t *s = ring_buffer_get(samples, i - 1);
+        if (s->success) {
+            return s->rtt_ms;
+        }
+    }
+    return 0.0;
+}
+
+// Jitter as stats_compute_jitter had it before deltas were whole nanoseconds
+static double scan_jitter_double(ring_buffer_t *samples) {
+    double total = 0.0;
+    size_t count = 0;
+    double prev = -1.0;
+    for (size_t i = 0; i < ring_buffer_count(samples); i++) {
+        const sample_t *s = ring_buffer_get(samples, i);
+        if (s->success) {
+            if (prev >= 0.0) {
+                total += fabs(s->rtt_ms - prev);
+                count++;
+            }
+            prev = s->rtt_ms;
+        }
+    }
+    return count == 0 ? 0.0 : total / (double)count;
+}
+
+static bool same_double(double a, double b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Push capacity * 2 + 50 samples, checking after each (every few in windows
+// over 512 samples, to keep the scans affordable). Returns mismatches.
+static uint64_t check_window(size_t capacity, stream_t stream, unsigned loss_pct,
+                             uint64_t *checks, double *jitter_gap) {
+    void *storage = calloc(1, stats_window_storage_size(capacity));
+    stats_window_t w;
+    if (storage == NULL || stats_window_init(&w, capacity, storage) != 0) {
+        free(storage);
+        return 1;
+    }
+
+    uint64_t mismatches = 0;
+    uint64_t pushes = capacity * 2 + 50;
+    uint64_t stride = 1 + capacity / 512;
+    for (uint64_t i = 0; i < pushes; i++) {
+        sample_t s = make_sample(stream, i, loss_pct);
+        stats_window_push(&w, &s);
+        if (i % stride != 0 && i + 1 < pushes) {
+            continue;
+        }
+
+        metrics_t m;
+        stats_compute(&w, &m);
+        bool ok = same_double(m.loss_pct, stats_compute_loss(&w.samples)) &&
+                  same_double(m.jitter_ms, stats_compute_jitter(&w.samples)) &&
+                  same_double(m.max_rtt_ms, stats_compute_max_rtt(&w.samples)) &&
+                  same_double(m.current_rtt_ms, scan_current_rtt(&w.samples));
+        if (!ok && mismatches++ < 5) {
+            fprintf(stderr, "capacity %zu, %s, %u%% loss, push %llu: window differs from the scans\n",
+                    capacity, stream_names[stream], loss_pct, (unsigned long long)i);
+        }
+
+        double gap = fabs(m.jitter_ms - scan_jitter_double(&w.samples));
+        if (gap > *jitter_gap) {
+            *jitter_gap = gap;
+        }
+        (*checks)++;
+    }
+
+    free(storage);
+    return mismatches;
+}
+
+int main(void) {
+    static const size_t capacities[] = { 1, 2, 3, 7, 120, 500, 4096 };
+    static const unsigned losses[] = { 0, 10, 50, 90 };
+
+    uint64_t checks = 0;
+    uint64_t mismatches = 0;
+    double jitter_gap = 0.0;
+    for (size_t c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+        for (size_t l = 0; l < sizeof(losses) / sizeof(losses[0]); l++) {
+            for (int s = 0; s < STREAM_COUNT; s++) {
+                mismatches += check_window(capacities[c], (stream_t)s, losses[l],
+                                           &checks, &jitter_gap);
+            }
+        }
+    }
+    printf("window vs full scan: %llu checks, %llu mismatches (loss, jitter, max, current RTT)\n",
+           (unsigned long long)checks, (unsigned long long)mismatches);
+    printf("jitter vs double-sum formula: largest gap %.3g ms\n", jitter_gap);
+
+    // Timing: a full 120-sample window of random RTTs, 4% failures
+    void *storage = calloc(1, stats_window_storage_size(DEFAULT_WINDOW_SIZE));
+    stats_window_t w;
+    if (storage == NULL || stats_window_init(&w, DEFAULT_WINDOW_SIZE, storage) != 0) {
+        fprintf(stderr, "cannot set up a window\n");
+        return 2;
+    }
+    for (uint64_t i = 0; i < DEFAULT_WINDOW_SIZE; i++) {
+        sample_t s = make_sample(STREAM_RANDOM, i, 4);
+        stats_window_push(&w, &s);
+    }
+
+    volatile double sink = 0.0;
+    uint64_t start_ns = now_ns();
+    for (int r = 0; r < BENCH_TIMING_RUNS; r++) {
+        sink += stats_compute_loss(&w.samples) + stats_compute_jitter(&w.samples) +
+                stats_compute_max_rtt(&w.samples);
+    }
+    double scan_ns = (double)(now_ns() - start_ns) / BENCH_TIMING_RUNS;
+
+    metrics_t m;
+    start_ns = now_ns();
+    for (int r = 0; r < BENCH_TIMING_RUNS; r++) {
+        stats_compute(&w, &m);
+        sink += m.jitter_ms;
+    }
+    double compute_ns = (double)(now_ns() - start_ns) / BENCH_TIMING_RUNS;
+
+    sample_t pushes[256];
+    for (int i = 0; i < 256; i++) {
+        pushes[i] = make_sample(STREAM_RANDOM, (uint64_t)i, 4);
+    }
+    start_ns = now_ns();
+    for (int r = 0; r < BENCH_TIMING_RUNS; r++) {
+        stats_window_push(&w, &pushes[r & 255]);
+    }
+    double push_ns = (double)(now_ns() - start_ns) / BENCH_TIMING_RUNS;
+    free(storage);
+    (void)sink;
+
+    printf("%d-sample window: full scan loss+jitter+max %.0f ns, stats_compute %.0f ns, push %.0f ns\n",
+           DEFAULT_WINDOW_SIZE, scan_ns, compute_ns, push_ns);
+
+    bool ok = mismatches == 0 && jitter_gap <= BENCH_JITTER_BOUND;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
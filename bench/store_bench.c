@@ -0,0 +1,184 @@
+/*
+ * Sample store benchmark
+ *
+ * Appends samples for a few series to a temporary sample store, interleaved
+ * as the scheduler would (500 ms apart with 0-2 ms of slop, RTTs of 0.05 to
+ * 140 ms with jitter, 1% failures), flushes it, and scans every series
+ * back, checking each sample against what was appended: timestamps and
+ * success flags exactly, RTTs to 1 us, in time order. Reports append and
+ * scan + decode ns per sample and the sample blocks' bytes per sample
+ * (headers included, rollup blocks not). Fails on any mismatch or drop.
+ *
+ *   make bench && ./build/store_bench [samples_per_series]
+ */
+
+#define _XOPEN_SOURCE 700
+#include "store/sample_store.h"
+#include "store/segment_log.h"
+#include "platform/platform.h"
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_SERIES        5
+#define BENCH_INTERVAL_MS   500
+#define BENCH_DAY_MS        86400000ULL
+
+static const double base_rtts_ms[BENCH_SERIES] = { 0.05, 4.0, 12.0, 35.0, 140.0 };
+
+typedef struct {
+    const sample_t *expected[BENCH_SERIES];
+    size_t count;               // Samples per series
+    size_t next[BENCH_SERIES];  // Next expected sample per series
+    uint64_t mismatches;
+} verify_t;
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int flag, struct FTW *ftw) {
+    (void)sb;
+    (void)flag;
+    (void)ftw;
+    return remove(path);
+}
+
+static long long to_us(double ms) {
+    return (long long)(ms * 1000.0 + 0.5);
+}
+
+// sample_store_scan_cb_t: compare with what was appended
+static void verify_samples(const char *series_id, const sample_t *samples, size_t count, void *ctx) {
+    verify_t *v = ctx;
+    int k = atoi(series_id + strlen("bench-"));
+    if (k < 0 || k >= BENCH_SERIES) {
+        v->mismatches += count;
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        size_t n = v->next[k]++;
+        if (n >= v->count) {
+            v->mismatches++;
+            continue;
+        }
+        const sample_t *want = &v->expected[k][n];
+        if (samples[i].timestamp_ms != want->timestamp_ms || samples[i].success != want->success ||
+            (want->success && to_us(samples[i].rtt_ms) != to_us(want->rtt_ms))) {
+            v->mismatches++;
+        }
+    }
+}
+
+// segment_log_scan_cb_t: total the block bytes
+static void count_bytes(const uint8_t *data, size_t pos, size_t end, void *ctx) {
+    (void)data;
+    *(uint64_t *)ctx += end - pos;
+}
+
+int main(int argc, char **argv) {
+    long long per_series = argc > 1 ? atoll(argv[1]) : 400000;
+    if (per_series <= 0 || per_series > 1000000) {
+        fprintf(stderr, "usage: %s [samples_per_series 1-1000000]\n", argv[0]);
+        return 2;
+    }
+    size_t count = (size_t)per_series;
+
+    char dir[] = "/tmp/netpulse-bench-XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        return 2;
+    }
+    sample_store_t *store = sample_store_open(dir, 7 * BENCH_DAY_MS);
+    if (store == NULL) {
+        fprintf(stderr, "cannot open store in %s\n", dir);
+        return 2;
+    }
+
+    // Samples ending now, so retention keeps them
+    verify_t v = { .count = count };
+    int series[BENCH_SERIES];
+    uint64_t from_ms = wall_clock_ms() - (uint64_t)count * BENCH_INTERVAL_MS;
+    for (int k = 0; k < BENCH_SERIES; k++) {
+        char id[32];
+        snprintf(id, sizeof(id), "bench-%d", k);
+        series[k] = sample_store_series(store, id);
+        sample_t *samples = malloc(count * sizeof(*samples));
+        if (series[k] < 0 || samples == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 2;
+        }
+        for (size_t i = 0; i < count; i++) {
+            double jitter = (double)(next_random() % 1000) / 1000.0;
+            samples[i] = (sample_t){
+                .timestamp_ms = from_ms + i * BENCH_INTERVAL_MS + next_random() % 3,
+                .success = next_random() % 100 != 0,
+            };
+            if (samples[i].success) {
+                samples[i].rtt_ms = base_rtts_ms[k] * (1.0 + 0.2 * jitter * jitter * jitter);
+            }
+        }
+        v.expected[k] = samples;
+    }
+
+    uint64_t dropped = 0;
+    uint64_t start_ns = now_ns();
+    for (size_t i = 0; i < count; i++) {
+        for (int k = 0; k < BENCH_SERIES; k++) {
+            dropped += sample_store_append(store, series[k], &v.expected[k][i]) != 0;
+        }
+    }
+    uint64_t append_ns = now_ns() - start_ns;
+    sample_store_flush(store);
+    uint64_t flush_ns = now_ns() - start_ns;
+
+    start_ns = now_ns();
+    int scanned = sample_store_scan(store, NULL, 0, UINT64_MAX, verify_samples, &v);
+    uint64_t scan_ns = now_ns() - start_ns;
+
+    sample_store_stats_t stats;
+    sample_store_get_stats(store, &stats);
+    sample_store_close(store);
+
+    // Sample blocks only: the rollup tiers have logs of their own
+    char samples_dir[sizeof(dir) + 16];
+    snprintf(samples_dir, sizeof(samples_dir), "%s/samples", dir);
+    segment_log_t *log = segment_log_open(samples_dir, SAMPLE_STORE_SEGMENT_BYTES,
+                                          SAMPLE_STORE_SEGMENT_SPAN, 0);
+    segment_log_cut_t cut;
+    uint64_t block_bytes = 0;
+    if (log != NULL && segment_log_cut(log, &cut) == 0) {
+        segment_log_scan(log, &cut, 0, UINT64_MAX, count_bytes, &block_bytes);
+        segment_log_cut_free(&cut);
+    }
+    segment_log_close(log);
+    nftw(dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+    uint64_t total = (uint64_t)count * BENCH_SERIES;
+    for (int k = 0; k < BENCH_SERIES; k++) {
+        if (v.next[k] != count) {
+            v.mismatches += v.next[k] > count ? v.next[k] - count : count - v.next[k];
+        }
+        free((void *)v.expected[k]);
+    }
+
+    printf("%d series x %zu samples, %d ms apart\n", BENCH_SERIES, count, BENCH_INTERVAL_MS);
+    printf("append            %6.1f ns/sample (%.1f ns with the writer done)\n",
+           (double)append_ns / (double)total, (double)flush_ns / (double)total);
+    printf("on disk           %6.2f bytes/sample\n", (double)block_bytes / (double)total);
+    printf("scan + decode     %6.1f ns/sample\n", (double)scan_ns / (double)total);
+
+    bool ok = scanned == 0 && dropped == 0 && stats.samples_dropped == 0 && v.mismatches == 0 &&
+              block_bytes > 0;
+    printf("%s (%llu mismatched, %llu dropped of %llu)\n", ok ? "PASS" : "FAIL",
+           (unsigned long long)v.mismatches, (unsigned long long)(dropped + stats.samples_dropped),
+           (unsigned long long)total);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+#define _GNU_SOURCE  // sendmmsg, recvmmsg
+#include "syscall_count.h"
+
+// Per thread, so a bench's helper threads do not count against it
+static _Thread_local uint64_t calls;
+
+#ifdef BENCH_COUNT_SYSCALLS
+
+#include <stdarg.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+
+#define COUNT() (calls++)
+
+// The real functions, as renamed by -Wl,--wrap=NAME
+int __real_socket(int domain, int type, int protocol);
+int __real_fcntl(int fd, int cmd, ...);
+int __real_connect(int fd, const struct sockaddr *addr, socklen_t len);
+int __real_getsockopt(int fd, int level, int name, void *value, socklen_t *len);
+int __real_setsockopt(int fd, int level, int name, const void *value, socklen_t len);
+int __real_close(int fd);
+int __real_epoll_ctl(int epfd, int op, int fd, struct epoll_event *event);
+int __real_epoll_wait(int epfd, struct epoll_event *events, int max, int timeout);
+ssize_t __real_read(int fd, void *buf, size_t len);
+ssize_t __real_write(int fd, const void *buf, size_t len);
+long __real_syscall(long number, ...);
+ssize_t __real_sendto(int fd, const void *buf, size_t len, int flags,
+                      const struct sockaddr *addr, socklen_t addr_len);
+ssize_t __real_recvfrom(int fd, void *buf, size_t len, int flags,
+                        struct sockaddr *addr, socklen_t *addr_len);
+int __real_sendmmsg(int fd, struct mmsghdr *msgs, unsigned int vlen, int flags);
+int __real_recvmmsg(int fd, struct mmsghdr *msgs, unsigned int vlen, int flags,
+                    struct timespec *timeout);
+int __real_poll(struct pollfd *fds, nfds_t nfds, int timeout);
+int __real_timerfd_settime(int fd, int flags, const struct itimerspec *value,
+                           struct itimerspec *old);
+
+int __wrap_socket(int domain, int type, int protocol) {
+    COUNT();
+    return __real_socket(domain, type, protocol);
+}
+
+// The probe code only passes an int (or nothing) after cmd
+int __wrap_fcntl(int fd, int cmd, ...) {
+    va_list ap;
+    va_start(ap, cmd);
+    int arg = va_arg(ap, int);
+    va_end(ap);
+    COUNT();
+    return __real_fcntl(fd, cmd, arg);
+}
+
+int __wrap_connect(int fd, const struct sockaddr *addr, socklen_t len) {
+    COUNT();
+    return __real_connect(fd, addr, len);
+}
+
+int __wrap_getsockopt(int fd, int level, int name, void *value, socklen_t *len) {
+    COUNT();
+    return __real_getsockopt(fd, level, name, value, len);
+}
+
+int __wrap_setsockopt(int fd, int level, int name, const void *value, socklen_t len) {
+    COUNT();
+    return __real_setsockopt(fd, level, name, value, len);
+}
+
+int __wrap_close(int fd) {
+    COUNT();
+    return __real_close(fd);
+}
+
+int __wrap_epoll_ctl(int epfd, int op, int fd, struct epoll_event *event) {
+    COUNT();
+    return __real_epoll_ctl(epfd, op, fd, event);
+}
+
+int __wrap_epoll_wait(int epfd, struct epoll_event *events, int max, int timeout) {
+    COUNT();
+    return __real_epoll_wait(epfd, events, max, timeout);
+}
+
+ssize_t __wrap_read(int fd, void *buf, size_t len) {
+    COUNT();
+    return __real_read(fd, buf, len);
+}
+
+ssize_t __wrap_write(int fd, const void *buf, size_t len) {
+    COUNT();
+    return __real_write(fd, buf, len);
+}
+
+// io_uring_setup/enter/register: at most six register-sized arguments
+long __wrap_syscall(long number, ...) {
+    va_list ap;
+    va_start(ap, number);
+    long a[6];
+    for (int i = 0; i < 6; i++) {
+        a[i] = va_arg(ap, long);
+    }
+    va_end(ap);
+    COUNT();
+    return __real_syscall(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+
+ssize_t __wrap_sendto(int fd, const void *buf, size_t len, int flags,
+                      const struct sockaddr *addr, socklen_t addr_len) {
+    COUNT();
+    return __real_sendto(fd, buf, len, flags, addr, addr_len);
+}
+
+ssize_t __wrap_recvfrom(int fd, void *buf, size_t len, int flags,
+                        struct sockaddr *addr, socklen_t *addr_len) {
+    COUNT();
+    return __real_recvfrom(fd, buf, len, flags, addr, addr_len);
+}
+
+int __wrap_sendmmsg(int fd, struct mmsghdr *msgs, unsigned int vlen, int flags) {
+    COUNT();
+    return __real_sendmmsg(fd, msgs, vlen, flags);
+}
+
+int __wrap_recvmmsg(int fd, struct mmsghdr *msgs, unsigned int vlen, int flags,
+                    struct timespec *timeout) {
+    COUNT();
+    return __real_recvmmsg(fd, msgs, vlen, flags, timeout);
+}
+
+int __wrap_poll(struct pollfd *fds, nfds_t nfds, int timeout) {
+    COUNT();
+    return __real_poll(fds, nfds, timeout);
+}
+
+int __wrap_timerfd_settime(int fd, int flags, const struct itimerspec *value,
+                           struct itimerspec *old) {
+    COUNT();
+    return __real_timerfd_settime(fd, flags, value, old);
+}
+
+bool syscall_count_available(void) {
+    return true;
+}
+
+#else
+
+bool syscall_count_available(void) {
+    return false;
+}
+
+#endif // BENCH_COUNT_SYSCALLS
+
+uint64_t syscall_count(void) {
+    return calls;
+}
+
+void syscall_count_reset(void) {
+    calls = 0;
+}
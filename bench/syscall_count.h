@@ -0,0 +1,23 @@
+#ifndef NETPULSE_BENCH_SYSCALL_COUNT_H
+#define NETPULSE_BENCH_SYSCALL_COUNT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Syscall counter for benchmarks
+ *
+ * Counts the calls the probe code makes to the socket, epoll, poll, read,
+ * close and syscall() wrappers. It works by linking with -Wl,--wrap for each
+ * of them, and building syscall_count.c with BENCH_COUNT_SYSCALLS (Linux,
+ * see the Makefile). Elsewhere, the counter is not available and stays at 0.
+ */
+
+// Whether calls are being counted
+bool syscall_count_available(void);
+
+// Calls made by the calling thread since it last reset the count
+uint64_t syscall_count(void);
+void syscall_count_reset(void);
+
+#endif // NETPULSE_BENCH_SYSCALL_COUNT_H
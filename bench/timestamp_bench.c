@@ -0,0 +1,258 @@
+/*
+ * Kernel timestamp accuracy benchmark
+ *
+ * Probes loopback one probe at a time and times each probe both ways the
+ * daemon can: in userspace (from just before the send to when the result
+ * is read) and in the kernel (ICMP: SO_TIMESTAMPING send and receive
+ * stamps; TCP: the smoothed RTT from TCP_INFO, which after the handshake is
+ * SYN -> SYN-ACK). Each is run idle and with the prober stalled for 2 ms
+ * before it reads the result, as a busy daemon would be. Reports p50/p99
+ * of both. Fails if kernel RTTs are missing for over 1% of probes, if the
+ * idle kernel p50 is above the userspace p50, or if the stall shows up in
+ * the kernel RTT (p99 over half the stall) rather than only in userspace.
+ * ICMP needs raw sockets (root or CAP_NET_RAW) and is skipped without them.
+ *
+ *   make bench && ./build/timestamp_bench [probes]
+ */
+
+#include "net/icmp_probe.h"
+#include "net/tcp_probe.h"
+#include "platform/platform.h"
+#include <arpa/inet.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_STALL_NS      2000000ULL
+#define BENCH_WAIT_MS       1000
+#define BENCH_SLACK_NS      10000ULL    // Kernel RTTs are whole microseconds
+
+typedef struct {
+    uint64_t *user_ns;
+    uint64_t *kernel_ns;
+    size_t count;               // Probes that succeeded
+    size_t missing;             // ... without a kernel RTT
+    size_t failed;
+} bench_run_t;
+
+typedef struct {
+    int fd;
+    atomic_bool running;
+} bench_listener_t;
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Percentile of a sorted array
+static uint64_t pct(const uint64_t *v, size_t n, double p) {
+    return n > 0 ? v[(size_t)(p / 100.0 * (double)(n - 1))] : 0;
+}
+
+// Keep the thread busy, as the daemon would be with other work
+static void stall(uint64_t ns) {
+    uint64_t until = now_ns() + ns;
+    while (now_ns() < until) {
+    }
+}
+
+static void *listen_loop(void *arg) {
+    bench_listener_t *l = arg;
+    while (atomic_load(&l->running)) {
+        struct pollfd pfd = { .fd = l->fd, .events = POLLIN };
+        if (poll(&pfd, 1, 100) > 0) {
+            int c;
+            while ((c = accept(l->fd, NULL, NULL)) >= 0) {
+                close(c);
+            }
+        }
+    }
+    return NULL;
+}
+
+static bool run_alloc(bench_run_t *run, size_t probes) {
+    *run = (bench_run_t){ 0 };
+    run->user_ns = malloc(probes * sizeof(uint64_t));
+    run->kernel_ns = malloc(probes * sizeof(uint64_t));
+    return run->user_ns != NULL && run->kernel_ns != NULL;
+}
+
+static void run_free(bench_run_t *run) {
+    free(run->user_ns);
+    free(run->kernel_ns);
+}
+
+static void run_tcp(const struct sockaddr_in *addr, size_t probes, uint64_t stall_ns, bench_run_t *run) {
+    for (size_t i = 0; i < probes; i++) {
+        uint64_t start_ns = now_ns();
+        int fd = tcp_probe_connect((const struct sockaddr *)addr, sizeof(*addr));
+        if (fd < 0) {
+            run->failed++;
+            continue;
+        }
+        stall(stall_ns);
+        struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+        bool ok = poll(&pfd, 1, BENCH_WAIT_MS) > 0 && tcp_probe_result(fd) == PROBE_SUCCESS;
+        uint64_t done_ns = now_ns();
+        if (!ok) {
+            run->failed++;
+        } else {
+            uint64_t kernel_ns = tcp_probe_kernel_rtt_ns(fd);
+            run->missing += kernel_ns == 0;
+            run->user_ns[run->count] = done_ns - start_ns;
+            run->kernel_ns[run->count++] = kernel_ns;
+        }
+        tcp_probe_cleanup(fd);
+    }
+}
+
+static void run_icmp(icmp_probe_state_t *icmp, size_t probes, uint64_t stall_ns, bench_run_t *run) {
+    for (size_t i = 0; i < probes; i++) {
+        uint16_t seq;
+        uint32_t addr;
+        uint64_t start_ns = now_ns();
+        if (icmp_probe_send(icmp, "127.0.0.1", &seq, &addr) != 0) {
+            run->failed++;
+            continue;
+        }
+        stall(stall_ns);
+
+        // As the scheduler reads replies: only the batch call reads timestamps
+        icmp_reply_t replies[ICMP_BATCH_MAX];
+        icmp_reply_t reply;
+        bool got = false;
+        while (!got) {
+            int n = icmp_probe_recv_batch(icmp, replies, ICMP_BATCH_MAX);
+            for (int k = 0; k < n; k++) {
+                if (replies[k].sequence == seq) {
+                    reply = replies[k];
+                    got = true;
+                }
+            }
+            struct pollfd pfd = { .fd = icmp->sock, .events = POLLIN };
+            if (!got && (n < 0 || (n == 0 && poll(&pfd, 1, BENCH_WAIT_MS) <= 0))) {
+                break;
+            }
+        }
+        if (!got) {
+            run->failed++;
+            continue;
+        }
+        run->missing += reply.kernel_rtt_ns == 0;
+        run->user_ns[run->count] = reply.recv_ns - start_ns;
+        run->kernel_ns[run->count++] = reply.kernel_rtt_ns;
+    }
+}
+
+// The kernel turns receive timestamps on from a workqueue, so the first
+// few ms of replies after enabling them have none. Probe until one does.
+static bool warm_up(icmp_probe_state_t *icmp) {
+    for (int i = 0; i < 1000; i++) {
+        bench_run_t run;
+        if (!run_alloc(&run, 1)) {
+            return false;
+        }
+        run_icmp(icmp, 1, 0, &run);
+        bool stamped = run.count == 1 && run.missing == 0;
+        run_free(&run);
+        if (stamped) {
+            return true;
+        }
+        struct timespec pause = { .tv_nsec = 1000000 };
+        nanosleep(&pause, NULL);
+    }
+    return false;
+}
+
+// Print a run and check it
+static bool report(const char *name, bench_run_t *run, uint64_t stall_ns) {
+    qsort(run->user_ns, run->count, sizeof(uint64_t), compare_u64);
+    qsort(run->kernel_ns, run->count, sizeof(uint64_t), compare_u64);
+    uint64_t user_p50 = pct(run->user_ns, run->count, 50);
+    uint64_t kernel_p50 = pct(run->kernel_ns, run->count, 50);
+    uint64_t kernel_p99 = pct(run->kernel_ns, run->count, 99);
+    printf("%-4s %6.1f ms %7zu %10.1f %10.1f %10.1f %10.1f %8zu\n", name, (double)stall_ns / 1e6,
+           run->count, (double)user_p50 / 1e3, (double)pct(run->user_ns, run->count, 99) / 1e3,
+           (double)kernel_p50 / 1e3, (double)kernel_p99 / 1e3, run->missing);
+
+    bool ok = run->count > 0 && run->missing * 100 <= run->count && run->failed * 100 <= run->count + run->failed;
+    if (stall_ns == 0) {
+        ok = ok && kernel_p50 <= user_p50 + BENCH_SLACK_NS;
+    } else {
+        ok = ok && user_p50 >= stall_ns && kernel_p99 < stall_ns / 2;
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    long long probes = argc > 1 ? atoll(argv[1]) : 2000;
+    if (probes <= 0) {
+        fprintf(stderr, "usage: %s [probes]\n", argv[0]);
+        return 2;
+    }
+    size_t stalled = (size_t)probes / 4 > 0 ? (size_t)probes / 4 : 1;
+
+    bench_listener_t listener;
+    atomic_init(&listener.running, true);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+    listener.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    pthread_t listen_thread;
+    if (listener.fd < 0 || bind(listener.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listener.fd, 128) != 0 || getsockname(listener.fd, (struct sockaddr *)&addr, &len) != 0 ||
+        pthread_create(&listen_thread, NULL, listen_loop, &listener) != 0) {
+        fprintf(stderr, "cannot listen on 127.0.0.1\n");
+        return 2;
+    }
+
+    printf("loopback, one probe at a time; RTTs in us\n");
+    printf("%-4s %9s %7s %10s %10s %10s %10s %8s\n", "", "stall", "probes",
+           "user p50", "user p99", "kern p50", "kern p99", "no kern");
+    bool ok = true;
+    bench_run_t run;
+    for (int s = 0; s < 2; s++) {
+        uint64_t stall_ns = s == 0 ? 0 : BENCH_STALL_NS;
+        if (!run_alloc(&run, (size_t)probes)) {
+            fprintf(stderr, "out of memory\n");
+            return 2;
+        }
+        run_tcp(&addr, s == 0 ? (size_t)probes : stalled, stall_ns, &run);
+        ok = report("tcp", &run, stall_ns) && ok;
+        run_free(&run);
+    }
+    atomic_store(&listener.running, false);
+    pthread_join(listen_thread, NULL);
+    close(listener.fd);
+
+    icmp_probe_state_t icmp;
+    if (icmp_probe_init(&icmp) != 0) {
+        printf("icmp SKIP (not available: %s)\n", icmp_probe_unavailable_reason());
+    } else if (icmp_probe_enable_timestamps(&icmp) != 0) {
+        printf("icmp SKIP (SO_TIMESTAMPING not available)\n");
+    } else if (!warm_up(&icmp)) {
+        printf("icmp: no kernel timestamps after 1 s\n");
+        ok = false;
+    } else {
+        for (int s = 0; s < 2; s++) {
+            uint64_t stall_ns = s == 0 ? 0 : BENCH_STALL_NS;
+            if (!run_alloc(&run, (size_t)probes)) {
+                fprintf(stderr, "out of memory\n");
+                return 2;
+            }
+            run_icmp(&icmp, s == 0 ? (size_t)probes : stalled, stall_ns, &run);
+            ok = report("icmp", &run, stall_ns) && ok;
+            run_free(&run);
+        }
+    }
+    icmp_probe_cleanup(&icmp);
+
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+import type { Batch, Metrics, WindowMetrics, WindowName } from '../types';
+
+// Binary batch subprotocol (layout in src/server/ws_binary.h)
+export const BINARY_PROTOCOL = 'netpulse.bin.v1';
+
+const BATCH = 1;
+const VERSION = 2;
+const WINDOWS: WindowName[] = ['1m', '5m', '1h', '24h'];
+const EVENT_FIELDS = ['loss_pct', 'p95_ms', 'jitter_ms'];
+
+// Samples of one batch, column by column
+export interface SampleColumns {
+  handle: Uint32Array;
+  ts: Float64Array;
+  rtt_ms: Float32Array;
+  success: Uint8Array;
+}
+
+class Reader {
+  private offset = 0;
+  private view: DataView;
+
+  constructor(view: DataView) {
+    this.view = view;
+  }
+
+  u8(): number {
+    return this.view.getUint8(this.offset++);
+  }
+
+  f32(): number {
+    const v = this.view.getFloat32(this.offset, true);
+    this.offset += 4;
+    return v;
+  }
+
+  // LEB128; plain arithmetic so values past 2^32 (timestamps) survive
+  varint(): number {
+    let v = 0;
+    let scale = 1;
+    for (;;) {
+      const b = this.u8();
+      v += (b & 0x7f) * scale;
+      if (b < 0x80) return v;
+      scale *= 128;
+    }
+  }
+
+  zigzag(): number {
+    const v = this.varint();
+    return v % 2 === 0 ? v / 2 : -(v + 1) / 2;
+  }
+
+  bytes(n: number): Uint8Array {
+    const v = new Uint8Array(this.view.buffer, this.view.byteOffset + this.offset, n);
+    this.offset += n;
+    return v;
+  }
+}
+
+function readSamples(r: Reader, baseTs: number): SampleColumns {
+  const n = r.varint();
+  const columns: SampleColumns = {
+    handle: new Uint32Array(n),
+    ts: new Float64Array(n),
+    rtt_ms: new Float32Array(n),
+    success: new Uint8Array(n),
+  };
+  for (let i = 0; i < n; i++) {
+    columns.handle[i] = r.varint();
+    columns.ts[i] = baseTs + r.zigzag();
+    columns.rtt_ms[i] = r.f32();
+  }
+  const bits = r.bytes((n + 7) >> 3);
+  for (let i = 0; i < n; i++) {
+    columns.success[i] = (bits[i >> 3] >> (i & 7)) & 1;
+  }
+  return columns;
+}
+
+function readWindow(r: Reader): WindowMetrics {
+  return {
+    samples: r.varint(),
+    loss_pct: r.f32(),
+    jitter_ms: r.f32(),
+    p50_ms: r.f32(),
+    p95_ms: r.f32(),
+    p99_ms: r.f32(),
+    max_rtt_ms: r.f32(),
+  };
+}
+
+function readMetrics(r: Reader): Metrics {
+  const metrics: Metrics = {
+    current_rtt_ms: r.f32(),
+    max_rtt_ms: r.f32(),
+    loss_pct: r.f32(),
+    jitter_ms: r.f32(),
+    p50_ms: r.f32(),
+    p95_ms: r.f32(),
+    p99_ms: r.f32(),
+    p999_ms: r.f32(),
+  };
+  const windows = {} as Record<WindowName, WindowMetrics>;
+  for (const name of WINDOWS) {
+    windows[name] = readWindow(r);
+  }
+  metrics.windows = windows;
+  return metrics;
+}
+
+const decoder = new TextDecoder();
+
+// Decode a binary batch; handles index targetIds (the order of the last
+// snapshot or targets_updated). Returns null for an unknown message.
+export function decodeBatch(buffer: ArrayBuffer, targetIds: string[]): Batch | null {
+  const r = new Reader(new DataView(buffer));
+  if (r.u8() !== BATCH || r.u8() !== VERSION) return null;
+  const seq = r.varint();
+  const baseTs = r.varint();
+
+  const batch: Batch = { seq, samples: [], metrics: [], events: [] };
+
+  const samples = readSamples(r, baseTs);
+  for (let i = 0; i < samples.handle.length; i++) {
+    const target_id = targetIds[samples.handle[i]];
+    if (target_id === undefined) continue;
+    batch.samples.push({
+      target_id,
+      ts: samples.ts[i],
+      rtt_ms: samples.rtt_ms[i],
+      success: samples.success[i] === 1,
+    });
+  }
+
+  const metricsCount = r.varint();
+  for (let i = 0; i < metricsCount; i++) {
+    const target_id = targetIds[r.varint()];
+    const metrics = readMetrics(r);
+    if (target_id !== undefined) {
+      batch.metrics.push({ target_id, metrics });
+    }
+  }
+
+  const eventCount = r.varint();
+  for (let i = 0; i < eventCount; i++) {
+    const target_id = targetIds[r.varint()];
+    const ts = baseTs + r.zigzag();
+    const field = EVENT_FIELDS[r.u8()] ?? 'unknown';
+    const value = r.f32();
+    const threshold = r.f32();
+    const duration_s = r.varint();
+    const reason = decoder.decode(r.bytes(r.varint()));
+    if (target_id !== undefined) {
+      batch.events.push({
+        ts,
+        target_id,
+        reason,
+        details: { [field]: value, threshold, duration_s },
+      });
+    }
+  }
+
+  return batch;
+}
@@ -1,21 +1,33 @@
 import { useMetricsStore } from '../stores/metricsStore';
 import type { WSMessage } from '../types';
+import { BINARY_PROTOCOL, decodeBatch } from './binaryProtocol';
+
+// Opt in to binary batches with ?ws=binary in the dashboard URL
+const useBinary = new URLSearchParams(window.location.search).get('ws') === 'binary';
 
 class WebSocketClient {
   private ws: WebSocket | null = null;
   private reconnectTimeout: number | null = null;
   private reconnectDelay = 1000;
   private maxReconnectDelay = 30000;
+  // Target ids by binary handle (order of the last target list)
+  private targetIds: string[] = [];
+  // Position in the daemon's message stream, sent back on reconnect so it
+  // replays what we missed instead of sending a whole new snapshot
+  private stream: string | null = null;
+  private lastSeq = 0;
 
   connect() {
     if (this.ws?.readyState === WebSocket.OPEN) return;
 
     const protocol = window.location.protocol === 'https:' ? 'wss:' : 'ws:';
-    const wsUrl = `${protocol}//${window.location.host}/ws`;
+    const resume = this.stream ? `?stream=${this.stream}&seq=${this.lastSeq}` : '';
+    const wsUrl = `${protocol}//${window.location.host}/ws${resume}`;
 
     console.log('Connecting to WebSocket:', wsUrl);
 
-    this.ws = new WebSocket(wsUrl);
+    this.ws = useBinary ? new WebSocket(wsUrl, BINARY_PROTOCOL) : new WebSocket(wsUrl);
+    this.ws.binaryType = 'arraybuffer';
 
     this.ws.onopen = () => {
       console.log('WebSocket connected');
@@ -35,6 +47,13 @@ class WebSocketClient {
 
     this.ws.onmessage = (event) => {
       try {
+        if (event.data instanceof ArrayBuffer) {
+          const batch = decodeBatch(event.data, this.targetIds);
+          if (batch && this.inSequence(batch.seq)) {
+            useMetricsStore.getState().applyBatch(batch);
+          }
+          return;
+        }
         const message = JSON.parse(event.data) as WSMessage;
         this.handleMessage(message);
       } catch (err) {
@@ -48,28 +67,16 @@ class WebSocketClient {
 
     switch (message.type) {
       case 'snapshot':
+        this.stream = message.stream;
+        this.lastSeq = message.seq;
+        this.targetIds = message.targets.map((t) => t.id);
         store.setSnapshot(message.targets, message.config);
         break;
 
-      case 'sample':
-        store.addSample(message.target_id, {
-          ts: message.ts,
-          rtt_ms: message.rtt_ms,
-          success: message.success,
-        });
-        break;
-
-      case 'metrics':
-        store.updateMetrics(message.target_id, message.metrics);
-        break;
-
-      case 'event':
-        store.addEvent({
-          ts: message.ts,
-          target_id: message.target_id,
-          reason: message.reason,
-          details: message.details,
-        });
+      case 'batch':
+        if (this.inSequence(message.seq)) {
+          store.applyBatch(message);
+        }
         break;
 
       case 'config_updated':
@@ -77,11 +84,29 @@ class WebSocketClient {
         break;
 
       case 'targets_updated':
-        store.setTargets(message.targets, message.config);
+        if (this.inSequence(message.seq)) {
+          this.targetIds = message.targets.map((t) => t.id);
+          store.setTargets(message.targets, message.config);
+        }
         break;
     }
   }
 
+  // Take the next message of the stream. Anything already seen is skipped;
+  // after a gap the connection is dropped, and the reconnect catches up
+  // from the last message taken.
+  private inSequence(seq: number): boolean {
+    if (seq === this.lastSeq + 1) {
+      this.lastSeq = seq;
+      return true;
+    }
+    if (seq > this.lastSeq) {
+      console.warn(`WebSocket message ${seq} after ${this.lastSeq}, resyncing`);
+      this.ws?.close();
+    }
+    return false;
+  }
+
   private scheduleReconnect() {
     if (this.reconnectTimeout) return;
 
@@ -1,5 +1,5 @@
 import { useState, useEffect } from 'react';
-import type { Target, Thresholds } from '../types';
+import type { Target, Thresholds, WindowName } from '../types';
 
 interface TargetCardProps {
   target: Target;
@@ -8,6 +8,7 @@ interface TargetCardProps {
 
 const MAX_SAMPLES = 120;
 const WARMING_THRESHOLD = 20;
+const WINDOWS: WindowName[] = ['1m', '5m', '1h', '24h'];
 
 function getStatusColor(value: number, threshold: number): string {
   const ratio = value / threshold;
@@ -156,8 +157,38 @@ export function TargetCard({ target, thresholds }: TargetCardProps) {
           threshold={thresholds?.p95_ms}
           isWarming={isWarming}
         />
+        <MetricRow
+          label="P99 Latency"
+          value={metrics.p99_ms}
+          unit="ms"
+          isWarming={isWarming}
+        />
       </div>
 
+      {/* Longer windows */}
+      {metrics.windows && (
+        <div className="mt-2 border-t border-slate-700 pt-2">
+          <div className="grid grid-cols-5 gap-1 text-xs font-mono">
+            <span className="text-slate-500">window</span>
+            {WINDOWS.map((name) => (
+              <span key={name} className="text-slate-500 text-right">{name}</span>
+            ))}
+            <span className="text-slate-400">p95</span>
+            {WINDOWS.map((name) => (
+              <span key={name} className="text-slate-300 text-right">
+                {metrics.windows![name].samples > 0 ? metrics.windows![name].p95_ms.toFixed(1) : '-'}
+              </span>
+            ))}
+            <span className="text-slate-400">loss</span>
+            {WINDOWS.map((name) => (
+              <span key={name} className="text-slate-300 text-right">
+                {metrics.windows![name].samples > 0 ? `${metrics.windows![name].loss_pct.toFixed(1)}%` : '-'}
+              </span>
+            ))}
+          </div>
+        </div>
+      )}
+
       {/* Thresholds footer */}
       {thresholds && (
         <div className="mt-3 pt-2 border-t border-slate-700">
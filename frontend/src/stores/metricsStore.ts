@@ -1,5 +1,5 @@
 import { create } from 'zustand';
-import type { Target, Config, NetEvent, Sample, Metrics } from '../types';
+import type { Target, Config, NetEvent, Batch } from '../types';
 
 interface MetricsState {
   targets: Map<string, Target>;
@@ -10,9 +10,7 @@ interface MetricsState {
   // Actions
   setSnapshot: (targets: Target[], config: Config) => void;
   setTargets: (targets: Target[], config: Config) => void;
-  addSample: (targetId: string, sample: Sample) => void;
-  updateMetrics: (targetId: string, metrics: Metrics) => void;
-  addEvent: (event: NetEvent) => void;
+  applyBatch: (batch: Batch) => void;
   updateConfig: (config: Config) => void;
   setConnected: (connected: boolean) => void;
 }
@@ -52,36 +50,41 @@ export const useMetricsStore = create<MetricsState>((set) => ({
     return { targets: targetMap, config };
   }),
 
-  addSample: (targetId, sample) => set((state) => {
-    const target = state.targets.get(targetId);
-    if (!target) return state;
-
-    const newSamples = [...target.samples, sample];
-    // Keep only last MAX_SAMPLES
-    if (newSamples.length > MAX_SAMPLES) {
-      newSamples.shift();
-    }
-
+  // One state update for everything in the batch
+  applyBatch: (batch) => set((state) => {
     const newTargets = new Map(state.targets);
-    newTargets.set(targetId, { ...target, samples: newSamples });
-    return { targets: newTargets };
-  }),
+    const copied = new Set<string>();
 
-  updateMetrics: (targetId, metrics) => set((state) => {
-    const target = state.targets.get(targetId);
-    if (!target) return state;
+    for (const { target_id, ...sample } of batch.samples) {
+      const target = newTargets.get(target_id);
+      if (!target) continue;
 
-    const newTargets = new Map(state.targets);
-    newTargets.set(targetId, { ...target, metrics });
-    return { targets: newTargets };
-  }),
+      // Copy each target's samples once, then append to the copy
+      let samples = target.samples;
+      if (!copied.has(target_id)) {
+        copied.add(target_id);
+        samples = [...samples];
+        newTargets.set(target_id, { ...target, samples });
+      }
+      samples.push(sample);
+      // Keep only last MAX_SAMPLES
+      if (samples.length > MAX_SAMPLES) {
+        samples.shift();
+      }
+    }
 
-  addEvent: (event) => set((state) => {
-    const newEvents = [...state.events, event];
-    if (newEvents.length > MAX_EVENTS) {
-      newEvents.shift();
+    for (const { target_id, metrics } of batch.metrics) {
+      const target = newTargets.get(target_id);
+      if (!target) continue;
+      newTargets.set(target_id, { ...target, metrics });
     }
-    return { events: newEvents };
+
+    let events = state.events;
+    if (batch.events.length > 0) {
+      events = [...state.events, ...batch.events].slice(-MAX_EVENTS);
+    }
+
+    return { targets: newTargets, events };
   }),
 
   updateConfig: (config) => set({ config }),
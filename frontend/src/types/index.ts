@@ -5,7 +5,20 @@ export interface Sample {
   success: boolean;
 }
 
-// Computed metrics for a target
+// Statistics of one window
+export interface WindowMetrics {
+  samples: number;
+  loss_pct: number;
+  jitter_ms: number;
+  p50_ms: number;
+  p95_ms: number;
+  p99_ms: number;
+  max_rtt_ms: number;
+}
+
+export type WindowName = '1m' | '5m' | '1h' | '24h';
+
+// Computed metrics for a target (top-level fields are the 1m window)
 export interface Metrics {
   current_rtt_ms: number;
   max_rtt_ms: number;
@@ -13,6 +26,9 @@ export interface Metrics {
   jitter_ms: number;
   p50_ms: number;
   p95_ms: number;
+  p99_ms: number;
+  p999_ms: number;
+  windows?: Record<WindowName, WindowMetrics>;
 }
 
 // Target with metrics and samples
@@ -49,11 +65,17 @@ export interface NetEvent {
   };
 }
 
+// Updates gathered by the daemon over one scheduler tick
+export interface Batch {
+  seq: number;
+  samples: (Sample & { target_id: string })[];
+  metrics: { target_id: string; metrics: Metrics }[];
+  events: NetEvent[];
+}
+
 // WebSocket message types
 export type WSMessage =
-  | { type: 'snapshot'; targets: Target[]; config: Config }
-  | { type: 'sample'; target_id: string; ts: number; rtt_ms: number; success: boolean }
-  | { type: 'metrics'; target_id: string; metrics: Metrics }
-  | { type: 'event'; ts: number; target_id: string; reason: string; details: Record<string, number> }
+  | { type: 'snapshot'; stream: string; seq: number; targets: Target[]; config: Config }
+  | ({ type: 'batch' } & Batch)
   | { type: 'config_updated'; config: Config }
-  | { type: 'targets_updated'; targets: Target[]; config: Config };
+  | { type: 'targets_updated'; seq: number; targets: Target[]; config: Config };
@@ -2,6 +2,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 void config_slugify(const char *label, char *slug, size_t slug_size) {
     if (label == NULL || slug == NULL || slug_size == 0) {
@@ -43,6 +44,15 @@ void config_init(config_t *cfg) {
     cfg->probe_timeout_ms = DEFAULT_PROBE_TIMEOUT_MS;
     cfg->http_port = HTTP_WS_PORT;
     cfg->probe_type = PROBE_TYPE_TCP;  // Default to TCP (works everywhere)
+    cfg->probe_engine = PROBE_ENGINE_POLL;
+    cfg->kernel_timestamps = false;    // Opt-in, userspace timing by default
+    cfg->history_hours = DEFAULT_HISTORY_HOURS;
+    cfg->ws_batch_ms = DEFAULT_WS_BATCH_MS;
+    cfg->ws_deflate = WS_DEFLATE_SHARED;
+    cfg->ws_deflate_min = DEFAULT_WS_DEFLATE_MIN;
+    cfg->ws_replay_kb = DEFAULT_WS_REPLAY_KB;
+    cfg->ws_queue_kb = DEFAULT_WS_QUEUE_KB;
+    cfg->probe_cpu = -1;
 
     cfg->thresholds.loss_pct = DEFAULT_LOSS_THRESHOLD;
     cfg->thresholds.p95_ms = DEFAULT_P95_THRESHOLD;
@@ -55,6 +65,54 @@ void config_init(config_t *cfg) {
     config_add_target(cfg, "8.8.8.8", 443, "Google");
 }
 
+void config_free(config_t *cfg) {
+    if (cfg == NULL) {
+        return;
+    }
+
+    free(cfg->targets);
+    cfg->targets = NULL;
+    cfg->target_count = 0;
+    cfg->target_capacity = 0;
+}
+
+int config_copy(config_t *dst, const config_t *src) {
+    if (dst == NULL || src == NULL) {
+        return -1;
+    }
+
+    *dst = *src;
+    dst->targets = NULL;
+    dst->target_capacity = 0;
+    if (src->target_count > 0) {
+        dst->targets = malloc((size_t)src->target_count * sizeof(*dst->targets));
+        if (dst->targets == NULL) {
+            dst->target_count = 0;
+            return -1;
+        }
+        memcpy(dst->targets, src->targets, (size_t)src->target_count * sizeof(*dst->targets));
+        dst->target_capacity = src->target_count;
+    }
+    return 0;
+}
+
+// Make room for one more target, doubling the array when full
+static int config_reserve_target(config_t *cfg) {
+    if (cfg->target_count < cfg->target_capacity) {
+        return 0;
+    }
+
+    int new_capacity = cfg->target_capacity > 0 ? cfg->target_capacity * 2 : 8;
+    target_config_t *targets = realloc(cfg->targets, (size_t)new_capacity * sizeof(*targets));
+    if (targets == NULL) {
+        return -1;
+    }
+
+    cfg->targets = targets;
+    cfg->target_capacity = new_capacity;
+    return 0;
+}
+
 int config_add_target(config_t *cfg, const char *host, uint16_t port, const char *label) {
     if (cfg == NULL || host == NULL || label == NULL) {
         return -1;
@@ -73,6 +131,10 @@ int config_add_target(config_t *cfg, const char *host, uint16_t port, const char
         return -1;
     }
 
+    if (config_reserve_target(cfg) != 0) {
+        return -1;
+    }
+
     int idx = cfg->target_count;
     target_config_t *target = &cfg->targets[idx];
 
@@ -102,9 +164,8 @@ int config_remove_target(config_t *cfg, const char *id) {
     for (int i = 0; i < cfg->target_count; i++) {
         if (strcmp(cfg->targets[i].id, id) == 0) {
             // Shift remaining targets down
-            for (int j = i; j < cfg->target_count - 1; j++) {
-                cfg->targets[j] = cfg->targets[j + 1];
-            }
+            memmove(&cfg->targets[i], &cfg->targets[i + 1],
+                    (size_t)(cfg->target_count - 1 - i) * sizeof(target_config_t));
             cfg->target_count--;
 
             // Clear the last slot
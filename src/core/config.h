@@ -15,8 +15,16 @@
 #define DEFAULT_P95_THRESHOLD       125.0   // ms
 #define DEFAULT_JITTER_THRESHOLD    20.0    // ms
 #define BAD_CONDITION_DURATION_S    10      // seconds before emitting event
+#define DEFAULT_HISTORY_HOURS       168     // Sample history kept on disk (7 days)
+#define DEFAULT_WS_BATCH_MS         0       // WebSocket batch interval (0 = every tick)
+#define MAX_WS_BATCH_MS             10000
+#define DEFAULT_WS_DEFLATE_MIN      256     // Smaller WebSocket messages go out uncompressed
+#define DEFAULT_WS_REPLAY_KB        4096    // Recent WebSocket messages kept for reconnects
+#define MAX_WS_REPLAY_KB            (1024 * 1024)
+#define DEFAULT_WS_QUEUE_KB         4096    // WebSocket backlog at which a client is congested
+#define MAX_WS_QUEUE_KB             (1024 * 1024)
 #define HTTP_WS_PORT                7331
-#define MAX_TARGETS                 10
+#define MAX_TARGETS                 65536   // Upper bound on configured targets
 #define MAX_LABEL_LEN               64
 #define MAX_HOST_LEN                256
 
@@ -28,6 +36,23 @@ typedef enum {
     PROBE_TYPE_ICMP,    // ICMP Echo (Linux only, requires CAP_NET_RAW)
 } probe_type_t;
 
+/*
+ * TCP probe engine selection
+ */
+typedef enum {
+    PROBE_ENGINE_POLL,  // Socket per probe watched by the reactor (default)
+    PROBE_ENGINE_URING, // Batched io_uring submissions (Linux 5.19+)
+} probe_engine_kind_t;
+
+/*
+ * WebSocket permessage-deflate
+ */
+typedef enum {
+    WS_DEFLATE_OFF,
+    WS_DEFLATE_SHARED,  // No context takeover: each message compressed once for all clients
+    WS_DEFLATE_CONTEXT, // Context takeover: compressed per client, smaller frames
+} ws_deflate_mode_t;
+
 /*
  * Threshold configuration for "bad minute" detection
  */
@@ -56,14 +81,31 @@ typedef struct {
     uint32_t probe_timeout_ms;
     uint16_t http_port;
     probe_type_t probe_type;
+    probe_engine_kind_t probe_engine;
+    bool kernel_timestamps;         // Take RTT from kernel timestamps (Linux)
+    uint32_t history_hours;         // Sample history kept on disk (0 = don't store)
+    uint32_t ws_batch_ms;           // Hold WebSocket updates this long (0 = one batch per tick)
+    ws_deflate_mode_t ws_deflate;   // permessage-deflate for clients that offer it
+    uint32_t ws_deflate_min;        // Smallest message worth compressing (bytes)
+    uint32_t ws_replay_kb;          // Replay log for reconnecting clients (0 = off)
+    uint32_t ws_queue_kb;           // Per-client backlog before samples are dropped (0 = no limit)
+    int probe_cpu;                  // CPU the probe thread is pinned to (-1 = not pinned)
     thresholds_t thresholds;
-    target_config_t targets[MAX_TARGETS];
+    target_config_t *targets;       // Growable array of target_count entries
     int target_count;
+    int target_capacity;
 } config_t;
 
 // Initialize config with defaults
 void config_init(config_t *cfg);
 
+// Free config resources
+void config_free(config_t *cfg);
+
+// Make dst a copy of src, targets included (dst is not freed first).
+// Returns 0 on success, -1 on error.
+int config_copy(config_t *dst, const config_t *src);
+
 // Add a target. Returns target index on success, -1 on error.
 int config_add_target(config_t *cfg, const char *host, uint16_t port, const char *label);
 
@@ -0,0 +1,193 @@
+#include "core/long_window.h"
+#include <math.h>
+#include <string.h>
+
+typedef struct {
+    uint64_t bucket_ms;     // Bucket width
+    uint32_t slot_count;    // Closed buckets + the open one
+    uint32_t first_slot;    // Offset of the level's ring in slots[]
+} level_shape_t;
+
+static const level_shape_t g_shapes[LONG_WINDOW_COUNT] = {
+    [LONG_WINDOW_5M]  = { 60000ULL,   6,  0 },
+    [LONG_WINDOW_1H]  = { 300000ULL,  13, 6 },
+    [LONG_WINDOW_24H] = { 3600000ULL, 25, 19 },
+};
+
+static long_bucket_t *slot_at(long_windows_t *lw, int level, uint32_t slot) {
+    return &lw->slots[g_shapes[level].first_slot + slot];
+}
+
+static long_bucket_t *open_bucket(long_windows_t *lw, int level) {
+    return slot_at(lw, level, lw->levels[level].head);
+}
+
+static void bucket_merge(long_bucket_t *dst, const long_bucket_t *src) {
+    quantile_coarse_merge(&dst->rtt, &src->rtt);
+    dst->count += src->count;
+    dst->failures += src->failures;
+    dst->jitter_count += src->jitter_count;
+    dst->jitter_sum_ns += src->jitter_sum_ns;
+    if (src->max_rtt_ms > dst->max_rtt_ms) {
+        dst->max_rtt_ms = src->max_rtt_ms;
+    }
+}
+
+// Max over the closed buckets of a level
+static double closed_max(long_windows_t *lw, int level) {
+    const long_level_t *lv = &lw->levels[level];
+    double max_rtt = 0.0;
+    for (uint32_t i = 0; i < g_shapes[level].slot_count; i++) {
+        const long_bucket_t *b = slot_at(lw, level, i);
+        if (i != lv->head && b->max_rtt_ms > max_rtt) {
+            max_rtt = b->max_rtt_ms;
+        }
+    }
+    return max_rtt;
+}
+
+static void advance_level(long_windows_t *lw, int level, uint64_t index);
+
+// Close the open bucket of a level and open the next one
+static void rotate_level(long_windows_t *lw, int level) {
+    long_level_t *lv = &lw->levels[level];
+    const level_shape_t *shape = &g_shapes[level];
+    long_bucket_t *closed = open_bucket(lw, level);
+
+    if (closed->count > 0) {
+        quantile_coarse_sum_add(&lv->closed_rtt, &closed->rtt);
+        lv->closed_count += closed->count;
+        lv->closed_failures += closed->failures;
+        lv->closed_jitter_count += closed->jitter_count;
+        lv->closed_jitter_sum_ns += closed->jitter_sum_ns;
+        if (closed->max_rtt_ms > lv->closed_max_rtt_ms) {
+            lv->closed_max_rtt_ms = closed->max_rtt_ms;
+        }
+
+        // Cascade into the bucket of the next level that this one falls in
+        if (level + 1 < LONG_WINDOW_COUNT) {
+            uint64_t start_ms = lv->open_index * shape->bucket_ms;
+            advance_level(lw, level + 1, start_ms / g_shapes[level + 1].bucket_ms);
+            bucket_merge(open_bucket(lw, level + 1), closed);
+        }
+    }
+
+    lv->head = (lv->head + 1) % shape->slot_count;
+    lv->open_index++;
+
+    // The slot reused for the new open bucket held the oldest closed one
+    long_bucket_t *evicted = open_bucket(lw, level);
+    if (evicted->count > 0) {
+        quantile_coarse_sum_sub(&lv->closed_rtt, &evicted->rtt);
+        lv->closed_count -= evicted->count;
+        lv->closed_failures -= evicted->failures;
+        lv->closed_jitter_count -= evicted->jitter_count;
+        lv->closed_jitter_sum_ns -= evicted->jitter_sum_ns;
+        memset(evicted, 0, sizeof(*evicted));
+        lv->closed_max_rtt_ms = closed_max(lw, level);
+    }
+}
+
+// Rotate a level until its open bucket is the one for time index
+static void advance_level(long_windows_t *lw, int level, uint64_t index) {
+    long_level_t *lv = &lw->levels[level];
+    while (lv->open_index < index) {
+        // After a long gap every closed bucket is empty; skip to the end
+        if (lv->closed_count == 0 && open_bucket(lw, level)->count == 0) {
+            lv->open_index = index;
+            break;
+        }
+        rotate_level(lw, level);
+    }
+}
+
+static void advance(long_windows_t *lw, uint64_t now_ms) {
+    if (!lw->started) {
+        for (int level = 0; level < LONG_WINDOW_COUNT; level++) {
+            lw->levels[level].open_index = now_ms / g_shapes[level].bucket_ms;
+        }
+        lw->started = true;
+        return;
+    }
+
+    // Lower levels first: their closing buckets cascade upwards
+    for (int level = 0; level < LONG_WINDOW_COUNT; level++) {
+        advance_level(lw, level, now_ms / g_shapes[level].bucket_ms);
+    }
+}
+
+void long_windows_push(long_windows_t *lw, bool success, double rtt_ms, uint64_t now_ms) {
+    if (lw == NULL) {
+        return;
+    }
+
+    advance(lw, now_ms);
+    long_bucket_t *b = open_bucket(lw, 0);
+    b->count++;
+
+    if (!success) {
+        b->failures++;
+        return;
+    }
+
+    if (lw->has_last_rtt) {
+        b->jitter_count++;
+        b->jitter_sum_ns += (uint64_t)(fabs(rtt_ms - lw->last_rtt_ms) * 1000000.0 + 0.5);
+    }
+    lw->last_rtt_ms = rtt_ms;
+    lw->has_last_rtt = true;
+
+    quantile_coarse_add(&b->rtt, rtt_ms);
+    if (rtt_ms > b->max_rtt_ms) {
+        b->max_rtt_ms = rtt_ms;
+    }
+}
+
+// v, or limit if that is smaller
+static double at_most(double v, double limit) {
+    return v < limit ? v : limit;
+}
+
+void long_windows_compute(long_windows_t *lw, uint64_t now_ms, window_metrics_t out[LONG_WINDOW_COUNT]) {
+    if (lw == NULL || out == NULL) {
+        return;
+    }
+
+    advance(lw, now_ms);
+
+    for (int level = 0; level < LONG_WINDOW_COUNT; level++) {
+        const long_level_t *lv = &lw->levels[level];
+        window_metrics_t *m = &out[level];
+
+        // Closed buckets of this level plus the open buckets of it and every
+        // level below (those have not cascaded up yet)
+        const quantile_coarse_t *open_rtt[LONG_WINDOW_COUNT];
+        uint64_t count = lv->closed_count;
+        uint64_t failures = lv->closed_failures;
+        uint64_t jitter_count = lv->closed_jitter_count;
+        uint64_t jitter_sum_ns = lv->closed_jitter_sum_ns;
+        double max_rtt = lv->closed_max_rtt_ms;
+
+        for (int below = 0; below <= level; below++) {
+            const long_bucket_t *b = open_bucket(lw, below);
+            open_rtt[below] = &b->rtt;
+            count += b->count;
+            failures += b->failures;
+            jitter_count += b->jitter_count;
+            jitter_sum_ns += b->jitter_sum_ns;
+            if (b->max_rtt_ms > max_rtt) {
+                max_rtt = b->max_rtt_ms;
+            }
+        }
+
+        size_t open_count = (size_t)level + 1;
+        m->sample_count = (uint32_t)count;
+        m->loss_pct = count == 0 ? 0.0 : (double)failures / (double)count * 100.0;
+        m->jitter_ms = jitter_count == 0 ? 0.0 : (double)jitter_sum_ns / 1000000.0 / (double)jitter_count;
+        // Bucket midpoints can lie above the exact max
+        m->p50_ms = at_most(quantile_coarse_query(&lv->closed_rtt, open_rtt, open_count, 50.0), max_rtt);
+        m->p95_ms = at_most(quantile_coarse_query(&lv->closed_rtt, open_rtt, open_count, 95.0), max_rtt);
+        m->p99_ms = at_most(quantile_coarse_query(&lv->closed_rtt, open_rtt, open_count, 99.0), max_rtt);
+        m->max_rtt_ms = max_rtt;
+    }
+}
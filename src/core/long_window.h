@@ -0,0 +1,91 @@
+#ifndef NETPULSE_LONG_WINDOW_H
+#define NETPULSE_LONG_WINDOW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "core/quantile.h"
+
+/*
+ * Long statistics windows (5 min, 1 h, 24 h) built from cascading buckets
+ *
+ * Samples are counted into a 1-minute bucket. When it closes it is merged
+ * into the open 5-minute bucket, which in turn is merged into the open
+ * 1-hour bucket when it closes. Each level keeps a ring of its last closed
+ * buckets and a running sum of them, so a window costs O(buckets) memory no
+ * matter how many samples it spans, and rotating a bucket costs one sketch
+ * add and one subtract.
+ *
+ *   window  bucket  closed buckets  covers
+ *   5m      1 min   5               5-6 min
+ *   1h      5 min   12              60-65 min
+ *   24h     1 h     24              24-25 h
+ *
+ * A window also includes the open buckets of its own and lower levels, so
+ * samples count as soon as they arrive. Percentiles come from coarse
+ * sketches (3.1% bound, see core/quantile.h).
+ */
+
+typedef enum {
+    LONG_WINDOW_5M,
+    LONG_WINDOW_1H,
+    LONG_WINDOW_24H,
+    LONG_WINDOW_COUNT
+} long_window_id_t;
+
+#define LONG_WINDOW_SLOTS   (6 + 13 + 25)  // Closed buckets + the open one, all levels
+
+/*
+ * Aggregate of the samples in one time bucket
+ */
+typedef struct {
+    quantile_coarse_t rtt;      // Successful RTTs
+    uint32_t count;             // Samples
+    uint32_t failures;          // Failed samples
+    uint32_t jitter_count;      // Deltas between consecutive successful RTTs
+    uint64_t jitter_sum_ns;     // Sum of their absolute values
+    double max_rtt_ms;          // Largest successful RTT
+} long_bucket_t;
+
+/*
+ * One level: a ring of buckets (head = open) and the sum of the closed ones
+ */
+typedef struct {
+    uint32_t head;              // Open bucket (index into the level's slots)
+    uint64_t open_index;        // Time index (ms / bucket width) of the open bucket
+    quantile_coarse_sum_t closed_rtt;
+    uint64_t closed_count;
+    uint64_t closed_failures;
+    uint64_t closed_jitter_count;
+    uint64_t closed_jitter_sum_ns;
+    double closed_max_rtt_ms;
+} long_level_t;
+
+typedef struct {
+    long_bucket_t slots[LONG_WINDOW_SLOTS];  // Every level's ring, back to back
+    long_level_t levels[LONG_WINDOW_COUNT];
+    double last_rtt_ms;         // Newest successful RTT (for jitter)
+    bool has_last_rtt;
+    bool started;               // Bucket clocks set (zeroed = empty)
+} long_windows_t;
+
+/*
+ * Statistics of one window
+ */
+typedef struct {
+    double loss_pct;
+    double jitter_ms;
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+    double max_rtt_ms;
+    uint32_t sample_count;
+} window_metrics_t;
+
+// Count a sample completed at now_ms (monotonic). Zeroed storage is an
+// empty long_windows_t.
+void long_windows_push(long_windows_t *lw, bool success, double rtt_ms, uint64_t now_ms);
+
+// Rotate buckets up to now_ms and compute every window into out
+void long_windows_compute(long_windows_t *lw, uint64_t now_ms, window_metrics_t out[LONG_WINDOW_COUNT]);
+
+#endif // NETPULSE_LONG_WINDOW_H
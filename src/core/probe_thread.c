@@ -0,0 +1,352 @@
+#include "core/probe_thread.h"
+#include "platform/platform.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+// Probe thread: queue an update (just its header and payload take up room),
+// or drop it if the server is that far behind
+static void publish(probe_thread_t *pt, probe_msg_type_t type, int index,
+                    const void *payload, size_t size) {
+    probe_msg_t *msg = spsc_queue_reserve(&pt->updates, offsetof(probe_msg_t, u) + size);
+    if (msg == NULL) {
+        atomic_fetch_add_explicit(&pt->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    msg->type = type;
+    msg->index = index;
+    memcpy(&msg->u, payload, size);
+    spsc_queue_commit(&pt->updates);
+    atomic_fetch_add_explicit(&pt->published_count, 1, memory_order_relaxed);
+    pt->published = true;
+}
+
+// Probe thread: wake the server once for everything published since the
+// last wake. Pairs with the exchange in probe_thread_drain: if this finds
+// the server already woken, its drain comes after and sees these updates.
+static void notify(probe_thread_t *pt) {
+    if (!pt->published) {
+        return;
+    }
+    pt->published = false;
+    if (!atomic_exchange(&pt->wake_pending, true) && pt->wake != NULL) {
+        pt->wake(pt->wake_ctx);
+    }
+}
+
+// Probe thread: queue a target change, waiting for room if need be (the
+// server's indices depend on seeing every one)
+static void publish_target(probe_thread_t *pt, probe_msg_type_t type, int index,
+                           const target_config_t *target) {
+    while (atomic_load(&pt->running)) {
+        probe_msg_t *msg = spsc_queue_reserve(&pt->updates,
+                                              offsetof(probe_msg_t, u) + sizeof(*target));
+        if (msg != NULL) {
+            msg->type = type;
+            msg->index = index;
+            msg->u.target = *target;
+            spsc_queue_commit(&pt->updates);
+            atomic_fetch_add_explicit(&pt->published_count, 1, memory_order_relaxed);
+            pt->published = true;
+            return;
+        }
+        pt->published = true;
+        notify(pt);
+        poll(NULL, 0, 1);
+    }
+}
+
+// Scheduler callbacks (probe thread)
+static void on_sample(int index, const char *target_id, const sample_t *sample, void *ctx) {
+    (void)target_id;
+    publish((probe_thread_t *)ctx, PROBE_MSG_SAMPLE, index, sample, sizeof(*sample));
+}
+
+static void on_metrics(int index, const char *target_id, const metrics_t *metrics, void *ctx) {
+    (void)target_id;
+    publish((probe_thread_t *)ctx, PROBE_MSG_METRICS, index, metrics, sizeof(*metrics));
+}
+
+static void on_event(int index, const event_t *event, void *ctx) {
+    publish((probe_thread_t *)ctx, PROBE_MSG_EVENT, index, event, sizeof(*event));
+}
+
+// Index of a target in the scheduler, or -1
+static int find_target(const scheduler_t *sched, const char *id) {
+    for (int i = 0; i < sched->target_count; i++) {
+        if (strcmp(sched->target_configs[i].id, id) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void add_target(probe_thread_t *pt, const target_config_t *target) {
+    scheduler_t *sched = pt->sched;
+    int index = config_add_target(sched->config, target->host, target->port, target->label);
+    if (index >= 0 && scheduler_sync_targets(sched) == 0) {
+        publish_target(pt, PROBE_MSG_TARGET_ADDED, index, &sched->target_configs[index]);
+        return;
+    }
+
+    // Tell the server it isn't probed after all
+    fprintf(stderr, "[probe] Failed to add target %s\n", target->id);
+    if (index >= 0) {
+        config_remove_target(sched->config, target->id);
+        scheduler_sync_targets(sched);
+    }
+    publish_target(pt, PROBE_MSG_TARGET_REMOVED, -1, target);
+}
+
+static void remove_target(probe_thread_t *pt, const target_config_t *target) {
+    scheduler_t *sched = pt->sched;
+    int index = find_target(sched, target->id);
+    if (index < 0 || config_remove_target(sched->config, target->id) != 0) {
+        return;
+    }
+    if (scheduler_sync_targets(sched) != 0) {
+        fprintf(stderr, "[probe] Failed to remove target %s\n", target->id);
+        return;
+    }
+    publish_target(pt, PROBE_MSG_TARGET_REMOVED, index, target);
+}
+
+static void run_command(probe_thread_t *pt, const probe_cmd_t *cmd) {
+    config_t *config = pt->sched->config;
+    switch (cmd->type) {
+        case PROBE_CMD_ADD_TARGET:
+            add_target(pt, &cmd->u.target);
+            break;
+        case PROBE_CMD_REMOVE_TARGET:
+            remove_target(pt, &cmd->u.target);
+            break;
+        case PROBE_CMD_SETTINGS:
+            // Read by the scheduler as it goes: the next probe uses them
+            config->probe_interval_ms = cmd->u.settings.probe_interval_ms;
+            config->probe_timeout_ms = cmd->u.settings.probe_timeout_ms;
+            config->thresholds = cmd->u.settings.thresholds;
+            break;
+    }
+}
+
+// Probe thread: apply every queued command
+static void run_commands(probe_thread_t *pt) {
+    char drain[64];
+    while (read(pt->command_pipe[0], drain, sizeof(drain)) > 0) {
+    }
+
+    probe_cmd_t cmds[16];
+    size_t count;
+    while ((count = spsc_ring_pop(&pt->commands, cmds, 16)) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            run_command(pt, &cmds[i]);
+        }
+    }
+}
+
+// Reactor handler: the server queued a command
+static void on_command(int fd, unsigned events, void *ctx) {
+    (void)fd;
+    (void)events;
+    run_commands((probe_thread_t *)ctx);
+}
+
+static void *probe_thread_main(void *arg) {
+    probe_thread_t *pt = arg;
+
+    // Signals are the main thread's to handle
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    if (pt->cpu >= 0) {
+        if (pin_current_thread(pt->cpu) == 0) {
+            printf("[probe] Pinned to CPU %d\n", pt->cpu);
+        } else {
+            fprintf(stderr, "[probe] Cannot pin to CPU %d, running unpinned\n", pt->cpu);
+        }
+    }
+
+    while (atomic_load(&pt->running)) {
+        int timeout = scheduler_tick(pt->sched);
+        notify(pt);
+
+        if (pt->use_reactor) {
+            // Sleep until a probe socket or the command pipe is ready, or
+            // the next probe/metrics deadline
+            reactor_wait(&pt->reactor, timeout);
+        } else {
+            // Cap at 2ms for accurate RTT measurement: completed connects
+            // are only seen on the next tick
+            struct pollfd pfd = { .fd = pt->command_pipe[0], .events = POLLIN };
+            poll(&pfd, 1, timeout < 2 ? timeout : 2);
+            run_commands(pt);
+        }
+        notify(pt);
+    }
+    return NULL;
+}
+
+int probe_thread_init(probe_thread_t *pt, scheduler_t *sched, int cpu) {
+    if (pt == NULL || sched == NULL) {
+        return -1;
+    }
+
+    memset(pt, 0, sizeof(*pt));
+    pt->sched = sched;
+    pt->cpu = cpu;
+    pt->command_pipe[0] = -1;
+    pt->command_pipe[1] = -1;
+    atomic_init(&pt->wake_pending, false);
+    atomic_init(&pt->running, false);
+    atomic_init(&pt->published_count, 0);
+    atomic_init(&pt->dropped, 0);
+
+    if (spsc_queue_init(&pt->updates, PROBE_QUEUE_BYTES) != 0) {
+        return -1;
+    }
+    if (spsc_ring_init(&pt->commands, sizeof(probe_cmd_t), PROBE_COMMANDS) != 0 ||
+        pipe(pt->command_pipe) != 0) {
+        probe_thread_free(pt);
+        return -1;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(pt->command_pipe[i], F_SETFL, fcntl(pt->command_pipe[i], F_GETFL) | O_NONBLOCK);
+    }
+
+    // Probe sockets and the command pipe in one epoll set (polling otherwise)
+    if (reactor_init(&pt->reactor) == 0) {
+        if (reactor_add(&pt->reactor, pt->command_pipe[0], REACTOR_EV_READ, on_command, pt) == 0) {
+            scheduler_set_reactor(sched, &pt->reactor);
+            pt->use_reactor = true;
+        } else {
+            reactor_free(&pt->reactor);
+        }
+    }
+
+    scheduler_set_sample_callback(sched, on_sample, pt);
+    scheduler_set_metrics_callback(sched, on_metrics, pt);
+    scheduler_set_event_callback(sched, on_event, pt);
+    return 0;
+}
+
+int probe_thread_start(probe_thread_t *pt, probe_wake_t wake, void *ctx) {
+    if (pt == NULL || pt->started) {
+        return -1;
+    }
+
+    pt->wake = wake;
+    pt->wake_ctx = ctx;
+    atomic_store(&pt->running, true);
+    if (pthread_create(&pt->thread, NULL, probe_thread_main, pt) != 0) {
+        atomic_store(&pt->running, false);
+        return -1;
+    }
+    pt->started = true;
+    return 0;
+}
+
+void probe_thread_stop(probe_thread_t *pt) {
+    if (pt == NULL || !pt->started) {
+        return;
+    }
+
+    atomic_store(&pt->running, false);
+    if (write(pt->command_pipe[1], "", 1) < 0) {
+        // Pipe full: the thread is woken already
+    }
+    pthread_join(pt->thread, NULL);
+    pt->started = false;
+}
+
+void probe_thread_free(probe_thread_t *pt) {
+    if (pt == NULL) {
+        return;
+    }
+
+    if (pt->use_reactor) {
+        scheduler_set_reactor(pt->sched, NULL);
+        reactor_remove(&pt->reactor, pt->command_pipe[0]);
+        reactor_free(&pt->reactor);
+        pt->use_reactor = false;
+    }
+    scheduler_set_sample_callback(pt->sched, NULL, NULL);
+    scheduler_set_metrics_callback(pt->sched, NULL, NULL);
+    scheduler_set_event_callback(pt->sched, NULL, NULL);
+    for (int i = 0; i < 2; i++) {
+        if (pt->command_pipe[i] >= 0) {
+            close(pt->command_pipe[i]);
+            pt->command_pipe[i] = -1;
+        }
+    }
+    spsc_ring_free(&pt->commands);
+    spsc_queue_free(&pt->updates);
+}
+
+size_t probe_thread_drain(probe_thread_t *pt,
+                          void (*handle)(const probe_msg_t *msg, void *ctx), void *ctx) {
+    if (pt == NULL || handle == NULL) {
+        return 0;
+    }
+
+    // Re-arm the wake before looking, so nothing published after the
+    // last update seen here goes without one
+    atomic_exchange(&pt->wake_pending, false);
+
+    size_t count = 0;
+    const probe_msg_t *msg;
+    size_t len;
+    while ((msg = spsc_queue_peek(&pt->updates, &len)) != NULL) {
+        handle(msg, ctx);
+        spsc_queue_release(&pt->updates);
+        count++;
+    }
+    return count;
+}
+
+// Server thread: queue a command and wake the probe thread for it
+static int send_command(probe_thread_t *pt, const probe_cmd_t *cmd) {
+    if (spsc_ring_push(&pt->commands, cmd, 1) != 1) {
+        return -1;
+    }
+    if (write(pt->command_pipe[1], "", 1) < 0) {
+        // Pipe full: a wakeup is pending already
+    }
+    return 0;
+}
+
+int probe_thread_add_target(probe_thread_t *pt, const target_config_t *target) {
+    if (pt == NULL || target == NULL) {
+        return -1;
+    }
+
+    probe_cmd_t cmd = { .type = PROBE_CMD_ADD_TARGET, .u.target = *target };
+    return send_command(pt, &cmd);
+}
+
+int probe_thread_remove_target(probe_thread_t *pt, const char *id) {
+    if (pt == NULL || id == NULL) {
+        return -1;
+    }
+
+    probe_cmd_t cmd = { .type = PROBE_CMD_REMOVE_TARGET };
+    snprintf(cmd.u.target.id, sizeof(cmd.u.target.id), "%s", id);
+    return send_command(pt, &cmd);
+}
+
+int probe_thread_set_settings(probe_thread_t *pt, const config_t *config) {
+    if (pt == NULL || config == NULL) {
+        return -1;
+    }
+
+    probe_cmd_t cmd = { .type = PROBE_CMD_SETTINGS };
+    cmd.u.settings.probe_interval_ms = config->probe_interval_ms;
+    cmd.u.settings.probe_timeout_ms = config->probe_timeout_ms;
+    cmd.u.settings.thresholds = config->thresholds;
+    return send_command(pt, &cmd);
+}
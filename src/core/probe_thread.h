@@ -0,0 +1,133 @@
+#ifndef NETPULSE_PROBE_THREAD_H
+#define NETPULSE_PROBE_THREAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "core/config.h"
+#include "core/stats.h"
+#include "core/event_log.h"
+#include "core/scheduler.h"
+#include "core/spsc_queue.h"
+#include "core/spsc_ring.h"
+#include "platform/reactor.h"
+
+/*
+ * Probe thread
+ *
+ * The scheduler runs on a thread of its own, with its own reactor, so
+ * nothing the server does (assembling a snapshot, answering a series query,
+ * a burst of WebSocket connects) delays starting a probe or reading its
+ * result. Once started, the thread owns the scheduler and the config it
+ * was initialized with; the server keeps its own config and a copy of the
+ * targets (server/target_view.h).
+ *
+ * Two lock-free queues connect them:
+ *   updates   probe -> server: samples, metrics and events as the scheduler
+ *             produces them, and every target added or removed, in order,
+ *             so each update's index is valid as of the target changes
+ *             before it
+ *   commands  server -> probe: add or remove a target, new settings
+ * Updates vary in size and go through an spsc_queue_t; commands are
+ * probe_cmd_t's, through an spsc_ring_t.
+ * After a scheduler tick that published anything, the probe thread calls
+ * the wake function (on its thread), once until the server next drains.
+ * A command is followed by a byte on a pipe the probe thread's reactor
+ * watches, so it is applied at once rather than at the next deadline.
+ *
+ * If the server falls PROBE_QUEUE_BYTES behind, samples, metrics and events
+ * are dropped (and counted) rather than delaying probes. Target changes
+ * never are: the probe thread waits for room for those.
+ */
+
+#define PROBE_QUEUE_BYTES       (8u << 20)      // Updates the server may fall behind by
+#define PROBE_COMMANDS          1024            // Commands not yet applied
+
+typedef enum {
+    PROBE_MSG_SAMPLE,
+    PROBE_MSG_METRICS,
+    PROBE_MSG_EVENT,
+    PROBE_MSG_TARGET_ADDED,     // Appended at index
+    PROBE_MSG_TARGET_REMOVED,   // Gone from index (-1: an add that failed)
+} probe_msg_type_t;
+
+typedef struct {
+    probe_msg_type_t type;
+    int index;                  // Target index (scheduler order)
+    union {
+        sample_t sample;
+        metrics_t metrics;
+        event_t event;
+        target_config_t target; // Added or removed target (removed: id only)
+    } u;
+} probe_msg_t;
+
+typedef enum {
+    PROBE_CMD_ADD_TARGET,
+    PROBE_CMD_REMOVE_TARGET,
+    PROBE_CMD_SETTINGS,
+} probe_cmd_type_t;
+
+typedef struct {
+    probe_cmd_type_t type;
+    union {
+        target_config_t target; // Target to add (remove: id only)
+        struct {
+            uint32_t probe_interval_ms;
+            uint32_t probe_timeout_ms;
+            thresholds_t thresholds;
+        } settings;
+    } u;
+} probe_cmd_t;
+
+// Called on the probe thread when updates are waiting
+typedef void (*probe_wake_t)(void *ctx);
+
+typedef struct {
+    scheduler_t *sched;
+    spsc_queue_t updates;
+    spsc_ring_t commands;       // probe_cmd_t
+    int command_pipe[2];        // A byte per command, to wake the thread
+    reactor_t reactor;
+    bool use_reactor;           // Otherwise the thread polls every 2 ms
+    int cpu;                    // CPU to pin the thread to (-1 = not pinned)
+    probe_wake_t wake;
+    void *wake_ctx;
+    atomic_bool wake_pending;   // Woken, and the server hasn't drained since
+    atomic_bool running;
+    pthread_t thread;
+    bool started;
+    bool published;             // Probe thread: updates since the last wake
+    _Atomic uint64_t published_count;   // Updates published
+    _Atomic uint64_t dropped;           // ... and dropped, queue full
+} probe_thread_t;
+
+// Set up the queues and reactor for a scheduler, and route its callbacks
+// to the update queue. The scheduler must not be used by the caller after
+// probe_thread_start. Returns 0 on success, -1 on error.
+int probe_thread_init(probe_thread_t *pt, scheduler_t *sched, int cpu);
+
+// Start probing; wake(ctx) is called when updates are waiting.
+// Returns 0 on success, -1 on error.
+int probe_thread_start(probe_thread_t *pt, probe_wake_t wake, void *ctx);
+
+// Stop the thread and wait for it (the scheduler is the caller's again)
+void probe_thread_stop(probe_thread_t *pt);
+
+// Free queues and reactor (after probe_thread_stop)
+void probe_thread_free(probe_thread_t *pt);
+
+// Server thread: hand every waiting update to handle, oldest first.
+// Returns the number handled.
+size_t probe_thread_drain(probe_thread_t *pt,
+                          void (*handle)(const probe_msg_t *msg, void *ctx), void *ctx);
+
+// Server thread: queue a command. The target ones are acknowledged with a
+// PROBE_MSG_TARGET_* update once applied. Return 0, or -1 if the command
+// queue is full.
+int probe_thread_add_target(probe_thread_t *pt, const target_config_t *target);
+int probe_thread_remove_target(probe_thread_t *pt, const char *id);
+int probe_thread_set_settings(probe_thread_t *pt, const config_t *config);
+
+#endif // NETPULSE_PROBE_THREAD_H
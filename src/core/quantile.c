@@ -0,0 +1,378 @@
+#include "core/quantile.h"
+#include <string.h>
+#include <stdbool.h>
+
+// Bucket index of a value in milliseconds, for 1 << sub_bits buckets per
+// power of two
+static size_t bucket_index(double value_ms, unsigned sub_bits) {
+    uint64_t sub_count = (uint64_t)1 << sub_bits;
+    double us = value_ms * 1000.0;
+    uint64_t v;
+    if (!(us > 0.0)) {
+        v = 0;
+    } else if (us >= (double)QUANTILE_MAX_US) {
+        v = QUANTILE_MAX_US - 1;
+    } else {
+        v = (uint64_t)us;
+    }
+
+    if (v < sub_count) {
+        return (size_t)v;
+    }
+
+    // Group g >= 1 holds [sub_count << (g - 1), sub_count << g)
+    unsigned shift = (unsigned)(63 - __builtin_clzll(v)) - sub_bits;
+    return (size_t)(shift + 1) * sub_count + (size_t)((v >> shift) - sub_count);
+}
+
+// Midpoint of a bucket in milliseconds
+static double bucket_midpoint(size_t index, unsigned sub_bits) {
+    size_t sub_count = (size_t)1 << sub_bits;
+    size_t group = index / sub_count;
+    size_t sub = index % sub_count;
+    if (group == 0) {
+        return ((double)sub + 0.5) / 1000.0;
+    }
+
+    double width = (double)((uint64_t)1 << (group - 1));
+    double low = (double)(sub_count + sub) * width;
+    return (low + width / 2.0) / 1000.0;
+}
+
+static size_t bucket_of(double value_ms) {
+    return bucket_index(value_ms, QUANTILE_SUB_BITS);
+}
+
+static double bucket_value(size_t index) {
+    return bucket_midpoint(index, QUANTILE_SUB_BITS);
+}
+
+// Value of the rank-th smallest entry (0-based, rank < total)
+static double value_at_rank(const quantile_sketch_t *qs, uint32_t rank) {
+    size_t group = 0;
+    while (group < QUANTILE_GROUPS - 1 && rank >= qs->group_counts[group]) {
+        rank -= qs->group_counts[group];
+        group++;
+    }
+
+    size_t index = group * QUANTILE_SUB_COUNT;
+    size_t end = index + QUANTILE_SUB_COUNT - 1;
+    while (index < end && rank >= qs->counts[index]) {
+        rank -= qs->counts[index];
+        index++;
+    }
+    return bucket_value(index);
+}
+
+void quantile_sketch_clear(quantile_sketch_t *qs) {
+    if (qs != NULL) {
+        memset(qs, 0, sizeof(*qs));
+    }
+}
+
+void quantile_sketch_add(quantile_sketch_t *qs, double value_ms) {
+    if (qs == NULL) {
+        return;
+    }
+
+    size_t index = bucket_of(value_ms);
+    if (qs->counts[index] == UINT16_MAX || qs->group_counts[index / QUANTILE_SUB_COUNT] == UINT16_MAX) {
+        return;     // Saturated: drop rather than wrap
+    }
+    qs->counts[index]++;
+    qs->group_counts[index / QUANTILE_SUB_COUNT]++;
+    qs->total++;
+}
+
+void quantile_sketch_remove(quantile_sketch_t *qs, double value_ms) {
+    if (qs == NULL) {
+        return;
+    }
+
+    size_t index = bucket_of(value_ms);
+    if (qs->counts[index] == 0) {
+        return;
+    }
+    qs->counts[index]--;
+    qs->group_counts[index / QUANTILE_SUB_COUNT]--;
+    qs->total--;
+}
+
+void quantile_sketch_merge(quantile_sketch_t *dst, const quantile_sketch_t *src) {
+    if (dst == NULL || src == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < QUANTILE_BUCKETS; i++) {
+        uint32_t room = UINT16_MAX - dst->counts[i];
+        uint32_t group_room = UINT16_MAX - dst->group_counts[i / QUANTILE_SUB_COUNT];
+        uint32_t add = src->counts[i];
+        if (add > room) {
+            add = room;
+        }
+        if (add > group_room) {
+            add = group_room;
+        }
+        dst->counts[i] += (uint16_t)add;
+        dst->group_counts[i / QUANTILE_SUB_COUNT] += (uint16_t)add;
+        dst->total += add;
+    }
+}
+
+double quantile_sketch_query(const quantile_sketch_t *qs, double percentile) {
+    if (qs == NULL || qs->total == 0) {
+        return 0.0;
+    }
+    if (percentile < 0.0) {
+        percentile = 0.0;
+    } else if (percentile > 100.0) {
+        percentile = 100.0;
+    }
+
+    // Same rank interpolation as stats_compute_percentile
+    double idx = (percentile / 100.0) * (double)(qs->total - 1);
+    uint32_t lower = (uint32_t)idx;
+    double low = value_at_rank(qs, lower);
+    if (lower + 1 >= qs->total) {
+        return low;
+    }
+
+    double frac = idx - (double)lower;
+    if (frac == 0.0) {
+        return low;
+    }
+    return low * (1.0 - frac) + value_at_rank(qs, lower + 1) * frac;
+}
+
+void quantile_coarse_add(quantile_coarse_t *qc, double value_ms) {
+    if (qc == NULL) {
+        return;
+    }
+
+    size_t index = bucket_index(value_ms, QUANTILE_COARSE_SUB_BITS);
+    size_t group = index / QUANTILE_COARSE_SUB_COUNT;
+    if (qc->counts[index] == UINT16_MAX || qc->group_counts[group] == UINT16_MAX) {
+        return;     // Saturated: drop rather than wrap
+    }
+    qc->counts[index]++;
+    qc->group_counts[group]++;
+}
+
+void quantile_coarse_merge(quantile_coarse_t *dst, const quantile_coarse_t *src) {
+    if (dst == NULL || src == NULL) {
+        return;
+    }
+
+    for (size_t g = 0; g < QUANTILE_COARSE_GROUPS; g++) {
+        if (src->group_counts[g] == 0) {
+            continue;
+        }
+        for (size_t i = g * QUANTILE_COARSE_SUB_COUNT; i < (g + 1) * QUANTILE_COARSE_SUB_COUNT; i++) {
+            uint32_t add = src->counts[i];
+            uint32_t room = UINT16_MAX - dst->counts[i];
+            uint32_t group_room = UINT16_MAX - dst->group_counts[g];
+            if (add > room) {
+                add = room;
+            }
+            if (add > group_room) {
+                add = group_room;
+            }
+            dst->counts[i] += (uint16_t)add;
+            dst->group_counts[g] += (uint16_t)add;
+        }
+    }
+}
+
+// Add (sign = 1) or subtract (sign = -1) a bucket; groups with no values are skipped
+static void coarse_sum_apply(quantile_coarse_sum_t *sum, const quantile_coarse_t *qc, int sign) {
+    for (size_t g = 0; g < QUANTILE_COARSE_GROUPS; g++) {
+        uint32_t group = qc->group_counts[g];
+        if (group == 0) {
+            continue;
+        }
+        for (size_t i = g * QUANTILE_COARSE_SUB_COUNT; i < (g + 1) * QUANTILE_COARSE_SUB_COUNT; i++) {
+            sum->counts[i] = sign > 0 ? sum->counts[i] + qc->counts[i] : sum->counts[i] - qc->counts[i];
+        }
+        sum->group_counts[g] = sign > 0 ? sum->group_counts[g] + group : sum->group_counts[g] - group;
+        sum->total = sign > 0 ? sum->total + group : sum->total - group;
+    }
+}
+
+void quantile_coarse_sum_add(quantile_coarse_sum_t *sum, const quantile_coarse_t *qc) {
+    if (sum != NULL && qc != NULL) {
+        coarse_sum_apply(sum, qc, 1);
+    }
+}
+
+void quantile_coarse_sum_sub(quantile_coarse_sum_t *sum, const quantile_coarse_t *qc) {
+    if (sum != NULL && qc != NULL) {
+        coarse_sum_apply(sum, qc, -1);
+    }
+}
+
+void quantile_coarse_add_bin(quantile_coarse_t *qc, size_t index, uint32_t count) {
+    if (qc == NULL || index >= QUANTILE_COARSE_BUCKETS) {
+        return;
+    }
+
+    size_t group = index / QUANTILE_COARSE_SUB_COUNT;
+    uint32_t room = UINT16_MAX - qc->counts[index];
+    uint32_t group_room = UINT16_MAX - qc->group_counts[group];
+    if (count > room) {
+        count = room;
+    }
+    if (count > group_room) {
+        count = group_room;
+    }
+    qc->counts[index] += (uint16_t)count;
+    qc->group_counts[group] += (uint16_t)count;
+}
+
+void quantile_coarse_sum_add_bin(quantile_coarse_sum_t *sum, size_t index, uint32_t count) {
+    if (sum == NULL || index >= QUANTILE_COARSE_BUCKETS) {
+        return;
+    }
+
+    sum->counts[index] += count;
+    sum->group_counts[index / QUANTILE_COARSE_SUB_COUNT] += count;
+    sum->total += count;
+}
+
+double quantile_coarse_bin_ms(size_t index) {
+    if (index >= QUANTILE_COARSE_BUCKETS) {
+        index = QUANTILE_COARSE_BUCKETS - 1;
+    }
+    return bucket_midpoint(index, QUANTILE_COARSE_SUB_BITS);
+}
+
+void quantile_coarse_sum_add_value(quantile_coarse_sum_t *sum, double value_ms) {
+    quantile_coarse_sum_add_bin(sum, bucket_index(value_ms, QUANTILE_COARSE_SUB_BITS), 1);
+}
+
+// Value of the rank-th smallest entry (0-based) of sum plus extra
+static double coarse_value_at_rank(const quantile_coarse_sum_t *sum,
+                                   const quantile_coarse_t *const *extra, size_t extra_count,
+                                   uint32_t rank) {
+    size_t group = 0;
+    for (; group < QUANTILE_COARSE_GROUPS - 1; group++) {
+        uint32_t n = sum->group_counts[group];
+        for (size_t e = 0; e < extra_count; e++) {
+            n += extra[e]->group_counts[group];
+        }
+        if (rank < n) {
+            break;
+        }
+        rank -= n;
+    }
+
+    size_t index = group * QUANTILE_COARSE_SUB_COUNT;
+    size_t end = index + QUANTILE_COARSE_SUB_COUNT - 1;
+    for (; index < end; index++) {
+        uint32_t n = sum->counts[index];
+        for (size_t e = 0; e < extra_count; e++) {
+            n += extra[e]->counts[index];
+        }
+        if (rank < n) {
+            break;
+        }
+        rank -= n;
+    }
+    return bucket_midpoint(index, QUANTILE_COARSE_SUB_BITS);
+}
+
+double quantile_coarse_query(const quantile_coarse_sum_t *sum,
+                             const quantile_coarse_t *const *extra, size_t extra_count,
+                             double percentile) {
+    if (sum == NULL) {
+        return 0.0;
+    }
+
+    uint32_t total = sum->total;
+    for (size_t e = 0; e < extra_count; e++) {
+        for (size_t g = 0; g < QUANTILE_COARSE_GROUPS; g++) {
+            total += extra[e]->group_counts[g];
+        }
+    }
+    if (total == 0) {
+        return 0.0;
+    }
+    if (percentile < 0.0) {
+        percentile = 0.0;
+    } else if (percentile > 100.0) {
+        percentile = 100.0;
+    }
+
+    double idx = (percentile / 100.0) * (double)(total - 1);
+    uint32_t lower = (uint32_t)idx;
+    double low = coarse_value_at_rank(sum, extra, extra_count, lower);
+    double frac = idx - (double)lower;
+    if (lower + 1 >= total || frac == 0.0) {
+        return low;
+    }
+    return low * (1.0 - frac) + coarse_value_at_rank(sum, extra, extra_count, lower + 1) * frac;
+}
+
+// Position of a walk through a sum for ascending ranks
+typedef struct {
+    size_t group;
+    uint32_t below_group;       // Values in earlier groups
+    size_t index;
+    uint32_t below_index;       // Values in earlier buckets
+} coarse_cursor_t;
+
+// Value of the rank-th smallest entry, rank at least the one the cursor
+// last stopped at
+static double coarse_cursor_value(const quantile_coarse_sum_t *sum, coarse_cursor_t *cur, uint32_t rank) {
+    bool moved = false;
+    while (cur->group < QUANTILE_COARSE_GROUPS - 1 && rank >= cur->below_group + sum->group_counts[cur->group]) {
+        cur->below_group += sum->group_counts[cur->group];
+        cur->group++;
+        moved = true;
+    }
+    if (moved) {
+        cur->index = cur->group * QUANTILE_COARSE_SUB_COUNT;
+        cur->below_index = cur->below_group;
+    }
+
+    size_t end = cur->group * QUANTILE_COARSE_SUB_COUNT + QUANTILE_COARSE_SUB_COUNT - 1;
+    while (cur->index < end && rank >= cur->below_index + sum->counts[cur->index]) {
+        cur->below_index += sum->counts[cur->index];
+        cur->index++;
+    }
+    return bucket_midpoint(cur->index, QUANTILE_COARSE_SUB_BITS);
+}
+
+void quantile_coarse_sum_percentiles(const quantile_coarse_sum_t *sum, const double *percentiles,
+                                     size_t count, double *out) {
+    if (sum == NULL || percentiles == NULL || out == NULL) {
+        return;
+    }
+
+    coarse_cursor_t cur = { 0, 0, 0, 0 };
+    uint32_t total = sum->total;
+    for (size_t i = 0; i < count; i++) {
+        if (total == 0) {
+            out[i] = 0.0;
+            continue;
+        }
+        double percentile = percentiles[i];
+        if (percentile < 0.0) {
+            percentile = 0.0;
+        } else if (percentile > 100.0) {
+            percentile = 100.0;
+        }
+
+        // Same interpolation as quantile_coarse_query
+        double idx = (percentile / 100.0) * (double)(total - 1);
+        uint32_t lower = (uint32_t)idx;
+        double low = coarse_cursor_value(sum, &cur, lower);
+        double frac = idx - (double)lower;
+        if (lower + 1 >= total || frac == 0.0) {
+            out[i] = low;
+        } else {
+            // The next percentile's lower rank can be below lower + 1
+            coarse_cursor_t ahead = cur;
+            out[i] = low * (1.0 - frac) + coarse_cursor_value(sum, &ahead, lower + 1) * frac;
+        }
+    }
+}
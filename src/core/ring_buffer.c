@@ -17,13 +17,32 @@ int ring_buffer_init(ring_buffer_t *rb, size_t elem_size, size_t capacity) {
     rb->count = 0;
     rb->head = 0;
     rb->tail = 0;
+    rb->owns_data = true;
+
+    return 0;
+}
+
+int ring_buffer_init_with_storage(ring_buffer_t *rb, size_t elem_size, size_t capacity, void *storage) {
+    if (rb == NULL || elem_size == 0 || capacity == 0 || storage == NULL) {
+        return -1;
+    }
+
+    rb->data = storage;
+    rb->elem_size = elem_size;
+    rb->capacity = capacity;
+    rb->count = 0;
+    rb->head = 0;
+    rb->tail = 0;
+    rb->owns_data = false;
 
     return 0;
 }
 
 void ring_buffer_free(ring_buffer_t *rb) {
     if (rb != NULL && rb->data != NULL) {
-        free(rb->data);
+        if (rb->owns_data) {
+            free(rb->data);
+        }
         rb->data = NULL;
         rb->capacity = 0;
         rb->count = 0;
@@ -7,7 +7,8 @@
 
 /*
  * Generic ring buffer for fixed-size elements.
- * Thread-safe for single producer, single consumer.
+ * Not thread-safe: push and read from one thread only. To hand elements
+ * between threads, use spsc_ring_t (core/spsc_ring.h).
  */
 
 typedef struct {
@@ -17,11 +18,17 @@ typedef struct {
     size_t count;         // Current number of elements
     size_t head;          // Write position (next push)
     size_t tail;          // Read position (oldest element)
+    bool owns_data;       // Whether ring_buffer_free releases data
 } ring_buffer_t;
 
 // Initialize a ring buffer. Returns 0 on success, -1 on error.
 int ring_buffer_init(ring_buffer_t *rb, size_t elem_size, size_t capacity);
 
+// Initialize a ring buffer over caller-provided storage of capacity elements
+// (e.g. from a slab). The storage is not freed by ring_buffer_free.
+// Returns 0 on success, -1 on error.
+int ring_buffer_init_with_storage(ring_buffer_t *rb, size_t elem_size, size_t capacity, void *storage);
+
 // Free ring buffer resources
 void ring_buffer_free(ring_buffer_t *rb);
 
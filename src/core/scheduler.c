@@ -1,11 +1,19 @@
 #include "core/scheduler.h"
 #include "net/tcp_probe.h"
 #include "net/icmp_probe.h"
+#include "net/dns.h"
 #include "platform/platform.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+#define DNS_PENDING_RETRY_MS 100    // Recheck interval while a target's name resolves
+#define HISTORY_RESTORE_MS   (25ULL * 3600000ULL)  // Stored history read back on attach (24h window + bucket)
+
+// Slab slot: the sample window, then the long windows
+#define WINDOW_STORAGE_BYTES ((stats_window_storage_size(DEFAULT_WINDOW_SIZE) + 15) & ~(size_t)15)
+#define TARGET_SLOT_BYTES    (WINDOW_STORAGE_BYTES + sizeof(long_windows_t))
+
 static sample_callback_t g_sample_cb = NULL;
 static void *g_sample_ctx = NULL;
 static metrics_callback_t g_metrics_cb = NULL;
@@ -13,6 +21,9 @@ static void *g_metrics_ctx = NULL;
 static event_callback_t g_event_cb = NULL;
 static void *g_event_ctx = NULL;
 
+static void on_probe_done(int handle, probe_result_t result, uint64_t sent_ns,
+                          uint64_t done_ns, void *ctx);
+
 void scheduler_set_sample_callback(scheduler_t *sched, sample_callback_t cb, void *ctx) {
     (void)sched;
     g_sample_cb = cb;
@@ -31,6 +42,72 @@ void scheduler_set_event_callback(scheduler_t *sched, event_callback_t cb, void
     g_event_ctx = ctx;
 }
 
+// A target's window or metrics changed (readers compare versions to see it)
+static void touch_target(scheduler_t *sched, target_state_t *ts) {
+    ts->version = ++sched->versions;
+}
+
+// End an in-flight probe: forget its ICMP sequence, or hand its TCP
+// probe back to the engine
+static void release_probe(scheduler_t *sched, target_state_t *ts) {
+    if (sched->icmp_seq_map != NULL && ts->probe_state == PROBE_STATE_CONNECTING &&
+        sched->icmp_seq_map[ts->probe_seq] == (int32_t)(ts - sched->targets)) {
+        sched->icmp_seq_map[ts->probe_seq] = -1;
+    }
+
+    if (ts->probe_handle < 0) {
+        return;
+    }
+    if ((size_t)ts->probe_handle < sched->handle_map_size) {
+        sched->handle_map[ts->probe_handle] = -1;
+    }
+    probe_engine_release(sched->engine, ts->probe_handle);
+    ts->probe_handle = -1;
+}
+
+// Cold config for a hot target entry (arrays are parallel)
+static const target_config_t *target_config_of(const scheduler_t *sched, const target_state_t *ts) {
+    return &sched->target_configs[ts - sched->targets];
+}
+
+// Release a target's in-flight probe and sample window
+static void release_target(scheduler_t *sched, target_state_t *ts) {
+    release_probe(sched, ts);
+    if (ts->window.samples.data != NULL) {
+        slab_release(&sched->sample_slab, ts->window.samples.data);
+        ts->window.samples.data = NULL;
+        ts->long_windows = NULL;
+    }
+}
+
+// Record which target owns a probe engine handle (-1 to clear)
+static int map_probe_handle(scheduler_t *sched, int handle, int index) {
+    if ((size_t)handle >= sched->handle_map_size) {
+        size_t new_size = sched->handle_map_size > 0 ? sched->handle_map_size : 64;
+        while (new_size <= (size_t)handle) {
+            new_size *= 2;
+        }
+
+        int *map = realloc(sched->handle_map, new_size * sizeof(*map));
+        if (map == NULL) {
+            return -1;
+        }
+        for (size_t i = sched->handle_map_size; i < new_size; i++) {
+            map[i] = -1;
+        }
+        sched->handle_map = map;
+        sched->handle_map_size = new_size;
+    }
+
+    sched->handle_map[handle] = index;
+    return 0;
+}
+
+// Move a target's single pending deadline in the heap
+static void set_deadline(scheduler_t *sched, target_state_t *ts, uint64_t deadline_ms) {
+    timer_heap_schedule(&sched->deadlines, (uint32_t)(ts - sched->targets), deadline_ms);
+}
+
 int scheduler_init(scheduler_t *sched, config_t *config) {
     if (sched == NULL || config == NULL) {
         return -1;
@@ -45,31 +122,105 @@ int scheduler_init(scheduler_t *sched, config_t *config) {
 
     // Initialize ICMP probe state if ICMP mode is requested
     if (config->probe_type == PROBE_TYPE_ICMP) {
-        if (icmp_probe_init(&sched->icmp_state) == 0) {
+        if (icmp_probe_init(&sched->icmp_state) == 0 &&
+            (sched->icmp_seq_map = malloc(ICMP_SEQ_SPACE * sizeof(int32_t))) != NULL) {
+            for (size_t i = 0; i < ICMP_SEQ_SPACE; i++) {
+                sched->icmp_seq_map[i] = -1;
+            }
             sched->icmp_available = true;
             printf("[scheduler] ICMP probing enabled\n");
         } else {
             printf("[scheduler] ICMP probing not available: %s\n",
                    icmp_probe_unavailable_reason());
             printf("[scheduler] Falling back to TCP probing\n");
+            icmp_probe_cleanup(&sched->icmp_state);
             config->probe_type = PROBE_TYPE_TCP;
         }
     }
 
-    if (event_log_init(&sched->event_log) != 0) {
+    // Kernel timing is opt-in. ICMP reads SO_TIMESTAMPING; TCP has no
+    // per-packet timestamps here and reads the kernel's smoothed RTT
+    // (TCP_INFO tcpi_rtt), which after a handshake is the SYN/SYN-ACK time
+    if (config->kernel_timestamps) {
+        if (sched->icmp_available) {
+            if (icmp_probe_enable_timestamps(&sched->icmp_state) == 0) {
+                printf("[scheduler] ICMP RTT from kernel timestamps (SO_TIMESTAMPING)\n");
+            } else {
+                printf("[scheduler] Kernel timestamps not available, using userspace timing\n");
+                config->kernel_timestamps = false;
+            }
+        } else {
+#ifdef PLATFORM_LINUX
+            printf("[scheduler] TCP RTT from the kernel's smoothed RTT (TCP_INFO), not SO_TIMESTAMPING\n");
+#else
+            printf("[scheduler] Kernel TCP RTT not available, using userspace timing\n");
+            config->kernel_timestamps = false;
+#endif
+        }
+    }
+
+    // TCP probes run on the selected engine; io_uring falls back to poll
+    if (config->probe_engine == PROBE_ENGINE_URING) {
+        sched->engine = probe_engine_uring_create(on_probe_done, sched);
+        if (sched->engine == NULL) {
+            printf("[scheduler] io_uring probe engine not available, using poll\n");
+            config->probe_engine = PROBE_ENGINE_POLL;
+        }
+    }
+    if (sched->engine == NULL) {
+        sched->engine = probe_engine_poll_create(on_probe_done, sched);
+    }
+    if (sched->engine == NULL) {
         if (sched->icmp_available) {
             icmp_probe_cleanup(&sched->icmp_state);
+            free(sched->icmp_seq_map);
+            sched->icmp_seq_map = NULL;
             sched->icmp_available = false;
         }
         return -1;
     }
+    printf("[scheduler] TCP probe engine: %s\n", sched->engine->ops->name);
+
+    if (timer_heap_init(&sched->deadlines, (size_t)config->target_count) != 0 ||
+        slab_init(&sched->sample_slab, TARGET_SLOT_BYTES, 16) != 0 ||
+        event_log_init(&sched->event_log) != 0) {
+        timer_heap_free(&sched->deadlines);
+        probe_engine_destroy(sched->engine);
+        sched->engine = NULL;
+        if (sched->icmp_available) {
+            icmp_probe_cleanup(&sched->icmp_state);
+            free(sched->icmp_seq_map);
+            sched->icmp_seq_map = NULL;
+            sched->icmp_available = false;
+        }
+        return -1;
+    }
+
+    printf("[scheduler] Target storage: %zu bytes per target\n", scheduler_bytes_per_target());
 
     int sync_result = scheduler_sync_targets(sched);
     if (sync_result != 0) {
         // Clean up on sync failure
         event_log_free(&sched->event_log);
+        timer_heap_free(&sched->deadlines);
+        for (int i = 0; i < sched->target_count; i++) {
+            release_target(sched, &sched->targets[i]);
+        }
+        slab_free(&sched->sample_slab);
+        free(sched->targets);
+        free(sched->target_configs);
+        free(sched->handle_map);
+        sched->targets = NULL;
+        sched->target_configs = NULL;
+        sched->handle_map = NULL;
+        sched->target_count = 0;
+        sched->target_capacity = 0;
+        probe_engine_destroy(sched->engine);
+        sched->engine = NULL;
         if (sched->icmp_available) {
             icmp_probe_cleanup(&sched->icmp_state);
+            free(sched->icmp_seq_map);
+            sched->icmp_seq_map = NULL;
             sched->icmp_available = false;
         }
     }
@@ -82,19 +233,30 @@ void scheduler_free(scheduler_t *sched) {
     }
 
     for (int i = 0; i < sched->target_count; i++) {
-        ring_buffer_free(&sched->targets[i].samples);
-        if (sched->targets[i].probe_fd >= 0) {
-            tcp_probe_cleanup(sched->targets[i].probe_fd);
-        }
+        release_target(sched, &sched->targets[i]);
     }
+    probe_engine_destroy(sched->engine);
+    sched->engine = NULL;
 
     // Clean up ICMP state
     if (sched->icmp_available) {
         icmp_probe_cleanup(&sched->icmp_state);
     }
+    free(sched->icmp_seq_map);
+    sched->icmp_seq_map = NULL;
 
     event_log_free(&sched->event_log);
+    timer_heap_free(&sched->deadlines);
+    slab_free(&sched->sample_slab);
+    free(sched->targets);
+    free(sched->target_configs);
+    free(sched->handle_map);
+    sched->targets = NULL;
+    sched->target_configs = NULL;
+    sched->handle_map = NULL;
+    sched->handle_map_size = 0;
     sched->target_count = 0;
+    sched->target_capacity = 0;
 }
 
 int scheduler_sync_targets(scheduler_t *sched) {
@@ -103,44 +265,90 @@ int scheduler_sync_targets(scheduler_t *sched) {
     }
 
     uint64_t now = now_ms();
+    int count = sched->config->target_count;
 
-    // For MVP, just reinitialize all targets from config
-    // TODO: Smarter sync that preserves existing sample history
-
-    // Free existing targets
-    for (int i = 0; i < sched->target_count; i++) {
-        ring_buffer_free(&sched->targets[i].samples);
-        if (sched->targets[i].probe_fd >= 0) {
-            tcp_probe_cleanup(sched->targets[i].probe_fd);
-        }
+    int capacity = 8;
+    while (capacity < count) {
+        capacity *= 2;
     }
 
-    sched->target_count = 0;
+    target_state_t *targets = malloc((size_t)capacity * sizeof(*targets));
+    target_config_t *configs = malloc((size_t)capacity * sizeof(*configs));
+    if (targets == NULL || configs == NULL) {
+        free(targets);
+        free(configs);
+        return -1;
+    }
 
-    // Initialize targets from config
-    for (int i = 0; i < sched->config->target_count; i++) {
-        target_state_t *ts = &sched->targets[i];
-        memset(ts, 0, sizeof(*ts));
+    // Config add/remove preserve relative order, so a single merge walk
+    // carries surviving targets (and their sample history) across. Old
+    // entries skipped by the walk were removed from config.
+    int old = 0;
+    for (int i = 0; i < count; i++) {
+        const target_config_t *cfg = &sched->config->targets[i];
+        target_state_t *ts = &targets[i];
+        configs[i] = *cfg;
+
+        while (old < sched->target_count &&
+               strcmp(sched->target_configs[old].id, cfg->id) != 0) {
+            release_target(sched, &sched->targets[old]);
+            old++;
+        }
 
-        ts->config = sched->config->targets[i];
+        if (old < sched->target_count) {
+            *ts = sched->targets[old];
+            old++;
+            continue;
+        }
 
-        if (ring_buffer_init(&ts->samples, sizeof(sample_t), DEFAULT_WINDOW_SIZE) != 0) {
-            // Clean up already-initialized targets on failure
-            for (int j = 0; j < sched->target_count; j++) {
-                ring_buffer_free(&sched->targets[j].samples);
-            }
-            sched->target_count = 0;
-            return -1;
+        memset(ts, 0, sizeof(*ts));
+        void *window = slab_alloc(&sched->sample_slab);
+        if (window == NULL ||
+            stats_window_init(&ts->window, DEFAULT_WINDOW_SIZE, window) != 0) {
+            // Out of memory: keep the targets built so far
+            slab_release(&sched->sample_slab, window);
+            count = i;
+            break;
         }
+        ts->long_windows = (long_windows_t *)((char *)window + WINDOW_STORAGE_BYTES);  // Zeroed = empty
 
         ts->probe_state = PROBE_STATE_IDLE;
-        ts->probe_fd = -1;
+        ts->probe_handle = -1;
+        ts->series = sched->store != NULL ? sample_store_series(sched->store, cfg->id) : -1;
         ts->next_probe_ms = now; // Start probing immediately
+        touch_target(sched, ts);
+    }
 
-        sched->target_count++;
+    for (; old < sched->target_count; old++) {
+        release_target(sched, &sched->targets[old]);
     }
 
-    return 0;
+    free(sched->targets);
+    free(sched->target_configs);
+    sched->targets = targets;
+    sched->target_configs = configs;
+    sched->target_count = count;
+    sched->target_capacity = capacity;
+    sched->versions++;          // The list itself changed
+
+    // Indices moved: rebuild the deadline heap and probe fd map
+    timer_heap_clear(&sched->deadlines);
+    for (int i = 0; i < count; i++) {
+        target_state_t *ts = &targets[i];
+        if (ts->probe_state == PROBE_STATE_CONNECTING) {
+            if (ts->probe_handle >= 0) {
+                map_probe_handle(sched, ts->probe_handle, i);
+            } else if (sched->icmp_seq_map != NULL) {
+                sched->icmp_seq_map[ts->probe_seq] = i;
+            }
+            timer_heap_schedule(&sched->deadlines, (uint32_t)i,
+                                ts->probe_start_ns / 1000000ULL + sched->config->probe_timeout_ms);
+        } else {
+            timer_heap_schedule(&sched->deadlines, (uint32_t)i, ts->next_probe_ms);
+        }
+    }
+
+    return count == sched->config->target_count ? 0 : -1;
 }
 
 static void handle_probe_complete(scheduler_t *sched, target_state_t *ts, bool success, double rtt_ms) {
@@ -152,44 +360,304 @@ static void handle_probe_complete(scheduler_t *sched, target_state_t *ts, bool s
         .success = success
     };
 
-    ring_buffer_push(&ts->samples, &sample);
+    stats_window_push(&ts->window, &sample);
+    long_windows_push(ts->long_windows, success, sample.rtt_ms, now);
+    touch_target(sched, ts);
+    if (ts->series >= 0) {
+        sample_store_append(sched->store, ts->series, &sample);
+    }
 
     // Notify sample callback
     if (g_sample_cb != NULL) {
-        g_sample_cb(ts->config.id, &sample, g_sample_ctx);
+        g_sample_cb((int)(ts - sched->targets), target_config_of(sched, ts)->id, &sample, g_sample_ctx);
     }
 
     // Schedule next probe
     ts->probe_state = PROBE_STATE_IDLE;
     ts->next_probe_ms = now + sched->config->probe_interval_ms;
+    set_deadline(sched, ts, ts->next_probe_ms);
+}
+
+// Send every queued Echo Request in one go and stamp the batch send time
+static void flush_icmp_batch(scheduler_t *sched) {
+    bool sent[ICMP_BATCH_MAX];
+    uint64_t sent_ns = 0;
+    int count = icmp_probe_flush(&sched->icmp_state, sent, &sent_ns);
+
+    for (int i = 0; i < count; i++) {
+        target_state_t *ts = &sched->targets[sched->icmp_batch[i]];
+        if (sent[i]) {
+            ts->probe_start_ns = sent_ns;
+        } else {
+            // Send error - record as failure
+            release_probe(sched, ts);
+            handle_probe_complete(sched, ts, false, 0.0);
+        }
+    }
+}
+
+// Perform ICMP probe start (non-blocking, queued until the end of the tick
+// and matched with its reply in drain_icmp_replies)
+static void do_icmp_probe_start(scheduler_t *sched, target_state_t *ts) {
+    uint16_t seq;
+    uint32_t addr;
+
+    if (icmp_probe_queued(&sched->icmp_state) >= ICMP_BATCH_MAX) {
+        flush_icmp_batch(sched);
+    }
+
+    if (icmp_probe_queue(&sched->icmp_state, target_config_of(sched, ts)->host, &seq, &addr) != 0) {
+        // Invalid address - record as failure
+        handle_probe_complete(sched, ts, false, 0.0);
+        return;
+    }
+
+    int32_t idx = (int32_t)(ts - sched->targets);
+    sched->icmp_batch[icmp_probe_queued(&sched->icmp_state) - 1] = idx;
+    ts->probe_seq = seq;
+    ts->probe_addr = addr;
+    ts->probe_start_ns = now_ns();  // Refined when the batch is sent
+    ts->probe_state = PROBE_STATE_CONNECTING;
+    sched->icmp_seq_map[seq] = idx;  // A wrapped, still-pending sequence just times out
+    set_deadline(sched, ts, ts->probe_start_ns / 1000000ULL + sched->config->probe_timeout_ms);
+}
+
+// Match every pending Echo Reply to its target by sequence and source address
+static void drain_icmp_replies(scheduler_t *sched) {
+    icmp_reply_t replies[ICMP_BATCH_MAX];
+    int count;
+
+    while ((count = icmp_probe_recv_batch(&sched->icmp_state, replies, ICMP_BATCH_MAX)) > 0) {
+        for (int i = 0; i < count; i++) {
+            const icmp_reply_t *reply = &replies[i];
+            int32_t idx = sched->icmp_seq_map[reply->sequence];
+            if (idx < 0 || idx >= sched->target_count) {
+                continue;  // Late reply for an expired or removed probe
+            }
+
+            target_state_t *ts = &sched->targets[idx];
+            if (ts->probe_state != PROBE_STATE_CONNECTING || ts->probe_addr != reply->addr) {
+                continue;
+            }
+
+            uint64_t rtt_ns = reply->kernel_rtt_ns != 0 ? reply->kernel_rtt_ns
+                                                        : reply->recv_ns - ts->probe_start_ns;
+            double rtt = (double)rtt_ns / 1000000.0;
+            release_probe(sched, ts);
+            handle_probe_complete(sched, ts, true, rtt);
+        }
+    }
 }
 
-// Perform ICMP probe (blocking with internal timeout)
-static void do_icmp_probe(scheduler_t *sched, target_state_t *ts) {
-    double rtt = icmp_probe_ping(&sched->icmp_state, ts->config.host,
-                                  (int)sched->config->probe_timeout_ms);
-    if (rtt >= 0) {
+// Reactor handler: Echo Replies are waiting on the raw socket
+static void on_icmp_ready(int fd, unsigned events, void *ctx) {
+    (void)fd;
+    (void)events;
+    drain_icmp_replies((scheduler_t *)ctx);
+}
+
+// Finish a TCP probe whose connect has resolved
+static void complete_tcp_probe(scheduler_t *sched, target_state_t *ts, probe_result_t result,
+                               uint64_t sent_ns, uint64_t done_ns) {
+    double rtt = (double)(done_ns - sent_ns) / 1000000.0;
+    if (result == PROBE_SUCCESS && sched->config->kernel_timestamps) {
+        int fd = probe_engine_socket_fd(sched->engine, ts->probe_handle);
+        uint64_t kernel_ns = fd >= 0 ? tcp_probe_kernel_rtt_ns(fd) : 0;
+        if (kernel_ns != 0) {
+            rtt = (double)kernel_ns / 1000000.0;
+        }
+    }
+    release_probe(sched, ts);
+
+    if (result == PROBE_SUCCESS) {
         handle_probe_complete(sched, ts, true, rtt);
     } else {
         handle_probe_complete(sched, ts, false, 0.0);
     }
 }
 
-// Perform TCP probe start (non-blocking)
+// Probe engine callback: a TCP probe's connect resolved
+static void on_probe_done(int handle, probe_result_t result, uint64_t sent_ns,
+                          uint64_t done_ns, void *ctx) {
+    scheduler_t *sched = (scheduler_t *)ctx;
+
+    if ((size_t)handle >= sched->handle_map_size || sched->handle_map[handle] < 0) {
+        return;
+    }
+
+    target_state_t *ts = &sched->targets[sched->handle_map[handle]];
+    if (ts->probe_state == PROBE_STATE_CONNECTING && ts->probe_handle == handle) {
+        complete_tcp_probe(sched, ts, result, sent_ns, done_ns);
+    }
+}
+
+// Perform TCP probe start (non-blocking). The address comes from the DNS
+// cache; while a name is still resolving the probe is simply retried.
 static void do_tcp_probe_start(scheduler_t *sched, target_state_t *ts) {
-    int fd = tcp_probe_start(ts->config.host, ts->config.port);
-    uint64_t now = now_ms();
+    const target_config_t *cfg = target_config_of(sched, ts);
+    struct sockaddr_in addr;
+
+    switch (dns_lookup(cfg->host, cfg->port, &addr)) {
+        case DNS_OK:
+            break;
+        case DNS_PENDING:
+            set_deadline(sched, ts, now_ms() + DNS_PENDING_RETRY_MS);
+            return;
+        case DNS_FAILED:
+            // Name does not resolve - record as failure
+            handle_probe_complete(sched, ts, false, 0.0);
+            return;
+    }
 
-    if (fd >= 0) {
-        ts->probe_fd = fd;
-        ts->probe_start_ms = now;
+    int handle = probe_engine_start(sched->engine, &addr, sched->config->probe_timeout_ms);
+
+    if (handle >= 0) {
+        ts->probe_handle = handle;
+        ts->probe_start_ns = now_ns();  // For the deadline; the engine times the RTT
         ts->probe_state = PROBE_STATE_CONNECTING;
+        if (map_probe_handle(sched, handle, (int)(ts - sched->targets)) != 0) {
+            release_probe(sched, ts);
+            handle_probe_complete(sched, ts, false, 0.0);
+            return;
+        }
+        set_deadline(sched, ts, ts->probe_start_ns / 1000000ULL + sched->config->probe_timeout_ms);
     } else {
-        // DNS or socket error - record as failure
+        // Socket error - record as failure
         handle_probe_complete(sched, ts, false, 0.0);
     }
 }
 
+void scheduler_set_reactor(scheduler_t *sched, reactor_t *reactor) {
+    if (sched == NULL) {
+        return;
+    }
+
+    // The engine moves its in-flight probes over to the new reactor
+    probe_engine_set_reactor(sched->engine, reactor);
+
+    // The shared ICMP socket is watched for replies for all targets
+    if (sched->icmp_available) {
+        if (sched->reactor != NULL) {
+            reactor_remove(sched->reactor, sched->icmp_state.sock);
+        }
+        if (reactor != NULL) {
+            reactor_add(reactor, sched->icmp_state.sock, REACTOR_EV_READ, on_icmp_ready, sched);
+        }
+    }
+
+    sched->reactor = reactor;
+}
+
+/*
+ * History restore: one scan over the stored samples, routed to targets by id
+ */
+typedef struct {
+    const char *id;
+    int index;
+} restore_entry_t;
+
+typedef struct {
+    scheduler_t *sched;
+    restore_entry_t *entries;   // Sorted by id
+    int count;
+    uint64_t wall_now_ms;
+    uint64_t mono_now_ms;
+    uint64_t restored;
+} restore_ctx_t;
+
+static int compare_restore_entries(const void *a, const void *b) {
+    return strcmp(((const restore_entry_t *)a)->id, ((const restore_entry_t *)b)->id);
+}
+
+static void restore_samples(const char *series_id, const sample_t *samples, size_t count, void *ctx) {
+    restore_ctx_t *rc = ctx;
+    restore_entry_t key = { .id = series_id };
+    const restore_entry_t *entry = bsearch(&key, rc->entries, (size_t)rc->count, sizeof(key),
+                                           compare_restore_entries);
+    if (entry == NULL) {
+        return;
+    }
+
+    target_state_t *ts = &rc->sched->targets[entry->index];
+    for (size_t i = 0; i < count; i++) {
+        const sample_t *s = &samples[i];
+        stats_window_push(&ts->window, s);
+
+        // Long windows run on the monotonic clock: place the sample by its age
+        uint64_t age_ms = rc->wall_now_ms > s->timestamp_ms ? rc->wall_now_ms - s->timestamp_ms : 0;
+        if (age_ms < rc->mono_now_ms) {
+            long_windows_push(ts->long_windows, s->success, s->rtt_ms, rc->mono_now_ms - age_ms);
+        }
+    }
+    touch_target(rc->sched, ts);
+    rc->restored += count;
+}
+
+void scheduler_set_store(scheduler_t *sched, sample_store_t *store) {
+    if (sched == NULL) {
+        return;
+    }
+
+    sched->store = store;
+    for (int i = 0; i < sched->target_count; i++) {
+        sched->targets[i].series = store != NULL ? sample_store_series(store, sched->target_configs[i].id) : -1;
+    }
+    if (store == NULL || sched->target_count == 0) {
+        return;
+    }
+
+    restore_ctx_t rc = {
+        .sched = sched,
+        .entries = malloc((size_t)sched->target_count * sizeof(restore_entry_t)),
+        .count = sched->target_count,
+        .wall_now_ms = wall_clock_ms(),
+        .mono_now_ms = now_ms(),
+    };
+    if (rc.entries == NULL) {
+        return;
+    }
+    for (int i = 0; i < sched->target_count; i++) {
+        rc.entries[i].id = sched->target_configs[i].id;
+        rc.entries[i].index = i;
+    }
+    qsort(rc.entries, (size_t)rc.count, sizeof(*rc.entries), compare_restore_entries);
+
+    uint64_t from_ms = rc.wall_now_ms > HISTORY_RESTORE_MS ? rc.wall_now_ms - HISTORY_RESTORE_MS : 0;
+    uint64_t start_ns = now_ns();
+    sample_store_scan(store, NULL, from_ms, rc.wall_now_ms + 1, restore_samples, &rc);
+    free(rc.entries);
+
+    printf("[scheduler] Restored %llu stored samples in %.1f ms\n",
+           (unsigned long long)rc.restored, (double)(now_ns() - start_ns) / 1e6);
+}
+
+// Run the action a target's deadline was set for
+static void handle_deadline(scheduler_t *sched, target_state_t *ts, bool use_icmp) {
+    switch (ts->probe_state) {
+        case PROBE_STATE_IDLE:
+            if (use_icmp) {
+                // ICMP probe is non-blocking
+                do_icmp_probe_start(sched, ts);
+            } else {
+                // TCP probe is non-blocking
+                do_tcp_probe_start(sched, ts);
+            }
+            break;
+
+        case PROBE_STATE_CONNECTING:
+            // Connect or echo did not resolve before probe_timeout_ms
+            release_probe(sched, ts);
+            handle_probe_complete(sched, ts, false, 0.0);
+            break;
+
+        case PROBE_STATE_DONE:
+            // Should not happen - reset to idle
+            ts->probe_state = PROBE_STATE_IDLE;
+            set_deadline(sched, ts, now_ms());
+            break;
+    }
+}
+
 int scheduler_tick(scheduler_t *sched) {
     if (sched == NULL || !sched->running) {
         return 1000;
@@ -199,71 +667,46 @@ int scheduler_tick(scheduler_t *sched) {
     int min_timeout = 1000; // Default 1 second
     bool use_icmp = (sched->config->probe_type == PROBE_TYPE_ICMP && sched->icmp_available);
 
-    // Process each target
-    for (int i = 0; i < sched->target_count; i++) {
-        target_state_t *ts = &sched->targets[i];
-
-        switch (ts->probe_state) {
-            case PROBE_STATE_IDLE:
-                // Check if it's time to start a new probe
-                if (now >= ts->next_probe_ms) {
-                    if (use_icmp) {
-                        // ICMP probe is blocking
-                        do_icmp_probe(sched, ts);
-                    } else {
-                        // TCP probe is non-blocking
-                        do_tcp_probe_start(sched, ts);
-                    }
-                } else {
-                    int wait = (int)(ts->next_probe_ms - now);
-                    if (wait < min_timeout) {
-                        min_timeout = wait;
-                    }
-                }
-                break;
-
-            case PROBE_STATE_CONNECTING: {
-                // Only TCP probe uses this state
-                uint64_t elapsed = now - ts->probe_start_ms;
-                int remaining = (int)(sched->config->probe_timeout_ms - elapsed);
-
-                if (remaining <= 0) {
-                    // Timeout
-                    tcp_probe_cleanup(ts->probe_fd);
-                    ts->probe_fd = -1;
-                    handle_probe_complete(sched, ts, false, 0.0);
-                } else {
-                    // Check probe status
-                    probe_result_t result = tcp_probe_check(ts->probe_fd);
-
-                    if (result == PROBE_SUCCESS) {
-                        double rtt = (double)(now - ts->probe_start_ms);
-                        tcp_probe_cleanup(ts->probe_fd);
-                        ts->probe_fd = -1;
-                        handle_probe_complete(sched, ts, true, rtt);
-                    } else if (result == PROBE_ERROR) {
-                        tcp_probe_cleanup(ts->probe_fd);
-                        ts->probe_fd = -1;
-                        handle_probe_complete(sched, ts, false, 0.0);
-                    } else {
-                        // Still pending
-                        if (remaining < min_timeout) {
-                            min_timeout = remaining;
-                        }
-                    }
-                }
-                break;
-            }
+    // Without a reactor, in-flight connects and echo replies have to be polled
+    if (sched->reactor == NULL) {
+        if (use_icmp) {
+            drain_icmp_replies(sched);
+        }
+        probe_engine_process(sched->engine);
+    }
 
-            case PROBE_STATE_DONE:
-                // Should not happen - reset to idle
-                ts->probe_state = PROBE_STATE_IDLE;
-                break;
+    // Only targets whose deadline has passed are touched
+    uint32_t idx;
+    while (timer_heap_pop_due(&sched->deadlines, now, &idx)) {
+        if ((int)idx < sched->target_count) {
+            handle_deadline(sched, &sched->targets[idx], use_icmp);
+        }
+    }
+
+    // Echo Requests started this tick go out together
+    if (use_icmp) {
+        flush_icmp_batch(sched);
+    }
+
+    // Connects started and probes released this tick are submitted together
+    probe_engine_flush(sched->engine);
+
+    timer_entry_t next;
+    if (timer_heap_peek(&sched->deadlines, &next)) {
+        int wait = (int)(next.deadline_ms - now);
+        if (wait < min_timeout) {
+            min_timeout = wait;
         }
     }
 
     // Update metrics once per second
-    if (now - sched->last_metrics_update_ms >= 1000) {
+    uint64_t since_metrics = now - sched->last_metrics_update_ms;
+    if (since_metrics < 1000) {
+        int wait = (int)(1000 - since_metrics);
+        if (wait < min_timeout) {
+            min_timeout = wait;
+        }
+    } else {
         sched->last_metrics_update_ms = now;
 
         // Debug: log resource usage every 10 seconds
@@ -275,23 +718,26 @@ int scheduler_tick(scheduler_t *sched) {
 
         for (int i = 0; i < sched->target_count; i++) {
             target_state_t *ts = &sched->targets[i];
+            const char *id = sched->target_configs[i].id;
 
-            stats_compute(&ts->samples, &ts->metrics, ts->scratch, DEFAULT_WINDOW_SIZE);
+            stats_compute(&ts->window, &ts->metrics);
+            long_windows_compute(ts->long_windows, now, &ts->metrics.windows[1]);
+            touch_target(sched, ts);
 
             // Check for events
             if (event_log_check(&sched->event_log, &ts->bad_state,
-                               ts->config.id, &ts->metrics,
+                               id, &ts->metrics,
                                &sched->config->thresholds)) {
                 // Event was emitted
                 event_t *event = (event_t *)ring_buffer_newest(&sched->event_log.events);
                 if (event != NULL && g_event_cb != NULL) {
-                    g_event_cb(event, g_event_ctx);
+                    g_event_cb(i, event, g_event_ctx);
                 }
             }
 
             // Notify metrics callback
             if (g_metrics_cb != NULL) {
-                g_metrics_cb(ts->config.id, &ts->metrics, g_metrics_ctx);
+                g_metrics_cb(i, id, &ts->metrics, g_metrics_ctx);
             }
         }
     }
@@ -305,10 +751,23 @@ target_state_t *scheduler_get_target(scheduler_t *sched, const char *id) {
     }
 
     for (int i = 0; i < sched->target_count; i++) {
-        if (strcmp(sched->targets[i].config.id, id) == 0) {
+        if (strcmp(sched->target_configs[i].id, id) == 0) {
             return &sched->targets[i];
         }
     }
 
     return NULL;
 }
+
+const target_config_t *scheduler_target_config(const scheduler_t *sched, int index) {
+    if (sched == NULL || index < 0 || index >= sched->target_count) {
+        return NULL;
+    }
+    return &sched->target_configs[index];
+}
+
+size_t scheduler_bytes_per_target(void) {
+    size_t slot = (TARGET_SLOT_BYTES + 15) & ~(size_t)15;  // Slab slot alignment
+
+    return sizeof(target_state_t) + sizeof(target_config_t) + slot + sizeof(timer_entry_t) + sizeof(int32_t);
+}
@@ -7,30 +7,58 @@
 #include "core/stats.h"
 #include "core/ring_buffer.h"
 #include "core/event_log.h"
+#include "core/timer_heap.h"
+#include "core/slab.h"
 #include "net/icmp_probe.h"
+#include "net/probe_engine.h"
+#include "platform/reactor.h"
+#include "store/sample_store.h"
 
 /*
  * Probe state for a single target
  */
 typedef enum {
     PROBE_STATE_IDLE,
-    PROBE_STATE_CONNECTING,
+    PROBE_STATE_CONNECTING,     // Probe in flight (TCP connect or ICMP echo)
     PROBE_STATE_DONE
 } probe_state_t;
 
+#define ICMP_SEQ_SPACE  65536   // Number of distinct ICMP sequence numbers
+
 /*
- * Runtime state for a target
+ * Runtime state for a target (hot: touched on every probe and metrics update)
+ *
+ * Target storage is split into two parallel arrays indexed by target:
+ *   targets[]         target_state_t   - probe state, sample window, metrics
+ *   target_configs[]  target_config_t  - id, host, label (read when a probe
+ *                                        starts or a message is built)
+ * Sample windows live in a slab shared by all targets; each slot holds the
+ * samples, the quantile sketch of their RTTs, the window's slot queues and
+ * the bucket rings of the 5m/1h/24h windows.
+ *
+ * Memory per target on 64-bit Linux (see scheduler_bytes_per_target):
+ *   target_state_t   488 B  (metrics_t carries all four windows)
+ *   target_config_t  388 B
+ *   sample window    2880 B (DEFAULT_WINDOW_SIZE x sizeof(sample_t))
+ *   RTT sketch       1456 B (sizeof(quantile_sketch_t))
+ *   slot queues      480 B  (success order and max deque, 2 x uint16 per sample)
+ *   long windows     40792 B (44 buckets x 816 B + 3 running sums, any interval)
+ *   timer heap       20 B
+ *   total            46512 B
  */
 typedef struct {
-    target_config_t config;
-    ring_buffer_t samples;          // Ring buffer of sample_t
-    metrics_t metrics;
-    bad_state_t bad_state;
     probe_state_t probe_state;
-    int probe_fd;                   // Socket fd during probe
-    uint64_t probe_start_ms;        // When current probe started
+    int probe_handle;               // Probe engine handle during TCP probe (-1 for ICMP)
+    uint16_t probe_seq;             // ICMP sequence of the echo in flight
+    uint32_t probe_addr;            // ICMP destination (network byte order)
+    uint64_t probe_start_ns;        // When current probe started (monotonic ns)
     uint64_t next_probe_ms;         // When to start next probe
-    double scratch[DEFAULT_WINDOW_SIZE]; // Scratch space for percentile calculation
+    stats_window_t window;          // Samples and running stats (storage from sample_slab)
+    long_windows_t *long_windows;   // 5m/1h/24h buckets (same slab slot)
+    int32_t series;                 // Sample store series (-1 = not stored)
+    metrics_t metrics;
+    bad_state_t bad_state;
+    uint64_t version;               // Changes with window or metrics; unique across targets
 } target_state_t;
 
 /*
@@ -38,14 +66,26 @@ typedef struct {
  */
 typedef struct {
     config_t *config;
-    target_state_t targets[MAX_TARGETS];
+    target_state_t *targets;          // Hot per-target state, target_count entries
+    target_config_t *target_configs;  // Cold per-target config, parallel to targets
     int target_count;
+    int target_capacity;              // Allocated entries in both arrays
+    int *handle_map;                  // Probe engine handle -> target index (-1 if none)
+    size_t handle_map_size;
+    slab_t sample_slab;               // Sample window storage, one slot per target
+    timer_heap_t deadlines;         // Next action per target (probe start or connect timeout), keyed by index
     event_log_t event_log;
     uint64_t last_metrics_update_ms;
+    uint64_t versions;                // Last target version handed out (also bumped by target changes)
     uint64_t start_time_ms;
     bool running;
     icmp_probe_state_t icmp_state;   // ICMP probe state (shared across targets)
     bool icmp_available;              // Whether ICMP probing was successfully initialized
+    int32_t *icmp_seq_map;            // ICMP sequence -> target index (-1 if none)
+    int32_t icmp_batch[ICMP_BATCH_MAX]; // Target indices of queued Echo Requests
+    probe_engine_t *engine;           // Runs TCP connect probes
+    reactor_t *reactor;               // Event reactor for probe sockets (NULL = poll in tick)
+    sample_store_t *store;            // Persistent sample history (NULL = none)
 } scheduler_t;
 
 // Initialize scheduler
@@ -57,6 +97,17 @@ void scheduler_free(scheduler_t *sched);
 // Sync targets from config (call after config changes)
 int scheduler_sync_targets(scheduler_t *sched);
 
+// Attach an event reactor. The probe engine and ICMP socket are then watched
+// by it and probes complete as soon as the kernel reports the result, instead
+// of being polled from scheduler_tick. Pass NULL to detach.
+void scheduler_set_reactor(scheduler_t *sched, reactor_t *reactor);
+
+// Attach a sample store. Every completed probe is then appended to it, and
+// the sample windows of current targets are refilled from the stored history
+// (up to the 24h window). Call before the first scheduler_tick; pass NULL
+// to detach.
+void scheduler_set_store(scheduler_t *sched, sample_store_t *store);
+
 // Main tick function - call from event loop
 // Returns suggested timeout for next poll() in milliseconds
 int scheduler_tick(scheduler_t *sched);
@@ -64,16 +115,25 @@ int scheduler_tick(scheduler_t *sched);
 // Get target state by ID
 target_state_t *scheduler_get_target(scheduler_t *sched, const char *id);
 
+// Config of the target at index (cold storage), or NULL if out of range
+const target_config_t *scheduler_target_config(const scheduler_t *sched, int index);
+
+// Bytes of scheduler memory attributable to each target
+size_t scheduler_bytes_per_target(void);
+
+// Callbacks get the target's index, which stays valid until the targets next
+// change (WebSocket clients use it as a compact target handle)
+
 // Callback: called when a sample is recorded (for WebSocket broadcast)
-typedef void (*sample_callback_t)(const char *target_id, const sample_t *sample, void *ctx);
+typedef void (*sample_callback_t)(int index, const char *target_id, const sample_t *sample, void *ctx);
 void scheduler_set_sample_callback(scheduler_t *sched, sample_callback_t cb, void *ctx);
 
 // Callback: called when metrics are updated (for WebSocket broadcast)
-typedef void (*metrics_callback_t)(const char *target_id, const metrics_t *metrics, void *ctx);
+typedef void (*metrics_callback_t)(int index, const char *target_id, const metrics_t *metrics, void *ctx);
 void scheduler_set_metrics_callback(scheduler_t *sched, metrics_callback_t cb, void *ctx);
 
 // Callback: called when an event is emitted
-typedef void (*event_callback_t)(const event_t *event, void *ctx);
+typedef void (*event_callback_t)(int index, const event_t *event, void *ctx);
 void scheduler_set_event_callback(scheduler_t *sched, event_callback_t cb, void *ctx);
 
 #endif // NETPULSE_SCHEDULER_H
@@ -0,0 +1,91 @@
+#include "core/slab.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SLAB_ALIGN 16
+
+int slab_init(slab_t *slab, size_t obj_size, size_t objs_per_chunk) {
+    if (slab == NULL || obj_size == 0 || objs_per_chunk == 0) {
+        return -1;
+    }
+
+    memset(slab, 0, sizeof(*slab));
+
+    // Slots must hold the free-list link and keep doubles aligned
+    if (obj_size < sizeof(void *)) {
+        obj_size = sizeof(void *);
+    }
+    slab->obj_size = (obj_size + SLAB_ALIGN - 1) & ~(size_t)(SLAB_ALIGN - 1);
+    slab->objs_per_chunk = objs_per_chunk;
+    slab->next_slot = objs_per_chunk;  // Forces a chunk on first alloc
+
+    return 0;
+}
+
+void slab_free(slab_t *slab) {
+    if (slab == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < slab->chunk_count; i++) {
+        free(slab->chunks[i]);
+    }
+    free(slab->chunks);
+
+    slab->chunks = NULL;
+    slab->chunk_count = 0;
+    slab->next_slot = slab->objs_per_chunk;
+    slab->free_list = NULL;
+    slab->in_use = 0;
+}
+
+static int add_chunk(slab_t *slab) {
+    void **chunks = realloc(slab->chunks, (slab->chunk_count + 1) * sizeof(*chunks));
+    if (chunks == NULL) {
+        return -1;
+    }
+    slab->chunks = chunks;
+
+    void *chunk = malloc(slab->objs_per_chunk * slab->obj_size);
+    if (chunk == NULL) {
+        return -1;
+    }
+
+    slab->chunks[slab->chunk_count++] = chunk;
+    slab->next_slot = 0;
+    return 0;
+}
+
+void *slab_alloc(slab_t *slab) {
+    if (slab == NULL) {
+        return NULL;
+    }
+
+    void *obj;
+
+    if (slab->free_list != NULL) {
+        obj = slab->free_list;
+        slab->free_list = *(void **)obj;
+    } else {
+        if (slab->next_slot >= slab->objs_per_chunk && add_chunk(slab) != 0) {
+            return NULL;
+        }
+        char *chunk = slab->chunks[slab->chunk_count - 1];
+        obj = chunk + slab->next_slot * slab->obj_size;
+        slab->next_slot++;
+    }
+
+    memset(obj, 0, slab->obj_size);
+    slab->in_use++;
+    return obj;
+}
+
+void slab_release(slab_t *slab, void *obj) {
+    if (slab == NULL || obj == NULL) {
+        return;
+    }
+
+    *(void **)obj = slab->free_list;
+    slab->free_list = obj;
+    slab->in_use--;
+}
@@ -0,0 +1,42 @@
+#ifndef NETPULSE_SLAB_H
+#define NETPULSE_SLAB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Slab allocator for fixed-size objects.
+ * Objects are carved from chunks of objs_per_chunk slots; released objects go
+ * on a free list and are reused before a new chunk is allocated. Chunks are
+ * never moved, so object pointers stay valid until released.
+ */
+
+typedef struct {
+    size_t obj_size;        // Slot size (rounded up for alignment)
+    size_t objs_per_chunk;  // Slots per chunk
+    void **chunks;          // Allocated chunks
+    size_t chunk_count;     // Number of chunks
+    size_t next_slot;       // Next never-used slot in the newest chunk
+    void *free_list;        // Released slots (singly linked through the slot)
+    size_t in_use;          // Live objects
+} slab_t;
+
+// Initialize a slab. Returns 0 on success, -1 on error.
+int slab_init(slab_t *slab, size_t obj_size, size_t objs_per_chunk);
+
+// Free all chunks. Outstanding objects become invalid.
+void slab_free(slab_t *slab);
+
+// Allocate a zeroed object. Returns NULL on allocation failure.
+void *slab_alloc(slab_t *slab);
+
+// Return an object to the slab
+void slab_release(slab_t *slab, void *obj);
+
+// Bytes reserved by all chunks
+static inline size_t slab_reserved_bytes(const slab_t *slab) {
+    return slab->chunk_count * slab->objs_per_chunk * slab->obj_size;
+}
+
+#endif // NETPULSE_SLAB_H
@@ -0,0 +1,104 @@
+#include "core/spsc_queue.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SPSC_HEADER     8                   // Length word, padded
+#define SPSC_PAD        UINT64_MAX          // Header of the skip to the end of the ring
+
+static size_t round_up_8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+int spsc_queue_init(spsc_queue_t *q, size_t capacity) {
+    if (q == NULL || capacity < 64) {
+        return -1;
+    }
+
+    size_t size = 64;
+    while (size < capacity) {
+        size *= 2;
+    }
+
+    memset(q, 0, sizeof(*q));
+    q->buf = malloc(size);
+    if (q->buf == NULL) {
+        return -1;
+    }
+    q->capacity = size;
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    return 0;
+}
+
+void spsc_queue_free(spsc_queue_t *q) {
+    if (q != NULL) {
+        free(q->buf);
+        q->buf = NULL;
+        q->capacity = 0;
+    }
+}
+
+void *spsc_queue_reserve(spsc_queue_t *q, size_t len) {
+    size_t need = SPSC_HEADER + round_up_8(len);
+    if (need > q->capacity / 2) {
+        return NULL;
+    }
+
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    size_t pos = head & (q->capacity - 1);
+    size_t to_end = q->capacity - pos;
+
+    // Doesn't fit before the end: skip to the start (to_end is a multiple
+    // of 8, so there is always room for the pad header)
+    size_t skip = need > to_end ? to_end : 0;
+    if (q->capacity - (head - tail) < skip + need) {
+        return NULL;
+    }
+    if (skip > 0) {
+        uint64_t pad = SPSC_PAD;
+        memcpy(q->buf + pos, &pad, sizeof(pad));
+        pos = 0;
+    }
+
+    uint64_t header = len;
+    memcpy(q->buf + pos, &header, sizeof(header));
+    q->reserved = head + skip + need;
+    return q->buf + pos + SPSC_HEADER;
+}
+
+void spsc_queue_commit(spsc_queue_t *q) {
+    atomic_store_explicit(&q->head, q->reserved, memory_order_release);
+}
+
+const void *spsc_queue_peek(spsc_queue_t *q, size_t *len) {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    if (tail == head) {
+        return NULL;
+    }
+
+    size_t pos = tail & (q->capacity - 1);
+    uint64_t header;
+    memcpy(&header, q->buf + pos, sizeof(header));
+    if (header == SPSC_PAD) {
+        // The producer only pads when a message follows at the start
+        tail += q->capacity - pos;
+        pos = 0;
+        memcpy(&header, q->buf, sizeof(header));
+    }
+
+    *len = (size_t)header;
+    q->peeked = tail + SPSC_HEADER + round_up_8((size_t)header);
+    return q->buf + pos + SPSC_HEADER;
+}
+
+void spsc_queue_release(spsc_queue_t *q) {
+    atomic_store_explicit(&q->tail, q->peeked, memory_order_release);
+}
+
+size_t spsc_queue_used(spsc_queue_t *q) {
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+    return head - tail;
+}
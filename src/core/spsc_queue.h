@@ -0,0 +1,58 @@
+#ifndef NETPULSE_SPSC_QUEUE_H
+#define NETPULSE_SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "core/spsc_ring.h"
+
+/*
+ * Lock-free single-producer, single-consumer queue of variable-size messages.
+ * Messages are laid end to end in one byte ring, each as an 8-byte header
+ * (its length) and its bytes, padded to 8. A message that would run past
+ * the end of the ring is put at the start instead, behind a pad header.
+ *
+ * head (bytes written) is stored only by the producer, tail (bytes read)
+ * only by the consumer. Each loads the other's with acquire and stores its
+ * own with release, so a message is complete before the consumer sees it,
+ * and its space is free before the producer reuses it. No locks: a side
+ * that finds the queue full or empty just gets NULL back. As in spsc_ring_t
+ * (for fixed-size elements), each side's index has a cache line of its own.
+ */
+
+typedef struct {
+    uint8_t *buf;
+    size_t capacity;            // Bytes, a power of two
+    _Alignas(SPSC_RING_CACHE_LINE) _Atomic size_t head;    // Bytes written (producer stores)
+    size_t reserved;            // Producer: head after the reserved message
+    _Alignas(SPSC_RING_CACHE_LINE) _Atomic size_t tail;    // Bytes read (consumer stores)
+    size_t peeked;              // Consumer: tail after the peeked message
+} spsc_queue_t;
+
+// Initialize an empty queue of capacity bytes (rounded up to a power of
+// two). Returns 0 on success, -1 on error.
+int spsc_queue_init(spsc_queue_t *q, size_t capacity);
+
+// Free the ring. Neither side may be using it.
+void spsc_queue_free(spsc_queue_t *q);
+
+// Producer: room for a message of len bytes, or NULL if the queue hasn't
+// that much free (or len is over half the capacity). Write the message
+// there, then spsc_queue_commit.
+void *spsc_queue_reserve(spsc_queue_t *q, size_t len);
+
+// Producer: make the reserved message visible to the consumer
+void spsc_queue_commit(spsc_queue_t *q);
+
+// Consumer: the oldest message (its length in *len), or NULL if the queue
+// is empty. It stays valid until spsc_queue_release.
+const void *spsc_queue_peek(spsc_queue_t *q, size_t *len);
+
+// Consumer: drop the peeked message, freeing its space
+void spsc_queue_release(spsc_queue_t *q);
+
+// Bytes in use, messages and padding (either side; a snapshot)
+size_t spsc_queue_used(spsc_queue_t *q);
+
+#endif // NETPULSE_SPSC_QUEUE_H
@@ -0,0 +1,90 @@
+#include "core/spsc_ring.h"
+#include <stdlib.h>
+#include <string.h>
+
+int spsc_ring_init(spsc_ring_t *r, size_t elem_size, size_t capacity) {
+    if (r == NULL || elem_size == 0 || capacity == 0 || capacity > SIZE_MAX / 2 / elem_size) {
+        return -1;
+    }
+
+    size_t size = 1;
+    while (size < capacity) {
+        size *= 2;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->buf = malloc(size * elem_size);
+    if (r->buf == NULL) {
+        return -1;
+    }
+    r->elem_size = elem_size;
+    r->capacity = size;
+    r->mask = size - 1;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    return 0;
+}
+
+void spsc_ring_free(spsc_ring_t *r) {
+    if (r != NULL) {
+        free(r->buf);
+        r->buf = NULL;
+        r->capacity = 0;
+        r->mask = 0;
+    }
+}
+
+size_t spsc_ring_push(spsc_ring_t *r, const void *elems, size_t n) {
+    size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    size_t room = r->capacity - (head - r->cached_tail);
+    if (room < n) {
+        r->cached_tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+        room = r->capacity - (head - r->cached_tail);
+        if (n > room) {
+            n = room;
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    // At most two runs: to the end of the buffer, then from its start
+    size_t pos = head & r->mask;
+    size_t first = n < r->capacity - pos ? n : r->capacity - pos;
+    memcpy(r->buf + pos * r->elem_size, elems, first * r->elem_size);
+    if (n > first) {
+        memcpy(r->buf, (const uint8_t *)elems + first * r->elem_size, (n - first) * r->elem_size);
+    }
+    atomic_store_explicit(&r->head, head + n, memory_order_release);
+    return n;
+}
+
+size_t spsc_ring_pop(spsc_ring_t *r, void *out, size_t n) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    size_t ready = r->cached_head - tail;
+    if (ready < n) {
+        r->cached_head = atomic_load_explicit(&r->head, memory_order_acquire);
+        ready = r->cached_head - tail;
+        if (n > ready) {
+            n = ready;
+        }
+    }
+    if (n == 0) {
+        return 0;
+    }
+
+    size_t pos = tail & r->mask;
+    size_t first = n < r->capacity - pos ? n : r->capacity - pos;
+    memcpy(out, r->buf + pos * r->elem_size, first * r->elem_size);
+    if (n > first) {
+        memcpy((uint8_t *)out + first * r->elem_size, r->buf, (n - first) * r->elem_size);
+    }
+    atomic_store_explicit(&r->tail, tail + n, memory_order_release);
+    return n;
+}
+
+size_t spsc_ring_count(spsc_ring_t *r) {
+    size_t tail = atomic_load_explicit(&r->tail, memory_order_acquire);
+    size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+    return head - tail;
+}
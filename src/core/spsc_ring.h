@@ -0,0 +1,59 @@
+#ifndef NETPULSE_SPSC_RING_H
+#define NETPULSE_SPSC_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+/*
+ * Lock-free single-producer, single-consumer ring of fixed-size elements,
+ * for handing elements from one thread to another (ring_buffer_t is for one
+ * thread only).
+ *
+ * head (elements pushed) is stored only by the producer, tail (elements
+ * popped) only by the consumer; both run freely and are masked into the
+ * power-of-two buffer. Each side loads the other's index with acquire and
+ * stores its own with release, so elements are written before the consumer
+ * sees them and read before the producer reuses their slots. The two sit on
+ * cache lines of their own, each with the side's last look at the other's
+ * index, which it only reloads when that look says the ring is full (or
+ * empty): a side that isn't waiting doesn't touch the other's line.
+ *
+ * The struct is cache-line aligned: embed it, or allocate it with
+ * aligned_alloc.
+ */
+
+#define SPSC_RING_CACHE_LINE    64
+
+typedef struct {
+    uint8_t *buf;
+    size_t elem_size;
+    size_t capacity;            // Elements, a power of two
+    size_t mask;                // capacity - 1
+    _Alignas(SPSC_RING_CACHE_LINE) _Atomic size_t head;    // Producer's line
+    size_t cached_tail;         // Producer: tail as last loaded
+    _Alignas(SPSC_RING_CACHE_LINE) _Atomic size_t tail;    // Consumer's line
+    size_t cached_head;         // Consumer: head as last loaded (the struct's
+                                // alignment pads this line out)
+} spsc_ring_t;
+
+// Initialize an empty ring of capacity elements of elem_size bytes
+// (capacity rounded up to a power of two). Returns 0 on success, -1 on error.
+int spsc_ring_init(spsc_ring_t *r, size_t elem_size, size_t capacity);
+
+// Free the buffer. Neither side may be using it.
+void spsc_ring_free(spsc_ring_t *r);
+
+// Producer: append up to n elements from elems, as many as there is room
+// for. Returns the number pushed (0 if the ring is full).
+size_t spsc_ring_push(spsc_ring_t *r, const void *elems, size_t n);
+
+// Consumer: take up to n of the oldest elements into out. Returns the
+// number popped (0 if the ring is empty).
+size_t spsc_ring_pop(spsc_ring_t *r, void *out, size_t n);
+
+// Elements in the ring (either side; a snapshot)
+size_t spsc_ring_count(spsc_ring_t *r);
+
+#endif // NETPULSE_SPSC_RING_H
@@ -1,6 +1,7 @@
 #include "core/stats.h"
 #include "platform/platform.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 // Comparison function for qsort
@@ -12,6 +13,20 @@ static int compare_doubles(const void *a, const void *b) {
     return 0;
 }
 
+// Absolute RTT delta in whole nanoseconds, so sums are exact in any order
+static uint64_t delta_ns(double a_ms, double b_ms) {
+    return (uint64_t)(fabs(a_ms - b_ms) * 1000000.0 + 0.5);
+}
+
+// Shared by the full scan and the window so both round identically
+static double loss_pct(size_t failures, size_t total) {
+    return total == 0 ? 0.0 : (double)failures / (double)total * 100.0;
+}
+
+static double jitter_ms(uint64_t sum_ns, size_t delta_count) {
+    return delta_count == 0 ? 0.0 : (double)sum_ns / 1000000.0 / (double)delta_count;
+}
+
 double stats_compute_loss(ring_buffer_t *samples) {
     if (samples == NULL || ring_buffer_count(samples) == 0) {
         return 0.0;
@@ -27,7 +42,7 @@ double stats_compute_loss(ring_buffer_t *samples) {
         }
     }
 
-    return (double)failures / (double)total * 100.0;
+    return loss_pct(failures, total);
 }
 
 double stats_compute_jitter(ring_buffer_t *samples) {
@@ -35,7 +50,7 @@ double stats_compute_jitter(ring_buffer_t *samples) {
         return 0.0;
     }
 
-    double total_delta = 0.0;
+    uint64_t total_delta = 0;
     size_t delta_count = 0;
     double prev_rtt = -1.0;
 
@@ -43,21 +58,17 @@ double stats_compute_jitter(ring_buffer_t *samples) {
         sample_t *s = (sample_t *)ring_buffer_get(samples, i);
         if (s != NULL && s->success) {
             if (prev_rtt >= 0.0) {
-                total_delta += fabs(s->rtt_ms - prev_rtt);
+                total_delta += delta_ns(prev_rtt, s->rtt_ms);
                 delta_count++;
             }
             prev_rtt = s->rtt_ms;
         }
     }
 
-    if (delta_count == 0) {
-        return 0.0;
-    }
-
-    return total_delta / (double)delta_count;
+    return jitter_ms(total_delta, delta_count);
 }
 
-static double stats_compute_max_rtt(ring_buffer_t *samples) {
+double stats_compute_max_rtt(ring_buffer_t *samples) {
     if (samples == NULL || ring_buffer_count(samples) == 0) {
         return 0.0;
     }
@@ -108,26 +119,137 @@ double stats_compute_percentile(ring_buffer_t *samples, double percentile, doubl
     return scratch[lower] * (1.0 - frac) + scratch[upper] * frac;
 }
 
-void stats_compute(ring_buffer_t *samples, metrics_t *metrics, double *scratch, size_t scratch_size) {
-    if (samples == NULL || metrics == NULL) {
+size_t stats_window_storage_size(size_t capacity) {
+    size_t samples = (capacity * sizeof(sample_t) + 15) & ~(size_t)15;
+    size_t sketch = (sizeof(quantile_sketch_t) + 15) & ~(size_t)15;
+    return samples + sketch + 2 * capacity * sizeof(uint16_t);
+}
+
+int stats_window_init(stats_window_t *w, size_t capacity, void *storage) {
+    if (w == NULL || storage == NULL || capacity == 0 || capacity > STATS_WINDOW_MAX) {
+        return -1;
+    }
+
+    memset(w, 0, sizeof(*w));
+    if (ring_buffer_init_with_storage(&w->samples, sizeof(sample_t), capacity, storage) != 0) {
+        return -1;
+    }
+
+    char *p = (char *)storage + ((capacity * sizeof(sample_t) + 15) & ~(size_t)15);
+    w->rtt_sketch = (quantile_sketch_t *)p;
+    p += (sizeof(quantile_sketch_t) + 15) & ~(size_t)15;
+    w->success_slots = (uint16_t *)p;
+    w->max_slots = w->success_slots + capacity;
+    return 0;
+}
+
+static const sample_t *sample_at_slot(const stats_window_t *w, uint16_t slot) {
+    return (const sample_t *)((const char *)w->samples.data + (size_t)slot * sizeof(sample_t));
+}
+
+// Slot queues are rings of the window's capacity
+static uint16_t queue_index(const stats_window_t *w, uint16_t head, uint16_t offset) {
+    return (uint16_t)(((size_t)head + offset) % w->samples.capacity);
+}
+
+void stats_window_push(stats_window_t *w, const sample_t *sample) {
+    if (w == NULL || sample == NULL) {
+        return;
+    }
+
+    // A full window drops its oldest sample, which is at the front of every queue it is in
+    if (ring_buffer_full(&w->samples)) {
+        uint16_t slot = (uint16_t)w->samples.tail;
+        const sample_t *oldest = sample_at_slot(w, slot);
+
+        if (!oldest->success) {
+            w->failures--;
+        } else {
+            w->success_head = queue_index(w, w->success_head, 1);
+            w->success_count--;
+            if (w->success_count > 0) {
+                const sample_t *next = sample_at_slot(w, w->success_slots[w->success_head]);
+                w->jitter_sum_ns -= delta_ns(oldest->rtt_ms, next->rtt_ms);
+            }
+            if (w->max_count > 0 && w->max_slots[w->max_head] == slot) {
+                w->max_head = queue_index(w, w->max_head, 1);
+                w->max_count--;
+            }
+            quantile_sketch_remove(w->rtt_sketch, oldest->rtt_ms);
+        }
+    }
+
+    uint16_t slot = (uint16_t)w->samples.head;
+    ring_buffer_push(&w->samples, sample);
+    w->pushes++;
+
+    if (!sample->success) {
+        w->failures++;
         return;
     }
 
-    metrics->loss_pct = stats_compute_loss(samples);
-    metrics->jitter_ms = stats_compute_jitter(samples);
-    metrics->p50_ms = stats_compute_percentile(samples, 50.0, scratch, scratch_size);
-    metrics->p95_ms = stats_compute_percentile(samples, 95.0, scratch, scratch_size);
-    metrics->max_rtt_ms = stats_compute_max_rtt(samples);
+    if (w->success_count > 0) {
+        uint16_t newest = w->success_slots[queue_index(w, w->success_head, w->success_count - 1)];
+        w->jitter_sum_ns += delta_ns(sample_at_slot(w, newest)->rtt_ms, sample->rtt_ms);
+    }
+    w->success_slots[queue_index(w, w->success_head, w->success_count)] = slot;
+    w->success_count++;
+
+    // Samples no larger than the new one can never be the max again
+    while (w->max_count > 0 &&
+           sample_at_slot(w, w->max_slots[queue_index(w, w->max_head, w->max_count - 1)])->rtt_ms <= sample->rtt_ms) {
+        w->max_count--;
+    }
+    w->max_slots[queue_index(w, w->max_head, w->max_count)] = slot;
+    w->max_count++;
 
-    // Get current RTT from newest successful sample
+    quantile_sketch_add(w->rtt_sketch, sample->rtt_ms);
+}
+
+// v, or limit if that is smaller
+static double at_most(double v, double limit) {
+    return v < limit ? v : limit;
+}
+
+void stats_compute(const stats_window_t *w, metrics_t *metrics) {
+    if (w == NULL || metrics == NULL) {
+        return;
+    }
+
+    const quantile_sketch_t *qs = w->rtt_sketch;
+    metrics->loss_pct = loss_pct(w->failures, ring_buffer_count(&w->samples));
+    metrics->jitter_ms = w->success_count < 2 ? 0.0 : jitter_ms(w->jitter_sum_ns, w->success_count - 1u);
+    metrics->max_rtt_ms = 0.0;
     metrics->current_rtt_ms = 0.0;
-    for (size_t i = ring_buffer_count(samples); i > 0; i--) {
-        sample_t *s = (sample_t *)ring_buffer_get(samples, i - 1);
-        if (s != NULL && s->success) {
-            metrics->current_rtt_ms = s->rtt_ms;
-            break;
+
+    if (w->max_count > 0) {
+        double max_rtt = sample_at_slot(w, w->max_slots[w->max_head])->rtt_ms;
+        if (max_rtt > 0.0) {
+            metrics->max_rtt_ms = max_rtt;
         }
     }
 
+    // Sketch answers are bucket midpoints, which can lie above the exact max
+    double max_rtt = metrics->max_rtt_ms;
+    metrics->p50_ms = at_most(quantile_sketch_query(qs, 50.0), max_rtt);
+    metrics->p95_ms = at_most(quantile_sketch_query(qs, 95.0), max_rtt);
+    metrics->p99_ms = at_most(quantile_sketch_query(qs, 99.0), max_rtt);
+    metrics->p999_ms = at_most(quantile_sketch_query(qs, 99.9), max_rtt);
+
+    // Current RTT is the newest successful sample
+    if (w->success_count > 0) {
+        uint16_t newest = w->success_slots[queue_index(w, w->success_head, w->success_count - 1)];
+        metrics->current_rtt_ms = sample_at_slot(w, newest)->rtt_ms;
+    }
+
+    window_metrics_t *wm = &metrics->windows[0];
+    wm->loss_pct = metrics->loss_pct;
+    wm->jitter_ms = metrics->jitter_ms;
+    wm->p50_ms = metrics->p50_ms;
+    wm->p95_ms = metrics->p95_ms;
+    wm->p99_ms = metrics->p99_ms;
+    wm->max_rtt_ms = metrics->max_rtt_ms;
+    wm->sample_count = (uint32_t)ring_buffer_count(&w->samples);
+
     metrics->last_updated = now_ms();
 }
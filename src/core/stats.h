@@ -5,6 +5,8 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include "core/ring_buffer.h"
+#include "core/quantile.h"
+#include "core/long_window.h"
 
 /*
  * Sample: a single probe result
@@ -15,8 +17,11 @@ typedef struct {
     bool success;           // Whether probe succeeded
 } sample_t;
 
+// Windows reported per target: the sample window, then the long windows
+#define METRICS_WINDOW_COUNT    (1 + LONG_WINDOW_COUNT)
+
 /*
- * Computed metrics for a target
+ * Computed metrics for a target (top-level fields are the sample window)
  */
 typedef struct {
     double current_rtt_ms;  // Last successful RTT
@@ -25,20 +30,68 @@ typedef struct {
     double jitter_ms;       // Average absolute RTT delta
     double p50_ms;          // 50th percentile RTT
     double p95_ms;          // 95th percentile RTT
+    double p99_ms;          // 99th percentile RTT
+    double p999_ms;         // 99.9th percentile RTT
+    window_metrics_t windows[METRICS_WINDOW_COUNT];  // 1m (sample window), 5m, 1h, 24h
     uint64_t last_updated;  // Timestamp of last metrics update
 } metrics_t;
 
-// Compute metrics from a ring buffer of samples
-// scratch must be an array of at least sample_count doubles for sorting
-void stats_compute(ring_buffer_t *samples, metrics_t *metrics, double *scratch, size_t scratch_size);
+/*
+ * Sliding window of samples with incrementally kept statistics
+ *
+ * Each push updates, for the samples entering and leaving the window, the
+ * failure count, the sum of absolute deltas between consecutive successful
+ * RTTs, a monotonic deque of slots for the maximum RTT, and the RTT quantile
+ * sketch. stats_compute() then costs O(1) per window, and its loss, jitter,
+ * max and current RTT are bit-for-bit those of the full-scan functions below.
+ *
+ * All storage (samples, sketch, slot queues) is one caller-provided block of
+ * stats_window_storage_size() bytes, e.g. a slab slot.
+ */
+typedef struct {
+    ring_buffer_t samples;          // sample_t, oldest first
+    quantile_sketch_t *rtt_sketch;  // RTTs of the successful samples
+    uint16_t *success_slots;        // Ring slots of successful samples, oldest first
+    uint16_t *max_slots;            // Ring slots of successful samples with decreasing RTT
+    uint16_t success_head;
+    uint16_t success_count;
+    uint16_t max_head;
+    uint16_t max_count;
+    uint32_t failures;              // Failed samples in the window
+    uint64_t jitter_sum_ns;         // Sum of |delta| over consecutive successful RTTs
+    uint64_t pushes;                // Samples pushed since init
+} stats_window_t;
+
+#define STATS_WINDOW_MAX    UINT16_MAX  // Largest window capacity
+
+// Bytes of storage a window of capacity samples needs
+size_t stats_window_storage_size(size_t capacity);
+
+// Initialize an empty window over zeroed storage of
+// stats_window_storage_size(capacity) bytes. Returns 0 on success, -1 on error.
+int stats_window_init(stats_window_t *w, size_t capacity, void *storage);
+
+// Push a sample, dropping the oldest one if the window is full
+void stats_window_push(stats_window_t *w, const sample_t *sample);
+
+// Compute metrics for a window, including windows[0]. Percentiles are read
+// from the RTT sketch (see core/quantile.h for the error bound).
+void stats_compute(const stats_window_t *w, metrics_t *metrics);
+
+// Full-scan versions (O(window)), kept as the reference for stats_window_t
 
 // Compute loss percentage from samples
 double stats_compute_loss(ring_buffer_t *samples);
 
-// Compute jitter (avg absolute delta between consecutive successful RTTs)
+// Compute jitter (avg absolute delta between consecutive successful RTTs).
+// Deltas are summed in whole nanoseconds so the sum is exact in any order.
 double stats_compute_jitter(ring_buffer_t *samples);
 
-// Compute percentile RTT (0-100). Requires scratch buffer for sorting.
+// Compute maximum successful RTT
+double stats_compute_max_rtt(ring_buffer_t *samples);
+
+// Compute exact percentile RTT (0-100) by sorting the window into scratch.
+// Reference for the sketch; stats_compute does not use it.
 double stats_compute_percentile(ring_buffer_t *samples, double percentile, double *scratch, size_t scratch_size);
 
 #endif // NETPULSE_STATS_H
@@ -0,0 +1,191 @@
+#include "core/timer_heap.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void place(timer_heap_t *h, size_t i, timer_entry_t e) {
+    h->entries[i] = e;
+    h->pos[e.id] = (int32_t)i;
+}
+
+static void sift_up(timer_heap_t *h, size_t i) {
+    timer_entry_t e = h->entries[i];
+
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (h->entries[parent].deadline_ms <= e.deadline_ms) {
+            break;
+        }
+        place(h, i, h->entries[parent]);
+        i = parent;
+    }
+
+    place(h, i, e);
+}
+
+static void sift_down(timer_heap_t *h, size_t i) {
+    timer_entry_t e = h->entries[i];
+
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= h->count) {
+            break;
+        }
+        if (child + 1 < h->count &&
+            h->entries[child + 1].deadline_ms < h->entries[child].deadline_ms) {
+            child++;
+        }
+        if (e.deadline_ms <= h->entries[child].deadline_ms) {
+            break;
+        }
+        place(h, i, h->entries[child]);
+        i = child;
+    }
+
+    place(h, i, e);
+}
+
+// Remove the entry at heap index i
+static void remove_at(timer_heap_t *h, size_t i) {
+    h->pos[h->entries[i].id] = -1;
+    h->count--;
+
+    if (i == h->count) {
+        return;
+    }
+
+    // Move last entry into the hole and restore heap order
+    timer_entry_t last = h->entries[h->count];
+    place(h, i, last);
+    if (i > 0 && h->entries[(i - 1) / 2].deadline_ms > last.deadline_ms) {
+        sift_up(h, i);
+    } else {
+        sift_down(h, i);
+    }
+}
+
+static int grow_ids(timer_heap_t *h, uint32_t id) {
+    if (id < h->pos_capacity) {
+        return 0;
+    }
+
+    size_t new_cap = h->pos_capacity > 0 ? h->pos_capacity : 16;
+    while (new_cap <= id) {
+        new_cap *= 2;
+    }
+
+    // Grow entries first so capacity >= pos_capacity holds even if pos fails
+    timer_entry_t *entries = realloc(h->entries, new_cap * sizeof(*entries));
+    if (entries == NULL) {
+        return -1;
+    }
+    h->entries = entries;
+    h->capacity = new_cap;
+
+    int32_t *pos = realloc(h->pos, new_cap * sizeof(*pos));
+    if (pos == NULL) {
+        return -1;
+    }
+    for (size_t i = h->pos_capacity; i < new_cap; i++) {
+        pos[i] = -1;
+    }
+
+    h->pos = pos;
+    h->pos_capacity = new_cap;
+    return 0;
+}
+
+int timer_heap_init(timer_heap_t *h, size_t capacity) {
+    if (h == NULL) {
+        return -1;
+    }
+
+    memset(h, 0, sizeof(*h));
+
+    if (capacity > 0 && grow_ids(h, (uint32_t)(capacity - 1)) != 0) {
+        timer_heap_free(h);
+        return -1;
+    }
+
+    return 0;
+}
+
+void timer_heap_free(timer_heap_t *h) {
+    if (h != NULL) {
+        free(h->entries);
+        free(h->pos);
+        memset(h, 0, sizeof(*h));
+    }
+}
+
+void timer_heap_clear(timer_heap_t *h) {
+    if (h == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < h->count; i++) {
+        h->pos[h->entries[i].id] = -1;
+    }
+    h->count = 0;
+}
+
+int timer_heap_schedule(timer_heap_t *h, uint32_t id, uint64_t deadline_ms) {
+    if (h == NULL) {
+        return -1;
+    }
+
+    if (grow_ids(h, id) != 0) {
+        return -1;
+    }
+
+    int32_t i = h->pos[id];
+    if (i >= 0) {
+        // Already queued - move it
+        uint64_t old = h->entries[i].deadline_ms;
+        h->entries[i].deadline_ms = deadline_ms;
+        if (deadline_ms < old) {
+            sift_up(h, (size_t)i);
+        } else {
+            sift_down(h, (size_t)i);
+        }
+        return 0;
+    }
+
+    // Ids are dense, so capacity >= pos_capacity always leaves room
+    timer_entry_t e = { .deadline_ms = deadline_ms, .id = id };
+    h->entries[h->count] = e;
+    h->pos[id] = (int32_t)h->count;
+    h->count++;
+    sift_up(h, h->count - 1);
+    return 0;
+}
+
+void timer_heap_cancel(timer_heap_t *h, uint32_t id) {
+    if (h == NULL || id >= h->pos_capacity || h->pos[id] < 0) {
+        return;
+    }
+
+    remove_at(h, (size_t)h->pos[id]);
+}
+
+bool timer_heap_peek(const timer_heap_t *h, timer_entry_t *out) {
+    if (h == NULL || h->count == 0) {
+        return false;
+    }
+
+    if (out != NULL) {
+        *out = h->entries[0];
+    }
+    return true;
+}
+
+bool timer_heap_pop_due(timer_heap_t *h, uint64_t now_ms, uint32_t *id) {
+    if (h == NULL || h->count == 0 || h->entries[0].deadline_ms > now_ms) {
+        return false;
+    }
+
+    if (id != NULL) {
+        *id = h->entries[0].id;
+    }
+    remove_at(h, 0);
+    return true;
+}
@@ -0,0 +1,57 @@
+#ifndef NETPULSE_TIMER_HEAP_H
+#define NETPULSE_TIMER_HEAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Indexed binary min-heap of deadlines.
+ * Each id (e.g. a target index) holds at most one deadline; scheduling an
+ * id that is already queued moves it. Insert, move and cancel are O(log n),
+ * peeking the earliest deadline is O(1).
+ */
+
+typedef struct {
+    uint64_t deadline_ms;   // Monotonic deadline
+    uint32_t id;            // Caller-defined identifier
+} timer_entry_t;
+
+typedef struct {
+    timer_entry_t *entries; // Heap-ordered entries
+    size_t count;           // Number of queued entries
+    size_t capacity;        // Allocated entries
+    int32_t *pos;           // id -> index in entries (-1 if not queued)
+    size_t pos_capacity;    // Number of ids pos can hold
+} timer_heap_t;
+
+// Initialize a heap sized for ids [0, capacity). Grows on demand.
+// Returns 0 on success, -1 on error.
+int timer_heap_init(timer_heap_t *h, size_t capacity);
+
+// Free heap resources
+void timer_heap_free(timer_heap_t *h);
+
+// Remove all entries
+void timer_heap_clear(timer_heap_t *h);
+
+// Queue id at deadline_ms, moving it if already queued.
+// Returns 0 on success, -1 on allocation failure.
+int timer_heap_schedule(timer_heap_t *h, uint32_t id, uint64_t deadline_ms);
+
+// Remove id if queued
+void timer_heap_cancel(timer_heap_t *h, uint32_t id);
+
+// Earliest entry without removing it. Returns false if the heap is empty.
+bool timer_heap_peek(const timer_heap_t *h, timer_entry_t *out);
+
+// Pop the earliest entry if its deadline is <= now_ms.
+// Returns false if nothing is due.
+bool timer_heap_pop_due(timer_heap_t *h, uint64_t now_ms, uint32_t *id);
+
+// Number of queued entries
+static inline size_t timer_heap_count(const timer_heap_t *h) {
+    return h->count;
+}
+
+#endif // NETPULSE_TIMER_HEAP_H
@@ -9,8 +9,12 @@
 #include "platform/platform.h"
 #include "core/config.h"
 #include "core/scheduler.h"
+#include "core/probe_thread.h"
 #include "server/server.h"
 #include "net/icmp_probe.h"
+#include "net/dns.h"
+#include "store/sample_store.h"
+#include "platform/reactor.h"
 
 static volatile sig_atomic_t g_running = 1;
 
@@ -34,6 +38,23 @@ static void print_usage(const char *prog) {
     printf("Usage: %s [options]\n", prog);
     printf("\nOptions:\n");
     printf("  -p, --probe-type TYPE   Probe type: tcp (default) or icmp\n");
+    printf("  -e, --probe-engine ENG  TCP probe engine: poll (default) or uring (Linux)\n");
+    printf("  -t, --kernel-timestamps Measure RTT with kernel timestamps (Linux)\n");
+    printf("  -d, --dns-server ADDR   Nameserver ip[:port] (default: /etc/resolv.conf)\n");
+    printf("  -r, --history HOURS     Sample history kept on disk (default: %d, 0 = off)\n",
+           DEFAULT_HISTORY_HOURS);
+    printf("  -b, --ws-batch MS       Gather WebSocket updates for up to MS (default: %d,\n"
+           "                          one message per tick)\n", DEFAULT_WS_BATCH_MS);
+    printf("  -z, --ws-deflate MODE   WebSocket compression: shared (default), context or off\n");
+    printf("  -m, --ws-deflate-min N  Send WebSocket messages under N bytes uncompressed\n"
+           "                          (default: %d)\n", DEFAULT_WS_DEFLATE_MIN);
+    printf("  -l, --ws-replay KB      Recent WebSocket messages kept so reconnecting clients\n"
+           "                          can catch up without a snapshot (default: %d, 0 = off)\n",
+           DEFAULT_WS_REPLAY_KB);
+    printf("  -q, --ws-queue KB       Backlog over which a WebSocket client gets batches\n"
+           "                          without samples (default: %d, 0 = no limit)\n",
+           DEFAULT_WS_QUEUE_KB);
+    printf("  -c, --probe-cpu N       Pin the probe thread to CPU N (Linux; default: not pinned)\n");
     printf("  -h, --help              Show this help message\n");
     printf("\nICMP mode:\n");
     printf("  On Linux, requires CAP_NET_RAW capability:\n");
@@ -43,16 +64,36 @@ static void print_usage(const char *prog) {
 
 int main(int argc, char *argv[]) {
     probe_type_t probe_type = PROBE_TYPE_TCP;
+    probe_engine_kind_t probe_engine = PROBE_ENGINE_POLL;
+    bool kernel_timestamps = false;
+    const char *dns_server = NULL;
+    long history_hours = DEFAULT_HISTORY_HOURS;
+    long ws_batch_ms = DEFAULT_WS_BATCH_MS;
+    ws_deflate_mode_t ws_deflate = WS_DEFLATE_SHARED;
+    long ws_deflate_min = DEFAULT_WS_DEFLATE_MIN;
+    long ws_replay_kb = DEFAULT_WS_REPLAY_KB;
+    long ws_queue_kb = DEFAULT_WS_QUEUE_KB;
+    long probe_cpu = -1;
 
     // Parse command-line options
     static struct option long_options[] = {
-        {"probe-type", required_argument, 0, 'p'},
-        {"help",       no_argument,       0, 'h'},
+        {"probe-type",        required_argument, 0, 'p'},
+        {"probe-engine",      required_argument, 0, 'e'},
+        {"kernel-timestamps", no_argument,       0, 't'},
+        {"dns-server",        required_argument, 0, 'd'},
+        {"history",           required_argument, 0, 'r'},
+        {"ws-batch",          required_argument, 0, 'b'},
+        {"ws-deflate",        required_argument, 0, 'z'},
+        {"ws-deflate-min",    required_argument, 0, 'm'},
+        {"ws-replay",         required_argument, 0, 'l'},
+        {"ws-queue",          required_argument, 0, 'q'},
+        {"probe-cpu",         required_argument, 0, 'c'},
+        {"help",              no_argument,       0, 'h'},
         {0, 0, 0, 0}
     };
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "p:h", long_options, NULL)) != -1) {
+    while ((opt = getopt_long(argc, argv, "p:e:td:r:b:z:m:l:q:c:h", long_options, NULL)) != -1) {
         switch (opt) {
             case 'p':
                 if (strcmp(optarg, "tcp") == 0) {
@@ -65,6 +106,90 @@ int main(int argc, char *argv[]) {
                     return 1;
                 }
                 break;
+            case 'e':
+                if (strcmp(optarg, "poll") == 0) {
+                    probe_engine = PROBE_ENGINE_POLL;
+                } else if (strcmp(optarg, "uring") == 0) {
+                    probe_engine = PROBE_ENGINE_URING;
+                } else {
+                    fprintf(stderr, "Unknown probe engine: %s\n", optarg);
+                    fprintf(stderr, "Valid engines: poll, uring\n");
+                    return 1;
+                }
+                break;
+            case 't':
+                kernel_timestamps = true;
+                break;
+            case 'd':
+                dns_server = optarg;
+                break;
+            case 'r': {
+                char *end;
+                history_hours = strtol(optarg, &end, 10);
+                if (*end != '\0' || history_hours < 0 || history_hours > 24L * 365 * 10) {
+                    fprintf(stderr, "Invalid history hours: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'b': {
+                char *end;
+                ws_batch_ms = strtol(optarg, &end, 10);
+                if (*end != '\0' || ws_batch_ms < 0 || ws_batch_ms > MAX_WS_BATCH_MS) {
+                    fprintf(stderr, "Invalid WebSocket batch interval: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'z':
+                if (strcmp(optarg, "shared") == 0) {
+                    ws_deflate = WS_DEFLATE_SHARED;
+                } else if (strcmp(optarg, "context") == 0) {
+                    ws_deflate = WS_DEFLATE_CONTEXT;
+                } else if (strcmp(optarg, "off") == 0) {
+                    ws_deflate = WS_DEFLATE_OFF;
+                } else {
+                    fprintf(stderr, "Unknown WebSocket compression: %s\n", optarg);
+                    fprintf(stderr, "Valid modes: shared, context, off\n");
+                    return 1;
+                }
+                break;
+            case 'm': {
+                char *end;
+                ws_deflate_min = strtol(optarg, &end, 10);
+                if (*end != '\0' || ws_deflate_min < 0 || ws_deflate_min > 1024L * 1024 * 1024) {
+                    fprintf(stderr, "Invalid WebSocket compression threshold: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'l': {
+                char *end;
+                ws_replay_kb = strtol(optarg, &end, 10);
+                if (*end != '\0' || ws_replay_kb < 0 || ws_replay_kb > MAX_WS_REPLAY_KB) {
+                    fprintf(stderr, "Invalid WebSocket replay log size: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'q': {
+                char *end;
+                ws_queue_kb = strtol(optarg, &end, 10);
+                if (*end != '\0' || ws_queue_kb < 0 || ws_queue_kb > MAX_WS_QUEUE_KB) {
+                    fprintf(stderr, "Invalid WebSocket queue limit: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
+            case 'c': {
+                char *end;
+                probe_cpu = strtol(optarg, &end, 10);
+                if (*end != '\0' || probe_cpu < 0 || probe_cpu > 4095) {
+                    fprintf(stderr, "Invalid probe CPU: %s\n", optarg);
+                    return 1;
+                }
+                break;
+            }
             case 'h':
                 print_usage(argv[0]);
                 return 0;
@@ -87,12 +212,20 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     printf("Data directory: %s\n", data_dir);
-    free(data_dir);
 
     // Initialize configuration
     config_t config;
     config_init(&config);
     config.probe_type = probe_type;
+    config.probe_engine = probe_engine;
+    config.kernel_timestamps = kernel_timestamps;
+    config.history_hours = (uint32_t)history_hours;
+    config.ws_batch_ms = (uint32_t)ws_batch_ms;
+    config.ws_deflate = ws_deflate;
+    config.ws_deflate_min = (uint32_t)ws_deflate_min;
+    config.ws_replay_kb = (uint32_t)ws_replay_kb;
+    config.ws_queue_kb = (uint32_t)ws_queue_kb;
+    config.probe_cpu = (int)probe_cpu;
 
     // Print probe mode
     if (probe_type == PROBE_TYPE_ICMP) {
@@ -117,43 +250,123 @@ int main(int argc, char *argv[]) {
     }
     printf("\n");
 
+    // Start the resolver so probes never block on DNS
+    if (dns_init(dns_server) != 0) {
+        fprintf(stderr, "Failed to initialize DNS resolver\n");
+        free(data_dir);
+        config_free(&config);
+        return 1;
+    }
+
+    // Open the sample history (runs without one if it can't)
+    sample_store_t *store = NULL;
+    if (config.history_hours > 0) {
+        store = sample_store_open(data_dir, (uint64_t)config.history_hours * 3600000ULL);
+        if (store == NULL) {
+            fprintf(stderr, "Failed to open sample store, history disabled\n");
+        }
+    }
+    free(data_dir);
+
+    // The probe thread gets a config of its own; the server's is changed
+    // over HTTP and the changes sent on as commands
+    config_t probe_config;
+    if (config_copy(&probe_config, &config) != 0) {
+        fprintf(stderr, "Failed to copy config\n");
+        sample_store_close(store);
+        dns_shutdown();
+        config_free(&config);
+        return 1;
+    }
+
     // Initialize scheduler
     scheduler_t scheduler;
-    if (scheduler_init(&scheduler, &config) != 0) {
+    if (scheduler_init(&scheduler, &probe_config) != 0) {
         fprintf(stderr, "Failed to initialize scheduler\n");
+        sample_store_close(store);
+        dns_shutdown();
+        config_free(&probe_config);
+        config_free(&config);
+        return 1;
+    }
+    scheduler_set_store(&scheduler, store);
+
+    // Probe thread: the scheduler with a reactor of its own
+    probe_thread_t probes;
+    if (probe_thread_init(&probes, &scheduler, config.probe_cpu) != 0) {
+        fprintf(stderr, "Failed to initialize probe thread\n");
+        scheduler_free(&scheduler);
+        sample_store_close(store);
+        dns_shutdown();
+        config_free(&probe_config);
+        config_free(&config);
         return 1;
     }
 
     // Initialize server
     server_t server;
-    if (server_init(&server, &config, &scheduler) != 0) {
+    if (server_init(&server, &config, store) != 0) {
         fprintf(stderr, "Failed to initialize server\n");
+        probe_thread_free(&probes);
         scheduler_free(&scheduler);
+        sample_store_close(store);
+        dns_shutdown();
+        config_free(&probe_config);
+        config_free(&config);
         return 1;
     }
 
-    // Wire up callbacks
-    server_setup_callbacks(&server, &scheduler);
+    // Event reactor for the server: Mongoose's epoll set and batch deadlines
+    reactor_t reactor;
+    bool use_reactor = false;
+    if (reactor_init(&reactor) == 0) {
+        if (server_attach_reactor(&server, &reactor) == 0) {
+            use_reactor = true;
+        } else {
+            reactor_free(&reactor);
+        }
+    }
+    printf("Event loop: %s\n", probes.use_reactor && use_reactor ? "epoll reactor" : "polling");
 
     printf("\nStarting probes...\n\n");
+    if (server_start_probes(&server, &probes) != 0) {
+        fprintf(stderr, "Failed to start probe thread\n");
+        g_running = 0;
+    }
 
-    // Main event loop
+    // Server loop: probe updates arrive as Mongoose wakeups and are sent
+    // to clients as one batch per wakeup (or per ws_batch_ms)
     while (g_running) {
-        // Run scheduler tick
-        int timeout = scheduler_tick(&scheduler);
-
-        // Poll server with appropriate timeout.
-        // Cap at 2ms for accurate RTT measurement - longer timeouts add latency
-        // since we only detect completed TCP connects on the next tick.
-        int poll_timeout = timeout < 2 ? timeout : 2;
-        server_poll(&server, poll_timeout);
+        int timeout = 1000;
+        int batch_due = server_flush_batch(&server);
+        if (batch_due >= 0 && batch_due < timeout) {
+            timeout = batch_due;
+        }
+
+        if (use_reactor) {
+            // Flush frames queued by the batch, then sleep until a socket
+            // (or the probe thread's wakeup) is ready or the batch is due
+            server_poll(&server, 0);
+            reactor_wait(&reactor, timeout);
+        } else {
+            server_poll(&server, timeout);
+        }
     }
 
     printf("\nShutting down...\n");
 
-    // Cleanup
+    // Cleanup: the probe thread first, it wakes the server
+    probe_thread_stop(&probes);
+    probe_thread_free(&probes);
+    if (use_reactor) {
+        reactor_free(&reactor);
+    }
     server_free(&server);
     scheduler_free(&scheduler);
+    sample_store_close(store);
+    dns_shutdown();
+    config_free(&probe_config);
+    config_free(&config);
 
     printf("Goodbye!\n");
     return 0;
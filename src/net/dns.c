@@ -1,10 +1,77 @@
 #define _POSIX_C_SOURCE 200809L
 
 #include "net/dns.h"
+#include "platform/platform.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <arpa/inet.h>
+
+#define DNS_WORKERS         2       // Resolver threads
+#define DNS_MAX_SERVERS     3       // Nameservers used (like resolv.conf)
+#define DNS_TIMEOUT_MS      1000    // Per query attempt
+#define DNS_ATTEMPTS        2       // Rounds over all nameservers
+#define DNS_PORT            53
+#define DNS_PACKET_MAX      512     // Classic UDP message limit
+#define DNS_HEADER_LEN      12
+#define DNS_INITIAL_SLOTS   64
+
+#define DNS_TYPE_A          1
+#define DNS_TYPE_CNAME      5
+#define DNS_TYPE_SOA        6
+#define DNS_CLASS_IN        1
+#define DNS_RCODE_NXDOMAIN  3
+
+typedef enum {
+    ENTRY_EMPTY,        // Unused hash slot
+    ENTRY_PENDING,      // No answer yet
+    ENTRY_VALID,        // Address cached
+    ENTRY_NEGATIVE      // Name does not resolve
+} entry_state_t;
+
+typedef struct {
+    char host[DNS_MAX_NAME];
+    entry_state_t state;
+    struct in_addr addr;
+    uint64_t expires_ms;    // Monotonic time the answer stops being used
+    uint64_t refresh_ms;    // Monotonic time to start a background refresh
+    bool resolving;         // Job queued or running
+    bool stale;             // Serving addr past its TTL while resolution fails
+} dns_entry_t;
+
+typedef struct dns_job {
+    struct dns_job *next;
+    char host[DNS_MAX_NAME];
+} dns_job_t;
+
+// Outcome of one resolution
+typedef enum {
+    RESOLVE_OK,
+    RESOLVE_NEGATIVE,   // Authoritative "no such name / no A record"
+    RESOLVE_FAILED      // Timeout, server failure or malformed answer
+} resolve_result_t;
+
+static struct {
+    bool running;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t workers[DNS_WORKERS];
+    int worker_count;
+    dns_entry_t *entries;   // Open-addressed by host (linear probing)
+    size_t capacity;        // Slots, power of two
+    size_t count;           // Used slots
+    dns_job_t *queue_head;
+    dns_job_t *queue_tail;
+    struct sockaddr_in servers[DNS_MAX_SERVERS];
+    int server_count;
+} g_dns;
 
 struct addrinfo *dns_resolve(const char *host, uint16_t port) {
     if (host == NULL) {
@@ -28,3 +95,594 @@ struct addrinfo *dns_resolve(const char *host, uint16_t port) {
 
     return result;
 }
+
+/*
+ * Wire format
+ */
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static uint16_t get_u16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Build an A query for host. Returns message length, -1 if the name is invalid.
+static int build_query(const char *host, uint16_t id, uint8_t *buf, size_t size) {
+    memset(buf, 0, DNS_HEADER_LEN);
+    put_u16(buf, id);
+    put_u16(buf + 2, 0x0100);   // Standard query, recursion desired
+    put_u16(buf + 4, 1);        // One question
+
+    size_t pos = DNS_HEADER_LEN;
+    const char *label = host;
+
+    while (*label != '\0') {
+        const char *dot = strchr(label, '.');
+        size_t len = dot != NULL ? (size_t)(dot - label) : strlen(label);
+        if (len == 0 || len > 63 || pos + len + 1 + 5 > size) {
+            return -1;
+        }
+        buf[pos++] = (uint8_t)len;
+        memcpy(buf + pos, label, len);
+        pos += len;
+        if (dot == NULL) {
+            break;
+        }
+        label = dot + 1;    // A trailing dot ends the loop on '\0'
+    }
+
+    if (pos == DNS_HEADER_LEN || pos - DNS_HEADER_LEN > 254) {
+        return -1;
+    }
+
+    buf[pos++] = 0;     // Root label
+    put_u16(buf + pos, DNS_TYPE_A);
+    put_u16(buf + pos + 2, DNS_CLASS_IN);
+    return (int)(pos + 4);
+}
+
+// Advance past a (possibly compressed) name. Returns false if malformed.
+static bool skip_name(const uint8_t *buf, size_t len, size_t *pos) {
+    while (*pos < len) {
+        uint8_t c = buf[*pos];
+        if ((c & 0xC0) == 0xC0) {
+            *pos += 2;
+            return *pos <= len;
+        }
+        if (c & 0xC0) {
+            return false;
+        }
+        *pos += (size_t)c + 1;
+        if (c == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse a response to query id. The TTL of a positive answer is the lowest
+// along the CNAME chain; a negative answer uses min(SOA TTL, SOA minimum).
+static resolve_result_t parse_response(const uint8_t *buf, size_t len, uint16_t id,
+                                       struct in_addr *addr, uint32_t *ttl) {
+    if (len < DNS_HEADER_LEN || get_u16(buf) != id) {
+        return RESOLVE_FAILED;
+    }
+
+    uint16_t flags = get_u16(buf + 2);
+    uint16_t qdcount = get_u16(buf + 4);
+    uint16_t ancount = get_u16(buf + 6);
+    uint16_t nscount = get_u16(buf + 8);
+    int rcode = flags & 0x000F;
+
+    if (!(flags & 0x8000) || (rcode != 0 && rcode != DNS_RCODE_NXDOMAIN)) {
+        return RESOLVE_FAILED;  // Not a response, or SERVFAIL/REFUSED/...
+    }
+
+    size_t pos = DNS_HEADER_LEN;
+    for (uint16_t i = 0; i < qdcount; i++) {
+        if (!skip_name(buf, len, &pos) || pos + 4 > len) {
+            return RESOLVE_FAILED;
+        }
+        pos += 4;
+    }
+
+    // Answer section
+    uint32_t min_ttl = UINT32_MAX;
+    bool found = false;
+    for (uint16_t i = 0; i < ancount; i++) {
+        if (!skip_name(buf, len, &pos) || pos + 10 > len) {
+            return RESOLVE_FAILED;
+        }
+        uint16_t type = get_u16(buf + pos);
+        uint16_t rclass = get_u16(buf + pos + 2);
+        uint32_t rr_ttl = get_u32(buf + pos + 4);
+        uint16_t rdlen = get_u16(buf + pos + 8);
+        pos += 10;
+        if (pos + rdlen > len) {
+            return RESOLVE_FAILED;
+        }
+
+        if (rclass == DNS_CLASS_IN && (type == DNS_TYPE_A || type == DNS_TYPE_CNAME)) {
+            if (rr_ttl < min_ttl) {
+                min_ttl = rr_ttl;
+            }
+            if (type == DNS_TYPE_A && rdlen == 4 && !found) {
+                memcpy(&addr->s_addr, buf + pos, 4);
+                found = true;
+            }
+        }
+        pos += rdlen;
+    }
+
+    if (found) {
+        *ttl = min_ttl;
+        return RESOLVE_OK;
+    }
+
+    // NXDOMAIN or NODATA: look for the SOA in the authority section
+    *ttl = DNS_NEGATIVE_TTL_S;
+    for (uint16_t i = 0; i < nscount; i++) {
+        if (!skip_name(buf, len, &pos) || pos + 10 > len) {
+            break;
+        }
+        uint16_t type = get_u16(buf + pos);
+        uint32_t rr_ttl = get_u32(buf + pos + 4);
+        uint16_t rdlen = get_u16(buf + pos + 8);
+        pos += 10;
+        if (pos + rdlen > len) {
+            break;
+        }
+
+        if (type == DNS_TYPE_SOA) {
+            size_t rd = pos;
+            if (skip_name(buf, len, &rd) && skip_name(buf, len, &rd) && rd + 20 <= len) {
+                uint32_t minimum = get_u32(buf + rd + 16);
+                *ttl = rr_ttl < minimum ? rr_ttl : minimum;
+            }
+            break;
+        }
+        pos += rdlen;
+    }
+
+    return RESOLVE_NEGATIVE;
+}
+
+/*
+ * Resolver threads
+ */
+
+// Ask one nameserver, waiting up to DNS_TIMEOUT_MS for the matching answer
+static resolve_result_t query_server(const struct sockaddr_in *server, const uint8_t *query,
+                                     size_t query_len, uint16_t id,
+                                     struct in_addr *addr, uint32_t *ttl) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        return RESOLVE_FAILED;
+    }
+
+    // Connected, so the kernel drops datagrams from anyone else
+    if (connect(sock, (const struct sockaddr *)server, sizeof(*server)) < 0 ||
+        send(sock, query, query_len, 0) != (ssize_t)query_len) {
+        close(sock);
+        return RESOLVE_FAILED;
+    }
+
+    resolve_result_t result = RESOLVE_FAILED;
+    uint64_t deadline = now_ms() + DNS_TIMEOUT_MS;
+
+    for (;;) {
+        uint64_t now = now_ms();
+        if (now >= deadline) {
+            break;
+        }
+
+        struct pollfd pfd = { .fd = sock, .events = POLLIN, .revents = 0 };
+        int ret = poll(&pfd, 1, (int)(deadline - now));
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+
+        uint8_t buf[DNS_PACKET_MAX];
+        ssize_t n = recv(sock, buf, sizeof(buf), 0);
+        if (n < 0) {
+            break;  // e.g. ICMP port unreachable
+        }
+        if (n < DNS_HEADER_LEN || get_u16(buf) != id) {
+            continue;   // Stale or spoofed - keep waiting
+        }
+
+        result = parse_response(buf, (size_t)n, id, addr, ttl);
+        break;
+    }
+
+    close(sock);
+    return result;
+}
+
+// Resolve host: DNS first for the TTL, then getaddrinfo() for names only
+// the system resolver knows about
+static resolve_result_t resolve_host(const char *host, unsigned int *seed,
+                                     struct in_addr *addr, uint32_t *ttl) {
+    resolve_result_t result = RESOLVE_FAILED;
+    uint8_t query[DNS_PACKET_MAX];
+    uint16_t id = (uint16_t)rand_r(seed);
+    int query_len = build_query(host, id, query, sizeof(query));
+
+    if (query_len < 0) {
+        result = RESOLVE_NEGATIVE;
+        *ttl = DNS_NEGATIVE_TTL_S;
+    }
+
+    for (int attempt = 0; query_len > 0 && attempt < DNS_ATTEMPTS; attempt++) {
+        for (int i = 0; i < g_dns.server_count; i++) {
+            result = query_server(&g_dns.servers[i], query, (size_t)query_len, id, addr, ttl);
+            if (result != RESOLVE_FAILED) {
+                break;
+            }
+        }
+        if (result != RESOLVE_FAILED) {
+            break;
+        }
+    }
+
+    if (result == RESOLVE_OK) {
+        return RESOLVE_OK;
+    }
+
+    struct addrinfo *ai = dns_resolve(host, 0);
+    if (ai != NULL) {
+        *addr = ((struct sockaddr_in *)ai->ai_addr)->sin_addr;
+        *ttl = DNS_DEFAULT_TTL_S;
+        freeaddrinfo(ai);
+        return RESOLVE_OK;
+    }
+
+    return result;
+}
+
+// FNV-1a
+static size_t hash_host(const char *host) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)host; *p != '\0'; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Slot holding host, or the empty slot where it belongs. Caller holds the lock.
+static dns_entry_t *find_slot(dns_entry_t *entries, size_t capacity, const char *host) {
+    size_t mask = capacity - 1;
+    for (size_t i = hash_host(host) & mask; ; i = (i + 1) & mask) {
+        dns_entry_t *e = &entries[i];
+        if (e->state == ENTRY_EMPTY || strcmp(e->host, host) == 0) {
+            return e;
+        }
+    }
+}
+
+// Double the table. Caller holds the lock.
+static int grow_table(void) {
+    size_t capacity = g_dns.capacity > 0 ? g_dns.capacity * 2 : DNS_INITIAL_SLOTS;
+    dns_entry_t *entries = calloc(capacity, sizeof(*entries));
+    if (entries == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < g_dns.capacity; i++) {
+        if (g_dns.entries[i].state != ENTRY_EMPTY) {
+            *find_slot(entries, capacity, g_dns.entries[i].host) = g_dns.entries[i];
+        }
+    }
+
+    free(g_dns.entries);
+    g_dns.entries = entries;
+    g_dns.capacity = capacity;
+    return 0;
+}
+
+// Hand host to a resolver thread. Caller holds the lock.
+static void queue_resolve(dns_entry_t *e) {
+    dns_job_t *job = malloc(sizeof(*job));
+    if (job == NULL) {
+        return;     // Retried on a later lookup
+    }
+
+    memcpy(job->host, e->host, sizeof(job->host));
+    job->next = NULL;
+    if (g_dns.queue_tail != NULL) {
+        g_dns.queue_tail->next = job;
+    } else {
+        g_dns.queue_head = job;
+    }
+    g_dns.queue_tail = job;
+    e->resolving = true;
+    pthread_cond_signal(&g_dns.cond);
+}
+
+// Store a resolution outcome. Caller holds the lock.
+static void apply_result(dns_entry_t *e, resolve_result_t result,
+                         struct in_addr addr, uint32_t ttl) {
+    uint64_t now = now_ms();
+
+    if (ttl < 1) {
+        ttl = 1;
+    } else if (ttl > DNS_MAX_TTL_S) {
+        ttl = DNS_MAX_TTL_S;
+    }
+
+    switch (result) {
+        case RESOLVE_OK:
+            e->state = ENTRY_VALID;
+            e->stale = false;
+            e->addr = addr;
+            e->expires_ms = now + (uint64_t)ttl * 1000ULL;
+            e->refresh_ms = now + (uint64_t)ttl * 10ULL * DNS_REFRESH_PCT;
+            break;
+
+        case RESOLVE_NEGATIVE:
+            e->state = ENTRY_NEGATIVE;
+            e->stale = false;
+            e->expires_ms = now + (uint64_t)ttl * 1000ULL;
+            e->refresh_ms = e->expires_ms;
+            break;
+
+        case RESOLVE_FAILED:
+            // Keep serving a known address while the servers are unreachable
+            if (e->state == ENTRY_VALID) {
+                e->stale = true;
+            } else {
+                e->state = ENTRY_NEGATIVE;
+                e->expires_ms = now + DNS_FAILURE_TTL_S * 1000ULL;
+            }
+            e->refresh_ms = now + DNS_FAILURE_TTL_S * 1000ULL;
+            break;
+    }
+
+    e->resolving = false;
+}
+
+static void *resolver_main(void *arg) {
+    unsigned int seed = (unsigned int)(now_ns() ^ (uintptr_t)arg);
+
+    pthread_mutex_lock(&g_dns.lock);
+    for (;;) {
+        while (g_dns.running && g_dns.queue_head == NULL) {
+            pthread_cond_wait(&g_dns.cond, &g_dns.lock);
+        }
+        if (!g_dns.running) {
+            break;
+        }
+
+        dns_job_t *job = g_dns.queue_head;
+        g_dns.queue_head = job->next;
+        if (g_dns.queue_head == NULL) {
+            g_dns.queue_tail = NULL;
+        }
+        pthread_mutex_unlock(&g_dns.lock);
+
+        struct in_addr addr = { 0 };
+        uint32_t ttl = 0;
+        resolve_result_t result = resolve_host(job->host, &seed, &addr, &ttl);
+
+        pthread_mutex_lock(&g_dns.lock);
+        dns_entry_t *e = find_slot(g_dns.entries, g_dns.capacity, job->host);
+        if (e->state != ENTRY_EMPTY) {
+            apply_result(e, result, addr, ttl);
+        }
+        free(job);
+    }
+    pthread_mutex_unlock(&g_dns.lock);
+
+    return NULL;
+}
+
+// Parse "ip[:port]" into a nameserver address
+static int parse_server(const char *spec, struct sockaddr_in *out) {
+    char ip[INET_ADDRSTRLEN];
+    const char *colon = strchr(spec, ':');
+    size_t len = colon != NULL ? (size_t)(colon - spec) : strlen(spec);
+    if (len == 0 || len >= sizeof(ip)) {
+        return -1;
+    }
+    memcpy(ip, spec, len);
+    ip[len] = '\0';
+
+    memset(out, 0, sizeof(*out));
+    out->sin_family = AF_INET;
+    out->sin_port = htons(DNS_PORT);
+    if (inet_pton(AF_INET, ip, &out->sin_addr) != 1) {
+        return -1;
+    }
+    if (colon != NULL) {
+        long port = strtol(colon + 1, NULL, 10);
+        if (port <= 0 || port > 65535) {
+            return -1;
+        }
+        out->sin_port = htons((uint16_t)port);
+    }
+    return 0;
+}
+
+// IPv4 nameservers from /etc/resolv.conf
+static void load_resolv_conf(void) {
+    FILE *f = fopen("/etc/resolv.conf", "r");
+    if (f == NULL) {
+        return;
+    }
+
+    char line[256];
+    while (g_dns.server_count < DNS_MAX_SERVERS && fgets(line, sizeof(line), f) != NULL) {
+        char addr[64];
+        if (sscanf(line, " nameserver %63s", addr) == 1 && strchr(addr, ':') == NULL &&
+            parse_server(addr, &g_dns.servers[g_dns.server_count]) == 0) {
+            g_dns.server_count++;
+        }
+    }
+
+    fclose(f);
+}
+
+int dns_init(const char *server) {
+    if (g_dns.running) {
+        return 0;
+    }
+
+    memset(&g_dns, 0, sizeof(g_dns));
+
+    if (server != NULL) {
+        if (parse_server(server, &g_dns.servers[0]) != 0) {
+            fprintf(stderr, "[dns] Invalid server address: %s\n", server);
+            return -1;
+        }
+        g_dns.server_count = 1;
+    } else {
+        load_resolv_conf();
+    }
+
+    if (pthread_mutex_init(&g_dns.lock, NULL) != 0) {
+        return -1;
+    }
+    if (pthread_cond_init(&g_dns.cond, NULL) != 0) {
+        pthread_mutex_destroy(&g_dns.lock);
+        return -1;
+    }
+    if (grow_table() != 0) {
+        pthread_cond_destroy(&g_dns.cond);
+        pthread_mutex_destroy(&g_dns.lock);
+        return -1;
+    }
+
+    g_dns.running = true;
+    for (int i = 0; i < DNS_WORKERS; i++) {
+        if (pthread_create(&g_dns.workers[i], NULL, resolver_main, (void *)(uintptr_t)i) != 0) {
+            break;
+        }
+        g_dns.worker_count++;
+    }
+
+    if (g_dns.worker_count == 0) {
+        g_dns.running = false;
+        free(g_dns.entries);
+        g_dns.entries = NULL;
+        pthread_cond_destroy(&g_dns.cond);
+        pthread_mutex_destroy(&g_dns.lock);
+        return -1;
+    }
+
+    printf("[dns] Async resolver: %d thread(s), %d nameserver(s)\n",
+           g_dns.worker_count, g_dns.server_count);
+    return 0;
+}
+
+void dns_shutdown(void) {
+    if (!g_dns.running) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_dns.lock);
+    g_dns.running = false;
+    pthread_cond_broadcast(&g_dns.cond);
+    pthread_mutex_unlock(&g_dns.lock);
+
+    for (int i = 0; i < g_dns.worker_count; i++) {
+        pthread_join(g_dns.workers[i], NULL);
+    }
+
+    while (g_dns.queue_head != NULL) {
+        dns_job_t *next = g_dns.queue_head->next;
+        free(g_dns.queue_head);
+        g_dns.queue_head = next;
+    }
+
+    free(g_dns.entries);
+    pthread_cond_destroy(&g_dns.cond);
+    pthread_mutex_destroy(&g_dns.lock);
+    memset(&g_dns, 0, sizeof(g_dns));
+}
+
+dns_status_t dns_lookup(const char *host, uint16_t port, struct sockaddr_in *addr) {
+    if (host == NULL || addr == NULL) {
+        return DNS_FAILED;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(port);
+
+    // Literal addresses need no resolution
+    if (inet_pton(AF_INET, host, &addr->sin_addr) == 1) {
+        return DNS_OK;
+    }
+
+    if (!g_dns.running) {
+        struct addrinfo *ai = dns_resolve(host, port);
+        if (ai == NULL) {
+            return DNS_FAILED;
+        }
+        *addr = *(struct sockaddr_in *)ai->ai_addr;
+        freeaddrinfo(ai);
+        return DNS_OK;
+    }
+
+    if (strlen(host) >= DNS_MAX_NAME) {
+        return DNS_FAILED;
+    }
+
+    dns_status_t status;
+    uint64_t now = now_ms();
+
+    pthread_mutex_lock(&g_dns.lock);
+
+    // Keep the table at most half full
+    if ((g_dns.count + 1) * 2 > g_dns.capacity && grow_table() != 0) {
+        pthread_mutex_unlock(&g_dns.lock);
+        return DNS_FAILED;
+    }
+
+    dns_entry_t *e = find_slot(g_dns.entries, g_dns.capacity, host);
+    if (e->state == ENTRY_EMPTY) {
+        snprintf(e->host, sizeof(e->host), "%s", host);
+        e->state = ENTRY_PENDING;
+        g_dns.count++;
+    }
+
+    switch (e->state) {
+        case ENTRY_VALID:
+            // Past its TTL, the address is still served while a refresh is
+            // in flight (it can take DNS_ATTEMPTS timeouts) or failing
+            if (now < e->expires_ms || e->resolving || e->stale) {
+                addr->sin_addr = e->addr;
+                status = DNS_OK;
+            } else {
+                status = DNS_PENDING;
+            }
+            break;
+
+        case ENTRY_NEGATIVE:
+            status = now < e->expires_ms ? DNS_FAILED : DNS_PENDING;
+            break;
+
+        default:
+            status = DNS_PENDING;
+            break;
+    }
+
+    // Refresh ahead of expiry, off this thread
+    if (!e->resolving && (e->state == ENTRY_PENDING || now >= e->refresh_ms)) {
+        queue_resolve(e);
+    }
+
+    pthread_mutex_unlock(&g_dns.lock);
+    return status;
+}
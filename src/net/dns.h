@@ -2,14 +2,52 @@
 #define NETPULSE_DNS_H
 
 #include <netdb.h>
+#include <netinet/in.h>
 #include <stdint.h>
 
 /*
- * DNS resolution wrapper using getaddrinfo()
+ * DNS resolution
+ *
+ * dns_lookup() is the non-blocking path used by probes. It answers from a
+ * per-host cache and hands misses and refreshes to background resolver
+ * threads. The resolver queries the nameservers over UDP itself so answers
+ * carry their TTLs, both positive and negative (RFC 2308). Entries are
+ * refreshed in the background once DNS_REFRESH_PCT of the TTL has passed, so
+ * a name that is probed regularly never expires. While the servers fail,
+ * a known address keeps being served and the name is retried every
+ * DNS_FAILURE_TTL_S. Names DNS cannot answer
+ * (e.g. /etc/hosts entries, search domains) fall back to getaddrinfo() with
+ * DNS_DEFAULT_TTL_S.
+ *
+ * dns_resolve() is the blocking getaddrinfo() wrapper.
  */
 
-// Resolve hostname to sockaddr. Returns addrinfo that must be freed with freeaddrinfo().
-// Returns NULL on error.
+#define DNS_MAX_NAME        256     // Longest host name that is cached
+#define DNS_DEFAULT_TTL_S   60      // TTL for getaddrinfo() answers (no TTL available)
+#define DNS_NEGATIVE_TTL_S  30      // Negative TTL when the answer has no SOA
+#define DNS_FAILURE_TTL_S   5       // Retry interval after timeouts or server failure
+#define DNS_MAX_TTL_S       86400   // TTLs are capped at one day
+#define DNS_REFRESH_PCT     80      // Refresh once this much of the TTL has passed
+
+typedef enum {
+    DNS_OK,         // Address available
+    DNS_PENDING,    // Resolution in progress, try again shortly
+    DNS_FAILED      // Name does not resolve (negatively cached)
+} dns_status_t;
+
+// Start the resolver threads. server is "ip[:port]", or NULL to use the
+// nameservers from /etc/resolv.conf. Returns 0 on success, -1 on error.
+int dns_init(const char *server);
+
+// Stop the resolver threads and drop the cache
+void dns_shutdown(void);
+
+// Non-blocking cached lookup of an IPv4 address. On DNS_OK, *addr holds
+// the address and port. Before dns_init() this resolves synchronously.
+dns_status_t dns_lookup(const char *host, uint16_t port, struct sockaddr_in *addr);
+
+// Resolve hostname to sockaddr (blocking). Returns addrinfo that must be freed
+// with freeaddrinfo(). Returns NULL on error.
 struct addrinfo *dns_resolve(const char *host, uint16_t port);
 
 #endif // NETPULSE_DNS_H
@@ -12,12 +12,28 @@
  * On macOS: Stub implementation that returns "not available"
  */
 
+#define ICMP_BATCH_MAX 64  // Echo Requests per sendmmsg / replies per recvmmsg
+
 typedef struct {
-    int sock;               // Raw socket fd (-1 if not initialized)
+    int sock;               // Raw socket fd (-1 if not initialized), non-blocking
     uint16_t identifier;    // ICMP identifier (typically PID)
     uint16_t sequence;      // Incrementing sequence number
+    int batch_count;        // Echo Requests queued by icmp_probe_queue()
+    uint16_t batch_seq[ICMP_BATCH_MAX];   // Queued sequence numbers
+    uint32_t batch_addr[ICMP_BATCH_MAX];  // Queued destinations (network byte order)
+    uint64_t *tx_stamps;    // Kernel send time per sequence (NULL unless timestamping)
 } icmp_probe_state_t;
 
+/*
+ * Echo Reply read by icmp_probe_recv()
+ */
+typedef struct {
+    uint16_t sequence;      // Sequence number echoed back
+    uint32_t addr;          // Source IPv4 address (network byte order)
+    uint64_t recv_ns;       // Monotonic time the reply was read
+    uint64_t kernel_rtt_ns; // RTT from kernel TX/RX timestamps (0 if unavailable)
+} icmp_reply_t;
+
 /*
  * Initialize ICMP probe state.
  *
@@ -35,6 +51,90 @@ int icmp_probe_init(icmp_probe_state_t *state);
  */
 void icmp_probe_cleanup(icmp_probe_state_t *state);
 
+/*
+ * Ask the kernel to timestamp Echo Requests as they leave and replies as
+ * they arrive (SO_TIMESTAMPING). Hardware timestamps are used when the NIC
+ * has them enabled for both directions, software timestamps otherwise.
+ * Replies then carry kernel_rtt_ns, which does not include time spent
+ * waiting for the daemon to run.
+ *
+ * Returns:
+ *   0   - Timestamping enabled
+ *  -1   - Not supported; replies keep kernel_rtt_ns = 0
+ */
+int icmp_probe_enable_timestamps(icmp_probe_state_t *state);
+
+/*
+ * Send an ICMP Echo Request without waiting for the reply.
+ *
+ * Parameters:
+ *   state    - Initialized ICMP probe state
+ *   host     - Target IP address (must be IPv4 dotted notation)
+ *   sequence - Receives the sequence number used
+ *   addr     - Receives the destination address (network byte order)
+ *
+ * Returns:
+ *   0   - Request sent
+ *  -1   - Invalid host or send error
+ */
+int icmp_probe_send(icmp_probe_state_t *state, const char *host,
+                    uint16_t *sequence, uint32_t *addr);
+
+/*
+ * Queue an ICMP Echo Request for the next icmp_probe_flush().
+ * Nothing is sent until the flush; at most ICMP_BATCH_MAX requests can be
+ * queued, so callers flush when icmp_probe_queued() reaches that.
+ *
+ * Parameters are as for icmp_probe_send().
+ *
+ * Returns:
+ *   0   - Request queued
+ *  -1   - Invalid host or queue full
+ */
+int icmp_probe_queue(icmp_probe_state_t *state, const char *host,
+                     uint16_t *sequence, uint32_t *addr);
+
+/*
+ * Send all queued Echo Requests with as few syscalls as possible
+ * (one sendmmsg on Linux) and empty the queue.
+ *
+ * Parameters:
+ *   state   - Initialized ICMP probe state
+ *   sent    - Optional, receives per-request success in queue order
+ *   sent_ns - Optional, receives the monotonic time the batch went out
+ *
+ * Returns the number of requests that were queued (0 if none).
+ */
+int icmp_probe_flush(icmp_probe_state_t *state, bool *sent, uint64_t *sent_ns);
+
+// Number of Echo Requests waiting for icmp_probe_flush()
+static inline int icmp_probe_queued(const icmp_probe_state_t *state) {
+    return state->batch_count;
+}
+
+/*
+ * Read the next pending Echo Reply carrying our identifier (non-blocking).
+ * Other ICMP traffic on the raw socket is skipped. Does not read receive
+ * timestamps, so kernel_rtt_ns stays 0; use icmp_probe_recv_batch() for that.
+ *
+ * Returns:
+ *   1   - Reply read into *reply
+ *   0   - No more replies pending
+ *  -1   - Socket error
+ */
+int icmp_probe_recv(icmp_probe_state_t *state, icmp_reply_t *reply);
+
+/*
+ * Read up to max pending Echo Replies carrying our identifier (non-blocking,
+ * one recvmmsg per ICMP_BATCH_MAX datagrams on Linux).
+ *
+ * Returns:
+ *   > 0 - Number of replies read into replies[]
+ *   0   - No more replies pending
+ *  -1   - Socket error
+ */
+int icmp_probe_recv_batch(icmp_probe_state_t *state, icmp_reply_t *replies, int max);
+
 /*
  * Send ICMP Echo Request and wait for reply.
  *
@@ -43,6 +143,10 @@ void icmp_probe_cleanup(icmp_probe_state_t *state);
  *   host       - Target IP address (must be IPv4 dotted notation)
  *   timeout_ms - Maximum time to wait for reply
  *
+ * Blocking convenience wrapper over icmp_probe_send/icmp_probe_recv; the
+ * scheduler uses the non-blocking pair. Replies to other sequences are
+ * discarded while waiting.
+ *
  * Returns:
  *   >= 0  - RTT in milliseconds (success)
  *   < 0   - Probe failed (timeout, unreachable, or error)
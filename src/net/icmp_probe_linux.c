@@ -5,6 +5,7 @@
  * Requires CAP_NET_RAW capability or root privileges.
  */
 
+#define _GNU_SOURCE  // sendmmsg, recvmmsg
 #include "net/icmp_probe.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -13,11 +14,28 @@
 #include <errno.h>
 #include <time.h>
 #include <poll.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <netinet/in.h>
 #include <netinet/ip_icmp.h>
 #include <arpa/inet.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+
+// Raw ICMP type filter (from <linux/icmp.h>, which clashes with <netinet/ip_icmp.h>)
+#ifndef ICMP_FILTER
+#define ICMP_FILTER 1
+#endif
+
+#define ICMP_RCVBUF_BYTES (1 << 20)  // Requested receive buffer (capped by rmem_max)
+#define ICMP_RECV_SLOT    256        // Per-datagram buffer in recvmmsg (IP + ICMP headers fit)
+#define ICMP_CTRL_SLOT    256        // Per-datagram control buffer (timestamps, extended error)
+#define ICMP_SEQ_COUNT    65536      // Distinct sequence numbers
+
+// Indexes into tx_stamps: two slots per sequence
+#define TX_STAMP_SW(seq)  ((size_t)(seq) * 2)
+#define TX_STAMP_HW(seq)  ((size_t)(seq) * 2 + 1)
 
 // ICMP packet structure
 typedef struct {
@@ -55,6 +73,150 @@ static uint16_t icmp_checksum(void *data, size_t len) {
     return (uint16_t)~sum;
 }
 
+static uint64_t timespec_ns(const struct timespec *ts) {
+    return (uint64_t)ts->tv_sec * 1000000000ULL + (uint64_t)ts->tv_nsec;
+}
+
+// Kernel timestamps from a message's control data, NULL if there are none
+static const struct scm_timestamping *find_timestamps(struct msghdr *msg) {
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(msg); c != NULL; c = CMSG_NXTHDR(msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_TIMESTAMPING) {
+            return (const struct scm_timestamping *)CMSG_DATA(c);
+        }
+    }
+    return NULL;
+}
+
+// Forget any send time left over from an earlier use of seq
+static void clear_tx_stamp(icmp_probe_state_t *state, uint16_t seq) {
+    if (state->tx_stamps != NULL) {
+        state->tx_stamps[TX_STAMP_SW(seq)] = 0;
+        state->tx_stamps[TX_STAMP_HW(seq)] = 0;
+    }
+}
+
+// Read send timestamps off the error queue. Each message echoes the sent
+// packet behind whatever link/IP headers the kernel kept, so the ICMP
+// header sits a fixed distance from the end.
+static void read_tx_stamps(icmp_probe_state_t *state) {
+    char bufs[ICMP_BATCH_MAX][ICMP_RECV_SLOT];
+    char ctls[ICMP_BATCH_MAX][ICMP_CTRL_SLOT];
+    struct iovec iovs[ICMP_BATCH_MAX];
+    struct mmsghdr msgs[ICMP_BATCH_MAX];
+
+    for (;;) {
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < ICMP_BATCH_MAX; i++) {
+            iovs[i].iov_base = bufs[i];
+            iovs[i].iov_len = sizeof(bufs[i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_control = ctls[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof(ctls[i]);
+        }
+
+        int ret = recvmmsg(state->sock, msgs, ICMP_BATCH_MAX, MSG_ERRQUEUE | MSG_DONTWAIT, NULL);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return;
+        }
+
+        for (int i = 0; i < ret; i++) {
+            size_t len = msgs[i].msg_len;
+            const struct scm_timestamping *tss = find_timestamps(&msgs[i].msg_hdr);
+            if (tss == NULL || len < sizeof(icmp_packet_t)) {
+                continue;
+            }
+
+            const struct icmphdr *hdr =
+                (const struct icmphdr *)(bufs[i] + len - sizeof(icmp_packet_t));
+            if (hdr->type != ICMP_ECHO || ntohs(hdr->un.echo.id) != state->identifier) {
+                continue;
+            }
+
+            uint16_t seq = ntohs(hdr->un.echo.sequence);
+            if (tss->ts[0].tv_sec != 0 || tss->ts[0].tv_nsec != 0) {
+                state->tx_stamps[TX_STAMP_SW(seq)] = timespec_ns(&tss->ts[0]);
+            }
+            if (tss->ts[2].tv_sec != 0 || tss->ts[2].tv_nsec != 0) {
+                state->tx_stamps[TX_STAMP_HW(seq)] = timespec_ns(&tss->ts[2]);
+            }
+        }
+
+        if (ret < ICMP_BATCH_MAX) {
+            return;
+        }
+    }
+}
+
+// RTT for a reply from its receive timestamps and the stored send time.
+// Hardware and software clocks are never mixed. Returns 0 if unknown.
+static uint64_t kernel_rtt(const icmp_probe_state_t *state, uint16_t seq,
+                           const struct scm_timestamping *rx) {
+    if (state->tx_stamps == NULL || rx == NULL) {
+        return 0;
+    }
+
+    uint64_t tx_hw = state->tx_stamps[TX_STAMP_HW(seq)];
+    uint64_t rx_hw = timespec_ns(&rx->ts[2]);
+    if (tx_hw != 0 && rx_hw > tx_hw) {
+        return rx_hw - tx_hw;
+    }
+
+    uint64_t tx_sw = state->tx_stamps[TX_STAMP_SW(seq)];
+    uint64_t rx_sw = timespec_ns(&rx->ts[0]);
+    if (tx_sw != 0 && rx_sw > tx_sw) {
+        return rx_sw - tx_sw;
+    }
+    return 0;
+}
+
+// Fill in an Echo Request for seq
+static void build_request(const icmp_probe_state_t *state, icmp_packet_t *packet, uint16_t seq) {
+    memset(packet, 0, sizeof(*packet));
+    packet->hdr.type = ICMP_ECHO;
+    packet->hdr.code = 0;
+    packet->hdr.un.echo.id = htons(state->identifier);
+    packet->hdr.un.echo.sequence = htons(seq);
+
+    // Fill payload with timestamp
+    uint64_t send_time = now_us();
+    memcpy(packet->data, &send_time, sizeof(send_time));
+
+    // Calculate checksum
+    packet->hdr.checksum = 0;
+    packet->hdr.checksum = icmp_checksum(packet, sizeof(*packet));
+}
+
+// Parse a received datagram. Returns false unless it is an Echo Reply for us.
+static bool parse_reply(const icmp_probe_state_t *state, const char *buf, size_t len,
+                        const struct sockaddr_in *from, uint64_t recv_ns,
+                        icmp_reply_t *reply) {
+    // Parse IP header to get to ICMP header
+    const struct iphdr *ip_hdr = (const struct iphdr *)buf;
+    size_t ip_hdr_len = (size_t)ip_hdr->ihl * 4;
+
+    if (len < sizeof(struct iphdr) || len < ip_hdr_len + sizeof(struct icmphdr)) {
+        return false;
+    }
+
+    const struct icmphdr *icmp_hdr = (const struct icmphdr *)(buf + ip_hdr_len);
+
+    // Skip anything that is not an Echo Reply for us
+    if (icmp_hdr->type != ICMP_ECHOREPLY ||
+        ntohs(icmp_hdr->un.echo.id) != state->identifier) {
+        return false;
+    }
+
+    reply->sequence = ntohs(icmp_hdr->un.echo.sequence);
+    reply->addr = from->sin_addr.s_addr;
+    reply->recv_ns = recv_ns;
+    reply->kernel_rtt_ns = 0;
+    return true;
+}
+
 int icmp_probe_init(icmp_probe_state_t *state) {
     if (state == NULL) {
         return -1;
@@ -63,6 +225,8 @@ int icmp_probe_init(icmp_probe_state_t *state) {
     state->sock = -1;
     state->identifier = (uint16_t)getpid();
     state->sequence = 0;
+    state->batch_count = 0;
+    state->tx_stamps = NULL;
 
     // Create raw socket for ICMP
     int sock = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
@@ -74,108 +238,333 @@ int icmp_probe_init(icmp_probe_state_t *state) {
         return -1;
     }
 
-    // Set receive timeout as backup (poll is primary timeout mechanism)
-    struct timeval tv;
-    tv.tv_sec = 5;
-    tv.tv_usec = 0;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    // Non-blocking: replies are drained when the reactor reports readability
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    // Only deliver Echo Replies to this socket (best effort)
+    uint32_t filter = ~(1U << ICMP_ECHOREPLY);
+    setsockopt(sock, SOL_RAW, ICMP_FILTER, &filter, sizeof(filter));
+
+    // One socket carries every target's replies; leave room for a burst
+    int rcvbuf = ICMP_RCVBUF_BYTES;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
 
     state->sock = sock;
     return 0;
 }
 
 void icmp_probe_cleanup(icmp_probe_state_t *state) {
-    if (state != NULL && state->sock >= 0) {
+    if (state == NULL) {
+        return;
+    }
+    if (state->sock >= 0) {
         close(state->sock);
         state->sock = -1;
     }
+    free(state->tx_stamps);
+    state->tx_stamps = NULL;
 }
 
-double icmp_probe_ping(icmp_probe_state_t *state, const char *host, int timeout_ms) {
+int icmp_probe_enable_timestamps(icmp_probe_state_t *state) {
+    if (state == NULL || state->sock < 0) {
+        return -1;
+    }
+
+    int flags = SOF_TIMESTAMPING_SOFTWARE |
+                SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE |
+                SOF_TIMESTAMPING_RAW_HARDWARE |
+                SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RX_HARDWARE;
+    if (setsockopt(state->sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+        // Retry without asking for hardware reports
+        flags = SOF_TIMESTAMPING_SOFTWARE |
+                SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE;
+        if (setsockopt(state->sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+            return -1;
+        }
+    }
+
+    if (state->tx_stamps == NULL) {
+        state->tx_stamps = calloc((size_t)ICMP_SEQ_COUNT * 2, sizeof(uint64_t));
+        if (state->tx_stamps == NULL) {
+            flags = 0;
+            setsockopt(state->sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int icmp_probe_send(icmp_probe_state_t *state, const char *host,
+                    uint16_t *sequence, uint32_t *addr) {
     if (state == NULL || state->sock < 0 || host == NULL) {
-        return -1.0;
+        return -1;
     }
 
     // Resolve host
-    struct sockaddr_in addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
+    struct sockaddr_in dest;
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
 
-    if (inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
-        return -1.0;
+    if (inet_pton(AF_INET, host, &dest.sin_addr) != 1) {
+        return -1;
     }
 
-    // Build ICMP Echo Request
-    icmp_packet_t packet;
-    memset(&packet, 0, sizeof(packet));
-    packet.hdr.type = ICMP_ECHO;
-    packet.hdr.code = 0;
-    packet.hdr.un.echo.id = htons(state->identifier);
-    packet.hdr.un.echo.sequence = htons(state->sequence++);
+    uint16_t seq = state->sequence++;
+    clear_tx_stamp(state, seq);
 
-    // Fill payload with timestamp
-    uint64_t send_time = now_us();
-    memcpy(packet.data, &send_time, sizeof(send_time));
-
-    // Calculate checksum
-    packet.hdr.checksum = 0;
-    packet.hdr.checksum = icmp_checksum(&packet, sizeof(packet));
+    icmp_packet_t packet;
+    build_request(state, &packet, seq);
 
     // Send packet
     ssize_t sent = sendto(state->sock, &packet, sizeof(packet), 0,
-                          (struct sockaddr *)&addr, sizeof(addr));
+                          (struct sockaddr *)&dest, sizeof(dest));
     if (sent < 0) {
-        return -1.0;
+        return -1;
     }
 
-    // Wait for reply using poll
-    struct pollfd pfd;
-    pfd.fd = state->sock;
-    pfd.events = POLLIN;
+    if (sequence != NULL) {
+        *sequence = seq;
+    }
+    if (addr != NULL) {
+        *addr = dest.sin_addr.s_addr;
+    }
+    return 0;
+}
 
-    int ret = poll(&pfd, 1, timeout_ms);
-    if (ret <= 0) {
-        // Timeout or error
-        return -1.0;
+int icmp_probe_queue(icmp_probe_state_t *state, const char *host,
+                     uint16_t *sequence, uint32_t *addr) {
+    if (state == NULL || state->sock < 0 || host == NULL ||
+        state->batch_count >= ICMP_BATCH_MAX) {
+        return -1;
+    }
+
+    struct in_addr dest;
+    if (inet_pton(AF_INET, host, &dest) != 1) {
+        return -1;
     }
 
-    // Receive reply
-    char recv_buf[1024];
-    struct sockaddr_in from_addr;
-    socklen_t from_len = sizeof(from_addr);
+    uint16_t seq = state->sequence++;
+    clear_tx_stamp(state, seq);
+    state->batch_seq[state->batch_count] = seq;
+    state->batch_addr[state->batch_count] = dest.s_addr;
+    state->batch_count++;
 
-    ssize_t received = recvfrom(state->sock, recv_buf, sizeof(recv_buf), 0,
-                                 (struct sockaddr *)&from_addr, &from_len);
-    if (received < 0) {
-        return -1.0;
+    if (sequence != NULL) {
+        *sequence = seq;
+    }
+    if (addr != NULL) {
+        *addr = dest.s_addr;
     }
+    return 0;
+}
 
-    uint64_t recv_time = now_us();
+int icmp_probe_flush(icmp_probe_state_t *state, bool *sent, uint64_t *sent_ns) {
+    if (state == NULL || state->batch_count == 0) {
+        return 0;
+    }
 
-    // Parse IP header to get to ICMP header
-    struct iphdr *ip_hdr = (struct iphdr *)recv_buf;
-    int ip_hdr_len = ip_hdr->ihl * 4;
+    int count = state->batch_count;
+    state->batch_count = 0;
+
+    icmp_packet_t packets[ICMP_BATCH_MAX];
+    struct sockaddr_in dests[ICMP_BATCH_MAX];
+    struct iovec iovs[ICMP_BATCH_MAX];
+    struct mmsghdr msgs[ICMP_BATCH_MAX];
+    memset(dests, 0, sizeof(dests[0]) * (size_t)count);
+    memset(msgs, 0, sizeof(msgs[0]) * (size_t)count);
+
+    for (int i = 0; i < count; i++) {
+        build_request(state, &packets[i], state->batch_seq[i]);
+        dests[i].sin_family = AF_INET;
+        dests[i].sin_addr.s_addr = state->batch_addr[i];
+        iovs[i].iov_base = &packets[i];
+        iovs[i].iov_len = sizeof(packets[i]);
+        msgs[i].msg_hdr.msg_name = &dests[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(dests[i]);
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
 
-    if (received < ip_hdr_len + (ssize_t)sizeof(struct icmphdr)) {
-        return -1.0;
+    if (sent_ns != NULL) {
+        *sent_ns = now_us() * 1000ULL;
     }
 
-    struct icmphdr *icmp_hdr = (struct icmphdr *)(recv_buf + ip_hdr_len);
+    // sendmmsg stops at the first failing message; skip it and carry on
+    int done = 0;
+    while (done < count) {
+        int ret = sendmmsg(state->sock, &msgs[done], (unsigned int)(count - done), 0);
+        if (ret > 0) {
+            for (int i = done; i < done + ret; i++) {
+                if (sent != NULL) {
+                    sent[i] = true;
+                }
+            }
+            done += ret;
+        } else if (ret < 0 && errno == EINTR) {
+            continue;
+        } else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+            // Socket buffer full - the rest of the batch fails
+            for (int i = done; i < count; i++) {
+                if (sent != NULL) {
+                    sent[i] = false;
+                }
+            }
+            break;
+        } else {
+            if (sent != NULL) {
+                sent[done] = false;
+            }
+            done++;
+        }
+    }
 
-    // Verify it's an Echo Reply for us
-    if (icmp_hdr->type != ICMP_ECHOREPLY) {
-        return -1.0;
+    return count;
+}
+
+int icmp_probe_recv(icmp_probe_state_t *state, icmp_reply_t *reply) {
+    if (state == NULL || state->sock < 0 || reply == NULL) {
+        return -1;
+    }
+
+    // Also keeps the error queue from holding the socket readable
+    if (state->tx_stamps != NULL) {
+        read_tx_stamps(state);
     }
 
-    if (ntohs(icmp_hdr->un.echo.id) != state->identifier) {
-        // Not our reply, try again (simplified - just fail for now)
+    for (;;) {
+        char recv_buf[1024];
+        struct sockaddr_in from_addr;
+        socklen_t from_len = sizeof(from_addr);
+
+        ssize_t received = recvfrom(state->sock, recv_buf, sizeof(recv_buf), 0,
+                                     (struct sockaddr *)&from_addr, &from_len);
+        if (received < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        if (parse_reply(state, recv_buf, (size_t)received, &from_addr,
+                        now_us() * 1000ULL, reply)) {
+            return 1;
+        }
+    }
+}
+
+int icmp_probe_recv_batch(icmp_probe_state_t *state, icmp_reply_t *replies, int max) {
+    if (state == NULL || state->sock < 0 || replies == NULL || max <= 0) {
+        return -1;
+    }
+
+    int vlen = max < ICMP_BATCH_MAX ? max : ICMP_BATCH_MAX;
+
+    char bufs[ICMP_BATCH_MAX][ICMP_RECV_SLOT];
+    char ctls[ICMP_BATCH_MAX][ICMP_CTRL_SLOT];
+    struct sockaddr_in froms[ICMP_BATCH_MAX];
+    struct iovec iovs[ICMP_BATCH_MAX];
+    struct mmsghdr msgs[ICMP_BATCH_MAX];
+    bool stamped = state->tx_stamps != NULL;
+
+    // Send times first, so replies in this batch can be matched to them
+    if (stamped) {
+        read_tx_stamps(state);
+    }
+
+    for (;;) {
+        memset(msgs, 0, sizeof(msgs[0]) * (size_t)vlen);
+        for (int i = 0; i < vlen; i++) {
+            iovs[i].iov_base = bufs[i];
+            iovs[i].iov_len = sizeof(bufs[i]);
+            msgs[i].msg_hdr.msg_name = &froms[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(froms[i]);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            if (stamped) {
+                msgs[i].msg_hdr.msg_control = ctls[i];
+                msgs[i].msg_hdr.msg_controllen = sizeof(ctls[i]);
+            }
+        }
+
+        int ret = recvmmsg(state->sock, msgs, (unsigned int)vlen, MSG_DONTWAIT, NULL);
+        if (ret < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        // One clock read covers the whole batch
+        uint64_t recv_ns = now_us() * 1000ULL;
+        int count = 0;
+        for (int i = 0; i < ret; i++) {
+            if (parse_reply(state, bufs[i], msgs[i].msg_len, &froms[i], recv_ns,
+                            &replies[count])) {
+                if (stamped) {
+                    replies[count].kernel_rtt_ns = kernel_rtt(state, replies[count].sequence,
+                                                              find_timestamps(&msgs[i].msg_hdr));
+                }
+                count++;
+            }
+        }
+
+        // A short batch means the socket is drained
+        if (count > 0 || ret < vlen) {
+            return count;
+        }
+    }
+}
+
+double icmp_probe_ping(icmp_probe_state_t *state, const char *host, int timeout_ms) {
+    uint16_t seq;
+    uint32_t addr;
+
+    uint64_t send_time = now_us();
+    if (icmp_probe_send(state, host, &seq, &addr) != 0) {
         return -1.0;
     }
 
-    // Calculate RTT in milliseconds
-    double rtt_ms = (double)(recv_time - send_time) / 1000.0;
+    uint64_t deadline = send_time + (uint64_t)timeout_ms * 1000ULL;
 
-    return rtt_ms;
+    for (;;) {
+        icmp_reply_t reply;
+        int ret = icmp_probe_recv(state, &reply);
+        if (ret < 0) {
+            return -1.0;
+        }
+        if (ret == 1) {
+            if (reply.sequence == seq && reply.addr == addr) {
+                // Calculate RTT in milliseconds
+                return (double)(reply.recv_ns / 1000ULL - send_time) / 1000.0;
+            }
+            continue;  // Reply to another probe
+        }
+
+        // Wait for reply using poll
+        uint64_t now = now_us();
+        if (now >= deadline) {
+            return -1.0;
+        }
+
+        struct pollfd pfd;
+        pfd.fd = state->sock;
+        pfd.events = POLLIN;
+
+        int wait_ms = (int)((deadline - now + 999) / 1000);
+        if (poll(&pfd, 1, wait_ms) < 0 && errno != EINTR) {
+            return -1.0;
+        }
+    }
 }
 
 bool icmp_probe_available(void) {
@@ -13,6 +13,8 @@ int icmp_probe_init(icmp_probe_state_t *state) {
         state->sock = -1;
         state->identifier = 0;
         state->sequence = 0;
+        state->batch_count = 0;
+        state->tx_stamps = NULL;
     }
     return -1;  // Not available
 }
@@ -23,6 +25,49 @@ void icmp_probe_cleanup(icmp_probe_state_t *state) {
     }
 }
 
+int icmp_probe_enable_timestamps(icmp_probe_state_t *state) {
+    (void)state;
+    return -1;  // Not available
+}
+
+int icmp_probe_send(icmp_probe_state_t *state, const char *host,
+                    uint16_t *sequence, uint32_t *addr) {
+    (void)state;
+    (void)host;
+    (void)sequence;
+    (void)addr;
+    return -1;  // Not available
+}
+
+int icmp_probe_queue(icmp_probe_state_t *state, const char *host,
+                     uint16_t *sequence, uint32_t *addr) {
+    (void)state;
+    (void)host;
+    (void)sequence;
+    (void)addr;
+    return -1;  // Not available
+}
+
+int icmp_probe_flush(icmp_probe_state_t *state, bool *sent, uint64_t *sent_ns) {
+    (void)state;
+    (void)sent;
+    (void)sent_ns;
+    return 0;  // Nothing queued
+}
+
+int icmp_probe_recv(icmp_probe_state_t *state, icmp_reply_t *reply) {
+    (void)state;
+    (void)reply;
+    return 0;  // Nothing pending
+}
+
+int icmp_probe_recv_batch(icmp_probe_state_t *state, icmp_reply_t *replies, int max) {
+    (void)state;
+    (void)replies;
+    (void)max;
+    return 0;  // Nothing pending
+}
+
 double icmp_probe_ping(icmp_probe_state_t *state, const char *host, int timeout_ms) {
     (void)state;
     (void)host;
@@ -0,0 +1,102 @@
+#ifndef NETPULSE_PROBE_ENGINE_H
+#define NETPULSE_PROBE_ENGINE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <netinet/in.h>
+#include "net/tcp_probe.h"
+#include "platform/reactor.h"
+
+/*
+ * Probe engine - runs TCP connect probes and reports their outcome
+ *
+ * poll:  one non-blocking socket per probe, watched through the reactor
+ *        (or scanned with poll() when there is no reactor). Portable.
+ * uring: socket, connect with a linked timeout, and close are submitted to
+ *        io_uring in batches, and completions are reaped from the shared ring.
+ *        Linux only, built unless IO_URING=0.
+ *
+ * A probe is identified by a small non-negative handle that stays valid
+ * until probe_engine_release(). Completions are delivered through the
+ * on_done callback from probe_engine_process() or a reactor handler, never
+ * from start/release.
+ */
+
+typedef struct probe_engine probe_engine_t;
+
+// Called once per probe when its connect resolves. sent_ns is when the
+// engine issued the connect (0 if it never did), so both engines time the
+// same SYN -> SYN-ACK interval however long the connect sat queued.
+typedef void (*probe_done_cb_t)(int handle, probe_result_t result, uint64_t sent_ns,
+                                uint64_t done_ns, void *ctx);
+
+typedef struct {
+    const char *name;
+
+    // Start a connect to addr that the engine gives up on after timeout_ms.
+    // Returns a handle, or -1 on error.
+    int (*start)(probe_engine_t *e, const struct sockaddr_in *addr, uint32_t timeout_ms);
+
+    // End a probe (in flight or completed) and free its socket and handle
+    void (*release)(probe_engine_t *e, int handle);
+
+    // Socket of a completed probe (for TCP_INFO), -1 if none
+    int (*socket_fd)(probe_engine_t *e, int handle);
+
+    // Move readiness watching to reactor (NULL = process() is called each tick)
+    void (*set_reactor)(probe_engine_t *e, reactor_t *reactor);
+
+    // Reap completions without blocking and submit follow-up work
+    void (*process)(probe_engine_t *e);
+
+    // Submit work queued by start/release
+    void (*flush)(probe_engine_t *e);
+
+    void (*destroy)(probe_engine_t *e);
+} probe_engine_ops_t;
+
+struct probe_engine {
+    const probe_engine_ops_t *ops;
+    probe_done_cb_t on_done;
+    void *ctx;
+    reactor_t *reactor;             // Reactor watching the engine (NULL = none)
+};
+
+// Portable engine. Returns NULL on allocation failure.
+probe_engine_t *probe_engine_poll_create(probe_done_cb_t on_done, void *ctx);
+
+// io_uring engine. Returns NULL if io_uring is not built in or not usable.
+probe_engine_t *probe_engine_uring_create(probe_done_cb_t on_done, void *ctx);
+
+static inline int probe_engine_start(probe_engine_t *e, const struct sockaddr_in *addr,
+                                     uint32_t timeout_ms) {
+    return e->ops->start(e, addr, timeout_ms);
+}
+
+static inline void probe_engine_release(probe_engine_t *e, int handle) {
+    e->ops->release(e, handle);
+}
+
+static inline int probe_engine_socket_fd(probe_engine_t *e, int handle) {
+    return e->ops->socket_fd(e, handle);
+}
+
+static inline void probe_engine_set_reactor(probe_engine_t *e, reactor_t *reactor) {
+    e->ops->set_reactor(e, reactor);
+}
+
+static inline void probe_engine_process(probe_engine_t *e) {
+    e->ops->process(e);
+}
+
+static inline void probe_engine_flush(probe_engine_t *e) {
+    e->ops->flush(e);
+}
+
+static inline void probe_engine_destroy(probe_engine_t *e) {
+    if (e != NULL) {
+        e->ops->destroy(e);
+    }
+}
+
+#endif // NETPULSE_PROBE_ENGINE_H
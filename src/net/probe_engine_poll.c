@@ -0,0 +1,208 @@
+/*
+ * Poll Probe Engine
+ *
+ * One non-blocking socket per probe; the handle is the socket fd. With a
+ * reactor the socket is watched for writability, otherwise process()
+ * checks every pending socket with poll().
+ */
+
+#include "net/probe_engine.h"
+#include "platform/platform.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    probe_engine_t base;
+    int *pending;           // Sockets whose connect has not resolved
+    size_t pending_count;
+    size_t pending_capacity;
+    int32_t *pending_pos;   // fd -> index in pending (-1 if not pending)
+    uint64_t *sent_ns;      // fd -> when its connect was issued
+    size_t pos_capacity;
+} poll_engine_t;
+
+static int track(poll_engine_t *pe, int fd, uint64_t sent_ns) {
+    if ((size_t)fd >= pe->pos_capacity) {
+        size_t cap = pe->pos_capacity > 0 ? pe->pos_capacity : 64;
+        while (cap <= (size_t)fd) {
+            cap *= 2;
+        }
+        int32_t *pos = realloc(pe->pending_pos, cap * sizeof(*pos));
+        if (pos == NULL) {
+            return -1;
+        }
+        for (size_t i = pe->pos_capacity; i < cap; i++) {
+            pos[i] = -1;
+        }
+        pe->pending_pos = pos;
+        uint64_t *sent = realloc(pe->sent_ns, cap * sizeof(*sent));
+        if (sent == NULL) {
+            return -1;
+        }
+        pe->sent_ns = sent;
+        pe->pos_capacity = cap;
+    }
+
+    if (pe->pending_count == pe->pending_capacity) {
+        size_t cap = pe->pending_capacity > 0 ? pe->pending_capacity * 2 : 64;
+        int *pending = realloc(pe->pending, cap * sizeof(*pending));
+        if (pending == NULL) {
+            return -1;
+        }
+        pe->pending = pending;
+        pe->pending_capacity = cap;
+    }
+
+    pe->pending_pos[fd] = (int32_t)pe->pending_count;
+    pe->pending[pe->pending_count++] = fd;
+    pe->sent_ns[fd] = sent_ns;
+    return 0;
+}
+
+static void untrack(poll_engine_t *pe, int fd) {
+    if ((size_t)fd >= pe->pos_capacity || pe->pending_pos[fd] < 0) {
+        return;
+    }
+
+    // Swap-remove
+    size_t i = (size_t)pe->pending_pos[fd];
+    int last = pe->pending[--pe->pending_count];
+    pe->pending[i] = last;
+    pe->pending_pos[last] = (int32_t)i;
+    pe->pending_pos[fd] = -1;
+}
+
+static void finish(poll_engine_t *pe, int fd, probe_result_t result, uint64_t done_ns) {
+    untrack(pe, fd);
+    if (pe->base.reactor != NULL) {
+        reactor_remove(pe->base.reactor, fd);
+    }
+    pe->base.on_done(fd, result, pe->sent_ns[fd], done_ns, pe->base.ctx);
+}
+
+// Reactor handler: connect resolved (writable or error)
+static void on_ready(int fd, unsigned events, void *ctx) {
+    poll_engine_t *pe = ctx;
+    (void)events;
+
+    // Time the probe from when the kernel woke us, not when we got here
+    finish(pe, fd, tcp_probe_result(fd), pe->base.reactor->wake_ns);
+}
+
+static int poll_start(probe_engine_t *e, const struct sockaddr_in *addr, uint32_t timeout_ms) {
+    poll_engine_t *pe = (poll_engine_t *)e;
+    (void)timeout_ms;   // The scheduler's deadline ends overdue probes
+
+    // connect() sends the SYN before returning, so stamp ahead of it
+    uint64_t sent_ns = now_ns();
+    int fd = tcp_probe_connect((const struct sockaddr *)addr, sizeof(*addr));
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (track(pe, fd, sent_ns) != 0 ||
+        (e->reactor != NULL && reactor_add(e->reactor, fd, REACTOR_EV_WRITE, on_ready, pe) != 0)) {
+        untrack(pe, fd);
+        tcp_probe_cleanup(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void poll_release(probe_engine_t *e, int handle) {
+    poll_engine_t *pe = (poll_engine_t *)e;
+
+    if (handle < 0) {
+        return;
+    }
+    if ((size_t)handle < pe->pos_capacity && pe->pending_pos[handle] >= 0) {
+        untrack(pe, handle);
+        if (e->reactor != NULL) {
+            reactor_remove(e->reactor, handle);
+        }
+    }
+    tcp_probe_cleanup(handle);
+}
+
+static int poll_socket_fd(probe_engine_t *e, int handle) {
+    (void)e;
+    return handle;
+}
+
+static void poll_set_reactor(probe_engine_t *e, reactor_t *reactor) {
+    poll_engine_t *pe = (poll_engine_t *)e;
+
+    // Move pending sockets over to the new reactor
+    for (size_t i = 0; i < pe->pending_count; i++) {
+        if (e->reactor != NULL) {
+            reactor_remove(e->reactor, pe->pending[i]);
+        }
+        if (reactor != NULL) {
+            reactor_add(reactor, pe->pending[i], REACTOR_EV_WRITE, on_ready, pe);
+        }
+    }
+    e->reactor = reactor;
+}
+
+static void poll_process(probe_engine_t *e) {
+    poll_engine_t *pe = (poll_engine_t *)e;
+
+    if (e->reactor != NULL) {
+        return;     // Completions arrive through on_ready
+    }
+
+    // finish() swap-removes, so walk backwards
+    for (size_t i = pe->pending_count; i-- > 0; ) {
+        if (i >= pe->pending_count) {
+            continue;   // A callback released more than one probe
+        }
+        int fd = pe->pending[i];
+        probe_result_t result = tcp_probe_check(fd);
+        if (result != PROBE_PENDING) {
+            finish(pe, fd, result, now_ns());
+        }
+    }
+}
+
+static void poll_flush(probe_engine_t *e) {
+    (void)e;    // Connects are issued directly
+}
+
+static void poll_destroy(probe_engine_t *e) {
+    poll_engine_t *pe = (poll_engine_t *)e;
+
+    while (pe->pending_count > 0) {
+        poll_release(e, pe->pending[pe->pending_count - 1]);
+    }
+    free(pe->pending);
+    free(pe->pending_pos);
+    free(pe->sent_ns);
+    free(pe);
+}
+
+static const probe_engine_ops_t poll_ops = {
+    .name = "poll",
+    .start = poll_start,
+    .release = poll_release,
+    .socket_fd = poll_socket_fd,
+    .set_reactor = poll_set_reactor,
+    .process = poll_process,
+    .flush = poll_flush,
+    .destroy = poll_destroy,
+};
+
+probe_engine_t *probe_engine_poll_create(probe_done_cb_t on_done, void *ctx) {
+    if (on_done == NULL) {
+        return NULL;
+    }
+
+    poll_engine_t *pe = calloc(1, sizeof(*pe));
+    if (pe == NULL) {
+        return NULL;
+    }
+
+    pe->base.ops = &poll_ops;
+    pe->base.on_done = on_done;
+    pe->base.ctx = ctx;
+    return &pe->base;
+}
@@ -0,0 +1,584 @@
+/*
+ * io_uring Probe Engine (Linux)
+ *
+ * Each probe is a slot. Its socket is created with IORING_OP_SOCKET; once
+ * that completes, IORING_OP_CONNECT is linked to an IORING_OP_LINK_TIMEOUT
+ * so the kernel gives up on its own, and the socket is finally closed
+ * with IORING_OP_CLOSE. Everything queued during a tick goes to the kernel
+ * in a single io_uring_enter(); completions are read straight off the
+ * shared CQ ring. An eventfd registered with the ring tells the reactor
+ * when completions are waiting.
+ *
+ * Talks to the kernel through the raw syscalls, so liburing is not needed.
+ */
+
+#define _GNU_SOURCE
+
+#include "net/probe_engine.h"
+#include "platform/platform.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <linux/io_uring.h>
+
+#define URING_SQ_ENTRIES    1024
+#define URING_CQ_ENTRIES    8192
+#define URING_MIN_TIMEOUT_NS 1000000ULL
+
+// user_data layout: generation (32) | slot (29) | op (3)
+#define OP_SOCKET   1
+#define OP_CONNECT  2
+#define OP_TIMEOUT  3
+#define OP_CLOSE    4
+#define OP_CANCEL   5
+#define OP_BITS     3
+#define OP_MASK     ((1u << OP_BITS) - 1)
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_SOCKET,        // Waiting for the socket
+    SLOT_CONNECTING,    // Connect (and its timeout) in flight
+    SLOT_DONE           // Outcome reported, waiting for release
+} slot_state_t;
+
+typedef struct {
+    int fd;                         // Socket (-1 until created)
+    uint32_t gen;                   // Bumped on free, guards against stale CQEs
+    slot_state_t state;
+    bool abandoned;                 // Released while an op was in flight
+    int32_t next_free;              // Free list link
+    uint64_t deadline_ns;           // Monotonic time the connect gives up
+    uint64_t sent_ns;               // Monotonic time the connect was submitted
+    struct sockaddr_in addr;
+    struct __kernel_timespec timeout;
+} uring_slot_t;
+
+typedef struct {
+    probe_engine_t base;
+    int ring_fd;
+    int event_fd;                   // Signalled when CQEs are posted
+
+    // Submission ring
+    void *sq_ptr;
+    size_t sq_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array, *sq_flags;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned sq_entries;
+    unsigned sqe_tail;              // Next SQE to fill
+    unsigned sqe_submitted;         // SQEs handed to the kernel
+
+    // Completion ring
+    void *cq_ptr;
+    size_t cq_size;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    uring_slot_t *slots;
+    size_t slot_count;
+    int32_t free_slot;              // Head of the free list (-1 if empty)
+} uring_engine_t;
+
+static int sys_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static uint64_t pack(const uring_engine_t *ue, size_t slot, unsigned op) {
+    return ((uint64_t)ue->slots[slot].gen << 32) | ((uint64_t)slot << OP_BITS) | op;
+}
+
+// Hand queued SQEs to the kernel
+static void submit(uring_engine_t *ue) {
+    unsigned pending = ue->sqe_tail - ue->sqe_submitted;
+    if (pending == 0) {
+        return;
+    }
+
+    // The connect goes out inside io_uring_enter(), so stamp ahead of it
+    uint64_t now = now_ns();
+    for (unsigned i = ue->sqe_submitted; i != ue->sqe_tail; i++) {
+        const struct io_uring_sqe *sqe = &ue->sqes[i & *ue->sq_mask];
+        if (sqe->opcode == IORING_OP_CONNECT) {
+            ue->slots[(sqe->user_data >> OP_BITS) & 0x1FFFFFFF].sent_ns = now;
+        }
+    }
+
+    __atomic_store_n(ue->sq_tail, ue->sqe_tail, __ATOMIC_RELEASE);
+
+    int ret;
+    do {
+        ret = sys_enter(ue->ring_fd, pending, 0, 0);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret > 0) {
+        ue->sqe_submitted += (unsigned)ret;
+    }
+}
+
+// Reserve n consecutive SQEs, submitting first if the ring is full.
+// Returns the first, or NULL if the kernel has not caught up.
+static struct io_uring_sqe *get_sqes(uring_engine_t *ue, unsigned n) {
+    unsigned head = __atomic_load_n(ue->sq_head, __ATOMIC_ACQUIRE);
+    if (ue->sqe_tail + n - head > ue->sq_entries) {
+        submit(ue);
+        head = __atomic_load_n(ue->sq_head, __ATOMIC_ACQUIRE);
+        if (ue->sqe_tail + n - head > ue->sq_entries) {
+            return NULL;
+        }
+    }
+
+    struct io_uring_sqe *first = NULL;
+    for (unsigned i = 0; i < n; i++) {
+        unsigned idx = ue->sqe_tail & *ue->sq_mask;
+        struct io_uring_sqe *sqe = &ue->sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        ue->sq_array[idx] = idx;
+        ue->sqe_tail++;
+        if (first == NULL) {
+            first = sqe;
+        }
+    }
+    return first;
+}
+
+static int32_t alloc_slot(uring_engine_t *ue) {
+    if (ue->free_slot < 0) {
+        // SQEs point into slots until submitted, so flush before moving them
+        submit(ue);
+
+        size_t count = ue->slot_count > 0 ? ue->slot_count * 2 : 256;
+        if (count > ((size_t)1 << (32 - OP_BITS))) {
+            return -1;
+        }
+        uring_slot_t *slots = realloc(ue->slots, count * sizeof(*slots));
+        if (slots == NULL) {
+            return -1;
+        }
+        for (size_t i = ue->slot_count; i < count; i++) {
+            memset(&slots[i], 0, sizeof(slots[i]));
+            slots[i].fd = -1;
+            slots[i].next_free = i + 1 < count ? (int32_t)(i + 1) : -1;
+        }
+        ue->free_slot = (int32_t)ue->slot_count;
+        ue->slots = slots;
+        ue->slot_count = count;
+    }
+
+    int32_t idx = ue->free_slot;
+    ue->free_slot = ue->slots[idx].next_free;
+    return idx;
+}
+
+static void free_slot(uring_engine_t *ue, size_t idx) {
+    uring_slot_t *s = &ue->slots[idx];
+    s->gen++;
+    s->state = SLOT_FREE;
+    s->fd = -1;
+    s->abandoned = false;
+    s->next_free = ue->free_slot;
+    ue->free_slot = (int32_t)idx;
+}
+
+static void queue_close(uring_engine_t *ue, size_t idx) {
+    uring_slot_t *s = &ue->slots[idx];
+    if (s->fd < 0) {
+        return;
+    }
+
+    struct io_uring_sqe *sqe = get_sqes(ue, 1);
+    if (sqe == NULL) {
+        close(s->fd);
+    } else {
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = s->fd;
+        sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+        sqe->user_data = pack(ue, idx, OP_CLOSE);
+    }
+    s->fd = -1;
+}
+
+static void report(uring_engine_t *ue, size_t idx, probe_result_t result, uint64_t done_ns) {
+    ue->slots[idx].state = SLOT_DONE;
+    ue->base.on_done((int)idx, result, ue->slots[idx].sent_ns, done_ns, ue->base.ctx);
+}
+
+// Socket is ready: connect, with the remaining time as a linked timeout
+static void queue_connect(uring_engine_t *ue, size_t idx, uint64_t now) {
+    uring_slot_t *s = &ue->slots[idx];
+
+    struct io_uring_sqe *sqe = get_sqes(ue, 2);
+    if (sqe == NULL) {
+        report(ue, idx, PROBE_ERROR, now);
+        return;
+    }
+
+    uint64_t left = s->deadline_ns > now ? s->deadline_ns - now : 0;
+    if (left < URING_MIN_TIMEOUT_NS) {
+        left = URING_MIN_TIMEOUT_NS;
+    }
+    s->timeout.tv_sec = (int64_t)(left / 1000000000ULL);
+    s->timeout.tv_nsec = (long long)(left % 1000000000ULL);
+
+    sqe->opcode = IORING_OP_CONNECT;
+    sqe->fd = s->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&s->addr;
+    sqe->off = sizeof(s->addr);
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = pack(ue, idx, OP_CONNECT);
+
+    // get_sqes() reserved two consecutive entries, but the ring may wrap
+    struct io_uring_sqe *tmo = &ue->sqes[(ue->sqe_tail - 1) & *ue->sq_mask];
+    tmo->opcode = IORING_OP_LINK_TIMEOUT;
+    tmo->fd = -1;
+    tmo->addr = (uint64_t)(uintptr_t)&s->timeout;
+    tmo->len = 1;
+    tmo->user_data = pack(ue, idx, OP_TIMEOUT);
+
+    s->state = SLOT_CONNECTING;
+}
+
+static void handle_cqe(uring_engine_t *ue, const struct io_uring_cqe *cqe, uint64_t now) {
+    unsigned op = (unsigned)(cqe->user_data & OP_MASK);
+    size_t idx = (size_t)((cqe->user_data >> OP_BITS) & 0x1FFFFFFF);
+    uint32_t gen = (uint32_t)(cqe->user_data >> 32);
+
+    if (op != OP_SOCKET && op != OP_CONNECT) {
+        return;     // Timeout, close and cancel results need no action
+    }
+
+    uring_slot_t *s = idx < ue->slot_count ? &ue->slots[idx] : NULL;
+    if (s == NULL || s->gen != gen || s->state == SLOT_FREE) {
+        if (op == OP_SOCKET && cqe->res >= 0) {
+            close(cqe->res);
+        }
+        return;
+    }
+
+    if (op == OP_SOCKET) {
+        if (cqe->res < 0) {
+            if (s->abandoned) {
+                free_slot(ue, idx);
+            } else {
+                report(ue, idx, PROBE_ERROR, now);
+            }
+            return;
+        }
+
+        s->fd = cqe->res;
+        if (s->abandoned) {
+            queue_close(ue, idx);
+            free_slot(ue, idx);
+        } else {
+            queue_connect(ue, idx, now);
+        }
+        return;
+    }
+
+    // OP_CONNECT: 0 on success, -ECANCELED when the linked timeout fired
+    if (s->abandoned) {
+        queue_close(ue, idx);
+        free_slot(ue, idx);
+    } else {
+        report(ue, idx, cqe->res == 0 ? PROBE_SUCCESS : PROBE_ERROR, now);
+    }
+}
+
+static void reap(uring_engine_t *ue) {
+    for (;;) {
+        unsigned head = *ue->cq_head;
+        unsigned tail = __atomic_load_n(ue->cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            // Completions that did not fit in the ring wait in the kernel
+            if (__atomic_load_n(ue->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) {
+                sys_enter(ue->ring_fd, 0, 0, IORING_ENTER_GETEVENTS);
+                if (__atomic_load_n(ue->cq_tail, __ATOMIC_ACQUIRE) != head) {
+                    continue;
+                }
+            }
+            return;
+        }
+
+        // One clock read per batch of completions
+        uint64_t now = now_ns();
+        while (head != tail) {
+            struct io_uring_cqe cqe = ue->cqes[head & *ue->cq_mask];
+            head++;
+            __atomic_store_n(ue->cq_head, head, __ATOMIC_RELEASE);
+            handle_cqe(ue, &cqe, now);
+        }
+    }
+}
+
+static int uring_start(probe_engine_t *e, const struct sockaddr_in *addr, uint32_t timeout_ms) {
+    uring_engine_t *ue = (uring_engine_t *)e;
+
+    int32_t idx = alloc_slot(ue);
+    if (idx < 0) {
+        return -1;
+    }
+
+    struct io_uring_sqe *sqe = get_sqes(ue, 1);
+    if (sqe == NULL) {
+        free_slot(ue, (size_t)idx);
+        return -1;
+    }
+
+    uring_slot_t *s = &ue->slots[idx];
+    s->addr = *addr;
+    s->deadline_ns = now_ns() + (uint64_t)timeout_ms * 1000000ULL;
+    s->sent_ns = 0;
+    s->state = SLOT_SOCKET;
+
+    sqe->opcode = IORING_OP_SOCKET;
+    sqe->fd = AF_INET;
+    sqe->off = SOCK_STREAM | SOCK_CLOEXEC;
+    sqe->len = 0;
+    sqe->user_data = pack(ue, (size_t)idx, OP_SOCKET);
+    return idx;
+}
+
+static void uring_release(probe_engine_t *e, int handle) {
+    uring_engine_t *ue = (uring_engine_t *)e;
+
+    if (handle < 0 || (size_t)handle >= ue->slot_count) {
+        return;
+    }
+
+    uring_slot_t *s = &ue->slots[handle];
+    switch (s->state) {
+        case SLOT_FREE:
+            break;
+
+        case SLOT_SOCKET:
+            s->abandoned = true;    // Closed when the socket arrives
+            break;
+
+        case SLOT_CONNECTING: {
+            s->abandoned = true;    // Closed when the connect CQE arrives
+            struct io_uring_sqe *sqe = get_sqes(ue, 1);
+            if (sqe != NULL) {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->addr = pack(ue, (size_t)handle, OP_CONNECT);
+                sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+                sqe->user_data = pack(ue, (size_t)handle, OP_CANCEL);
+            }
+            break;
+        }
+
+        case SLOT_DONE:
+            queue_close(ue, (size_t)handle);
+            free_slot(ue, (size_t)handle);
+            break;
+    }
+}
+
+static int uring_socket_fd(probe_engine_t *e, int handle) {
+    uring_engine_t *ue = (uring_engine_t *)e;
+
+    if (handle < 0 || (size_t)handle >= ue->slot_count ||
+        ue->slots[handle].state != SLOT_DONE) {
+        return -1;
+    }
+    return ue->slots[handle].fd;
+}
+
+static void uring_process(probe_engine_t *e) {
+    uring_engine_t *ue = (uring_engine_t *)e;
+    reap(ue);
+    submit(ue);
+}
+
+// Reactor handler: completions were posted
+static void on_ready(int fd, unsigned events, void *ctx) {
+    uint64_t count;
+    (void)events;
+
+    while (read(fd, &count, sizeof(count)) > 0) {
+        // Drain the eventfd
+    }
+    uring_process((probe_engine_t *)ctx);
+}
+
+static void uring_set_reactor(probe_engine_t *e, reactor_t *reactor) {
+    uring_engine_t *ue = (uring_engine_t *)e;
+
+    if (e->reactor != NULL) {
+        reactor_remove(e->reactor, ue->event_fd);
+    }
+    if (reactor != NULL) {
+        reactor_add(reactor, ue->event_fd, REACTOR_EV_READ, on_ready, ue);
+    }
+    e->reactor = reactor;
+}
+
+static void uring_flush(probe_engine_t *e) {
+    submit((uring_engine_t *)e);
+}
+
+static void uring_destroy(probe_engine_t *e) {
+    uring_engine_t *ue = (uring_engine_t *)e;
+
+    if (e->reactor != NULL) {
+        reactor_remove(e->reactor, ue->event_fd);
+    }
+
+    // Closing the ring cancels everything in flight and drops its file refs
+    if (ue->ring_fd >= 0) {
+        close(ue->ring_fd);
+    }
+    for (size_t i = 0; i < ue->slot_count; i++) {
+        if (ue->slots[i].state != SLOT_FREE && ue->slots[i].fd >= 0) {
+            close(ue->slots[i].fd);
+        }
+    }
+
+    if (ue->sqes != NULL && ue->sqes != MAP_FAILED) {
+        munmap(ue->sqes, ue->sqes_size);
+    }
+    if (ue->cq_ptr != NULL && ue->cq_ptr != MAP_FAILED && ue->cq_ptr != ue->sq_ptr) {
+        munmap(ue->cq_ptr, ue->cq_size);
+    }
+    if (ue->sq_ptr != NULL && ue->sq_ptr != MAP_FAILED) {
+        munmap(ue->sq_ptr, ue->sq_size);
+    }
+    if (ue->event_fd >= 0) {
+        close(ue->event_fd);
+    }
+    free(ue->slots);
+    free(ue);
+}
+
+// Check the kernel implements every opcode the engine uses
+static bool ops_supported(int ring_fd) {
+    static const unsigned needed[] = {
+        IORING_OP_SOCKET, IORING_OP_CONNECT, IORING_OP_LINK_TIMEOUT,
+        IORING_OP_CLOSE, IORING_OP_ASYNC_CANCEL
+    };
+
+    size_t len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, len);
+    if (probe == NULL) {
+        return false;
+    }
+
+    bool ok = sys_register(ring_fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; ok && i < sizeof(needed) / sizeof(needed[0]); i++) {
+        ok = needed[i] <= probe->last_op &&
+             (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+
+    free(probe);
+    return ok;
+}
+
+static const probe_engine_ops_t uring_ops = {
+    .name = "io_uring",
+    .start = uring_start,
+    .release = uring_release,
+    .socket_fd = uring_socket_fd,
+    .set_reactor = uring_set_reactor,
+    .process = uring_process,
+    .flush = uring_flush,
+    .destroy = uring_destroy,
+};
+
+probe_engine_t *probe_engine_uring_create(probe_done_cb_t on_done, void *ctx) {
+    if (on_done == NULL) {
+        return NULL;
+    }
+
+    uring_engine_t *ue = calloc(1, sizeof(*ue));
+    if (ue == NULL) {
+        return NULL;
+    }
+    ue->base.ops = &uring_ops;
+    ue->base.on_done = on_done;
+    ue->base.ctx = ctx;
+    ue->event_fd = -1;
+    ue->free_slot = -1;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = URING_CQ_ENTRIES;
+
+    ue->ring_fd = sys_setup(URING_SQ_ENTRIES, &p);
+    if (ue->ring_fd < 0 || !(p.features & IORING_FEAT_NODROP) || !ops_supported(ue->ring_fd)) {
+        uring_destroy(&ue->base);
+        return NULL;
+    }
+
+    ue->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ue->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ue->cq_size > ue->sq_size) {
+            ue->sq_size = ue->cq_size;
+        }
+        ue->cq_size = ue->sq_size;
+    }
+
+    ue->sq_ptr = mmap(NULL, ue->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ue->ring_fd, IORING_OFF_SQ_RING);
+    if (ue->sq_ptr == MAP_FAILED) {
+        uring_destroy(&ue->base);
+        return NULL;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ue->cq_ptr = ue->sq_ptr;
+    } else {
+        ue->cq_ptr = mmap(NULL, ue->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ue->ring_fd, IORING_OFF_CQ_RING);
+        if (ue->cq_ptr == MAP_FAILED) {
+            uring_destroy(&ue->base);
+            return NULL;
+        }
+    }
+
+    ue->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ue->sqes = mmap(NULL, ue->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ue->ring_fd, IORING_OFF_SQES);
+    if (ue->sqes == MAP_FAILED) {
+        uring_destroy(&ue->base);
+        return NULL;
+    }
+
+    char *sq = ue->sq_ptr;
+    ue->sq_head = (unsigned *)(sq + p.sq_off.head);
+    ue->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    ue->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    ue->sq_array = (unsigned *)(sq + p.sq_off.array);
+    ue->sq_flags = (unsigned *)(sq + p.sq_off.flags);
+    ue->sq_entries = p.sq_entries;
+    ue->sqe_tail = *ue->sq_tail;
+    ue->sqe_submitted = ue->sqe_tail;
+
+    char *cq = ue->cq_ptr;
+    ue->cq_head = (unsigned *)(cq + p.cq_off.head);
+    ue->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    ue->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    ue->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    ue->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ue->event_fd < 0 ||
+        sys_register(ue->ring_fd, IORING_REGISTER_EVENTFD, &ue->event_fd, 1) != 0) {
+        uring_destroy(&ue->base);
+        return NULL;
+    }
+
+    return &ue->base;
+}
@@ -0,0 +1,15 @@
+/*
+ * io_uring Probe Engine Stub
+ *
+ * Used on platforms without io_uring (macOS) and in builds with IO_URING=0.
+ * The scheduler stays on the poll engine.
+ */
+
+#include "net/probe_engine.h"
+#include <stddef.h>
+
+probe_engine_t *probe_engine_uring_create(probe_done_cb_t on_done, void *ctx) {
+    (void)on_done;
+    (void)ctx;
+    return NULL;    // Not available
+}
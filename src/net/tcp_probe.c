@@ -10,16 +10,15 @@
 #include <poll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 
-int tcp_probe_start(const char *host, uint16_t port) {
-    struct addrinfo *addr = dns_resolve(host, port);
+int tcp_probe_connect(const struct sockaddr *addr, socklen_t addr_len) {
     if (addr == NULL) {
         return -1;
     }
 
-    int fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+    int fd = socket(addr->sa_family, SOCK_STREAM, 0);
     if (fd < 0) {
-        freeaddrinfo(addr);
         return -1;
     }
 
@@ -27,13 +26,11 @@ int tcp_probe_start(const char *host, uint16_t port) {
     int flags = fcntl(fd, F_GETFL, 0);
     if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
         close(fd);
-        freeaddrinfo(addr);
         return -1;
     }
 
     // Start non-blocking connect
-    int ret = connect(fd, addr->ai_addr, addr->ai_addrlen);
-    freeaddrinfo(addr);
+    int ret = connect(fd, addr, addr_len);
 
     if (ret < 0 && errno != EINPROGRESS) {
         close(fd);
@@ -43,6 +40,17 @@ int tcp_probe_start(const char *host, uint16_t port) {
     return fd;
 }
 
+int tcp_probe_start(const char *host, uint16_t port) {
+    struct addrinfo *addr = dns_resolve(host, port);
+    if (addr == NULL) {
+        return -1;
+    }
+
+    int fd = tcp_probe_connect(addr->ai_addr, addr->ai_addrlen);
+    freeaddrinfo(addr);
+    return fd;
+}
+
 probe_result_t tcp_probe_check(int fd) {
     if (fd < 0) {
         return PROBE_ERROR;
@@ -70,18 +78,44 @@ probe_result_t tcp_probe_check(int fd) {
     }
 
     if (pfd.revents & POLLOUT) {
-        // Check SO_ERROR to confirm connection success
-        int error = 0;
-        socklen_t len = sizeof(error);
-        if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
-            return PROBE_ERROR;
-        }
-        return PROBE_SUCCESS;
+        return tcp_probe_result(fd);
     }
 
     return PROBE_PENDING;
 }
 
+probe_result_t tcp_probe_result(int fd) {
+    if (fd < 0) {
+        return PROBE_ERROR;
+    }
+
+    // Check SO_ERROR to confirm connection success
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+        return PROBE_ERROR;
+    }
+    return PROBE_SUCCESS;
+}
+
+uint64_t tcp_probe_kernel_rtt_ns(int fd) {
+#if defined(__linux__)
+    // tcpi_rtt is the kernel's smoothed RTT in microseconds. Right after
+    // the handshake its only sample is SYN -> SYN-ACK. Zero if the SYN was
+    // retransmitted (Karn).
+    struct tcp_info info;
+    socklen_t len = sizeof(info);
+    if (fd >= 0 && getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0 &&
+        info.tcpi_rtt > 0) {
+        return (uint64_t)info.tcpi_rtt * 1000ULL;
+    }
+    return 0;
+#else
+    (void)fd;
+    return 0;
+#endif
+}
+
 void tcp_probe_cleanup(int fd) {
     if (fd >= 0) {
         close(fd);
@@ -2,6 +2,7 @@
 #define NETPULSE_TCP_PROBE_H
 
 #include <stdint.h>
+#include <sys/socket.h>
 
 /*
  * TCP connect timing probe using non-blocking sockets and poll()
@@ -13,7 +14,11 @@ typedef enum {
     PROBE_ERROR
 } probe_result_t;
 
-// Start a non-blocking TCP connect probe.
+// Start a non-blocking TCP connect probe to a resolved address.
+// Returns socket fd on success, -1 on error.
+int tcp_probe_connect(const struct sockaddr *addr, socklen_t addr_len);
+
+// Resolve host (blocking) and start a non-blocking TCP connect probe.
 // Returns socket fd on success, -1 on error.
 int tcp_probe_start(const char *host, uint16_t port);
 
@@ -21,6 +26,15 @@ int tcp_probe_start(const char *host, uint16_t port);
 // Returns PROBE_PENDING if still connecting, PROBE_SUCCESS or PROBE_ERROR otherwise.
 probe_result_t tcp_probe_check(int fd);
 
+// Read the connect outcome once the socket has been reported writable or errored
+// (e.g. by the reactor). Returns PROBE_SUCCESS or PROBE_ERROR.
+probe_result_t tcp_probe_result(int fd);
+
+// Handshake RTT as timed by the kernel for a connected probe socket: its
+// smoothed RTT from TCP_INFO (not SO_TIMESTAMPING), in nanoseconds
+// (microsecond resolution). Returns 0 if unavailable.
+uint64_t tcp_probe_kernel_rtt_ns(int fd);
+
 // Clean up probe socket
 void tcp_probe_cleanup(int fd);
 
@@ -38,6 +38,14 @@ char *expand_home_path(const char *path);
 // Returns NULL on error.
 char *get_data_dir(void);
 
+/*
+ * Threads
+ */
+
+// Pin the calling thread to one CPU. Returns 0 on success, -1 on error or
+// where pinning isn't supported (macOS).
+int pin_current_thread(int cpu);
+
 /*
  * Debug utilities (compile with -DDEBUG_RESOURCES to enable)
  */
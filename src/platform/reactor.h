@@ -0,0 +1,72 @@
+#ifndef NETPULSE_REACTOR_H
+#define NETPULSE_REACTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Event reactor - one readiness set per thread: the probe thread's for probe
+ * sockets, the main thread's for the HTTP server
+ *
+ * On Linux: epoll set plus a timerfd that holds the next deadline, so the
+ *           thread sleeps until an fd is ready or a probe (or batch) is due.
+ * On macOS: Stub implementation that returns "not available"; the caller
+ *           falls back to the polling main loop.
+ */
+
+// Readiness flags (platform independent)
+#define REACTOR_EV_READ     0x01
+#define REACTOR_EV_WRITE    0x02
+#define REACTOR_EV_ERROR    0x04
+
+// Called when a registered fd becomes ready. events is a mask of REACTOR_EV_*.
+typedef void (*reactor_handler_t)(int fd, unsigned events, void *ctx);
+
+typedef struct {
+    reactor_handler_t handler;
+    void *ctx;
+} reactor_slot_t;
+
+typedef struct {
+    int epoll_fd;                   // epoll instance (-1 if not initialized)
+    int timer_fd;                   // timerfd holding the next deadline
+    reactor_slot_t *slots;          // Handlers indexed by fd
+    size_t slot_count;              // Number of entries in slots
+    uint64_t armed_deadline_ms;     // Deadline currently on the timerfd (0 = disarmed)
+    uint64_t wake_ns;               // Monotonic time the last wait returned
+} reactor_t;
+
+/*
+ * Initialize the reactor.
+ *
+ * Returns:
+ *   0  - Success
+ *  -1  - Not available on this platform or out of resources
+ */
+int reactor_init(reactor_t *r);
+
+/*
+ * Free reactor resources.
+ * Registered fds are not closed; they remain owned by their callers.
+ */
+void reactor_free(reactor_t *r);
+
+// Watch fd for the given REACTOR_EV_* mask. Returns 0 on success, -1 on error.
+int reactor_add(reactor_t *r, int fd, unsigned events, reactor_handler_t handler, void *ctx);
+
+// Stop watching fd. Must be called before the fd is closed. Returns 0 on success, -1 on error.
+int reactor_remove(reactor_t *r, int fd);
+
+/*
+ * Sleep until a registered fd is ready or timeout_ms elapses, then run the
+ * handlers of every ready fd.
+ *
+ * The timeout is kept on the timerfd as an absolute monotonic deadline, so
+ * repeated waits for the same deadline do not re-arm the timer.
+ *
+ * Returns number of handlers dispatched (0 on timeout or signal), -1 on error.
+ */
+int reactor_wait(reactor_t *r, int timeout_ms);
+
+#endif // NETPULSE_REACTOR_H
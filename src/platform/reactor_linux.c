@@ -0,0 +1,202 @@
+/*
+ * Reactor Linux Implementation
+ *
+ * epoll for fd readiness, timerfd (CLOCK_MONOTONIC, absolute) for the next
+ * scheduler deadline. Both live in the same epoll set, so a single
+ * epoll_wait() covers probes, the HTTP server and timers.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "platform/reactor.h"
+#include "platform/platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define REACTOR_MAX_EVENTS 64
+
+static uint32_t to_epoll_events(unsigned events) {
+    uint32_t ev = 0;
+    if (events & REACTOR_EV_READ) ev |= EPOLLIN;
+    if (events & REACTOR_EV_WRITE) ev |= EPOLLOUT;
+    return ev;
+}
+
+static unsigned from_epoll_events(uint32_t ev) {
+    unsigned events = 0;
+    if (ev & (EPOLLIN | EPOLLHUP)) events |= REACTOR_EV_READ;
+    if (ev & EPOLLOUT) events |= REACTOR_EV_WRITE;
+    if (ev & (EPOLLERR | EPOLLHUP)) events |= REACTOR_EV_ERROR;
+    return events;
+}
+
+// Grow the fd-indexed handler table to hold fd
+static int ensure_slot(reactor_t *r, int fd) {
+    if ((size_t)fd < r->slot_count) {
+        return 0;
+    }
+
+    size_t new_count = r->slot_count > 0 ? r->slot_count : 64;
+    while (new_count <= (size_t)fd) {
+        new_count *= 2;
+    }
+
+    reactor_slot_t *slots = realloc(r->slots, new_count * sizeof(*slots));
+    if (slots == NULL) {
+        return -1;
+    }
+
+    memset(slots + r->slot_count, 0, (new_count - r->slot_count) * sizeof(*slots));
+    r->slots = slots;
+    r->slot_count = new_count;
+    return 0;
+}
+
+int reactor_init(reactor_t *r) {
+    if (r == NULL) {
+        return -1;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->epoll_fd = -1;
+    r->timer_fd = -1;
+
+    r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (r->epoll_fd < 0) {
+        return -1;
+    }
+
+    r->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (r->timer_fd < 0) {
+        close(r->epoll_fd);
+        r->epoll_fd = -1;
+        return -1;
+    }
+
+    // Timer fd is dispatched internally (data.fd == timer_fd), no slot needed
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = r->timer_fd };
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->timer_fd, &ev) != 0) {
+        close(r->timer_fd);
+        close(r->epoll_fd);
+        r->timer_fd = -1;
+        r->epoll_fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+void reactor_free(reactor_t *r) {
+    if (r == NULL) {
+        return;
+    }
+
+    if (r->timer_fd >= 0) {
+        close(r->timer_fd);
+        r->timer_fd = -1;
+    }
+    if (r->epoll_fd >= 0) {
+        close(r->epoll_fd);
+        r->epoll_fd = -1;
+    }
+
+    free(r->slots);
+    r->slots = NULL;
+    r->slot_count = 0;
+}
+
+int reactor_add(reactor_t *r, int fd, unsigned events, reactor_handler_t handler, void *ctx) {
+    if (r == NULL || r->epoll_fd < 0 || fd < 0 || handler == NULL) {
+        return -1;
+    }
+
+    if (ensure_slot(r, fd) != 0) {
+        return -1;
+    }
+
+    struct epoll_event ev = { .events = to_epoll_events(events), .data.fd = fd };
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        return -1;
+    }
+
+    r->slots[fd].handler = handler;
+    r->slots[fd].ctx = ctx;
+    return 0;
+}
+
+int reactor_remove(reactor_t *r, int fd) {
+    if (r == NULL || r->epoll_fd < 0 || fd < 0 || (size_t)fd >= r->slot_count) {
+        return -1;
+    }
+
+    // Clear the slot first so an event already returned in this batch is ignored
+    r->slots[fd].handler = NULL;
+    r->slots[fd].ctx = NULL;
+
+    return epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+static void arm_timer(reactor_t *r, uint64_t deadline_ms) {
+    if (deadline_ms == r->armed_deadline_ms) {
+        return;
+    }
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = (time_t)(deadline_ms / 1000);
+    its.it_value.tv_nsec = (long)((deadline_ms % 1000) * 1000000);
+
+    if (timerfd_settime(r->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) == 0) {
+        r->armed_deadline_ms = deadline_ms;
+    }
+}
+
+int reactor_wait(reactor_t *r, int timeout_ms) {
+    if (r == NULL || r->epoll_fd < 0) {
+        return -1;
+    }
+
+    if (timeout_ms < 0) {
+        timeout_ms = 0;
+    }
+
+    // now_ms() and timerfd share CLOCK_MONOTONIC, so the deadline is absolute
+    arm_timer(r, now_ms() + (uint64_t)timeout_ms);
+
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    int n = epoll_wait(r->epoll_fd, events, REACTOR_MAX_EVENTS, -1);
+    r->wake_ns = now_ns();
+
+    if (n < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    int dispatched = 0;
+    for (int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+
+        if (fd == r->timer_fd) {
+            uint64_t expirations;
+            if (read(r->timer_fd, &expirations, sizeof(expirations)) > 0) {
+                r->armed_deadline_ms = 0;
+            }
+            continue;
+        }
+
+        // Handler may have been removed by an earlier handler in this batch
+        if ((size_t)fd >= r->slot_count || r->slots[fd].handler == NULL) {
+            continue;
+        }
+
+        r->slots[fd].handler(fd, from_epoll_events(events[i].events), r->slots[fd].ctx);
+        dispatched++;
+    }
+
+    return dispatched;
+}
@@ -0,0 +1,43 @@
+/*
+ * Reactor Stub Implementation
+ *
+ * This stub is used on platforms without epoll/timerfd (macOS).
+ * reactor_init() fails and the daemon keeps its polling main loop.
+ */
+
+#include "platform/reactor.h"
+#include <string.h>
+
+int reactor_init(reactor_t *r) {
+    if (r != NULL) {
+        memset(r, 0, sizeof(*r));
+        r->epoll_fd = -1;
+        r->timer_fd = -1;
+    }
+    return -1;  // Not available
+}
+
+void reactor_free(reactor_t *r) {
+    (void)r;
+}
+
+int reactor_add(reactor_t *r, int fd, unsigned events, reactor_handler_t handler, void *ctx) {
+    (void)r;
+    (void)fd;
+    (void)events;
+    (void)handler;
+    (void)ctx;
+    return -1;
+}
+
+int reactor_remove(reactor_t *r, int fd) {
+    (void)r;
+    (void)fd;
+    return -1;
+}
+
+int reactor_wait(reactor_t *r, int timeout_ms) {
+    (void)r;
+    (void)timeout_ms;
+    return -1;
+}
@@ -0,0 +1,29 @@
+#ifdef PLATFORM_LINUX
+#define _GNU_SOURCE
+#endif
+
+#include "platform/platform.h"
+
+#ifdef PLATFORM_LINUX
+
+#include <sched.h>
+
+int pin_current_thread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return -1;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0 ? 0 : -1;
+}
+
+#else // macOS: thread affinity is only a hint there, so don't pretend
+
+int pin_current_thread(int cpu) {
+    (void)cpu;
+    return -1;
+}
+
+#endif
@@ -1,10 +1,17 @@
 #include "server/http_handlers.h"
 #include "server/server.h"
+#include "server/json_writer.h"
+#include "store/series_query.h"
 #include "platform/platform.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+#define SERIES_STREAM_MARK      'S'     // c->data[0] while a series response is sent
+#define SERIES_DEFAULT_RANGE_MS 3600000ULL
+#define SERIES_DEFAULT_STEP_MS  60000ULL
+#define SERIES_UNIT_MAX         192     // Longest formatted row or series opening
+
 // Simple JSON parsing helpers (minimal implementation)
 static bool json_get_string(const char *json, size_t json_len, const char *key, char *value, size_t value_size) {
     char pattern[128];
@@ -64,53 +71,125 @@ static bool json_get_double(const char *json, size_t json_len, const char *key,
     return true;
 }
 
-void http_handle_health(struct mg_connection *c, uint64_t start_time_ms) {
+void http_handle_health(struct mg_connection *c, server_t *server, uint64_t start_time_ms) {
     uint64_t now = now_ms();
     uint64_t uptime_s = (now - start_time_ms) / 1000;
 
+    if (server == NULL) {
+        mg_http_reply(c, 200, "Content-Type: application/json\r\n",
+                      "{\"ok\":true,\"uptime_s\":%llu}\n",
+                      (unsigned long long)uptime_s);
+        return;
+    }
+
+    // Backlogs are as of now; compression figures, connect counts, drops
+    // and probe updates cover everything since startup
+    const ws_hub_t *hub = &server->ws_hub;
+    probe_thread_t *probes = server->probes;
+    uint64_t updates = 0;
+    uint64_t dropped_updates = 0;
+    size_t update_backlog = 0;
+    if (probes != NULL) {
+        updates = atomic_load_explicit(&probes->published_count, memory_order_relaxed);
+        dropped_updates = atomic_load_explicit(&probes->dropped, memory_order_relaxed);
+        update_backlog = spsc_queue_used(&probes->updates);
+    }
+    size_t queued = 0;
+    size_t max_queued = 0;
+    for (const ws_client_t *client = hub->clients; client != NULL; client = client->next) {
+        size_t backlog = ws_hub_backlog(client);
+        queued += backlog;
+        if (backlog > max_queued) {
+            max_queued = backlog;
+        }
+    }
     mg_http_reply(c, 200, "Content-Type: application/json\r\n",
-                  "{\"ok\":true,\"uptime_s\":%llu}\n",
-                  (unsigned long long)uptime_s);
+                  "{\"ok\":true,\"uptime_s\":%llu,\"ws\":{\"clients\":%lu,"
+                  "\"deflate_clients\":%lu,\"deflate_in_bytes\":%llu,"
+                  "\"deflate_out_bytes\":%llu,\"deflate_cpu_ms\":%llu,"
+                  "\"snapshots\":%llu,\"resumes\":%llu,\"replay_bytes\":%lu,"
+                  "\"queued_bytes\":%lu,\"max_queued_bytes\":%lu,"
+                  "\"congested_clients\":%lu,\"reduced_batches\":%llu,"
+                  "\"dropped_samples\":%llu,\"slow_disconnects\":%llu},"
+                  "\"probes\":{\"cpu\":%d,\"updates\":%llu,\"dropped_updates\":%llu,"
+                  "\"backlog_bytes\":%lu}}\n",
+                  (unsigned long long)uptime_s,
+                  (unsigned long)hub->client_count,
+                  (unsigned long)hub->deflate_clients,
+                  (unsigned long long)hub->deflate_in,
+                  (unsigned long long)hub->deflate_out,
+                  (unsigned long long)(hub->deflate_ns / 1000000),
+                  (unsigned long long)server->ws_snapshots,
+                  (unsigned long long)server->ws_resumes,
+                  (unsigned long)server->ws_replay.bytes,
+                  (unsigned long)queued,
+                  (unsigned long)max_queued,
+                  (unsigned long)hub->congested_clients,
+                  (unsigned long long)hub->reduced,
+                  (unsigned long long)server->ws_dropped_samples,
+                  (unsigned long long)hub->slow_disconnects,
+                  probes != NULL ? probes->cpu : -1,
+                  (unsigned long long)updates,
+                  (unsigned long long)dropped_updates,
+                  (unsigned long)update_backlog);
+}
+
+// 200 with w's JSON as the body, sent with one copy (500 if w ran out of memory)
+static void reply_json(struct mg_connection *c, const json_writer_t *w) {
+    if (w->failed) {
+        mg_http_reply(c, 500, "", "Out of memory\n");
+        return;
+    }
+    mg_printf(c, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %lu\r\n\r\n",
+              (unsigned long)w->len);
+    mg_send(c, w->buf, w->len);
+    c->is_resp = 0;
 }
 
 void http_handle_get_config(struct mg_connection *c, config_t *config) {
-    // Build JSON response
-    char buf[4096];
-    int pos = 0;
-
-    pos += snprintf(buf + pos, sizeof(buf) - pos,
-                    "{\"probe_interval_ms\":%u,"
-                    "\"probe_timeout_ms\":%u,"
-                    "\"thresholds\":{"
-                    "\"loss_pct\":%.1f,"
-                    "\"p95_ms\":%.1f,"
-                    "\"jitter_ms\":%.1f"
-                    "},\"targets\":[",
-                    config->probe_interval_ms,
-                    config->probe_timeout_ms,
-                    config->thresholds.loss_pct,
-                    config->thresholds.p95_ms,
-                    config->thresholds.jitter_ms);
+    json_writer_t w;
+    json_writer_init(&w);
+
+    json_lit(&w, "{\"probe_interval_ms\":");
+    json_u64(&w, config->probe_interval_ms);
+    json_lit(&w, ",\"probe_timeout_ms\":");
+    json_u64(&w, config->probe_timeout_ms);
+    json_lit(&w, ",\"thresholds\":{\"loss_pct\":");
+    json_fixed(&w, config->thresholds.loss_pct, 1);
+    json_lit(&w, ",\"p95_ms\":");
+    json_fixed(&w, config->thresholds.p95_ms, 1);
+    json_lit(&w, ",\"jitter_ms\":");
+    json_fixed(&w, config->thresholds.jitter_ms, 1);
+    json_lit(&w, "},\"targets\":[");
 
     for (int i = 0; i < config->target_count; i++) {
         target_config_t *t = &config->targets[i];
         if (i > 0) {
-            pos += snprintf(buf + pos, sizeof(buf) - pos, ",");
+            json_lit(&w, ",");
         }
-        pos += snprintf(buf + pos, sizeof(buf) - pos,
-                        "{\"id\":\"%s\",\"host\":\"%s\",\"port\":%u,\"label\":\"%s\"}",
-                        t->id, t->host, t->port, t->label);
+        json_lit(&w, "{\"id\":");
+        json_str(&w, t->id);
+        json_lit(&w, ",\"host\":");
+        json_str(&w, t->host);
+        json_lit(&w, ",\"port\":");
+        json_u64(&w, t->port);
+        json_lit(&w, ",\"label\":");
+        json_str(&w, t->label);
+        json_lit(&w, "}");
     }
+    json_lit(&w, "]}\n");
 
-    pos += snprintf(buf + pos, sizeof(buf) - pos, "]}\n");
-
-    mg_http_reply(c, 200, "Content-Type: application/json\r\n", "%s", buf);
+    reply_json(c, &w);
+    json_writer_free(&w);
 }
 
 void http_handle_post_config(struct mg_connection *c, struct mg_http_message *hm,
-                             config_t *config, scheduler_t *scheduler) {
+                             config_t *config, server_t *server) {
     const char *json = hm->body.buf;
     size_t json_len = hm->body.len;
+    uint32_t old_interval_ms = config->probe_interval_ms;
+    uint32_t old_timeout_ms = config->probe_timeout_ms;
+    thresholds_t old_thresholds = config->thresholds;
 
     int val_int;
     double val_double;
@@ -146,15 +225,22 @@ void http_handle_post_config(struct mg_connection *c, struct mg_http_message *hm
         }
     }
 
-    (void)scheduler; // Config changes apply automatically on next cycle
+    // The probe thread has a config of its own
+    if (probe_thread_set_settings(server->probes, config) != 0) {
+        config->probe_interval_ms = old_interval_ms;
+        config->probe_timeout_ms = old_timeout_ms;
+        config->thresholds = old_thresholds;
+        mg_http_reply(c, 503, "Content-Type: application/json\r\n",
+                      "{\"ok\":false,\"error\":\"probe thread busy\"}\n");
+        return;
+    }
 
     mg_http_reply(c, 200, "Content-Type: application/json\r\n",
                   "{\"ok\":true}\n");
 }
 
 void http_handle_post_targets(struct mg_connection *c, struct mg_http_message *hm,
-                              config_t *config, scheduler_t *scheduler,
-                              server_t *server) {
+                              config_t *config, server_t *server) {
     const char *json = hm->body.buf;
     size_t json_len = hm->body.len;
 
@@ -183,11 +269,15 @@ void http_handle_post_targets(struct mg_connection *c, struct mg_http_message *h
             return;
         }
 
-        // Sync scheduler
-        scheduler_sync_targets(scheduler);
-
-        // Broadcast targets update to all WebSocket clients
-        server_broadcast_targets_updated(server);
+        // WebSocket clients hear of it once the probe thread has it
+        if (probe_thread_add_target(server->probes, &config->targets[idx]) != 0) {
+            char id[MAX_LABEL_LEN];
+            snprintf(id, sizeof(id), "%s", config->targets[idx].id);
+            config_remove_target(config, id);
+            mg_http_reply(c, 503, "Content-Type: application/json\r\n",
+                          "{\"ok\":false,\"error\":\"probe thread busy\"}\n");
+            return;
+        }
 
         mg_http_reply(c, 200, "Content-Type: application/json\r\n",
                       "{\"ok\":true,\"target_id\":\"%s\"}\n",
@@ -203,17 +293,19 @@ void http_handle_post_targets(struct mg_connection *c, struct mg_http_message *h
             return;
         }
 
-        if (config_remove_target(config, target_id) != 0) {
+        if (config_find_target(config, target_id) == NULL) {
             mg_http_reply(c, 404, "Content-Type: application/json\r\n",
                           "{\"ok\":false,\"error\":\"target not found\"}\n");
             return;
         }
 
-        // Sync scheduler
-        scheduler_sync_targets(scheduler);
-
-        // Broadcast targets update to all WebSocket clients
-        server_broadcast_targets_updated(server);
+        // WebSocket clients hear of it once the probe thread has dropped it
+        if (probe_thread_remove_target(server->probes, target_id) != 0) {
+            mg_http_reply(c, 503, "Content-Type: application/json\r\n",
+                          "{\"ok\":false,\"error\":\"probe thread busy\"}\n");
+            return;
+        }
+        config_remove_target(config, target_id);
 
         mg_http_reply(c, 200, "Content-Type: application/json\r\n",
                       "{\"ok\":true}\n");
@@ -224,23 +316,354 @@ void http_handle_post_targets(struct mg_connection *c, struct mg_http_message *h
     }
 }
 
+/*
+ * Series history
+ */
+
+// A point as sent: what the response's "fields" name, nothing else
+typedef struct {
+    uint64_t ts_ms;
+    uint32_t count;
+    float loss_pct;
+    float p50_ms;
+    float p95_ms;
+    float p99_ms;
+    float max_ms;
+} series_row_t;
+
+// Query result kept on the connection, formatted chunk by chunk
+typedef struct {
+    char head[256];             // {"from":...,"series":[
+    size_t head_len;
+    char (*ids)[MAX_LABEL_LEN];
+    size_t *ends;               // Series i's rows end at ends[i]
+    size_t series_count;
+    series_row_t *rows;
+    size_t row_count;
+    size_t row_capacity;
+    bool failed;                // Out of memory
+    // Send position
+    bool head_sent;
+    size_t series;              // Series being sent (series_count = tail)
+    size_t row;                 // Next row; SIZE_MAX = series opening not sent
+} series_stream_t;
+
+// series_query_cb_t: keep one series' points as rows
+static void collect_series(const char *series_id, const rollup_point_t *points, size_t count, void *ctx) {
+    series_stream_t *st = ctx;
+    if (st->failed) {
+        return;
+    }
+
+    if (st->row_count + count > st->row_capacity) {
+        size_t new_capacity = st->row_capacity > 0 ? st->row_capacity : 4096;
+        while (new_capacity < st->row_count + count) {
+            new_capacity *= 2;
+        }
+        series_row_t *grown = realloc(st->rows, new_capacity * sizeof(*grown));
+        if (grown == NULL) {
+            st->failed = true;
+            return;
+        }
+        st->rows = grown;
+        st->row_capacity = new_capacity;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        series_row_t *row = &st->rows[st->row_count++];
+        row->ts_ms = points[i].start_ms;
+        row->count = points[i].count;
+        row->loss_pct = (float)points[i].loss_pct;
+        row->p50_ms = (float)points[i].p50_ms;
+        row->p95_ms = (float)points[i].p95_ms;
+        row->p99_ms = (float)points[i].p99_ms;
+        row->max_ms = (float)points[i].max_ms;
+    }
+    snprintf(st->ids[st->series_count], MAX_LABEL_LEN, "%s", series_id);
+    st->ends[st->series_count++] = st->row_count;
+}
+
+static char *format_row(char *p, const series_row_t *row) {
+    *p++ = '[';
+    p = json_format_u64(p, row->ts_ms);
+    *p++ = ',';
+    p = json_format_u64(p, row->count);
+    *p++ = ',';
+    p = json_format_fixed(p, row->loss_pct, 3);
+    *p++ = ',';
+    p = json_format_fixed(p, row->p50_ms, 3);
+    *p++ = ',';
+    p = json_format_fixed(p, row->p95_ms, 3);
+    *p++ = ',';
+    p = json_format_fixed(p, row->p99_ms, 3);
+    *p++ = ',';
+    p = json_format_fixed(p, row->max_ms, 3);
+    *p++ = ']';
+    return p;
+}
+
+// Format the response from the send position on into dst, stopping when
+// less than SERIES_UNIT_MAX bytes are left. Returns the bytes written.
+static size_t format_stream(series_stream_t *st, char *dst, size_t room) {
+    char *p = dst;
+    char *end = dst + room - SERIES_UNIT_MAX;
+
+    if (!st->head_sent) {
+        memcpy(p, st->head, st->head_len);
+        p += st->head_len;
+        st->head_sent = true;
+    }
+    while (st->series < st->series_count && p <= end) {
+        if (st->row == SIZE_MAX) {
+            p += sprintf(p, "%s{\"target_id\":\"%s\",\"points\":[",
+                         st->series > 0 ? "," : "", st->ids[st->series]);
+            st->row = st->series > 0 ? st->ends[st->series - 1] : 0;
+            continue;
+        }
+        size_t first = st->series > 0 ? st->ends[st->series - 1] : 0;
+        size_t last = st->ends[st->series];
+        while (st->row < last && p <= end) {
+            if (st->row > first) {
+                *p++ = ',';
+            }
+            p = format_row(p, &st->rows[st->row++]);
+        }
+        if (st->row == last && p <= end) {
+            *p++ = ']';
+            *p++ = '}';
+            st->series++;
+            st->row = SIZE_MAX;
+        }
+    }
+    if (st->series == st->series_count && p <= end) {
+        memcpy(p, "]}\n", 3);
+        p += 3;
+        st->series++;
+    }
+    return (size_t)(p - dst);
+}
+
+// Unsigned query parameter, or def if absent. Returns false if malformed.
+static bool get_u64_var(struct mg_http_message *hm, const char *name, uint64_t def, uint64_t *value) {
+    char buf[32];
+    int n = mg_http_get_var(&hm->query, name, buf, sizeof(buf));
+    if (n <= 0) {
+        *value = def;
+        return n != -3;         // -3: value longer than buf
+    }
+
+    char *end;
+    unsigned long long v = strtoull(buf, &end, 10);
+    if (*end != '\0' || buf[0] == '-') {
+        return false;
+    }
+    *value = (uint64_t)v;
+    return true;
+}
+
+static series_stream_t *series_stream(const struct mg_connection *c) {
+    series_stream_t *st = NULL;
+    if (c->data[0] == SERIES_STREAM_MARK) {
+        memcpy(&st, c->data + sizeof(void *), sizeof(st));
+    }
+    return st;
+}
+
+static void series_stream_free(series_stream_t *st) {
+    if (st != NULL) {
+        free(st->ids);
+        free(st->ends);
+        free(st->rows);
+        free(st);
+    }
+}
+
+// Requested targets: one, a comma-separated list, or all of them. Returns
+// the count, or -1 if one is not configured.
+static int resolve_targets(struct mg_http_message *hm, config_t *config, const char *target_id,
+                           const char **ids) {
+    int count = 0;
+    if (target_id != NULL) {
+        target_config_t *tc = config_find_target(config, target_id);
+        if (tc == NULL) {
+            return -1;
+        }
+        ids[count++] = tc->id;
+        return count;
+    }
+
+    char *list = malloc(hm->query.len + 1);
+    if (list != NULL && mg_http_get_var(&hm->query, "targets", list, hm->query.len + 1) > 0) {
+        for (char *tok = strtok(list, ","); tok != NULL; tok = strtok(NULL, ",")) {
+            target_config_t *tc = config_find_target(config, tok);
+            if (tc == NULL || count == config->target_count) {
+                count = -1;
+                break;
+            }
+            ids[count++] = tc->id;
+        }
+    } else {
+        for (int i = 0; i < config->target_count; i++) {
+            ids[count++] = config->targets[i].id;
+        }
+    }
+    free(list);
+    return count;
+}
+
+void http_handle_get_series(struct mg_connection *c, struct mg_http_message *hm,
+                            config_t *config, sample_store_t *store, const char *target_id) {
+    if (store == NULL) {
+        mg_http_reply(c, 503, "Content-Type: application/json\r\n",
+                      "{\"ok\":false,\"error\":\"history disabled\"}\n");
+        return;
+    }
+
+    uint64_t now = wall_clock_ms();
+    uint64_t from_ms = 0, to_ms = 0, step_ms = 0;
+    bool ok = get_u64_var(hm, "to", now, &to_ms) &&
+              get_u64_var(hm, "from", to_ms > SERIES_DEFAULT_RANGE_MS ? to_ms - SERIES_DEFAULT_RANGE_MS : 0, &from_ms) &&
+              get_u64_var(hm, "step", SERIES_DEFAULT_STEP_MS, &step_ms);
+    int source = series_query_source(step_ms);
+    if (ok && source >= 0) {
+        from_ms -= from_ms % rollup_tier_width_ms((rollup_tier_t)source);
+    }
+    if (!ok || step_ms == 0 || to_ms <= from_ms ||
+        (to_ms - from_ms + step_ms - 1) / step_ms > SERIES_QUERY_MAX_POINTS) {
+        mg_http_reply(c, 400, "Content-Type: application/json\r\n",
+                      "{\"ok\":false,\"error\":\"invalid from, to or step (at most %d steps)\"}\n",
+                      SERIES_QUERY_MAX_POINTS);
+        return;
+    }
+
+    size_t slots = config->target_count > 0 ? (size_t)config->target_count : 1;
+    const char **ids = malloc(slots * sizeof(*ids));
+    series_stream_t *st = calloc(1, sizeof(*st));
+    if (st != NULL) {
+        st->ids = malloc(slots * sizeof(*st->ids));
+        st->ends = malloc(slots * sizeof(*st->ends));
+    }
+    if (ids == NULL || st == NULL || st->ids == NULL || st->ends == NULL) {
+        free(ids);
+        series_stream_free(st);
+        mg_http_reply(c, 500, "", "Out of memory\n");
+        return;
+    }
+
+    int count = resolve_targets(hm, config, target_id, ids);
+    if (count < 0) {
+        free(ids);
+        series_stream_free(st);
+        mg_http_reply(c, 404, "Content-Type: application/json\r\n",
+                      "{\"ok\":false,\"error\":\"target not found\"}\n");
+        return;
+    }
+
+    int rc = series_query_run(store, ids, (size_t)count, from_ms, to_ms, step_ms,
+                              collect_series, st);
+    free(ids);
+    if (rc != 0 || st->failed) {
+        series_stream_free(st);
+        mg_http_reply(c, 500, "Content-Type: application/json\r\n",
+                      "{\"ok\":false,\"error\":\"query failed\"}\n");
+        return;
+    }
+
+    int n = snprintf(st->head, sizeof(st->head),
+                     "{\"from\":%llu,\"to\":%llu,\"step\":%llu,\"source\":\"%s\","
+                     "\"fields\":[\"ts\",\"count\",\"loss_pct\",\"p50_ms\",\"p95_ms\",\"p99_ms\",\"max_ms\"],"
+                     "\"series\":[",
+                     (unsigned long long)from_ms, (unsigned long long)to_ms, (unsigned long long)step_ms,
+                     source >= 0 ? rollup_tier_name((rollup_tier_t)source) : "raw");
+    st->head_len = (size_t)n;
+    st->row = SIZE_MAX;
+
+    mg_printf(c, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                 "Transfer-Encoding: chunked\r\n\r\n");
+    c->data[0] = SERIES_STREAM_MARK;
+    memcpy(c->data + sizeof(void *), &st, sizeof(st));
+    http_series_continue(c);
+}
+
+void http_series_continue(struct mg_connection *c) {
+    series_stream_t *st = series_stream(c);
+    if (st == NULL || c->send.len + HTTP_SERIES_CHUNK > HTTP_SERIES_HIGH_WATER) {
+        return;
+    }
+
+    // One chunk, as large as the high-water mark allows, formatted straight
+    // into the send buffer: mongoose reallocates it on every append, so it is
+    // grown once for a fixed-width size line, the data and its CRLF, then
+    // trimmed to what was written
+    if (st->series <= st->series_count) {
+        size_t ofs = c->send.len;
+        size_t room = HTTP_SERIES_HIGH_WATER - ofs;
+        if (mg_iobuf_add(&c->send, ofs, NULL, 6 + room + 2) == 0) {
+            mg_error(c, "OOM");
+            return;
+        }
+        char *frame = (char *)c->send.buf + ofs;
+        size_t n = format_stream(st, frame + 6, room);
+        static const char hex[] = "0123456789abcdef";
+        for (int i = 0; i < 4; i++) {
+            frame[i] = hex[(n >> (12 - 4 * i)) & 0xf];
+        }
+        frame[4] = '\r';
+        frame[5] = '\n';
+        frame[6 + n] = '\r';
+        frame[6 + n + 1] = '\n';
+        c->send.len = ofs + 6 + n + 2;
+    }
+    if (st->series > st->series_count) {
+        mg_http_write_chunk(c, "", 0);
+        http_series_close(c);
+    }
+}
+
+void http_series_close(struct mg_connection *c) {
+    series_stream_free(series_stream(c));
+    if (c->data[0] == SERIES_STREAM_MARK) {
+        memset(c->data, 0, sizeof(void *) * 2);
+    }
+}
+
+bool http_series_active(const struct mg_connection *c) {
+    return c->data[0] == SERIES_STREAM_MARK;
+}
+
 void http_handle_request(struct mg_connection *c, struct mg_http_message *hm,
-                         config_t *config, scheduler_t *scheduler,
-                         server_t *server, uint64_t start_time_ms) {
+                         config_t *config, server_t *server, uint64_t start_time_ms) {
+    struct mg_str caps[2];
 
     if (mg_match(hm->uri, mg_str("/api/health"), NULL)) {
-        http_handle_health(c, start_time_ms);
+        http_handle_health(c, server, start_time_ms);
     } else if (mg_match(hm->uri, mg_str("/api/config"), NULL)) {
         if (mg_strcmp(hm->method, mg_str("GET")) == 0) {
             http_handle_get_config(c, config);
         } else if (mg_strcmp(hm->method, mg_str("POST")) == 0) {
-            http_handle_post_config(c, hm, config, scheduler);
+            http_handle_post_config(c, hm, config, server);
+        } else {
+            mg_http_reply(c, 405, "", "Method not allowed\n");
+        }
+    } else if (mg_match(hm->uri, mg_str("/api/targets/*/series"), caps)) {
+        if (mg_strcmp(hm->method, mg_str("GET")) == 0) {
+            char target_id[MAX_LABEL_LEN];
+            size_t len = caps[0].len < sizeof(target_id) - 1 ? caps[0].len : sizeof(target_id) - 1;
+            memcpy(target_id, caps[0].buf, len);
+            target_id[len] = '\0';
+            http_handle_get_series(c, hm, config, server->store, target_id);
+        } else {
+            mg_http_reply(c, 405, "", "Method not allowed\n");
+        }
+    } else if (mg_match(hm->uri, mg_str("/api/series"), NULL)) {
+        if (mg_strcmp(hm->method, mg_str("GET")) == 0) {
+            http_handle_get_series(c, hm, config, server->store, NULL);
         } else {
             mg_http_reply(c, 405, "", "Method not allowed\n");
         }
     } else if (mg_match(hm->uri, mg_str("/api/targets"), NULL)) {
         if (mg_strcmp(hm->method, mg_str("POST")) == 0) {
-            http_handle_post_targets(c, hm, config, scheduler, server);
+            http_handle_post_targets(c, hm, config, server);
         } else {
             mg_http_reply(c, 405, "", "Method not allowed\n");
         }
@@ -3,7 +3,7 @@
 
 #include "mongoose.h"
 #include "core/config.h"
-#include "core/scheduler.h"
+#include "store/sample_store.h"
 #include "server/server.h"
 
 /*
@@ -12,22 +12,46 @@
 
 // Handle HTTP request routing
 void http_handle_request(struct mg_connection *c, struct mg_http_message *hm,
-                         config_t *config, scheduler_t *scheduler,
-                         server_t *server, uint64_t start_time_ms);
+                         config_t *config, server_t *server, uint64_t start_time_ms);
 
-// GET /api/health
-void http_handle_health(struct mg_connection *c, uint64_t start_time_ms);
+// GET /api/health (with WebSocket figures when server is given)
+void http_handle_health(struct mg_connection *c, server_t *server, uint64_t start_time_ms);
 
 // GET /api/config
 void http_handle_get_config(struct mg_connection *c, config_t *config);
 
-// POST /api/config
+// POST /api/config (config is updated, and the probe thread told)
 void http_handle_post_config(struct mg_connection *c, struct mg_http_message *hm,
-                             config_t *config, scheduler_t *scheduler);
+                             config_t *config, server_t *server);
 
-// POST /api/targets
+// POST /api/targets (likewise; targets_updated goes out once the probe
+// thread has applied the change)
 void http_handle_post_targets(struct mg_connection *c, struct mg_http_message *hm,
-                              config_t *config, scheduler_t *scheduler,
-                              server_t *server);
+                              config_t *config, server_t *server);
+
+/*
+ * GET /api/targets/{id}/series and GET /api/series?targets=a,b
+ *
+ * Aggregated history (store/series_query.h) for [from, to) in steps of step
+ * (milliseconds; defaults: the last hour, one-minute steps). The query runs
+ * once and its points are kept on the connection; JSON is formatted from
+ * them one HTTP chunk at a time whenever the socket has drained below
+ * HTTP_SERIES_HIGH_WATER, so a large response never sits in one buffer.
+ * target_id is NULL for /api/series.
+ */
+#define HTTP_SERIES_CHUNK       16384   // Smallest HTTP chunk worth sending
+#define HTTP_SERIES_HIGH_WATER  65535   // Unsent bytes that pause the stream (chunks < 64 KiB)
+
+void http_handle_get_series(struct mg_connection *c, struct mg_http_message *hm,
+                            config_t *config, sample_store_t *store, const char *target_id);
+
+// Send more of a series response (on MG_EV_POLL / MG_EV_WRITE)
+void http_series_continue(struct mg_connection *c);
+
+// Drop a series response in progress (on MG_EV_CLOSE)
+void http_series_close(struct mg_connection *c);
+
+// True if c is sending a series response
+bool http_series_active(const struct mg_connection *c);
 
 #endif // NETPULSE_HTTP_HANDLERS_H
@@ -0,0 +1,179 @@
+#include "server/json_writer.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSON_POOL_SIZE      8
+#define JSON_INITIAL_SIZE   4096
+#define JSON_POOL_KEEP_MAX  (1024 * 1024)  // Larger buffers are freed, not pooled
+
+// Spare buffers (writers run on the event loop and the scheduler's threads)
+static struct {
+    pthread_mutex_t lock;
+    char *bufs[JSON_POOL_SIZE];
+    size_t capacities[JSON_POOL_SIZE];
+    int count;
+} g_pool = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static const uint64_t g_pow10[7] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+void json_writer_init(json_writer_t *w) {
+    memset(w, 0, sizeof(*w));
+
+    pthread_mutex_lock(&g_pool.lock);
+    if (g_pool.count > 0) {
+        g_pool.count--;
+        w->buf = g_pool.bufs[g_pool.count];
+        w->capacity = g_pool.capacities[g_pool.count];
+    }
+    pthread_mutex_unlock(&g_pool.lock);
+}
+
+void json_writer_free(json_writer_t *w) {
+    if (w == NULL || w->buf == NULL) {
+        return;
+    }
+
+    bool pooled = false;
+    if (w->capacity <= JSON_POOL_KEEP_MAX) {
+        pthread_mutex_lock(&g_pool.lock);
+        if (g_pool.count < JSON_POOL_SIZE) {
+            g_pool.bufs[g_pool.count] = w->buf;
+            g_pool.capacities[g_pool.count] = w->capacity;
+            g_pool.count++;
+            pooled = true;
+        }
+        pthread_mutex_unlock(&g_pool.lock);
+    }
+    if (!pooled) {
+        free(w->buf);
+    }
+    memset(w, 0, sizeof(*w));
+}
+
+char *json_writer_reserve(json_writer_t *w, size_t n) {
+    if (w->failed) {
+        return NULL;
+    }
+    if (w->len + n > w->capacity) {
+        size_t new_capacity = w->capacity > 0 ? w->capacity * 2 : JSON_INITIAL_SIZE;
+        while (new_capacity < w->len + n) {
+            new_capacity *= 2;
+        }
+        char *grown = realloc(w->buf, new_capacity);
+        if (grown == NULL) {
+            w->failed = true;
+            return NULL;
+        }
+        w->buf = grown;
+        w->capacity = new_capacity;
+    }
+    return w->buf + w->len;
+}
+
+void json_raw(json_writer_t *w, const char *s, size_t n) {
+    char *p = json_writer_reserve(w, n);
+    if (p != NULL) {
+        memcpy(p, s, n);
+        w->len += n;
+    }
+}
+
+void json_str(json_writer_t *w, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    size_t n = strlen(s);
+    char *p = json_writer_reserve(w, n * 6 + 2);     // Worst case: all \u00XX
+    if (p == NULL) {
+        return;
+    }
+
+    char *start = p;
+    *p++ = '"';
+    for (size_t i = 0; i < n; i++) {
+        unsigned char ch = (unsigned char)s[i];
+        if (ch == '"' || ch == '\\') {
+            *p++ = '\\';
+            *p++ = (char)ch;
+        } else if (ch < 0x20) {
+            memcpy(p, "\\u00", 4);
+            p[4] = hex[ch >> 4];
+            p[5] = hex[ch & 0xf];
+            p += 6;
+        } else {
+            *p++ = (char)ch;
+        }
+    }
+    *p++ = '"';
+    w->len += (size_t)(p - start);
+}
+
+void json_u64(json_writer_t *w, uint64_t v) {
+    char *p = json_writer_reserve(w, JSON_NUMBER_MAX);
+    if (p != NULL) {
+        w->len += (size_t)(json_format_u64(p, v) - p);
+    }
+}
+
+void json_bool(json_writer_t *w, bool v) {
+    if (v) {
+        json_lit(w, "true");
+    } else {
+        json_lit(w, "false");
+    }
+}
+
+void json_fixed(json_writer_t *w, double v, int decimals) {
+    char *p = json_writer_reserve(w, JSON_NUMBER_MAX);
+    if (p != NULL) {
+        w->len += (size_t)(json_format_fixed(p, v, decimals) - p);
+    }
+}
+
+char *json_format_u64(char *p, uint64_t v) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v != 0);
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+    return p;
+}
+
+char *json_format_fixed(char *p, double v, int decimals) {
+    if (!isfinite(v)) {
+        memcpy(p, "null", 4);
+        return p + 4;
+    }
+    if (decimals < 0) {
+        decimals = 0;
+    } else if (decimals > 6) {
+        decimals = 6;
+    }
+    if (fabs(v) >= 1e12) {
+        return p + snprintf(p, JSON_NUMBER_MAX, "%.17g", v);
+    }
+
+    // Scaled and rounded half away from zero; integer maths from here on
+    uint64_t scale = g_pow10[decimals];
+    double scaled = fabs(v) * (double)scale + 0.5;
+    uint64_t units = (uint64_t)scaled;
+    if (v < 0 && units != 0) {
+        *p++ = '-';
+    }
+    p = json_format_u64(p, units / scale);
+    if (decimals > 0) {
+        uint64_t frac = units % scale;
+        *p++ = '.';
+        for (int i = decimals - 1; i >= 0; i--) {
+            p[i] = (char)('0' + frac % 10);
+            frac /= 10;
+        }
+        p += decimals;
+    }
+    return p;
+}
@@ -0,0 +1,56 @@
+#ifndef NETPULSE_JSON_WRITER_H
+#define NETPULSE_JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Growable JSON output buffer
+ *
+ * Messages are written into a buffer taken from a small pool and grown as
+ * needed, so output is never truncated and, once the pool has warmed up,
+ * building a message allocates nothing. Numbers are formatted by hand
+ * (json_format_*) rather than through snprintf. The caller writes the
+ * punctuation; the writer only tracks the buffer. Running out of memory
+ * sets failed and drops further output.
+ */
+
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t capacity;
+    bool failed;
+} json_writer_t;
+
+#define JSON_NUMBER_MAX     32      // Longest json_format_* output
+
+// Start an empty message in a pooled buffer
+void json_writer_init(json_writer_t *w);
+
+// Give the buffer back to the pool
+void json_writer_free(json_writer_t *w);
+
+// Room for n more bytes at buf + len (the caller advances len), or NULL
+char *json_writer_reserve(json_writer_t *w, size_t n);
+
+void json_raw(json_writer_t *w, const char *s, size_t n);
+
+// A string literal, copied without escaping
+#define json_lit(w, s) json_raw((w), (s), sizeof(s) - 1)
+
+// A quoted, escaped string
+void json_str(json_writer_t *w, const char *s);
+
+void json_u64(json_writer_t *w, uint64_t v);
+void json_bool(json_writer_t *w, bool v);
+
+// A number with the given decimals (0-6), null if not finite
+void json_fixed(json_writer_t *w, double v, int decimals);
+
+// Formatting into a caller's buffer (at least JSON_NUMBER_MAX bytes free);
+// these return the end of what was written
+char *json_format_u64(char *p, uint64_t v);
+char *json_format_fixed(char *p, double v, int decimals);
+
+#endif // NETPULSE_JSON_WRITER_H
@@ -1,28 +1,43 @@
 #include "server/server.h"
 #include "server/http_handlers.h"
 #include "server/ws_handlers.h"
+#include "server/ws_binary.h"
 #include "platform/platform.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-// Forward declaration of event handler
+// Forward declarations (event handler, probe update handler)
 static void server_event_handler(struct mg_connection *c, int ev, void *ev_data);
+static void on_probe_update(const probe_msg_t *msg, void *ctx);
 
 // Global server pointer for callbacks (mongoose doesn't have user context in event handler signature in older versions)
 static server_t *g_server = NULL;
 
-int server_init(server_t *srv, config_t *config, scheduler_t *scheduler) {
-    if (srv == NULL || config == NULL || scheduler == NULL) {
+int server_init(server_t *srv, config_t *config, sample_store_t *store) {
+    if (srv == NULL || config == NULL) {
         return -1;
     }
 
     memset(srv, 0, sizeof(*srv));
     srv->config = config;
-    srv->scheduler = scheduler;
+    srv->store = store;
     srv->start_time_ms = now_ms();
 
     g_server = srv;
 
+    target_view_init(&srv->targets);
+    ws_batch_init(&srv->ws_batch);
+    ws_snapshot_init(&srv->ws_snapshot);
+    srv->ws_hub.deflate_min = config->ws_deflate_min;
+    srv->ws_hub.queue_high = (size_t)config->ws_queue_kb * 1024;
+    ws_replay_init(&srv->ws_replay, (size_t)config->ws_replay_kb * 1024);
+
+    // Sequence numbers restart with the daemon; a client holding one from
+    // an earlier run must not resume with it
+    uint64_t stream;
+    mg_random(&stream, sizeof(stream));
+    snprintf(srv->ws_stream, sizeof(srv->ws_stream), "%016llx", (unsigned long long)stream);
     mg_mgr_init(&srv->mgr);
 
     char addr[64];
@@ -33,6 +48,13 @@ int server_init(server_t *srv, config_t *config, scheduler_t *scheduler) {
         fprintf(stderr, "Failed to listen on %s\n", addr);
         return -1;
     }
+    srv->wake_id = srv->listener->id;
+
+    // For the probe thread to interrupt mg_mgr_poll
+    if (!mg_wakeup_init(&srv->mgr)) {
+        fprintf(stderr, "Failed to set up server wakeups\n");
+        return -1;
+    }
 
     printf("NetPulse daemon listening on %s\n", addr);
     printf("WebSocket endpoint: ws://localhost:%u/ws\n", config->http_port);
@@ -43,26 +65,223 @@ int server_init(server_t *srv, config_t *config, scheduler_t *scheduler) {
 void server_free(server_t *srv) {
     if (srv != NULL) {
         mg_mgr_free(&srv->mgr);
+        ws_hub_cache_clear(&srv->ws_snapshot_frames);
+        ws_hub_free(&srv->ws_hub);
+        ws_batch_free(&srv->ws_batch);
+        ws_replay_free(&srv->ws_replay);
+        ws_snapshot_free(&srv->ws_snapshot);
+        target_view_free(&srv->targets);
         g_server = NULL;
     }
 }
 
+// Hub subscription of a WebSocket connection, kept in c->data after the 'W'
+static ws_client_t *ws_client_of(const struct mg_connection *c) {
+    ws_client_t *client = NULL;
+    if (c->data[0] == 'W') {
+        memcpy(&client, c->data + sizeof(void *), sizeof(client));
+    }
+    return client;
+}
+
 void server_poll(server_t *srv, int timeout_ms) {
     if (srv != NULL) {
         mg_mgr_poll(&srv->mgr, timeout_ms);
     }
 }
 
-void server_broadcast_ws(server_t *srv, const char *msg, size_t len) {
-    if (srv == NULL || msg == NULL) {
+// Reactor handler: Mongoose's epoll set has ready connections
+static void on_server_ready(int fd, unsigned events, void *ctx) {
+    server_t *srv = (server_t *)ctx;
+    (void)fd;
+    (void)events;
+    mg_mgr_poll(&srv->mgr, 0);
+}
+
+int server_attach_reactor(server_t *srv, reactor_t *reactor) {
+    if (srv == NULL || reactor == NULL) {
+        return -1;
+    }
+
+#if MG_ENABLE_EPOLL
+    // Mongoose keeps every connection in its own epoll set; nesting that fd
+    // in the reactor makes it readable whenever any connection is ready.
+    return reactor_add(reactor, srv->mgr.epoll_fd, REACTOR_EV_READ, on_server_ready, srv);
+#else
+    return -1;
+#endif
+}
+
+// Whether updates are worth building: someone is subscribed, or the last
+// subscriber to leave could still catch up from the replay log for less
+// than a snapshot. Once that is no longer so, the log is reset.
+static bool ws_wanted(server_t *srv) {
+    if (srv->ws_hub.clients != NULL) {
+        return true;
+    }
+    if (srv->ws_recording) {
+        if (ws_replay_bytes_after(&srv->ws_replay, srv->ws_resume_seq) < srv->ws_snapshot_len) {
+            return true;
+        }
+        srv->ws_recording = false;
+        ws_replay_reset(&srv->ws_replay);
+    }
+    return false;
+}
+
+// Broadcast the pending batch now, whether or not it is due
+static void send_batch(server_t *srv) {
+    if (srv->ws_batch.count == 0) {
         return;
     }
 
-    for (struct mg_connection *c = srv->mgr.conns; c != NULL; c = c->next) {
-        if (c->data[0] == 'W') {  // WebSocket connection
-            mg_ws_send(c, msg, len, WEBSOCKET_OP_TEXT);
+    // Subscribers that have fallen behind get the batch without its samples.
+    // Its metrics still carry each target's current RTT, and its seq is the
+    // same, so they see a contiguous stream, just without the sample detail.
+    ws_hub_t *hub = &srv->ws_hub;
+    bool lite = hub->congested_clients > 0 && srv->ws_batch.sample_count > 0;
+    uint64_t reduced = hub->reduced;
+
+    srv->ws_batch.seq = ws_replay_next(&srv->ws_replay);
+    json_writer_t w;
+    json_writer_t l;
+    json_writer_init(&w);
+    json_writer_init(&l);
+    if (ws_build_batch_msg(&w, &srv->ws_batch, true) == 0) {
+        ws_replay_append(&srv->ws_replay, srv->ws_batch.seq, w.buf, w.len);
+        if (lite && ws_build_batch_msg(&l, &srv->ws_batch, false) == 0) {
+            ws_hub_broadcast_lite(hub, WS_PROTOCOL_JSON, w.buf, w.len, l.buf, l.len,
+                                  WEBSOCKET_OP_TEXT);
+        } else {
+            ws_hub_broadcast(hub, WS_PROTOCOL_JSON, w.buf, w.len, WEBSOCKET_OP_TEXT);
+        }
+    }
+    w.len = 0;
+    l.len = 0;
+    if (ws_build_batch_bin(&w, &srv->ws_batch, true) == 0) {
+        if (lite && ws_build_batch_bin(&l, &srv->ws_batch, false) == 0) {
+            ws_hub_broadcast_lite(hub, WS_PROTOCOL_BINARY, w.buf, w.len, l.buf, l.len,
+                                  WEBSOCKET_OP_BINARY);
+        } else {
+            ws_hub_broadcast(hub, WS_PROTOCOL_BINARY, w.buf, w.len, WEBSOCKET_OP_BINARY);
+        }
+    }
+    json_writer_free(&l);
+    json_writer_free(&w);
+    srv->ws_dropped_samples += (hub->reduced - reduced) * srv->ws_batch.sample_count;
+    ws_batch_clear(&srv->ws_batch);
+}
+
+// Build batches only in the encodings someone is subscribed for. The replay
+// log keeps JSON (binary subscribers take JSON batches too), so that is
+// always built while the log is on.
+static void update_batch_encodings(server_t *srv) {
+    srv->ws_batch.json = srv->ws_hub.protocol_clients[WS_PROTOCOL_JSON] > 0 ||
+                         srv->ws_replay.max_bytes > 0;
+    srv->ws_batch.binary = srv->ws_hub.protocol_clients[WS_PROTOCOL_BINARY] > 0;
+}
+
+// permessage-deflate settings for an upgrade request (the same answer at
+// MG_EV_HTTP_MSG, where the response header is sent, and at MG_EV_WS_OPEN)
+static ws_deflate_mode_t negotiate_deflate(struct mg_http_message *hm, char *response, size_t size) {
+    return ws_hub_negotiate_deflate(g_server->config->ws_deflate,
+                                    mg_http_get_header(hm, "Sec-WebSocket-Extensions"),
+                                    response, size);
+}
+
+// Binary batches for clients that list WS_BINARY_PROTOCOL among the
+// subprotocols they offer
+static ws_protocol_t requested_protocol(struct mg_http_message *hm) {
+    struct mg_str *offer = mg_http_get_header(hm, "Sec-WebSocket-Protocol");
+    return ws_hub_offers(offer, WS_BINARY_PROTOCOL) ? WS_PROTOCOL_BINARY : WS_PROTOCOL_JSON;
+}
+
+// Mongoose answers an upgrade with whatever Sec-WebSocket-Protocol the
+// request holds, but the reply must name one offered subprotocol or none.
+// Narrow the offer to the one we accept, or hide it if there is none.
+static void settle_protocol(struct mg_http_message *hm) {
+    for (size_t i = 0; i < MG_MAX_HTTP_HEADERS && hm->headers[i].name.len > 0; i++) {
+        struct mg_http_header *h = &hm->headers[i];
+        if (mg_strcasecmp(h->name, mg_str("Sec-WebSocket-Protocol")) != 0) {
+            continue;
         }
+        if (ws_hub_offers(&h->value, WS_BINARY_PROTOCOL)) {
+            h->value = mg_str(WS_BINARY_PROTOCOL);
+        } else {
+            h->name = mg_str("X-Declined-WebSocket-Protocol");
+        }
+    }
+}
+
+// Where a reconnecting client left off: ?stream=...&seq=N on the upgrade
+// request, for this run's stream. Returns false if it didn't say (or it
+// was another run).
+static bool resume_point(struct mg_http_message *hm, uint64_t *seq) {
+    char stream[sizeof(g_server->ws_stream)];
+    char number[24];
+    if (mg_http_get_var(&hm->query, "stream", stream, sizeof(stream)) <= 0 ||
+        strcmp(stream, g_server->ws_stream) != 0 ||
+        mg_http_get_var(&hm->query, "seq", number, sizeof(number)) <= 0) {
+        return false;
+    }
+    char *end;
+    *seq = strtoull(number, &end, 10);
+    return *end == '\0';
+}
+
+// Bring a new subscriber up to date: the messages it missed if it is
+// resuming and they are all in the replay log and smaller than a snapshot,
+// a snapshot otherwise. Sent through the hub, so they are compressed like
+// everything after them.
+static void send_catch_up(server_t *srv, ws_client_t *client, struct mg_http_message *hm) {
+    uint64_t since;
+    if (resume_point(hm, &since) &&
+        ws_replay_bytes_after(&srv->ws_replay, since) < srv->ws_snapshot_len) {
+        const ws_replay_entry_t *entry;
+        for (size_t i = 0; (entry = ws_replay_after(&srv->ws_replay, since, i)) != NULL; i++) {
+            ws_hub_send(&srv->ws_hub, client, entry->data, entry->len, WEBSOCKET_OP_TEXT);
+        }
+        srv->ws_resumes++;
+        return;
+    }
+
+    // Subscribers connecting before anything changes share the message and
+    // its frames
+    ws_snapshot_t *snap = &srv->ws_snapshot;
+    int changed = ws_snapshot_update(snap, srv->config, &srv->targets, srv->ws_stream,
+                                     srv->ws_replay.seq);
+    if (changed != 0) {
+        ws_hub_cache_clear(&srv->ws_snapshot_frames);
     }
+    if (changed >= 0) {
+        ws_hub_send_cached(&srv->ws_hub, client, &srv->ws_snapshot_frames,
+                           snap->msg.buf, snap->msg.len, WEBSOCKET_OP_TEXT);
+        srv->ws_snapshot_len = snap->msg.len;
+        srv->ws_snapshots++;
+    }
+}
+
+int server_flush_batch(server_t *srv) {
+    if (srv == NULL || srv->ws_batch.count == 0) {
+        return -1;
+    }
+
+    uint64_t due_ms = srv->ws_batch.started_ms + srv->config->ws_batch_ms;
+    uint64_t now = now_ms();
+    if (now < due_ms) {
+        return (int)(due_ms - now);
+    }
+    send_batch(srv);
+    return -1;
+}
+
+void server_broadcast_ws(server_t *srv, const char *msg, size_t len) {
+    if (srv == NULL || msg == NULL) {
+        return;
+    }
+
+    send_batch(srv);
+    ws_hub_broadcast(&srv->ws_hub, WS_PROTOCOL_ANY, msg, len, WEBSOCKET_OP_TEXT);
 }
 
 void server_broadcast_targets_updated(server_t *srv) {
@@ -70,11 +289,19 @@ void server_broadcast_targets_updated(server_t *srv) {
         return;
     }
 
-    char buf[8192];
-    int len = ws_build_targets_updated_msg(buf, sizeof(buf), srv->config, srv->scheduler);
-    if (len > 0) {
-        server_broadcast_ws(srv, buf, (size_t)len);
+    send_batch(srv);
+    if (!ws_wanted(srv)) {
+        return;
+    }
+
+    uint64_t seq = ws_replay_next(&srv->ws_replay);
+    json_writer_t w;
+    json_writer_init(&w);
+    if (ws_build_targets_updated_msg(&w, srv->config, &srv->targets, seq) == 0) {
+        ws_replay_append(&srv->ws_replay, seq, w.buf, w.len);
+        ws_hub_broadcast(&srv->ws_hub, WS_PROTOCOL_ANY, w.buf, w.len, WEBSOCKET_OP_TEXT);
     }
+    json_writer_free(&w);
 }
 
 static void server_event_handler(struct mg_connection *c, int ev, void *ev_data) {
@@ -88,16 +315,33 @@ static void server_event_handler(struct mg_connection *c, int ev, void *ev_data)
 
             // Check for WebSocket upgrade
             if (mg_match(hm->uri, mg_str("/ws"), NULL)) {
-                mg_ws_upgrade(c, hm, NULL);
+                char extensions[WS_DEFLATE_RESPONSE_MAX];
+                negotiate_deflate(hm, extensions, sizeof(extensions));
+                settle_protocol(hm);
+                mg_ws_upgrade(c, hm, "%s", extensions);
             } else {
                 // Handle HTTP request
-                http_handle_request(c, hm, g_server->config, g_server->scheduler, g_server, g_server->start_time_ms);
+                http_handle_request(c, hm, g_server->config, g_server, g_server->start_time_ms);
             }
             break;
         }
 
         case MG_EV_WS_OPEN: {
-            ws_handle_open(c, g_server->config, g_server->scheduler);
+            // The snapshot already holds what is pending; send that to the
+            // others first so the new client doesn't get it twice
+            send_batch(g_server);
+            ws_handle_open(c);
+            struct mg_http_message *hm = (struct mg_http_message *)ev_data;
+            ws_client_t *client = ws_hub_join(&g_server->ws_hub, c, requested_protocol(hm),
+                                              negotiate_deflate(hm, NULL, 0));
+            if (client == NULL) {
+                mg_error(c, "OOM");
+                break;
+            }
+            memcpy(c->data + sizeof(void *), &client, sizeof(client));
+            update_batch_encodings(g_server);
+            g_server->ws_recording = true;
+            send_catch_up(g_server, client, hm);
             break;
         }
 
@@ -107,9 +351,31 @@ static void server_event_handler(struct mg_connection *c, int ev, void *ev_data)
             break;
         }
 
+        case MG_EV_POLL:
+        case MG_EV_WRITE: {
+            // Top up a series response or queued broadcasts as the socket drains
+            if (http_series_active(c)) {
+                http_series_continue(c);
+            } else if (c->data[0] == 'W') {
+                ws_hub_flush(&g_server->ws_hub, ws_client_of(c));
+            }
+            break;
+        }
+
+        case MG_EV_WAKEUP:
+            probe_thread_drain(g_server->probes, on_probe_update, g_server);
+            break;
+
         case MG_EV_CLOSE: {
             if (c->data[0] == 'W') {
+                ws_hub_leave(&g_server->ws_hub, ws_client_of(c));
                 ws_handle_close(c);
+                update_batch_encodings(g_server);
+                if (g_server->ws_hub.clients == NULL) {
+                    g_server->ws_resume_seq = g_server->ws_replay.seq;
+                }
+            } else if (http_series_active(c)) {
+                http_series_close(c);
             }
             break;
         }
@@ -119,37 +385,69 @@ static void server_event_handler(struct mg_connection *c, int ev, void *ev_data)
     }
 }
 
-// Callback wrappers for scheduler integration
-static void on_sample(const char *target_id, const sample_t *sample, void *ctx) {
+// Apply one probe thread update: the server's copy of the targets always,
+// the pending batch only while someone is subscribed or about to resume
+static void on_probe_update(const probe_msg_t *msg, void *ctx) {
     server_t *srv = (server_t *)ctx;
-    char buf[512];
-    int len = ws_build_sample_msg(buf, sizeof(buf), target_id, sample);
-    if (len > 0) {
-        server_broadcast_ws(srv, buf, (size_t)len);
+    target_view_t *view = &srv->targets;
+    int index = msg->index;
+
+    switch (msg->type) {
+        case PROBE_MSG_SAMPLE:
+            target_view_push_sample(view, index, &msg->u.sample);
+            if (index < view->count && ws_wanted(srv)) {
+                ws_batch_add_sample(&srv->ws_batch, index, view->targets[index].config.id,
+                                    &msg->u.sample);
+            }
+            break;
+
+        case PROBE_MSG_METRICS:
+            target_view_set_metrics(view, index, &msg->u.metrics);
+            if (index < view->count && ws_wanted(srv)) {
+                ws_batch_add_metrics(&srv->ws_batch, index, view->targets[index].config.id,
+                                     &msg->u.metrics);
+            }
+            break;
+
+        case PROBE_MSG_EVENT:
+            if (ws_wanted(srv)) {
+                ws_batch_add_event(&srv->ws_batch, index, &msg->u.event);
+            }
+            break;
+
+        case PROBE_MSG_TARGET_ADDED:
+            if (target_view_add(view, &msg->u.target) < 0) {
+                fprintf(stderr, "[server] Out of memory adding target %s\n", msg->u.target.id);
+            }
+            server_broadcast_targets_updated(srv);
+            break;
+
+        case PROBE_MSG_TARGET_REMOVED:
+            if (index < 0) {
+                // Never probed: drop it from the config it was added to
+                config_remove_target(srv->config, msg->u.target.id);
+                break;
+            }
+            target_view_remove(view, index);
+            server_broadcast_targets_updated(srv);
+            break;
     }
 }
 
-static void on_metrics(const char *target_id, const metrics_t *metrics, void *ctx) {
+// Probe thread: updates are waiting (mg_wakeup is safe from any thread)
+static void wake_server(void *ctx) {
     server_t *srv = (server_t *)ctx;
-    char buf[512];
-    int len = ws_build_metrics_msg(buf, sizeof(buf), target_id, metrics);
-    if (len > 0) {
-        server_broadcast_ws(srv, buf, (size_t)len);
-    }
+    mg_wakeup(&srv->mgr, srv->wake_id, "", 0);
 }
 
-static void on_event(const event_t *event, void *ctx) {
-    server_t *srv = (server_t *)ctx;
-    char buf[512];
-    int len = ws_build_event_msg(buf, sizeof(buf), event);
-    if (len > 0) {
-        server_broadcast_ws(srv, buf, (size_t)len);
+int server_start_probes(server_t *srv, probe_thread_t *probes) {
+    if (srv == NULL || probes == NULL) {
+        return -1;
     }
-}
 
-// Call this after server_init to wire up callbacks
-void server_setup_callbacks(server_t *srv, scheduler_t *sched) {
-    scheduler_set_sample_callback(sched, on_sample, srv);
-    scheduler_set_metrics_callback(sched, on_metrics, srv);
-    scheduler_set_event_callback(sched, on_event, srv);
+    if (target_view_load(&srv->targets, probes->sched) != 0) {
+        return -1;
+    }
+    srv->probes = probes;
+    return probe_thread_start(probes, wake_server, srv);
 }
@@ -3,22 +3,49 @@
 
 #include "mongoose.h"
 #include "core/config.h"
-#include "core/scheduler.h"
+#include "core/probe_thread.h"
+#include "platform/reactor.h"
+#include "server/ws_hub.h"
+#include "server/ws_handlers.h"
+#include "server/ws_replay.h"
+#include "server/target_view.h"
+#include "store/sample_store.h"
 
 /*
  * HTTP + WebSocket server using Mongoose
+ *
+ * Runs on the main thread, apart from probing (core/probe_thread.h): it
+ * learns of samples, metrics, events and target changes by draining the
+ * probe thread's update queue when woken for it, and keeps what snapshots
+ * need in its own copy of the targets. Target and settings changes made
+ * over HTTP go to its config at once and to the probe thread as commands.
  */
 
 typedef struct {
     struct mg_mgr mgr;
     struct mg_connection *listener;
     config_t *config;
-    scheduler_t *scheduler;
+    probe_thread_t *probes;         // Where updates come from (NULL until attached)
+    sample_store_t *store;          // Sample history for series queries (NULL = none)
+    target_view_t targets;          // The probe thread's targets, as of the last drain
+    unsigned long wake_id;          // Connection the probe thread's wakeups go to
     uint64_t start_time_ms;
+    ws_hub_t ws_hub;                // WebSocket subscribers
+    ws_batch_t ws_batch;            // Updates not yet sent to subscribers
+    ws_replay_t ws_replay;          // Recent messages, for subscribers that reconnect
+    char ws_stream[17];             // Names this run's message numbering
+    bool ws_recording;              // Building updates for the replay log
+    uint64_t ws_resume_seq;         // Last message the last subscriber to leave saw
+    ws_snapshot_t ws_snapshot;      // Serialized snapshot, kept up to date on demand
+    ws_hub_cache_t ws_snapshot_frames;  // ... and its frames
+    size_t ws_snapshot_len;         // Size of the last snapshot sent
+    uint64_t ws_snapshots;          // Subscribers that got a snapshot
+    uint64_t ws_resumes;            // ... and that caught up from the replay log
+    uint64_t ws_dropped_samples;    // Samples left out of batches for congested subscribers
 } server_t;
 
 // Initialize server
-int server_init(server_t *srv, config_t *config, scheduler_t *scheduler);
+int server_init(server_t *srv, config_t *config, sample_store_t *store);
 
 // Free server resources
 void server_free(server_t *srv);
@@ -27,13 +54,28 @@ void server_free(server_t *srv);
 // timeout_ms: how long to wait for events
 void server_poll(server_t *srv, int timeout_ms);
 
-// Broadcast message to all WebSocket clients
+// Register the Mongoose listener and connections with an event reactor, so
+// server I/O wakes the main loop instead of being polled on a timer.
+// Returns 0 on success, -1 if Mongoose was built without epoll.
+int server_attach_reactor(server_t *srv, reactor_t *reactor);
+
+// Send the pending batch of samples, metrics and events to WebSocket clients
+// once config->ws_batch_ms has passed since its first update (0 = at once).
+// Call once per loop. Returns ms until the pending batch is due, or -1
+// if nothing is pending.
+int server_flush_batch(server_t *srv);
+
+// Broadcast message to all WebSocket clients (framed once, shared by all).
+// Sends the pending batch first, so clients see updates in order. The
+// message has no sequence number and isn't replayed to reconnecting clients.
 void server_broadcast_ws(server_t *srv, const char *msg, size_t len);
 
 // Broadcast targets updated message to all WebSocket clients
 void server_broadcast_targets_updated(server_t *srv);
 
-// Wire up scheduler callbacks to broadcast via WebSocket
-void server_setup_callbacks(server_t *srv, scheduler_t *sched);
+// Take over the probe thread's updates: copy its scheduler's targets (call
+// before probe_thread_start), then start it, waking the server loop
+// whenever updates are waiting. Returns 0 on success, -1 on error.
+int server_start_probes(server_t *srv, probe_thread_t *probes);
 
 #endif // NETPULSE_SERVER_H
@@ -0,0 +1,120 @@
+#include "server/target_view.h"
+#include <stdlib.h>
+#include <string.h>
+
+void target_view_init(target_view_t *view) {
+    memset(view, 0, sizeof(*view));
+}
+
+void target_view_free(target_view_t *view) {
+    if (view == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < view->count; i++) {
+        ring_buffer_free(&view->targets[i].samples);
+    }
+    free(view->targets);
+    view->targets = NULL;
+    view->count = 0;
+    view->capacity = 0;
+}
+
+// Make room for one more target, doubling the array when full
+static int reserve_target(target_view_t *view) {
+    if (view->count < view->capacity) {
+        return 0;
+    }
+
+    int capacity = view->capacity > 0 ? view->capacity * 2 : 8;
+    target_view_entry_t *targets = realloc(view->targets, (size_t)capacity * sizeof(*targets));
+    if (targets == NULL) {
+        return -1;
+    }
+    view->targets = targets;
+    view->capacity = capacity;
+    return 0;
+}
+
+int target_view_add(target_view_t *view, const target_config_t *config) {
+    if (view == NULL || config == NULL || reserve_target(view) != 0) {
+        return -1;
+    }
+
+    target_view_entry_t *entry = &view->targets[view->count];
+    memset(entry, 0, sizeof(*entry));
+    if (ring_buffer_init(&entry->samples, sizeof(sample_t), DEFAULT_WINDOW_SIZE) != 0) {
+        return -1;
+    }
+    entry->config = *config;
+    entry->version = ++view->versions;
+    entry->created = entry->version;
+    view->versions++;           // The list itself changed
+    return view->count++;
+}
+
+void target_view_remove(target_view_t *view, int index) {
+    if (view == NULL || index < 0 || index >= view->count) {
+        return;
+    }
+
+    ring_buffer_free(&view->targets[index].samples);
+    memmove(&view->targets[index], &view->targets[index + 1],
+            (size_t)(view->count - index - 1) * sizeof(*view->targets));
+    view->count--;
+    view->versions++;
+}
+
+int target_view_load(target_view_t *view, const scheduler_t *sched) {
+    if (view == NULL || sched == NULL) {
+        return -1;
+    }
+
+    target_view_free(view);
+    for (int i = 0; i < sched->target_count; i++) {
+        const target_state_t *ts = &sched->targets[i];
+        if (target_view_add(view, &sched->target_configs[i]) < 0) {
+            target_view_free(view);
+            return -1;
+        }
+
+        target_view_entry_t *entry = &view->targets[i];
+        ring_buffer_t *window = (ring_buffer_t *)&ts->window.samples;
+        for (size_t j = 0; j < ring_buffer_count(window); j++) {
+            ring_buffer_push(&entry->samples, ring_buffer_get(window, j));
+        }
+        entry->pushes = ts->window.pushes;
+        entry->metrics = ts->metrics;
+    }
+    return 0;
+}
+
+int target_view_find(const target_view_t *view, const char *id) {
+    for (int i = 0; i < view->count; i++) {
+        if (strcmp(view->targets[i].config.id, id) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void target_view_push_sample(target_view_t *view, int index, const sample_t *sample) {
+    if (index < 0 || index >= view->count) {
+        return;
+    }
+
+    target_view_entry_t *entry = &view->targets[index];
+    ring_buffer_push(&entry->samples, sample);
+    entry->pushes++;
+    entry->version = ++view->versions;
+}
+
+void target_view_set_metrics(target_view_t *view, int index, const metrics_t *metrics) {
+    if (index < 0 || index >= view->count) {
+        return;
+    }
+
+    target_view_entry_t *entry = &view->targets[index];
+    entry->metrics = *metrics;
+    entry->version = ++view->versions;
+}
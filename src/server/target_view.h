@@ -0,0 +1,62 @@
+#ifndef NETPULSE_TARGET_VIEW_H
+#define NETPULSE_TARGET_VIEW_H
+
+#include <stdint.h>
+#include "core/config.h"
+#include "core/stats.h"
+#include "core/ring_buffer.h"
+#include "core/scheduler.h"
+
+/*
+ * The server's copy of the targets
+ *
+ * The scheduler belongs to the probe thread (core/probe_thread.h), so the
+ * server builds snapshots and target lists from this copy instead, kept up
+ * to date from the probe thread's updates: each target's config, its sample
+ * window (the scheduler's, sample for sample) and its latest metrics.
+ * Indices are the scheduler's as of the last target change applied, which
+ * is what WebSocket clients get as target handles.
+ *
+ * version changes with a target's window or metrics and is unique across
+ * targets, as target_state_t's is (the snapshot cache relies on both).
+ * Server thread only.
+ */
+
+typedef struct {
+    target_config_t config;
+    ring_buffer_t samples;          // Sample window (DEFAULT_WINDOW_SIZE)
+    uint64_t pushes;                // Samples pushed since the target was added
+    metrics_t metrics;
+    uint64_t version;
+    uint64_t created;               // version when added (tells a target re-added
+                                    // under the same id from the one before)
+} target_view_entry_t;
+
+typedef struct {
+    target_view_entry_t *targets;
+    int count;
+    int capacity;
+    uint64_t versions;              // Last version handed out (also bumped by target changes)
+} target_view_t;
+
+void target_view_init(target_view_t *view);
+void target_view_free(target_view_t *view);
+
+// Replace the view with the scheduler's targets (before the probe thread
+// starts). Returns 0 on success, -1 if out of memory.
+int target_view_load(target_view_t *view, const scheduler_t *sched);
+
+// Append a target with an empty window. Returns its index, or -1 if out
+// of memory.
+int target_view_add(target_view_t *view, const target_config_t *config);
+
+// Remove the target at index (the ones after it move down)
+void target_view_remove(target_view_t *view, int index);
+
+// Index of the target with this id, or -1
+int target_view_find(const target_view_t *view, const char *id);
+
+void target_view_push_sample(target_view_t *view, int index, const sample_t *sample);
+void target_view_set_metrics(target_view_t *view, int index, const metrics_t *metrics);
+
+#endif // NETPULSE_TARGET_VIEW_H
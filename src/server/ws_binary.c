@@ -0,0 +1,44 @@
+#include "server/ws_binary.h"
+#include <string.h>
+
+void bin_u8(json_writer_t *w, uint8_t v) {
+    char *p = json_writer_reserve(w, 1);
+    if (p != NULL) {
+        *p = (char)v;
+        w->len++;
+    }
+}
+
+void bin_varint(json_writer_t *w, uint64_t v) {
+    char *p = json_writer_reserve(w, WS_VARINT_MAX);
+    if (p == NULL) {
+        return;
+    }
+
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (char)v;
+    w->len += n;
+}
+
+void bin_zigzag(json_writer_t *w, int64_t v) {
+    bin_varint(w, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+void bin_f32(json_writer_t *w, double v) {
+    char *p = json_writer_reserve(w, 4);
+    if (p == NULL) {
+        return;
+    }
+
+    float f = (float)v;
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    for (int i = 0; i < 4; i++) {
+        p[i] = (char)(bits >> (8 * i));
+    }
+    w->len += 4;
+}
@@ -0,0 +1,40 @@
+#ifndef NETPULSE_WS_BINARY_H
+#define NETPULSE_WS_BINARY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "server/json_writer.h"
+
+/*
+ * Binary WebSocket subprotocol
+ *
+ * A client that offers WS_BINARY_PROTOCOL in Sec-WebSocket-Protocol gets
+ * batches as binary frames; everything else (snapshot, targets_updated,
+ * config_updated) stays JSON. Targets are named by handle: their position
+ * in the last snapshot or targets_updated "targets" array. Little-endian:
+ *
+ *   u8 WS_BINARY_BATCH, u8 WS_BINARY_VERSION, varint seq, varint base_ts (ms)
+ *   varint n, n x { varint handle, zigzag ts - base_ts, f32 rtt_ms },
+ *            (n + 7) / 8 bytes of success bits, least significant first
+ *   varint n, n x { varint handle, f32 x 8 (current_rtt, max_rtt, loss,
+ *            jitter, p50, p95, p99, p999), 4 x { varint samples,
+ *            f32 x 6 (loss, jitter, p50, p95, p99, max_rtt) } }
+ *   varint n, n x { varint handle, zigzag ts - base_ts, u8 event type,
+ *            f32 value, f32 threshold, varint duration_s,
+ *            varint length, reason bytes }
+ *
+ * Varints are LEB128; zigzag maps signed deltas onto them. The writers
+ * below use a json_writer_t as a plain byte buffer.
+ */
+
+#define WS_BINARY_PROTOCOL  "netpulse.bin.v1"
+#define WS_BINARY_BATCH     1
+#define WS_BINARY_VERSION   2
+#define WS_VARINT_MAX       10      // Longest encoded varint
+
+void bin_u8(json_writer_t *w, uint8_t v);
+void bin_varint(json_writer_t *w, uint64_t v);
+void bin_zigzag(json_writer_t *w, int64_t v);
+void bin_f32(json_writer_t *w, double v);
+
+#endif // NETPULSE_WS_BINARY_H
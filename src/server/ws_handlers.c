@@ -1,13 +1,130 @@
 #include "server/ws_handlers.h"
+#include "server/ws_binary.h"
+#include "platform/platform.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-void ws_handle_open(struct mg_connection *c, config_t *config, scheduler_t *scheduler) {
+// Window names in the metrics "windows" object, in metrics_t order
+static const char *const g_window_names[METRICS_WINDOW_COUNT] = { "1m", "5m", "1h", "24h" };
+
+// Write a metrics object (sample window fields plus every window)
+static void write_metrics(json_writer_t *w, const metrics_t *m) {
+    json_lit(w, "{\"current_rtt_ms\":");
+    json_fixed(w, m->current_rtt_ms, 2);
+    json_lit(w, ",\"max_rtt_ms\":");
+    json_fixed(w, m->max_rtt_ms, 2);
+    json_lit(w, ",\"loss_pct\":");
+    json_fixed(w, m->loss_pct, 2);
+    json_lit(w, ",\"jitter_ms\":");
+    json_fixed(w, m->jitter_ms, 2);
+    json_lit(w, ",\"p50_ms\":");
+    json_fixed(w, m->p50_ms, 2);
+    json_lit(w, ",\"p95_ms\":");
+    json_fixed(w, m->p95_ms, 2);
+    json_lit(w, ",\"p99_ms\":");
+    json_fixed(w, m->p99_ms, 2);
+    json_lit(w, ",\"p999_ms\":");
+    json_fixed(w, m->p999_ms, 2);
+    json_lit(w, ",\"windows\":{");
+
+    for (int i = 0; i < METRICS_WINDOW_COUNT; i++) {
+        const window_metrics_t *wm = &m->windows[i];
+        if (i > 0) {
+            json_lit(w, ",");
+        }
+        json_str(w, g_window_names[i]);
+        json_lit(w, ":{\"samples\":");
+        json_u64(w, wm->sample_count);
+        json_lit(w, ",\"loss_pct\":");
+        json_fixed(w, wm->loss_pct, 2);
+        json_lit(w, ",\"jitter_ms\":");
+        json_fixed(w, wm->jitter_ms, 2);
+        json_lit(w, ",\"p50_ms\":");
+        json_fixed(w, wm->p50_ms, 2);
+        json_lit(w, ",\"p95_ms\":");
+        json_fixed(w, wm->p95_ms, 2);
+        json_lit(w, ",\"p99_ms\":");
+        json_fixed(w, wm->p99_ms, 2);
+        json_lit(w, ",\"max_rtt_ms\":");
+        json_fixed(w, wm->max_rtt_ms, 2);
+        json_lit(w, "}");
+    }
+    json_lit(w, "}}");
+}
+
+// Write {"ts":...,"rtt_ms":...,"success":...}
+static void write_sample(json_writer_t *w, const sample_t *s) {
+    json_lit(w, "{\"ts\":");
+    json_u64(w, s->timestamp_ms);
+    json_lit(w, ",\"rtt_ms\":");
+    json_fixed(w, s->rtt_ms, 2);
+    json_lit(w, ",\"success\":");
+    json_bool(w, s->success);
+    json_lit(w, "}");
+}
+
+// Write a target up to its samples: {"id":...,"metrics":{...},"samples":[
+static void write_target_head(json_writer_t *w, const target_view_entry_t *t) {
+    json_lit(w, "{\"id\":");
+    json_str(w, t->config.id);
+    json_lit(w, ",\"host\":");
+    json_str(w, t->config.host);
+    json_lit(w, ",\"port\":");
+    json_u64(w, t->config.port);
+    json_lit(w, ",\"label\":");
+    json_str(w, t->config.label);
+    json_lit(w, ",\"metrics\":");
+    write_metrics(w, &t->metrics);
+    json_lit(w, ",\"samples\":[");
+}
+
+// Write the "targets" array, with each target's sample window or without
+static void write_targets(json_writer_t *w, target_view_t *view, bool with_samples) {
+    json_lit(w, "\"targets\":[");
+    for (int i = 0; i < view->count; i++) {
+        target_view_entry_t *t = &view->targets[i];
+
+        if (i > 0) {
+            json_lit(w, ",");
+        }
+        write_target_head(w, t);
+
+        size_t sample_count = with_samples ? ring_buffer_count(&t->samples) : 0;
+        bool first = true;
+        for (size_t j = 0; j < sample_count; j++) {
+            sample_t *s = (sample_t *)ring_buffer_get(&t->samples, j);
+            if (s != NULL) {
+                if (!first) {
+                    json_lit(w, ",");
+                }
+                write_sample(w, s);
+                first = false;
+            }
+        }
+        json_lit(w, "]}");
+    }
+    json_lit(w, "]");
+}
+
+// Write the "config" object clients need
+static void write_config(json_writer_t *w, const config_t *config) {
+    json_lit(w, "\"config\":{\"probe_interval_ms\":");
+    json_u64(w, config->probe_interval_ms);
+    json_lit(w, ",\"probe_timeout_ms\":");
+    json_u64(w, config->probe_timeout_ms);
+    json_lit(w, ",\"thresholds\":{\"loss_pct\":");
+    json_fixed(w, config->thresholds.loss_pct, 1);
+    json_lit(w, ",\"p95_ms\":");
+    json_fixed(w, config->thresholds.p95_ms, 1);
+    json_lit(w, ",\"jitter_ms\":");
+    json_fixed(w, config->thresholds.jitter_ms, 1);
+    json_lit(w, "}}");
+}
+
+void ws_handle_open(struct mg_connection *c) {
     // Mark connection as WebSocket
     c->data[0] = 'W';
-
-    // Send snapshot
-    ws_send_snapshot(c, config, scheduler);
 }
 
 void ws_handle_message(struct mg_connection *c, struct mg_ws_message *wm) {
@@ -20,107 +137,333 @@ void ws_handle_close(struct mg_connection *c) {
     c->data[0] = '\0';
 }
 
-void ws_send_snapshot(struct mg_connection *c, config_t *config, scheduler_t *scheduler) {
-    // Build snapshot JSON
-    char buf[16384];
-    int pos = 0;
+int ws_build_snapshot_msg(json_writer_t *w, config_t *config, target_view_t *view,
+                          const char *stream, uint64_t seq) {
+    json_lit(w, "{\"type\":\"snapshot\",\"stream\":");
+    json_str(w, stream);
+    json_lit(w, ",\"seq\":");
+    json_u64(w, seq);
+    json_lit(w, ",");
+    write_targets(w, view, true);
+    json_lit(w, ",");
+    write_config(w, config);
+    json_lit(w, "}");
+    return w->failed ? -1 : 0;
+}
 
-    pos += snprintf(buf + pos, sizeof(buf) - pos,
-                    "{\"type\":\"snapshot\",\"targets\":[");
+void ws_snapshot_init(ws_snapshot_t *snap) {
+    memset(snap, 0, sizeof(*snap));
+    json_writer_init(&snap->config);
+    json_writer_init(&snap->next_config);
+    json_writer_init(&snap->msg);
+}
 
-    for (int i = 0; i < scheduler->target_count; i++) {
-        target_state_t *ts = &scheduler->targets[i];
+void ws_snapshot_free(ws_snapshot_t *snap) {
+    if (snap == NULL) {
+        return;
+    }
+    for (int i = 0; i < snap->capacity; i++) {
+        json_writer_free(&snap->targets[i].head);
+        json_writer_free(&snap->targets[i].samples);
+        free(snap->targets[i].lens);
+    }
+    free(snap->targets);
+    json_writer_free(&snap->config);
+    json_writer_free(&snap->next_config);
+    json_writer_free(&snap->msg);
+    memset(snap, 0, sizeof(*snap));
+}
 
-        if (i > 0) {
-            pos += snprintf(buf + pos, sizeof(buf) - pos, ",");
-        }
-
-        pos += snprintf(buf + pos, sizeof(buf) - pos,
-                        "{\"id\":\"%s\",\"host\":\"%s\",\"port\":%u,\"label\":\"%s\","
-                        "\"metrics\":{"
-                        "\"current_rtt_ms\":%.2f,"
-                        "\"max_rtt_ms\":%.2f,"
-                        "\"loss_pct\":%.2f,"
-                        "\"jitter_ms\":%.2f,"
-                        "\"p50_ms\":%.2f,"
-                        "\"p95_ms\":%.2f"
-                        "},\"samples\":[",
-                        ts->config.id, ts->config.host, ts->config.port, ts->config.label,
-                        ts->metrics.current_rtt_ms,
-                        ts->metrics.max_rtt_ms,
-                        ts->metrics.loss_pct,
-                        ts->metrics.jitter_ms,
-                        ts->metrics.p50_ms,
-                        ts->metrics.p95_ms);
-
-        // Add samples
-        size_t sample_count = ring_buffer_count(&ts->samples);
-        for (size_t j = 0; j < sample_count; j++) {
-            sample_t *s = (sample_t *)ring_buffer_get(&ts->samples, j);
-            if (s != NULL) {
-                if (j > 0) {
-                    pos += snprintf(buf + pos, sizeof(buf) - pos, ",");
-                }
-                pos += snprintf(buf + pos, sizeof(buf) - pos,
-                                "{\"ts\":%llu,\"rtt_ms\":%.2f,\"success\":%s}",
-                                (unsigned long long)s->timestamp_ms,
-                                s->rtt_ms,
-                                s->success ? "true" : "false");
+// Append one sample, with its comma, to a part's sample list
+static void part_push_sample(ws_snapshot_target_t *part, const sample_t *s) {
+    size_t before = part->samples.len;
+    write_sample(&part->samples, s);
+    json_lit(&part->samples, ",");
+    part->lens[(part->first + part->count) % part->lens_capacity] =
+        (uint16_t)(part->samples.len - before);
+    part->count++;
+}
+
+// Bring a target's part up to the target's version: returns false if out
+// of memory
+static bool part_update(ws_snapshot_t *snap, ws_snapshot_target_t *part,
+                        const target_view_entry_t *t) {
+    bool same = part->version != 0 && part->created == t->created;
+    if (same && part->version == t->version) {
+        return true;
+    }
+
+    part->head.len = 0;
+    write_target_head(&part->head, t);
+
+    const ring_buffer_t *window = &t->samples;
+    size_t count = ring_buffer_count(window);
+    uint64_t fresh = t->pushes - part->pushes;
+    if (same && t->pushes >= part->pushes && fresh <= count &&
+        part->lens_capacity == window->capacity) {
+        // Patch: the ones that left off the front, then the new samples on
+        // the end (in that order: lens only has room for a full window)
+        size_t left = part->count + (size_t)fresh - count;
+        for (size_t j = 0; j < left; j++) {
+            part->start += part->lens[part->first];
+            part->first = (part->first + 1) % part->lens_capacity;
+            part->count--;
+        }
+        for (size_t j = count - (size_t)fresh; j < count; j++) {
+            part_push_sample(part, ring_buffer_get((ring_buffer_t *)window, j));
+        }
+        // Reclaim the cut-off front once it outgrows the rest
+        if (part->start > part->samples.len - part->start) {
+            memmove(part->samples.buf, part->samples.buf + part->start,
+                    part->samples.len - part->start);
+            part->samples.len -= part->start;
+            part->start = 0;
+        }
+        snap->patches++;
+    } else {
+        if (part->lens_capacity != window->capacity) {
+            uint16_t *lens = realloc(part->lens, window->capacity * sizeof(*lens));
+            if (lens == NULL) {
+                part->version = 0;
+                return false;
             }
+            part->lens = lens;
+            part->lens_capacity = window->capacity;
+        }
+        part->samples.len = 0;
+        part->start = 0;
+        part->first = 0;
+        part->count = 0;
+        for (size_t j = 0; j < count; j++) {
+            part_push_sample(part, ring_buffer_get((ring_buffer_t *)window, j));
         }
+        snap->builds++;
+    }
 
-        pos += snprintf(buf + pos, sizeof(buf) - pos, "]}");
-    }
-
-    pos += snprintf(buf + pos, sizeof(buf) - pos,
-                    "],\"config\":{"
-                    "\"probe_interval_ms\":%u,"
-                    "\"probe_timeout_ms\":%u,"
-                    "\"thresholds\":{"
-                    "\"loss_pct\":%.1f,"
-                    "\"p95_ms\":%.1f,"
-                    "\"jitter_ms\":%.1f"
-                    "}}}",
-                    config->probe_interval_ms,
-                    config->probe_timeout_ms,
-                    config->thresholds.loss_pct,
-                    config->thresholds.p95_ms,
-                    config->thresholds.jitter_ms);
-
-    mg_ws_send(c, buf, (size_t)pos, WEBSOCKET_OP_TEXT);
-}
-
-int ws_build_sample_msg(char *buf, size_t buf_size, const char *target_id, const sample_t *sample) {
-    return snprintf(buf, buf_size,
-                    "{\"type\":\"sample\",\"target_id\":\"%s\","
-                    "\"ts\":%llu,\"rtt_ms\":%.2f,\"success\":%s}",
-                    target_id,
-                    (unsigned long long)sample->timestamp_ms,
-                    sample->rtt_ms,
-                    sample->success ? "true" : "false");
-}
-
-int ws_build_metrics_msg(char *buf, size_t buf_size, const char *target_id, const metrics_t *metrics) {
-    return snprintf(buf, buf_size,
-                    "{\"type\":\"metrics\",\"target_id\":\"%s\","
-                    "\"metrics\":{"
-                    "\"current_rtt_ms\":%.2f,"
-                    "\"max_rtt_ms\":%.2f,"
-                    "\"loss_pct\":%.2f,"
-                    "\"jitter_ms\":%.2f,"
-                    "\"p50_ms\":%.2f,"
-                    "\"p95_ms\":%.2f"
-                    "}}",
-                    target_id,
-                    metrics->current_rtt_ms,
-                    metrics->max_rtt_ms,
-                    metrics->loss_pct,
-                    metrics->jitter_ms,
-                    metrics->p50_ms,
-                    metrics->p95_ms);
-}
-
-int ws_build_event_msg(char *buf, size_t buf_size, const event_t *event) {
+    if (part->head.failed || part->samples.failed) {
+        part->head.failed = false;
+        part->samples.failed = false;
+        part->version = 0;
+        return false;
+    }
+    part->created = t->created;
+    part->version = t->version;
+    part->pushes = t->pushes;
+    return true;
+}
+
+int ws_snapshot_update(ws_snapshot_t *snap, config_t *config, target_view_t *view,
+                       const char *stream, uint64_t seq) {
+    // Config can change over HTTP without a version; it is small enough to
+    // compare in full
+    snap->next_config.len = 0;
+    snap->next_config.failed = false;
+    write_config(&snap->next_config, config);
+    bool config_same = snap->config.len == snap->next_config.len &&
+                       memcmp(snap->config.buf, snap->next_config.buf, snap->config.len) == 0;
+    if (snap->msg.len > 0 && config_same && snap->versions == view->versions &&
+        snap->seq == seq && snap->count == view->count) {
+        return 0;
+    }
+    if (!config_same) {
+        json_writer_t swap = snap->config;
+        snap->config = snap->next_config;
+        snap->next_config = swap;
+    }
+
+    if (view->count > snap->capacity) {
+        ws_snapshot_target_t *grown = realloc(snap->targets,
+                                              (size_t)view->count * sizeof(*grown));
+        if (grown == NULL) {
+            snap->msg.len = 0;
+            return -1;
+        }
+        for (int i = snap->capacity; i < view->count; i++) {
+            memset(&grown[i], 0, sizeof(grown[i]));
+            json_writer_init(&grown[i].head);
+            json_writer_init(&grown[i].samples);
+        }
+        snap->targets = grown;
+        snap->capacity = view->count;
+    }
+
+    json_writer_t *w = &snap->msg;
+    w->len = 0;
+    w->failed = false;
+    json_lit(w, "{\"type\":\"snapshot\",\"stream\":");
+    json_str(w, stream);
+    json_lit(w, ",\"seq\":");
+    json_u64(w, seq);
+    json_lit(w, ",\"targets\":[");
+    for (int i = 0; i < view->count; i++) {
+        ws_snapshot_target_t *part = &snap->targets[i];
+        if (!part_update(snap, part, &view->targets[i])) {
+            w->len = 0;
+            return -1;
+        }
+        if (i > 0) {
+            json_lit(w, ",");
+        }
+        json_raw(w, part->head.buf, part->head.len);
+        if (part->count > 0) {
+            json_raw(w, part->samples.buf + part->start, part->samples.len - part->start - 1);
+        }
+        json_lit(w, "]}");
+    }
+    json_lit(w, "],");
+    json_raw(w, snap->config.buf, snap->config.len);
+    json_lit(w, "}");
+    if (w->failed) {
+        w->len = 0;
+        return -1;
+    }
+
+    snap->versions = view->versions;
+    snap->seq = seq;
+    snap->count = view->count;
+    snap->assemblies++;
+    return 1;
+}
+
+// Every buffer a batch writes into
+static json_writer_t *batch_writers(ws_batch_t *batch, int i) {
+    json_writer_t *writers[] = {
+        &batch->samples, &batch->metrics, &batch->events,
+        &batch->bin_samples, &batch->bin_success, &batch->bin_metrics, &batch->bin_events,
+    };
+    return i < (int)(sizeof(writers) / sizeof(writers[0])) ? writers[i] : NULL;
+}
+
+void ws_batch_init(ws_batch_t *batch) {
+    memset(batch, 0, sizeof(*batch));
+    for (int i = 0; batch_writers(batch, i) != NULL; i++) {
+        json_writer_init(batch_writers(batch, i));
+    }
+}
+
+void ws_batch_free(ws_batch_t *batch) {
+    for (int i = 0; batch_writers(batch, i) != NULL; i++) {
+        json_writer_free(batch_writers(batch, i));
+    }
+    batch->count = 0;
+}
+
+void ws_batch_clear(ws_batch_t *batch) {
+    for (int i = 0; batch_writers(batch, i) != NULL; i++) {
+        json_writer_t *w = batch_writers(batch, i);
+        w->len = 0;
+        w->failed = false;
+    }
+    batch->sample_count = 0;
+    batch->metrics_count = 0;
+    batch->event_count = 0;
+    batch->count = 0;
+}
+
+static bool batch_failed(const ws_batch_t *batch) {
+    return batch->samples.failed || batch->metrics.failed || batch->events.failed ||
+           batch->bin_samples.failed || batch->bin_success.failed ||
+           batch->bin_metrics.failed || batch->bin_events.failed;
+}
+
+// Start the next update; the first one fixes the batch's times
+static void batch_next(ws_batch_t *batch) {
+    if (batch->count == 0) {
+        batch->started_ms = now_ms();
+        batch->base_ts = wall_clock_ms();
+    }
+    batch->count++;
+}
+
+// Separator before the next element of a JSON array
+static void json_next(json_writer_t *w) {
+    if (w->len > 0) {
+        json_lit(w, ",");
+    }
+}
+
+static int64_t batch_ts_delta(const ws_batch_t *batch, uint64_t ts) {
+    return (int64_t)(ts - batch->base_ts);
+}
+
+int ws_batch_add_sample(ws_batch_t *batch, int handle, const char *target_id, const sample_t *sample) {
+    batch_next(batch);
+
+    if (batch->json) {
+        json_writer_t *w = &batch->samples;
+        json_next(w);
+        json_lit(w, "{\"target_id\":");
+        json_str(w, target_id);
+        json_lit(w, ",\"ts\":");
+        json_u64(w, sample->timestamp_ms);
+        json_lit(w, ",\"rtt_ms\":");
+        json_fixed(w, sample->rtt_ms, 2);
+        json_lit(w, ",\"success\":");
+        json_bool(w, sample->success);
+        json_lit(w, "}");
+    }
+
+    if (batch->binary) {
+        json_writer_t *w = &batch->bin_samples;
+        bin_varint(w, (uint64_t)handle);
+        bin_zigzag(w, batch_ts_delta(batch, sample->timestamp_ms));
+        bin_f32(w, sample->rtt_ms);
+
+        json_writer_t *bits = &batch->bin_success;
+        size_t bit = batch->sample_count % 8;
+        if (bit == 0) {
+            bin_u8(bits, 0);
+        }
+        if (sample->success && !bits->failed) {
+            bits->buf[bits->len - 1] |= (char)(1u << bit);
+        }
+    }
+    batch->sample_count++;
+
+    return batch->samples.failed || batch->bin_samples.failed || batch->bin_success.failed ? -1 : 0;
+}
+
+int ws_batch_add_metrics(ws_batch_t *batch, int handle, const char *target_id, const metrics_t *metrics) {
+    batch_next(batch);
+
+    if (batch->json) {
+        json_writer_t *w = &batch->metrics;
+        json_next(w);
+        json_lit(w, "{\"target_id\":");
+        json_str(w, target_id);
+        json_lit(w, ",\"metrics\":");
+        write_metrics(w, metrics);
+        json_lit(w, "}");
+    }
+
+    if (batch->binary) {
+        json_writer_t *w = &batch->bin_metrics;
+        bin_varint(w, (uint64_t)handle);
+        bin_f32(w, metrics->current_rtt_ms);
+        bin_f32(w, metrics->max_rtt_ms);
+        bin_f32(w, metrics->loss_pct);
+        bin_f32(w, metrics->jitter_ms);
+        bin_f32(w, metrics->p50_ms);
+        bin_f32(w, metrics->p95_ms);
+        bin_f32(w, metrics->p99_ms);
+        bin_f32(w, metrics->p999_ms);
+        for (int i = 0; i < METRICS_WINDOW_COUNT; i++) {
+            const window_metrics_t *wm = &metrics->windows[i];
+            bin_varint(w, wm->sample_count);
+            bin_f32(w, wm->loss_pct);
+            bin_f32(w, wm->jitter_ms);
+            bin_f32(w, wm->p50_ms);
+            bin_f32(w, wm->p95_ms);
+            bin_f32(w, wm->p99_ms);
+            bin_f32(w, wm->max_rtt_ms);
+        }
+    }
+    batch->metrics_count++;
+
+    return batch->metrics.failed || batch->bin_metrics.failed ? -1 : 0;
+}
+
+int ws_batch_add_event(ws_batch_t *batch, int handle, const event_t *event) {
     const char *field;
     switch (event->type) {
         case EVENT_BAD_LOSS: field = "loss_pct"; break;
@@ -129,66 +472,100 @@ int ws_build_event_msg(char *buf, size_t buf_size, const event_t *event) {
         default: field = "unknown"; break;
     }
 
-    return snprintf(buf, buf_size,
-                    "{\"type\":\"event\",\"ts\":%llu,\"target_id\":\"%s\","
-                    "\"reason\":\"%s\",\"details\":{"
-                    "\"%s\":%.2f,\"threshold\":%.2f,\"duration_s\":%u"
-                    "}}",
-                    (unsigned long long)event->timestamp_ms,
-                    event->target_id,
-                    event->reason,
-                    field,
-                    event->value,
-                    event->threshold,
-                    event->duration_s);
+    batch_next(batch);
+
+    if (batch->json) {
+        json_writer_t *w = &batch->events;
+        json_next(w);
+        json_lit(w, "{\"ts\":");
+        json_u64(w, event->timestamp_ms);
+        json_lit(w, ",\"target_id\":");
+        json_str(w, event->target_id);
+        json_lit(w, ",\"reason\":");
+        json_str(w, event->reason);
+        json_lit(w, ",\"details\":{");
+        json_str(w, field);
+        json_lit(w, ":");
+        json_fixed(w, event->value, 2);
+        json_lit(w, ",\"threshold\":");
+        json_fixed(w, event->threshold, 2);
+        json_lit(w, ",\"duration_s\":");
+        json_u64(w, event->duration_s);
+        json_lit(w, "}}");
+    }
+
+    if (batch->binary) {
+        json_writer_t *w = &batch->bin_events;
+        size_t reason_len = strlen(event->reason);
+        bin_varint(w, (uint64_t)handle);
+        bin_zigzag(w, batch_ts_delta(batch, event->timestamp_ms));
+        bin_u8(w, (uint8_t)event->type);
+        bin_f32(w, event->value);
+        bin_f32(w, event->threshold);
+        bin_varint(w, event->duration_s);
+        bin_varint(w, reason_len);
+        json_raw(w, event->reason, reason_len);
+    }
+    batch->event_count++;
+
+    return batch->events.failed || batch->bin_events.failed ? -1 : 0;
 }
 
-int ws_build_targets_updated_msg(char *buf, size_t buf_size, config_t *config, scheduler_t *scheduler) {
-    int pos = 0;
+// Copy one of the batch's buffers (an empty writer may have no buffer yet)
+static void write_items(json_writer_t *w, const json_writer_t *items) {
+    if (items->len > 0) {
+        json_raw(w, items->buf, items->len);
+    }
+}
 
-    pos += snprintf(buf + pos, buf_size - pos,
-                    "{\"type\":\"targets_updated\",\"targets\":[");
+int ws_build_batch_msg(json_writer_t *w, const ws_batch_t *batch, bool samples) {
+    if (!batch->json || batch_failed(batch)) {
+        return -1;
+    }
+    json_lit(w, "{\"type\":\"batch\",\"seq\":");
+    json_u64(w, batch->seq);
+    json_lit(w, ",\"samples\":[");
+    if (samples) {
+        write_items(w, &batch->samples);
+    }
+    json_lit(w, "],\"metrics\":[");
+    write_items(w, &batch->metrics);
+    json_lit(w, "],\"events\":[");
+    write_items(w, &batch->events);
+    json_lit(w, "]}");
+    return w->failed ? -1 : 0;
+}
 
-    for (int i = 0; i < scheduler->target_count; i++) {
-        target_state_t *ts = &scheduler->targets[i];
+int ws_build_batch_bin(json_writer_t *w, const ws_batch_t *batch, bool samples) {
+    if (!batch->binary || batch_failed(batch)) {
+        return -1;
+    }
+    bin_u8(w, WS_BINARY_BATCH);
+    bin_u8(w, WS_BINARY_VERSION);
+    bin_varint(w, batch->seq);
+    bin_varint(w, batch->base_ts);
+    if (samples) {
+        bin_varint(w, batch->sample_count);
+        write_items(w, &batch->bin_samples);
+        write_items(w, &batch->bin_success);
+    } else {
+        bin_varint(w, 0);
+    }
+    bin_varint(w, batch->metrics_count);
+    write_items(w, &batch->bin_metrics);
+    bin_varint(w, batch->event_count);
+    write_items(w, &batch->bin_events);
+    return w->failed ? -1 : 0;
+}
 
-        if (i > 0) {
-            pos += snprintf(buf + pos, buf_size - pos, ",");
-        }
-
-        pos += snprintf(buf + pos, buf_size - pos,
-                        "{\"id\":\"%s\",\"host\":\"%s\",\"port\":%u,\"label\":\"%s\","
-                        "\"metrics\":{"
-                        "\"current_rtt_ms\":%.2f,"
-                        "\"max_rtt_ms\":%.2f,"
-                        "\"loss_pct\":%.2f,"
-                        "\"jitter_ms\":%.2f,"
-                        "\"p50_ms\":%.2f,"
-                        "\"p95_ms\":%.2f"
-                        "},\"samples\":[]}",
-                        ts->config.id, ts->config.host, ts->config.port, ts->config.label,
-                        ts->metrics.current_rtt_ms,
-                        ts->metrics.max_rtt_ms,
-                        ts->metrics.loss_pct,
-                        ts->metrics.jitter_ms,
-                        ts->metrics.p50_ms,
-                        ts->metrics.p95_ms);
-    }
-
-    pos += snprintf(buf + pos, buf_size - pos,
-                    "],\"config\":{"
-                    "\"probe_interval_ms\":%u,"
-                    "\"probe_timeout_ms\":%u,"
-                    "\"thresholds\":{"
-                    "\"loss_pct\":%.1f,"
-                    "\"p95_ms\":%.1f,"
-                    "\"jitter_ms\":%.1f"
-                    "}}}",
-                    config->probe_interval_ms,
-                    config->probe_timeout_ms,
-                    config->thresholds.loss_pct,
-                    config->thresholds.p95_ms,
-                    config->thresholds.jitter_ms);
-
-    return pos;
+int ws_build_targets_updated_msg(json_writer_t *w, config_t *config, target_view_t *view,
+                                 uint64_t seq) {
+    json_lit(w, "{\"type\":\"targets_updated\",\"seq\":");
+    json_u64(w, seq);
+    json_lit(w, ",");
+    write_targets(w, view, false);
+    json_lit(w, ",");
+    write_config(w, config);
+    json_lit(w, "}");
+    return w->failed ? -1 : 0;
 }
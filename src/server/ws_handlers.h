@@ -3,16 +3,17 @@
 
 #include "mongoose.h"
 #include "core/config.h"
-#include "core/scheduler.h"
+#include "server/target_view.h"
 #include "core/stats.h"
 #include "core/event_log.h"
+#include "server/json_writer.h"
 
 /*
  * WebSocket handlers
  */
 
-// Handle WebSocket upgrade
-void ws_handle_open(struct mg_connection *c, config_t *config, scheduler_t *scheduler);
+// Handle WebSocket upgrade (the server then sends the snapshot)
+void ws_handle_open(struct mg_connection *c);
 
 // Handle WebSocket message (from client)
 void ws_handle_message(struct mg_connection *c, struct mg_ws_message *wm);
@@ -20,19 +21,112 @@ void ws_handle_message(struct mg_connection *c, struct mg_ws_message *wm);
 // Handle WebSocket close
 void ws_handle_close(struct mg_connection *c);
 
-// Build and send snapshot message to a client
-void ws_send_snapshot(struct mg_connection *c, config_t *config, scheduler_t *scheduler);
+/*
+ * Live updates are sent in batches: everything the probe thread produced since
+ * the last flush goes out as one
+ *   {"type":"batch","seq":N,"samples":[...],"metrics":[...],"events":[...]}
+ * frame, so a client takes one message (and one store update) per tick
+ * instead of one per sample. A batch is encoded as it fills, as JSON and/or
+ * binary (ws_binary.h) depending on what the subscribers speak.
+ */
+typedef struct {
+    bool json;                      // Encodings to build
+    bool binary;
+    json_writer_t samples;          // JSON: comma-separated array elements
+    json_writer_t metrics;
+    json_writer_t events;
+    json_writer_t bin_samples;      // Binary sections
+    json_writer_t bin_success;      // Success bits of bin_samples
+    json_writer_t bin_metrics;
+    json_writer_t bin_events;
+    size_t sample_count;
+    size_t metrics_count;
+    size_t event_count;
+    size_t count;                   // Updates of all kinds
+    uint64_t started_ms;            // When the first update was added
+    uint64_t base_ts;               // Wall clock then (binary timestamps are relative)
+    uint64_t seq;                   // Stream position (ws_replay.h), set when sent
+} ws_batch_t;
+
+void ws_batch_init(ws_batch_t *batch);
+void ws_batch_free(ws_batch_t *batch);
+
+// Empty the batch, keeping its buffers
+void ws_batch_clear(ws_batch_t *batch);
+
+// Add one update for the target at handle. Return 0, or -1 if out of memory.
+int ws_batch_add_sample(ws_batch_t *batch, int handle, const char *target_id, const sample_t *sample);
+int ws_batch_add_metrics(ws_batch_t *batch, int handle, const char *target_id, const metrics_t *metrics);
+int ws_batch_add_event(ws_batch_t *batch, int handle, const event_t *event);
+
+/*
+ * The snapshot a new subscriber gets is kept serialized. Each target's part
+ * is cached with the version it was built at (target_view_entry_t
+ * version) and redone only once that changes: the id/metrics head is
+ * rebuilt, and the sample list patched (the samples pushed since are
+ * appended, the ones that left the window cut off the front). A part for
+ * another target than the one now at its index, even one re-added under
+ * the same id, is built from scratch instead. The message
+ * is then those parts copied end to end, and is reused as it is while
+ * nothing in it changed, so subscribers connecting together share one.
+ */
+typedef struct {
+    uint64_t created;               // Target the part is for (its created)
+    uint64_t version;               // Its version then (0 = not built)
+    uint64_t pushes;                // Window pushes the sample list covers
+    json_writer_t head;             // {"id":...,"metrics":{...},"samples":[
+    json_writer_t samples;          // Sample objects, each followed by a comma
+    size_t start;                   // Where the oldest one starts in samples
+    uint16_t *lens;                 // Length of each, ring of the window's capacity
+    size_t lens_capacity;
+    size_t first;                   // Ring position of the oldest
+    size_t count;
+} ws_snapshot_target_t;
+
+typedef struct {
+    ws_snapshot_target_t *targets;
+    int capacity;
+    int count;                      // Targets in msg
+    uint64_t versions;              // view versions when msg was assembled
+    uint64_t seq;                   // Stream position msg is as of
+    json_writer_t config;           // "config":{...} as in msg
+    json_writer_t next_config;      // ... and as it is now
+    json_writer_t msg;              // The snapshot message (empty until built)
+    uint64_t builds;                // Target parts built from scratch
+    uint64_t patches;               // ... patched
+    uint64_t assemblies;            // Messages assembled
+} ws_snapshot_t;
+
+void ws_snapshot_init(ws_snapshot_t *snap);
+void ws_snapshot_free(ws_snapshot_t *snap);
+
+// Bring snap->msg up to date: the message ws_build_snapshot_msg would build
+// now. Returns 1 if it changed, 0 if it is the same message as before, or
+// -1 if out of memory (snap->msg is then empty).
+int ws_snapshot_update(ws_snapshot_t *snap, config_t *config, target_view_t *view,
+                       const char *stream, uint64_t seq);
+
+/*
+ * Message builders: append one message to w. Return 0, or -1 if w ran out
+ * of memory.
+ */
 
-// Build sample message JSON
-int ws_build_sample_msg(char *buf, size_t buf_size, const char *target_id, const sample_t *sample);
+// Build snapshot message JSON (every target with its sample window), as of
+// message seq of the given stream. Formats everything on every call: the
+// reference ws_snapshot_t is checked against.
+int ws_build_snapshot_msg(json_writer_t *w, config_t *config, target_view_t *view,
+                          const char *stream, uint64_t seq);
 
-// Build metrics message JSON
-int ws_build_metrics_msg(char *buf, size_t buf_size, const char *target_id, const metrics_t *metrics);
+// Build batch message JSON (-1 too if the batch has no JSON encoding). With
+// samples false the samples list is left empty: the batch as a subscriber
+// that has fallen behind gets it (ws_hub.h).
+int ws_build_batch_msg(json_writer_t *w, const ws_batch_t *batch, bool samples);
 
-// Build event message JSON
-int ws_build_event_msg(char *buf, size_t buf_size, const event_t *event);
+// Build binary batch message (-1 too if the batch has no binary encoding)
+int ws_build_batch_bin(json_writer_t *w, const ws_batch_t *batch, bool samples);
 
 // Build targets updated message JSON (for add/remove notifications)
-int ws_build_targets_updated_msg(char *buf, size_t buf_size, config_t *config, scheduler_t *scheduler);
+int ws_build_targets_updated_msg(json_writer_t *w, config_t *config, target_view_t *view,
+                                 uint64_t seq);
 
 #endif // NETPULSE_WS_HANDLERS_H
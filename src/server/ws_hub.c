@@ -0,0 +1,538 @@
+#include "server/ws_hub.h"
+#include "platform/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAS_ZLIB
+#include <zlib.h>
+#endif
+
+#define WS_QUEUE_INITIAL    16
+#define WS_RSV1             0x40    // Frame header bit: payload is compressed
+#define WS_WINDOW_BITS      15
+
+static void frame_release(ws_frame_t *frame) {
+    if (--frame->refs == 0) {
+        free(frame);
+    }
+}
+
+// Server frames are unmasked: opcode byte, then a 7, 16 or 64-bit length
+static ws_frame_t *frame_new(const void *msg, size_t len, int op, bool compressed) {
+    uint8_t header[10];
+    size_t header_len;
+    header[0] = (uint8_t)(op | 0x80 | (compressed ? WS_RSV1 : 0));
+    if (len < 126) {
+        header[1] = (uint8_t)len;
+        header_len = 2;
+    } else if (len < 65536) {
+        header[1] = 126;
+        header[2] = (uint8_t)(len >> 8);
+        header[3] = (uint8_t)len;
+        header_len = 4;
+    } else {
+        header[1] = 127;
+        for (int i = 0; i < 8; i++) {
+            header[2 + i] = (uint8_t)((uint64_t)len >> (56 - 8 * i));
+        }
+        header_len = 10;
+    }
+
+    ws_frame_t *frame = malloc(sizeof(*frame) + header_len + len);
+    if (frame == NULL) {
+        return NULL;
+    }
+    frame->refs = 1;
+    frame->len = header_len + len;
+    memcpy(frame->data, header, header_len);
+    memcpy(frame->data + header_len, msg, len);
+    return frame;
+}
+
+#ifdef HAS_ZLIB
+static z_stream *stream_new(void) {
+    z_stream *z = calloc(1, sizeof(*z));
+    if (z == NULL) {
+        return NULL;
+    }
+    // Raw deflate (negative window bits: no zlib header or trailer). Fastest
+    // level: it runs on the event loop, and level 6 shrinks our JSON only a
+    // quarter further for about twice the time.
+    if (deflateInit2(z, Z_BEST_SPEED, Z_DEFLATED, -WS_WINDOW_BITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(z);
+        return NULL;
+    }
+    return z;
+}
+
+static void stream_free(void *stream) {
+    if (stream != NULL) {
+        deflateEnd(stream);
+        free(stream);
+    }
+}
+
+// Compress msg as one message of the stream (from scratch if reset). RFC
+// 7692: sync flush, minus the 00 00 ff ff that flush ends with.
+static ws_frame_t *frame_deflate(ws_hub_t *hub, z_stream *z, bool reset,
+                                 const void *msg, size_t len, int op) {
+    uint64_t start_ns = now_ns();
+    if (reset) {
+        deflateReset(z);
+    }
+
+    // deflateBound covers a finished stream; leave room for the flush marker
+    size_t bound = deflateBound(z, (uLong)len) + 16;
+    if (bound > hub->scratch_size) {
+        uint8_t *grown = realloc(hub->scratch, bound);
+        if (grown == NULL) {
+            return NULL;
+        }
+        hub->scratch = grown;
+        hub->scratch_size = bound;
+    }
+
+    z->next_in = (Bytef *)msg;
+    z->avail_in = (uInt)len;
+    z->next_out = hub->scratch;
+    z->avail_out = (uInt)bound;
+    if (deflate(z, Z_SYNC_FLUSH) != Z_OK || z->avail_in != 0 || z->avail_out == 0) {
+        return NULL;
+    }
+    size_t out = bound - z->avail_out;
+    if (out >= 4) {
+        out -= 4;
+    }
+
+    ws_frame_t *frame = frame_new(hub->scratch, out, op, true);
+    hub->deflate_in += len;
+    hub->deflate_out += out;
+    hub->deflate_ns += now_ns() - start_ns;
+    return frame;
+}
+#else
+static void stream_free(void *stream) {
+    (void)stream;
+}
+#endif
+
+/*
+ * A reference to msg framed the way client takes it. raw and shared cache
+ * the uncompressed and shared compressed frames across clients (the caller
+ * releases them).
+ */
+static ws_frame_t *frame_for(ws_hub_t *hub, ws_client_t *client, const void *msg, size_t len,
+                             int op, ws_frame_t **raw, ws_frame_t **shared) {
+    ws_frame_t **cached = raw;
+
+    if (client->deflate == WS_DEFLATE_OFF || len == 0 || len < hub->deflate_min) {
+        if (*raw == NULL) {
+            *raw = frame_new(msg, len, op, false);
+        }
+#ifdef HAS_ZLIB
+    } else if (client->deflate == WS_DEFLATE_SHARED) {
+        cached = shared;
+        if (*shared == NULL) {
+            if (hub->shared_stream == NULL) {
+                hub->shared_stream = stream_new();
+            }
+            if (hub->shared_stream != NULL) {
+                *shared = frame_deflate(hub, hub->shared_stream, true, msg, len, op);
+            }
+        }
+    } else {
+        // Not shareable: this client's stream remembers every message. If
+        // compressing fails the stream is out of step with the client's.
+        ws_frame_t *frame = frame_deflate(hub, client->stream, false, msg, len, op);
+        if (frame == NULL) {
+            mg_error(client->conn, "deflate failed");
+        }
+        return frame;
+#else
+    } else {
+        (void)shared;
+#endif
+    }
+
+    ws_frame_t *frame = *cached;
+    if (frame != NULL) {
+        frame->refs++;
+    }
+    return frame;
+}
+
+static bool queue_push(ws_client_t *client, ws_frame_t *frame) {
+    if (client->count == client->capacity) {
+        size_t new_capacity = client->capacity > 0 ? client->capacity * 2 : WS_QUEUE_INITIAL;
+        ws_frame_t **grown = malloc(new_capacity * sizeof(*grown));
+        if (grown == NULL) {
+            return false;
+        }
+        for (size_t i = 0; i < client->count; i++) {
+            grown[i] = client->queue[(client->head + i) & (client->capacity - 1)];
+        }
+        free(client->queue);
+        client->queue = grown;
+        client->head = 0;
+        client->capacity = new_capacity;
+    }
+    client->queue[(client->head + client->count) & (client->capacity - 1)] = frame;
+    client->count++;
+    client->queued += frame->len;
+    frame->refs++;
+    return true;
+}
+
+// Move queued bytes into the send buffer, up to the low-water mark
+static void move_queued(ws_client_t *client) {
+    struct mg_connection *c = client->conn;
+    if (client->count == 0 || c->is_closing || c->send.len >= WS_HUB_SEND_LOW_WATER) {
+        return;
+    }
+
+    // Take bytes up to the low-water mark (the last frame maybe in part),
+    // then append them in one go: an append to c->send can reallocate it
+    size_t take = 0;
+    size_t bytes = 0;
+    size_t room = WS_HUB_SEND_LOW_WATER - c->send.len;
+    while (take < client->count && bytes < room) {
+        size_t len = client->queue[(client->head + take) & (client->capacity - 1)]->len;
+        if (take == 0) {
+            len -= client->offset;
+        }
+        bytes += len;
+        take++;
+    }
+    if (bytes > room) {
+        bytes = room;
+    }
+
+    size_t ofs = c->send.len;
+    if (mg_iobuf_add(&c->send, ofs, NULL, bytes) == 0) {
+        mg_error(c, "OOM");
+        return;
+    }
+    client->queued -= bytes;
+    uint8_t *p = c->send.buf + ofs;
+    while (bytes > 0) {
+        ws_frame_t *frame = client->queue[client->head];
+        size_t n = frame->len - client->offset;
+        if (n > bytes) {
+            n = bytes;
+        }
+        memcpy(p, frame->data + client->offset, n);
+        p += n;
+        bytes -= n;
+        client->offset += n;
+        if (client->offset == frame->len) {
+            frame_release(frame);
+            client->head = (client->head + 1) & (client->capacity - 1);
+            client->count--;
+            client->offset = 0;
+        }
+    }
+}
+
+size_t ws_hub_backlog(const ws_client_t *client) {
+    return client != NULL ? client->conn->send.len + client->queued : 0;
+}
+
+// Mark the client congested once its backlog passes queue_high, and clear
+// that once it drains to a quarter of it. A client that stays congested is
+// dropped: with its socket that far behind it isn't reading.
+static void check_backlog(ws_hub_t *hub, ws_client_t *client) {
+    struct mg_connection *c = client->conn;
+    if (hub->queue_high == 0 || c->is_closing) {
+        return;
+    }
+
+    size_t backlog = ws_hub_backlog(client);
+    if (!client->congested) {
+        if (backlog > hub->queue_high) {
+            client->congested = true;
+            client->congested_ms = now_ms();
+            hub->congested_clients++;
+        }
+    } else if (backlog <= hub->queue_high / 4) {
+        client->congested = false;
+        hub->congested_clients--;
+    } else if (now_ms() - client->congested_ms >= WS_HUB_CONGESTED_MS) {
+        printf("[ws] Dropping slow client %lu (%zu bytes behind for %d s)\n",
+               c->id, backlog, WS_HUB_CONGESTED_MS / 1000);
+        c->is_closing = 1;
+        hub->slow_disconnects++;
+    }
+}
+
+// Copy the frame in if nothing is queued and it fits under the low-water
+// mark, otherwise queue it: a large one (a snapshot) then moves in as the
+// socket drains, and clients given the same frame share it until then
+static bool deliver(ws_hub_t *hub, ws_client_t *client, ws_frame_t *frame) {
+    struct mg_connection *c = client->conn;
+    if (c->is_closing) {
+        return true;
+    }
+    if (client->count == 0 && c->send.len + frame->len <= WS_HUB_SEND_LOW_WATER) {
+        if (!mg_send(c, frame->data, frame->len)) {
+            mg_error(c, "OOM");
+        }
+    } else if (!queue_push(client, frame)) {
+        return false;
+    } else {
+        move_queued(client);
+    }
+    check_backlog(hub, client);
+    return true;
+}
+
+// Is s, less surrounding blanks, the token t?
+static bool token_is(struct mg_str s, const char *t) {
+    while (s.len > 0 && (s.buf[0] == ' ' || s.buf[0] == '\t')) {
+        s.buf++;
+        s.len--;
+    }
+    while (s.len > 0 && (s.buf[s.len - 1] == ' ' || s.buf[s.len - 1] == '\t')) {
+        s.len--;
+    }
+    return mg_strcmp(s, mg_str(t)) == 0;
+}
+
+ws_deflate_mode_t ws_hub_negotiate_deflate(ws_deflate_mode_t mode, const struct mg_str *offer,
+                                           char *response, size_t size) {
+    if (response != NULL && size > 0) {
+        response[0] = '\0';
+    }
+#ifndef HAS_ZLIB
+    mode = WS_DEFLATE_OFF;
+#endif
+    if (mode == WS_DEFLATE_OFF || offer == NULL) {
+        return WS_DEFLATE_OFF;
+    }
+
+    // Offers are comma-separated, each "permessage-deflate; param; ..."; the
+    // first one we can honour wins
+    struct mg_str offers = *offer, one;
+    while (mg_span(offers, &one, &offers, ',')) {
+        struct mg_str params = one, param;
+        if (!mg_span(params, &param, &params, ';') || !token_is(param, "permessage-deflate")) {
+            continue;
+        }
+
+        ws_deflate_mode_t chosen = mode;
+        bool window_bits = false;
+        bool ok = true;
+        while (ok && mg_span(params, &param, &params, ';')) {
+            struct mg_str name, value;
+            if (!mg_span(param, &name, &value, '=') || token_is(name, "")) {
+                continue;
+            }
+            if (token_is(name, "server_no_context_takeover")) {
+                chosen = WS_DEFLATE_SHARED;
+            } else if (token_is(name, "server_max_window_bits")) {
+                // Our window is fixed; a smaller one can't be honoured
+                window_bits = true;
+                ok = token_is(value, "15");
+            } else if (!token_is(name, "client_no_context_takeover") &&
+                       !token_is(name, "client_max_window_bits")) {
+                ok = false;
+            }
+        }
+        if (!ok) {
+            continue;
+        }
+
+        if (response != NULL) {
+            snprintf(response, size, "Sec-WebSocket-Extensions: permessage-deflate%s%s\r\n",
+                     chosen == WS_DEFLATE_SHARED ? "; server_no_context_takeover" : "",
+                     window_bits ? "; server_max_window_bits=15" : "");
+        }
+        return chosen;
+    }
+    return WS_DEFLATE_OFF;
+}
+
+bool ws_hub_offers(const struct mg_str *offer, const char *token) {
+    if (offer == NULL) {
+        return false;
+    }
+    struct mg_str offers = *offer, one;
+    while (mg_span(offers, &one, &offers, ',')) {
+        if (token_is(one, token)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ws_client_t *ws_hub_join(ws_hub_t *hub, struct mg_connection *c, ws_protocol_t protocol,
+                         ws_deflate_mode_t deflate) {
+    if (hub == NULL || c == NULL) {
+        return NULL;
+    }
+
+    ws_client_t *client = calloc(1, sizeof(*client));
+    if (client == NULL) {
+        return NULL;
+    }
+#ifdef HAS_ZLIB
+    if (deflate == WS_DEFLATE_CONTEXT) {
+        client->stream = stream_new();
+        if (client->stream == NULL) {
+            free(client);
+            return NULL;
+        }
+    }
+#else
+    deflate = WS_DEFLATE_OFF;
+#endif
+    client->conn = c;
+    client->protocol = protocol;
+    client->deflate = deflate;
+    client->next = hub->clients;
+    if (hub->clients != NULL) {
+        hub->clients->prev = client;
+    }
+    hub->clients = client;
+    hub->client_count++;
+    hub->protocol_clients[protocol]++;
+    if (deflate != WS_DEFLATE_OFF) {
+        hub->deflate_clients++;
+    }
+    return client;
+}
+
+void ws_hub_leave(ws_hub_t *hub, ws_client_t *client) {
+    if (hub == NULL || client == NULL) {
+        return;
+    }
+
+    if (client->prev != NULL) {
+        client->prev->next = client->next;
+    } else {
+        hub->clients = client->next;
+    }
+    if (client->next != NULL) {
+        client->next->prev = client->prev;
+    }
+    hub->client_count--;
+    hub->protocol_clients[client->protocol]--;
+    if (client->deflate != WS_DEFLATE_OFF) {
+        hub->deflate_clients--;
+    }
+    if (client->congested) {
+        hub->congested_clients--;
+    }
+
+    for (size_t i = 0; i < client->count; i++) {
+        frame_release(client->queue[(client->head + i) & (client->capacity - 1)]);
+    }
+    free(client->queue);
+    stream_free(client->stream);
+    free(client);
+}
+
+void ws_hub_flush(ws_hub_t *hub, ws_client_t *client) {
+    if (hub == NULL || client == NULL) {
+        return;
+    }
+    move_queued(client);
+    check_backlog(hub, client);
+}
+
+void ws_hub_cache_clear(ws_hub_cache_t *cache) {
+    if (cache == NULL) {
+        return;
+    }
+    if (cache->raw != NULL) {
+        frame_release(cache->raw);
+    }
+    if (cache->shared != NULL) {
+        frame_release(cache->shared);
+    }
+    cache->raw = NULL;
+    cache->shared = NULL;
+}
+
+int ws_hub_send_cached(ws_hub_t *hub, ws_client_t *client, ws_hub_cache_t *cache,
+                       const void *msg, size_t len, int op) {
+    if (hub == NULL || client == NULL || cache == NULL || msg == NULL) {
+        return -1;
+    }
+
+    ws_frame_t *frame = frame_for(hub, client, msg, len, op, &cache->raw, &cache->shared);
+    int result = frame != NULL && deliver(hub, client, frame) ? 0 : -1;
+    if (frame != NULL) {
+        frame_release(frame);
+    }
+    return result;
+}
+
+int ws_hub_send(ws_hub_t *hub, ws_client_t *client, const void *msg, size_t len, int op) {
+    ws_hub_cache_t cache = { NULL, NULL };
+    int result = ws_hub_send_cached(hub, client, &cache, msg, len, op);
+    ws_hub_cache_clear(&cache);
+    return result;
+}
+
+int ws_hub_broadcast_lite(ws_hub_t *hub, int protocol, const void *msg, size_t len,
+                          const void *lite, size_t lite_len, int op) {
+    if (hub == NULL || msg == NULL) {
+        return -1;
+    }
+    if (protocol == WS_PROTOCOL_ANY ? hub->clients == NULL : hub->protocol_clients[protocol] == 0) {
+        return 0;
+    }
+    hub->broadcasts++;
+
+    // Each form framed (and compressed) on first use, then shared
+    ws_hub_cache_t caches[2] = { { NULL, NULL }, { NULL, NULL } };
+    int result = 0;
+    for (ws_client_t *client = hub->clients; client != NULL; client = client->next) {
+        if (protocol != WS_PROTOCOL_ANY && client->protocol != (ws_protocol_t)protocol) {
+            continue;
+        }
+        const void *m = msg;
+        size_t n = len;
+        ws_hub_cache_t *cache = &caches[0];
+        if (client->congested && lite != msg) {
+            hub->reduced++;
+            if (lite == NULL) {
+                continue;
+            }
+            m = lite;
+            n = lite_len;
+            cache = &caches[1];
+        }
+        ws_frame_t *frame = frame_for(hub, client, m, n, op, &cache->raw, &cache->shared);
+        if (frame == NULL) {
+            result = -1;
+            continue;
+        }
+        if (!deliver(hub, client, frame)) {
+            result = -1;
+        }
+        frame_release(frame);
+    }
+    ws_hub_cache_clear(&caches[0]);
+    ws_hub_cache_clear(&caches[1]);
+    return result;
+}
+
+int ws_hub_broadcast(ws_hub_t *hub, int protocol, const void *msg, size_t len, int op) {
+    return ws_hub_broadcast_lite(hub, protocol, msg, len, msg, len, op);
+}
+
+void ws_hub_free(ws_hub_t *hub) {
+    if (hub == NULL) {
+        return;
+    }
+    while (hub->clients != NULL) {
+        ws_hub_leave(hub, hub->clients);
+    }
+    stream_free(hub->shared_stream);
+    hub->shared_stream = NULL;
+    free(hub->scratch);
+    hub->scratch = NULL;
+    hub->scratch_size = 0;
+}
@@ -0,0 +1,154 @@
+#ifndef NETPULSE_WS_HUB_H
+#define NETPULSE_WS_HUB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "mongoose.h"
+#include "core/config.h"
+
+/*
+ * WebSocket broadcast hub
+ *
+ * A broadcast is framed once into a reference-counted ws_frame_t; nothing is
+ * re-framed per client. A client with nothing queued gets the frame copied
+ * straight into its send buffer, one append (mg_ws_send makes two), as long
+ * as that stays within WS_HUB_SEND_LOW_WATER. Any other client gets a
+ * reference queued, and its queue is moved into the send buffer with one
+ * append on MG_EV_WRITE / MG_EV_POLL, up to WS_HUB_SEND_LOW_WATER bytes, so
+ * a large frame goes in a slice at a time. A frame is freed when the last client has
+ * taken all of it.
+ * Subscribers are kept in their own list, so broadcasting does not walk
+ * every HTTP connection. Each one has a protocol, and a broadcast can be
+ * limited to the subscribers speaking a given protocol.
+ *
+ * Subscribers that negotiated permessage-deflate (RFC 7692) get messages of
+ * deflate_min bytes or more compressed. Without context takeover
+ * (WS_DEFLATE_SHARED) every message is compressed from scratch, so one
+ * compressed frame is shared by all such clients. With context takeover
+ * (WS_DEFLATE_CONTEXT) each client has its own stream and earlier messages
+ * serve as the dictionary: smaller frames, but compressed once per client.
+ * Needs zlib (HAS_ZLIB); without it deflate is never negotiated.
+ *
+ * A client's backlog is what sits in its send buffer plus what it has
+ * queued. Once that passes queue_high the client is congested: broadcasts
+ * with a reduced form (batches without their samples) go to it in that
+ * form, until its backlog drains to a quarter of queue_high. A client still
+ * congested after WS_HUB_CONGESTED_MS is disconnected.
+ *
+ * Event loop thread only.
+ */
+
+#define WS_HUB_SEND_LOW_WATER   65536   // Send-buffer bytes up to which queued frames move in
+#define WS_HUB_CONGESTED_MS     30000   // Congested this long and a client is dropped
+
+// Message encoding a subscriber negotiated
+typedef enum {
+    WS_PROTOCOL_JSON,           // Text frames (default)
+    WS_PROTOCOL_BINARY,         // Binary batches (ws_binary.h), JSON for the rest
+    WS_PROTOCOL_COUNT
+} ws_protocol_t;
+
+#define WS_PROTOCOL_ANY     (-1)    // Broadcast to every subscriber
+
+typedef struct {
+    uint32_t refs;
+    size_t len;
+    uint8_t data[];             // Frame header, then the payload
+} ws_frame_t;
+
+typedef struct ws_client {
+    struct mg_connection *conn;
+    struct ws_client *prev;
+    struct ws_client *next;
+    ws_protocol_t protocol;
+    ws_deflate_mode_t deflate;
+    void *stream;               // z_stream of a WS_DEFLATE_CONTEXT client
+    ws_frame_t **queue;         // Ring of frames not yet in conn->send
+    size_t head;
+    size_t count;
+    size_t capacity;            // Power of two (0 until the first frame)
+    size_t offset;              // Bytes of the oldest frame already in conn->send
+    size_t queued;              // Bytes in queue not yet in conn->send
+    bool congested;             // Backlog went over queue_high ...
+    uint64_t congested_ms;      // ... at this time, and hasn't drained since
+} ws_client_t;
+
+typedef struct {
+    ws_client_t *clients;
+    size_t client_count;
+    size_t protocol_clients[WS_PROTOCOL_COUNT];
+    size_t deflate_clients;
+    uint64_t broadcasts;
+    size_t deflate_min;         // Smaller messages are sent uncompressed
+    void *shared_stream;        // z_stream for WS_DEFLATE_SHARED clients
+    uint8_t *scratch;           // Compressor output
+    size_t scratch_size;
+    uint64_t deflate_in;        // Payload bytes compressed
+    uint64_t deflate_out;       // Compressed bytes produced from them
+    uint64_t deflate_ns;        // Time spent compressing
+    size_t queue_high;          // Backlog over which a client is congested (0 = no limit)
+    size_t congested_clients;
+    uint64_t reduced;           // Broadcasts a congested client got reduced (or not at all)
+    uint64_t slow_disconnects;  // Clients dropped for staying congested
+} ws_hub_t;
+
+// Framings of one message, made on first use and kept across sends until
+// cleared: a message sent to clients one by one (the snapshot) is then
+// framed, and compressed for WS_DEFLATE_SHARED clients, only once
+typedef struct {
+    ws_frame_t *raw;
+    ws_frame_t *shared;
+} ws_hub_cache_t;
+
+#define WS_DEFLATE_RESPONSE_MAX     128
+
+// Settings for a client's Sec-WebSocket-Extensions offer (NULL if none) under
+// the configured mode: WS_DEFLATE_OFF if no offer fits. The header to send
+// back goes in response (empty if off).
+ws_deflate_mode_t ws_hub_negotiate_deflate(ws_deflate_mode_t mode, const struct mg_str *offer,
+                                           char *response, size_t size);
+
+// Whether a comma-separated header value such as Sec-WebSocket-Protocol
+// (NULL if absent) lists token, blanks around entries ignored
+bool ws_hub_offers(const struct mg_str *offer, const char *token);
+
+// Subscribe a WebSocket connection. Returns NULL if out of memory.
+ws_client_t *ws_hub_join(ws_hub_t *hub, struct mg_connection *c, ws_protocol_t protocol,
+                         ws_deflate_mode_t deflate);
+
+// Unsubscribe and drop what it had queued
+void ws_hub_leave(ws_hub_t *hub, ws_client_t *client);
+
+// Frame msg once and queue it on every subscriber speaking protocol (or all,
+// for WS_PROTOCOL_ANY). Returns 0, or -1 if out of memory.
+int ws_hub_broadcast(ws_hub_t *hub, int protocol, const void *msg, size_t len, int op);
+
+// ws_hub_broadcast, except that congested subscribers get lite (of lite_len
+// bytes) instead, or nothing if lite is NULL
+int ws_hub_broadcast_lite(ws_hub_t *hub, int protocol, const void *msg, size_t len,
+                          const void *lite, size_t lite_len, int op);
+
+// Send one message to one subscriber, behind what it has queued. Returns 0,
+// or -1 if out of memory.
+int ws_hub_send(ws_hub_t *hub, ws_client_t *client, const void *msg, size_t len, int op);
+
+// ws_hub_send with msg's framings kept in cache. Clear the cache before
+// sending a different msg through it.
+int ws_hub_send_cached(ws_hub_t *hub, ws_client_t *client, ws_hub_cache_t *cache,
+                       const void *msg, size_t len, int op);
+
+// Release a cache's frames
+void ws_hub_cache_clear(ws_hub_cache_t *cache);
+
+// Move queued frames into the send buffer while it is below the low-water
+// mark, then check the client's backlog
+void ws_hub_flush(ws_hub_t *hub, ws_client_t *client);
+
+// Bytes a client has yet to take: its send buffer and its queue
+size_t ws_hub_backlog(const ws_client_t *client);
+
+// Drop every subscriber (at shutdown)
+void ws_hub_free(ws_hub_t *hub);
+
+#endif // NETPULSE_WS_HUB_H
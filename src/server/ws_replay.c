@@ -0,0 +1,129 @@
+#include "server/ws_replay.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define WS_REPLAY_INITIAL   64
+
+void ws_replay_init(ws_replay_t *log, size_t max_bytes) {
+    memset(log, 0, sizeof(*log));
+    log->max_bytes = max_bytes;
+}
+
+static ws_replay_entry_t *entry_at(const ws_replay_t *log, size_t i) {
+    return log->entries[(log->head + i) & (log->capacity - 1)];
+}
+
+static void drop_oldest(ws_replay_t *log) {
+    ws_replay_entry_t *entry = entry_at(log, 0);
+    log->bytes -= entry->len;
+    free(entry);
+    log->head = (log->head + 1) & (log->capacity - 1);
+    log->count--;
+}
+
+static void clear(ws_replay_t *log) {
+    while (log->count > 0) {
+        drop_oldest(log);
+    }
+}
+
+void ws_replay_free(ws_replay_t *log) {
+    if (log == NULL) {
+        return;
+    }
+    clear(log);
+    free(log->entries);
+    log->entries = NULL;
+    log->capacity = 0;
+}
+
+uint64_t ws_replay_next(ws_replay_t *log) {
+    return ++log->seq;
+}
+
+void ws_replay_reset(ws_replay_t *log) {
+    clear(log);
+    log->seq++;
+}
+
+static bool grow(ws_replay_t *log) {
+    size_t new_capacity = log->capacity > 0 ? log->capacity * 2 : WS_REPLAY_INITIAL;
+    ws_replay_entry_t **grown = malloc(new_capacity * sizeof(*grown));
+    if (grown == NULL) {
+        return false;
+    }
+    for (size_t i = 0; i < log->count; i++) {
+        grown[i] = entry_at(log, i);
+    }
+    free(log->entries);
+    log->entries = grown;
+    log->head = 0;
+    log->capacity = new_capacity;
+    return true;
+}
+
+void ws_replay_append(ws_replay_t *log, uint64_t seq, const void *msg, size_t len) {
+    if (log->max_bytes == 0) {
+        return;
+    }
+    log->appended += len;
+    if (len > log->max_bytes) {
+        clear(log);
+        return;
+    }
+
+    // Keep the numbers contiguous: a message that never made it in breaks
+    // the chain, and what came before it can't be replayed anyway
+    if (log->count > 0 && entry_at(log, log->count - 1)->seq + 1 != seq) {
+        clear(log);
+    }
+    while (log->count > 0 && log->bytes + len > log->max_bytes) {
+        drop_oldest(log);
+    }
+
+    ws_replay_entry_t *entry = malloc(sizeof(*entry) + len);
+    if (entry == NULL || (log->count == log->capacity && !grow(log))) {
+        free(entry);
+        clear(log);
+        return;
+    }
+    entry->seq = seq;
+    entry->offset = log->appended - len;
+    entry->len = len;
+    memcpy(entry->data, msg, len);
+    log->entries[(log->head + log->count) & (log->capacity - 1)] = entry;
+    log->count++;
+    log->bytes += len;
+}
+
+// Position of the message after seq, or SIZE_MAX if the log can't cover
+// everything from there to the last message
+static size_t index_after(const ws_replay_t *log, uint64_t seq) {
+    if (log->count == 0 || seq >= log->seq) {
+        return SIZE_MAX;
+    }
+    const ws_replay_entry_t *first = entry_at(log, 0);
+    if (entry_at(log, log->count - 1)->seq != log->seq || seq + 1 < first->seq) {
+        return SIZE_MAX;
+    }
+    return (size_t)(seq + 1 - first->seq);
+}
+
+size_t ws_replay_bytes_after(const ws_replay_t *log, uint64_t seq) {
+    if (seq == log->seq) {
+        return 0;
+    }
+    size_t i = index_after(log, seq);
+    if (i == SIZE_MAX) {
+        return SIZE_MAX;
+    }
+    return (size_t)(log->appended - entry_at(log, i)->offset);
+}
+
+const ws_replay_entry_t *ws_replay_after(const ws_replay_t *log, uint64_t seq, size_t i) {
+    size_t start = index_after(log, seq);
+    if (start == SIZE_MAX || start + i >= log->count) {
+        return NULL;
+    }
+    return entry_at(log, start + i);
+}
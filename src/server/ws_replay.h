@@ -0,0 +1,62 @@
+#ifndef NETPULSE_WS_REPLAY_H
+#define NETPULSE_WS_REPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * WebSocket replay log
+ *
+ * Every message in the live stream (batches, targets_updated) carries a
+ * sequence number, and the snapshot carries the number of the last message
+ * it includes. The log keeps the most recent messages, as sent in JSON, up
+ * to max_bytes. A client that reconnects with the last number it saw gets
+ * the messages after it replayed from here instead of a new snapshot, as
+ * long as they are all still held. Numbering goes on when the log is off
+ * (max_bytes 0), so a client that missed nothing can still resume.
+ * Sequence numbers are contiguous within the log; ws_replay_reset skips
+ * one, so nothing before it can be resumed.
+ *
+ * Event loop thread only.
+ */
+
+typedef struct {
+    uint64_t seq;
+    uint64_t offset;            // Bytes appended before this message
+    size_t len;
+    char data[];
+} ws_replay_entry_t;
+
+typedef struct {
+    ws_replay_entry_t **entries;    // Ring, oldest first
+    size_t head;
+    size_t count;
+    size_t capacity;                // Power of two (0 until the first message)
+    size_t bytes;                   // Held in entries
+    size_t max_bytes;               // 0 = keep nothing
+    uint64_t seq;                   // Number of the last message
+    uint64_t appended;              // Bytes appended so far
+} ws_replay_t;
+
+void ws_replay_init(ws_replay_t *log, size_t max_bytes);
+void ws_replay_free(ws_replay_t *log);
+
+// Number for the next message (pass it to ws_replay_append)
+uint64_t ws_replay_next(ws_replay_t *log);
+
+// Keep message seq, dropping the oldest ones beyond max_bytes. If it can't
+// be kept (too large, or out of memory), the log is emptied.
+void ws_replay_append(ws_replay_t *log, uint64_t seq, const void *msg, size_t len);
+
+// Forget every message and skip a number: no client can resume from before
+void ws_replay_reset(ws_replay_t *log);
+
+// Bytes of the messages after seq, or SIZE_MAX if any of them is gone
+size_t ws_replay_bytes_after(const ws_replay_t *log, uint64_t seq);
+
+// Messages after seq, oldest first: call with i = 0, 1, ... until NULL.
+// Only valid when ws_replay_bytes_after(log, seq) isn't SIZE_MAX.
+const ws_replay_entry_t *ws_replay_after(const ws_replay_t *log, uint64_t seq, size_t i);
+
+#endif // NETPULSE_WS_REPLAY_H
@@ -0,0 +1,408 @@
+#include "store/gorilla.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NO_WINDOW   0xFF    // window_leading before the first XOR
+
+/*
+ * Encoder
+ */
+
+// Make room for extra bytes, zeroing what is added (bits are ORed in)
+static int reserve(uint8_t **buf, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) {
+        return 0;
+    }
+
+    size_t new_capacity = *capacity > 0 ? *capacity * 2 : 64;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    uint8_t *grown = realloc(*buf, new_capacity);
+    if (grown == NULL) {
+        return -1;
+    }
+    memset(grown + *capacity, 0, new_capacity - *capacity);
+    *buf = grown;
+    *capacity = new_capacity;
+    return 0;
+}
+
+// Append the low n bits of value (n <= 64), most significant first
+static void put_bits(gorilla_encoder_t *enc, uint64_t value, unsigned n) {
+    while (n > 0) {
+        size_t byte = enc->stream_bits / 8;
+        unsigned room = 8 - (unsigned)(enc->stream_bits % 8);
+        unsigned take = n < room ? n : room;
+        uint8_t chunk = (uint8_t)((value >> (n - take)) & ((1u << take) - 1));
+        enc->stream[byte] |= (uint8_t)(chunk << (room - take));
+        enc->stream_bits += take;
+        n -= take;
+    }
+}
+
+static void put_timestamp(gorilla_encoder_t *enc, uint64_t ts_ms) {
+    int64_t delta = (int64_t)(ts_ms - enc->last_ts_ms);
+    int64_t dod = delta - enc->last_delta_ms;
+    enc->last_delta_ms = delta;
+
+    if (dod == 0) {
+        put_bits(enc, 0x0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        put_bits(enc, 0x2, 2);
+        put_bits(enc, (uint64_t)(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        put_bits(enc, 0x6, 3);
+        put_bits(enc, (uint64_t)(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        put_bits(enc, 0xE, 4);
+        put_bits(enc, (uint64_t)(dod + 2047), 12);
+    } else {
+        put_bits(enc, 0xF, 4);
+        put_bits(enc, (uint64_t)dod, 64);
+    }
+}
+
+static void put_rtt(gorilla_encoder_t *enc, double rtt_ms) {
+    double us = rtt_ms > 0.0 ? (double)(uint64_t)(rtt_ms * 1000.0 + 0.5) : 0.0;
+    uint64_t bits;
+    memcpy(&bits, &us, sizeof(bits));
+
+    if (!enc->has_rtt) {
+        put_bits(enc, bits, 64);
+        enc->has_rtt = true;
+        enc->last_rtt_bits = bits;
+        enc->window_leading = NO_WINDOW;
+        return;
+    }
+
+    uint64_t x = bits ^ enc->last_rtt_bits;
+    enc->last_rtt_bits = bits;
+    if (x == 0) {
+        put_bits(enc, 0x0, 1);
+        return;
+    }
+
+    unsigned leading = (unsigned)__builtin_clzll(x);
+    unsigned trailing = (unsigned)__builtin_ctzll(x);
+    if (leading > 31) {
+        leading = 31;   // 5-bit field
+    }
+
+    if (enc->window_leading != NO_WINDOW &&
+        leading >= enc->window_leading && trailing >= enc->window_trailing) {
+        put_bits(enc, 0x2, 2);
+        put_bits(enc, x >> enc->window_trailing, 64 - enc->window_leading - enc->window_trailing);
+        return;
+    }
+
+    unsigned length = 64 - leading - trailing;
+    put_bits(enc, 0x3, 2);
+    put_bits(enc, leading, 5);
+    put_bits(enc, length - 1, 6);
+    put_bits(enc, x >> trailing, length);
+    enc->window_leading = (uint8_t)leading;
+    enc->window_trailing = (uint8_t)trailing;
+}
+
+static size_t varint_size(uint32_t v) {
+    size_t n = 1;
+    while (v >= 0x80) {
+        v >>= 7;
+        n++;
+    }
+    return n;
+}
+
+static size_t put_varint(uint8_t *p, uint32_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+void gorilla_encoder_init(gorilla_encoder_t *enc) {
+    if (enc != NULL) {
+        memset(enc, 0, sizeof(*enc));
+    }
+}
+
+void gorilla_encoder_reset(gorilla_encoder_t *enc) {
+    if (enc == NULL) {
+        return;
+    }
+
+    if (enc->stream != NULL) {
+        memset(enc->stream, 0, (enc->stream_bits + 7) / 8);
+    }
+    enc->stream_bits = 0;
+    enc->runs_len = 0;
+    enc->count = 0;
+    enc->run_length = 0;
+    enc->has_rtt = false;
+    enc->last_delta_ms = 0;
+}
+
+void gorilla_encoder_free(gorilla_encoder_t *enc) {
+    if (enc == NULL) {
+        return;
+    }
+
+    free(enc->stream);
+    free(enc->runs);
+    gorilla_encoder_init(enc);
+}
+
+int gorilla_encoder_append(gorilla_encoder_t *enc, const sample_t *sample) {
+    if (enc == NULL || sample == NULL) {
+        return -1;
+    }
+
+    // Worst case: 68 timestamp bits + 77 RTT bits, and one closed run
+    if (reserve(&enc->stream, &enc->stream_capacity, (enc->stream_bits + 145 + 7) / 8) != 0 ||
+        reserve(&enc->runs, &enc->runs_capacity, enc->runs_len + 5) != 0) {
+        return -1;
+    }
+
+    if (enc->count == 0) {
+        enc->first_ts_ms = sample->timestamp_ms;
+        enc->first_ok = sample->success;
+        enc->run_ok = sample->success;
+        enc->run_length = 1;
+    } else {
+        put_timestamp(enc, sample->timestamp_ms);
+        if (sample->success == enc->run_ok) {
+            enc->run_length++;
+        } else {
+            enc->runs_len += put_varint(enc->runs + enc->runs_len, enc->run_length);
+            enc->run_ok = sample->success;
+            enc->run_length = 1;
+        }
+    }
+    enc->last_ts_ms = sample->timestamp_ms;
+
+    if (sample->success) {
+        put_rtt(enc, sample->rtt_ms);
+    }
+    enc->count++;
+    return 0;
+}
+
+size_t gorilla_encoder_stream_bytes(const gorilla_encoder_t *enc) {
+    return enc != NULL ? (enc->stream_bits + 7) / 8 : 0;
+}
+
+size_t gorilla_encoder_runs_bytes(const gorilla_encoder_t *enc) {
+    if (enc == NULL || enc->count == 0) {
+        return 0;
+    }
+    return enc->runs_len + varint_size(enc->run_length);
+}
+
+void gorilla_encoder_finish(const gorilla_encoder_t *enc, uint8_t *stream_out, uint8_t *runs_out) {
+    if (enc == NULL || enc->count == 0) {
+        return;
+    }
+
+    memcpy(stream_out, enc->stream, gorilla_encoder_stream_bytes(enc));
+    memcpy(runs_out, enc->runs, enc->runs_len);
+    put_varint(runs_out + enc->runs_len, enc->run_length);
+}
+
+/*
+ * Decoder
+ */
+
+typedef struct {
+    const uint8_t *data;
+    size_t bits;
+    size_t pos;
+} bit_reader_t;
+
+// Read n bits (n <= 64). Returns false past the end of the stream.
+static bool get_bits(bit_reader_t *r, unsigned n, uint64_t *value) {
+    if (r->pos + n > r->bits) {
+        return false;
+    }
+
+    // Fast path: one unaligned big-endian load covers the bits
+    size_t byte = r->pos / 8;
+    unsigned offset = (unsigned)(r->pos % 8);
+    if (n > 0 && n + offset <= 64 && byte + 8 <= r->bits / 8) {
+        uint64_t word;
+        memcpy(&word, r->data + byte, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        *value = (word << offset) >> (64 - n);
+        r->pos += n;
+        return true;
+    }
+
+    uint64_t v = 0;
+    while (n > 0) {
+        unsigned room = 8 - (unsigned)(r->pos % 8);
+        unsigned take = n < room ? n : room;
+        uint8_t chunk = (uint8_t)((r->data[r->pos / 8] >> (room - take)) & ((1u << take) - 1));
+        v = (v << take) | chunk;
+        r->pos += take;
+        n -= take;
+    }
+    *value = v;
+    return true;
+}
+
+static bool get_dod(bit_reader_t *r, int64_t *dod) {
+    // Count leading 1 bits of the control prefix (at most 4)
+    unsigned ones = 0;
+    uint64_t bit;
+    while (ones < 4) {
+        if (!get_bits(r, 1, &bit)) {
+            return false;
+        }
+        if (bit == 0) {
+            break;
+        }
+        ones++;
+    }
+
+    uint64_t v;
+    switch (ones) {
+        case 0:
+            *dod = 0;
+            return true;
+        case 1:
+            if (!get_bits(r, 7, &v)) {
+                return false;
+            }
+            *dod = (int64_t)v - 63;
+            return true;
+        case 2:
+            if (!get_bits(r, 9, &v)) {
+                return false;
+            }
+            *dod = (int64_t)v - 255;
+            return true;
+        case 3:
+            if (!get_bits(r, 12, &v)) {
+                return false;
+            }
+            *dod = (int64_t)v - 2047;
+            return true;
+        default:
+            if (!get_bits(r, 64, &v)) {
+                return false;
+            }
+            *dod = (int64_t)v;
+            return true;
+    }
+}
+
+typedef struct {
+    uint64_t last_bits;
+    unsigned leading;
+    unsigned trailing;
+    bool has_value;
+} rtt_reader_t;
+
+static bool get_rtt(bit_reader_t *r, rtt_reader_t *state, double *rtt_ms) {
+    uint64_t v;
+    if (!state->has_value) {
+        if (!get_bits(r, 64, &v)) {
+            return false;
+        }
+        state->has_value = true;
+    } else {
+        uint64_t control;
+        if (!get_bits(r, 1, &control)) {
+            return false;
+        }
+        if (control == 0) {
+            v = state->last_bits;
+        } else {
+            if (!get_bits(r, 1, &control)) {
+                return false;
+            }
+            if (control == 1) {
+                uint64_t leading, length;
+                if (!get_bits(r, 5, &leading) || !get_bits(r, 6, &length)) {
+                    return false;
+                }
+                if (leading + length + 1 > 64) {
+                    return false;
+                }
+                state->leading = (unsigned)leading;
+                state->trailing = 64 - (unsigned)leading - ((unsigned)length + 1);
+            }
+            unsigned length = 64 - state->leading - state->trailing;
+            uint64_t meaningful;
+            if (length == 0 || !get_bits(r, length, &meaningful)) {
+                return false;
+            }
+            v = state->last_bits ^ (meaningful << state->trailing);
+        }
+    }
+    state->last_bits = v;
+
+    double us;
+    memcpy(&us, &v, sizeof(us));
+    *rtt_ms = us / 1000.0;
+    return true;
+}
+
+size_t gorilla_decode(const gorilla_block_t *block, sample_t *out) {
+    if (block == NULL || out == NULL || block->count == 0) {
+        return 0;
+    }
+
+    // Success flags from the runs
+    size_t filled = 0;
+    size_t pos = 0;
+    bool ok = block->first_ok;
+    while (filled < block->count) {
+        uint32_t run = 0;
+        unsigned shift = 0;
+        for (;;) {
+            if (pos >= block->runs_bytes || shift > 28) {
+                return 0;
+            }
+            uint8_t byte = block->runs[pos++];
+            run |= (uint32_t)(byte & 0x7F) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+        if (run == 0 || run > block->count - filled) {
+            return 0;
+        }
+        for (uint32_t i = 0; i < run; i++) {
+            out[filled++].success = ok;
+        }
+        ok = !ok;
+    }
+
+    bit_reader_t r = { .data = block->stream, .bits = block->stream_bytes * 8 };
+    rtt_reader_t rtt = {0};
+    uint64_t ts = block->first_ts_ms;
+    int64_t delta = 0;
+    for (size_t i = 0; i < block->count; i++) {
+        if (i > 0) {
+            int64_t dod;
+            if (!get_dod(&r, &dod)) {
+                return 0;
+            }
+            delta += dod;
+            ts += (uint64_t)delta;
+        }
+        out[i].timestamp_ms = ts;
+        out[i].rtt_ms = 0.0;
+        if (out[i].success && !get_rtt(&r, &rtt, &out[i].rtt_ms)) {
+            return 0;
+        }
+    }
+    return block->count;
+}
@@ -0,0 +1,94 @@
+#ifndef NETPULSE_GORILLA_H
+#define NETPULSE_GORILLA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "core/stats.h"
+
+/*
+ * Compressed sample series (Gorilla style)
+ *
+ * A block of samples is encoded as two columns:
+ *
+ *   stream  one bit stream with, per sample, the timestamp and (for
+ *           successful samples) the RTT
+ *   runs    success flags as run lengths (LEB128), starting with first_ok
+ *
+ * Timestamps are delta-of-delta encoded against the block's first timestamp:
+ *
+ *   '0'                    same interval as before
+ *   '10'   + 7 bits        delta of delta in [-63, 64]
+ *   '110'  + 9 bits        [-255, 256]
+ *   '1110' + 12 bits       [-2047, 2048]
+ *   '1111' + 64 bits       anything else
+ *
+ * RTTs are stored as doubles holding whole microseconds (so their low
+ * mantissa bits are zero), each XORed with the previous RTT:
+ *
+ *   '0'                    same value
+ *   '10'  + bits           meaningful bits fit the previous window
+ *   '11'  + 5 bits leading zeros + 6 bits length + bits
+ *
+ * The first RTT of a block is stored as 64 raw bits. Failed samples carry
+ * no RTT (they decode as 0 ms). RTTs are rounded to 1 us.
+ *
+ * An encoder grows its buffers as samples are appended, so it doubles as
+ * the in-memory form of a series' most recent samples.
+ */
+
+typedef struct {
+    uint8_t *stream;            // Timestamp/RTT bit stream
+    size_t stream_capacity;     // Bytes allocated
+    size_t stream_bits;         // Bits written
+    uint8_t *runs;              // Closed success runs (LEB128)
+    size_t runs_capacity;
+    size_t runs_len;
+    uint32_t count;             // Samples in the block
+    uint32_t run_length;        // Samples in the open run
+    bool first_ok;              // Success flag of the first run
+    bool run_ok;                // Success flag of the open run
+    bool has_rtt;               // last_rtt_bits is set
+    uint8_t window_leading;     // XOR window of the previous RTT
+    uint8_t window_trailing;
+    uint64_t first_ts_ms;
+    uint64_t last_ts_ms;
+    int64_t last_delta_ms;
+    uint64_t last_rtt_bits;
+} gorilla_encoder_t;
+
+// A finished block, as read back from storage
+typedef struct {
+    const uint8_t *stream;
+    size_t stream_bytes;
+    const uint8_t *runs;
+    size_t runs_bytes;
+    uint64_t first_ts_ms;
+    uint32_t count;
+    bool first_ok;
+} gorilla_block_t;
+
+// Empty encoder with no buffers
+void gorilla_encoder_init(gorilla_encoder_t *enc);
+
+// Drop the encoded samples, keeping the buffers
+void gorilla_encoder_reset(gorilla_encoder_t *enc);
+
+void gorilla_encoder_free(gorilla_encoder_t *enc);
+
+// Append a sample (timestamps should not go backwards). Returns 0, or -1
+// if a buffer could not grow.
+int gorilla_encoder_append(gorilla_encoder_t *enc, const sample_t *sample);
+
+// Sizes of the finished columns
+size_t gorilla_encoder_stream_bytes(const gorilla_encoder_t *enc);
+size_t gorilla_encoder_runs_bytes(const gorilla_encoder_t *enc);     // Includes the open run
+
+// Write the finished columns (sizes above) without changing the encoder
+void gorilla_encoder_finish(const gorilla_encoder_t *enc, uint8_t *stream_out, uint8_t *runs_out);
+
+// Decode block->count samples into out. Returns the count, or 0 if the
+// block is malformed.
+size_t gorilla_decode(const gorilla_block_t *block, sample_t *out);
+
+#endif // NETPULSE_GORILLA_H
@@ -0,0 +1,371 @@
+#include "store/rollup.h"
+#include <string.h>
+
+static const uint64_t g_tier_width_ms[ROLLUP_TIER_COUNT] = { 10000, 60000, 3600000 };
+static const char *const g_tier_names[ROLLUP_TIER_COUNT] = { "10s", "1m", "1h" };
+
+uint64_t rollup_tier_width_ms(rollup_tier_t tier) {
+    return tier < ROLLUP_TIER_COUNT ? g_tier_width_ms[tier] : 0;
+}
+
+const char *rollup_tier_name(rollup_tier_t tier) {
+    return tier < ROLLUP_TIER_COUNT ? g_tier_names[tier] : "raw";
+}
+
+// Start an empty bucket at index
+static void bucket_start(rollup_bucket_t *b, uint64_t index) {
+    b->index = index;
+    b->count = 0;
+    b->failures = 0;
+    b->min_rtt_ms = 0.0;
+    b->max_rtt_ms = 0.0;
+    b->sum_rtt_ms = 0.0;
+}
+
+// Fold src (same or earlier period) into dst
+static void bucket_merge(rollup_bucket_t *dst, const rollup_bucket_t *src) {
+    uint32_t dst_ok = dst->count - dst->failures;
+    uint32_t src_ok = src->count - src->failures;
+    if (src_ok > 0) {
+        if (dst_ok == 0 || src->min_rtt_ms < dst->min_rtt_ms) {
+            dst->min_rtt_ms = src->min_rtt_ms;
+        }
+        if (dst_ok == 0 || src->max_rtt_ms > dst->max_rtt_ms) {
+            dst->max_rtt_ms = src->max_rtt_ms;
+        }
+    }
+    dst->count += src->count;
+    dst->failures += src->failures;
+    dst->sum_rtt_ms += src->sum_rtt_ms;
+    quantile_coarse_merge(&dst->rtt, &src->rtt);
+}
+
+// Value of the rank-th smallest entry of sparse bins, walking on from *pos
+// (with *below entries before it); rank at least the last one asked
+static double bins_value(const rollup_bin_t *bins, uint16_t bin_count, uint16_t *pos, uint32_t *below,
+                         uint32_t rank) {
+    while (*pos + 1 < bin_count && rank >= *below + bins[*pos].count) {
+        *below += bins[*pos].count;
+        (*pos)++;
+    }
+    return quantile_coarse_bin_ms(bins[*pos].index);
+}
+
+// Fill in a record's percentiles from its bins. Bins are in index order,
+// so one walk reads them in ascending order, interpolating like
+// rollup_accum_point.
+static void record_percentiles(rollup_record_t *record) {
+    const rollup_bin_t *bins = rollup_record_bins(record);
+    uint32_t total = 0;
+    for (uint16_t i = 0; i < record->bin_count; i++) {
+        total += bins[i].count;
+    }
+    if (total == 0) {
+        return;
+    }
+
+    static const double percentiles[3] = { 50.0, 95.0, 99.0 };
+    double values[3];
+    uint16_t pos = 0;
+    uint32_t below = 0;
+    for (int i = 0; i < 3; i++) {
+        double idx = (percentiles[i] / 100.0) * (double)(total - 1);
+        uint32_t lower = (uint32_t)idx;
+        double low = bins_value(bins, record->bin_count, &pos, &below, lower);
+        double frac = idx - (double)lower;
+        if (lower + 1 >= total || frac == 0.0) {
+            values[i] = low;
+        } else {
+            uint16_t ahead_pos = pos;
+            uint32_t ahead_below = below;
+            double high = bins_value(bins, record->bin_count, &ahead_pos, &ahead_below, lower + 1);
+            values[i] = low * (1.0 - frac) + high * frac;
+        }
+    }
+    record->p50_ms = (float)values[0];
+    record->p95_ms = (float)values[1];
+    record->p99_ms = (float)values[2];
+}
+
+// Write a bucket as a record into out (ROLLUP_RECORD_MAX bytes)
+static void bucket_record(const rollup_bucket_t *b, uint64_t width_ms, rollup_record_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->start_ms = b->index * width_ms;
+    out->count = b->count;
+    out->failures = b->failures;
+    out->min_rtt_ms = (float)b->min_rtt_ms;
+    out->max_rtt_ms = (float)b->max_rtt_ms;
+    out->sum_rtt_ms = b->sum_rtt_ms;
+
+    rollup_bin_t *bins = (rollup_bin_t *)(out + 1);
+    uint16_t n = 0;
+    for (size_t g = 0; g < QUANTILE_COARSE_GROUPS; g++) {
+        if (b->rtt.group_counts[g] == 0) {
+            continue;
+        }
+        for (size_t i = g * QUANTILE_COARSE_SUB_COUNT; i < (g + 1) * QUANTILE_COARSE_SUB_COUNT; i++) {
+            if (b->rtt.counts[i] != 0) {
+                bins[n].index = (uint16_t)i;
+                bins[n].count = b->rtt.counts[i];
+                n++;
+            }
+        }
+    }
+    out->bin_count = n;
+    record_percentiles(out);
+}
+
+static void close_tier(rollup_series_t *rs, rollup_tier_t tier, rollup_emit_cb_t emit, void *ctx) {
+    rollup_bucket_t *b = &rs->open[tier];
+    if (b->count == 0) {
+        return;
+    }
+
+    uint64_t record_buf[ROLLUP_RECORD_MAX / sizeof(uint64_t) + 1];
+    rollup_record_t *record = (rollup_record_t *)record_buf;
+    bucket_record(b, g_tier_width_ms[tier], record);
+    emit(tier, record, ctx);
+
+    if (tier + 1 < ROLLUP_TIER_COUNT) {
+        rollup_bucket_t *next = &rs->open[tier + 1];
+        uint64_t index = b->index * g_tier_width_ms[tier] / g_tier_width_ms[tier + 1];
+        if (next->count > 0 && index > next->index) {
+            close_tier(rs, tier + 1, emit, ctx);
+        }
+        if (next->count == 0) {
+            bucket_start(next, index);
+        }
+        bucket_merge(next, b);
+    }
+
+    bucket_start(b, b->index);
+    memset(&b->rtt, 0, sizeof(b->rtt));
+}
+
+void rollup_push(rollup_series_t *rs, const sample_t *sample, rollup_emit_cb_t emit, void *ctx) {
+    if (rs == NULL || sample == NULL || emit == NULL) {
+        return;
+    }
+
+    rollup_bucket_t *b = &rs->open[ROLLUP_10S];
+    uint64_t index = sample->timestamp_ms / g_tier_width_ms[ROLLUP_10S];
+    if (b->count > 0 && index > b->index) {
+        close_tier(rs, ROLLUP_10S, emit, ctx);
+    }
+    if (b->count == 0) {
+        bucket_start(b, index);
+    }
+
+    // A late sample (clock stepped back) counts in the open bucket
+    b->count++;
+    if (!sample->success) {
+        b->failures++;
+        return;
+    }
+    if (b->count - b->failures == 1 || sample->rtt_ms < b->min_rtt_ms) {
+        b->min_rtt_ms = sample->rtt_ms;
+    }
+    if (b->count - b->failures == 1 || sample->rtt_ms > b->max_rtt_ms) {
+        b->max_rtt_ms = sample->rtt_ms;
+    }
+    b->sum_rtt_ms += sample->rtt_ms;
+    quantile_coarse_add(&b->rtt, sample->rtt_ms);
+}
+
+void rollup_advance(rollup_series_t *rs, uint64_t now_wall_ms, rollup_emit_cb_t emit, void *ctx) {
+    if (rs == NULL || emit == NULL) {
+        return;
+    }
+
+    // In tier order: closing a bucket can fill the next tier's
+    for (int t = 0; t < ROLLUP_TIER_COUNT; t++) {
+        const rollup_bucket_t *b = &rs->open[t];
+        if (b->count > 0 && (b->index + 1) * g_tier_width_ms[t] <= now_wall_ms) {
+            close_tier(rs, (rollup_tier_t)t, emit, ctx);
+        }
+    }
+}
+
+void rollup_flush(rollup_series_t *rs, rollup_emit_cb_t emit, void *ctx) {
+    if (rs == NULL || emit == NULL) {
+        return;
+    }
+
+    for (int t = 0; t < ROLLUP_TIER_COUNT; t++) {
+        close_tier(rs, (rollup_tier_t)t, emit, ctx);
+    }
+}
+
+bool rollup_open_record(const rollup_series_t *rs, rollup_tier_t tier, rollup_record_t *out) {
+    if (rs == NULL || tier >= ROLLUP_TIER_COUNT || out == NULL) {
+        return false;
+    }
+
+    rollup_bucket_t merged = rs->open[tier];
+    for (int t = 0; t < (int)tier; t++) {
+        const rollup_bucket_t *lower = &rs->open[t];
+        if (lower->count == 0) {
+            continue;
+        }
+        uint64_t index = lower->index * g_tier_width_ms[t] / g_tier_width_ms[tier];
+        if (merged.count == 0) {
+            bucket_start(&merged, index);
+            memset(&merged.rtt, 0, sizeof(merged.rtt));
+        }
+        if (index == merged.index) {
+            bucket_merge(&merged, lower);
+        }
+    }
+    if (merged.count == 0) {
+        return false;
+    }
+
+    bucket_record(&merged, g_tier_width_ms[tier], out);
+    return true;
+}
+
+/*
+ * Query aggregation
+ */
+
+void rollup_accum_clear(rollup_accum_t *acc) {
+    if (acc == NULL) {
+        return;
+    }
+
+    // Only the groups that hold values need zeroing
+    for (size_t g = 0; g < QUANTILE_COARSE_GROUPS; g++) {
+        if (acc->rtt.group_counts[g] != 0) {
+            memset(&acc->rtt.counts[g * QUANTILE_COARSE_SUB_COUNT], 0,
+                   QUANTILE_COARSE_SUB_COUNT * sizeof(acc->rtt.counts[0]));
+            acc->rtt.group_counts[g] = 0;
+        }
+    }
+    acc->rtt.total = 0;
+    acc->count = 0;
+    acc->failures = 0;
+    acc->min_rtt_ms = 0.0;
+    acc->max_rtt_ms = 0.0;
+    acc->sum_rtt_ms = 0.0;
+}
+
+void rollup_accum_add_sample(rollup_accum_t *acc, const sample_t *sample) {
+    if (acc == NULL || sample == NULL) {
+        return;
+    }
+
+    acc->count++;
+    if (!sample->success) {
+        acc->failures++;
+        return;
+    }
+    if (acc->rtt.total == 0 || sample->rtt_ms < acc->min_rtt_ms) {
+        acc->min_rtt_ms = sample->rtt_ms;
+    }
+    if (acc->rtt.total == 0 || sample->rtt_ms > acc->max_rtt_ms) {
+        acc->max_rtt_ms = sample->rtt_ms;
+    }
+    acc->sum_rtt_ms += sample->rtt_ms;
+    quantile_coarse_sum_add_value(&acc->rtt, sample->rtt_ms);
+}
+
+void rollup_accum_add_record(rollup_accum_t *acc, const rollup_record_t *record) {
+    if (acc == NULL || record == NULL) {
+        return;
+    }
+
+    if (record->count > record->failures) {
+        if (acc->count == acc->failures || record->min_rtt_ms < acc->min_rtt_ms) {
+            acc->min_rtt_ms = record->min_rtt_ms;
+        }
+        if (acc->count == acc->failures || record->max_rtt_ms > acc->max_rtt_ms) {
+            acc->max_rtt_ms = record->max_rtt_ms;
+        }
+    }
+    acc->count += record->count;
+    acc->failures += record->failures;
+    acc->sum_rtt_ms += record->sum_rtt_ms;
+
+    // Inline rather than quantile_coarse_sum_add_bin: this is the query inner loop
+    const rollup_bin_t *bins = rollup_record_bins(record);
+    uint32_t added = 0;
+    for (uint16_t i = 0; i < record->bin_count; i++) {
+        uint16_t index = bins[i].index;
+        if (index < QUANTILE_COARSE_BUCKETS) {
+            acc->rtt.counts[index] += bins[i].count;
+            acc->rtt.group_counts[index / QUANTILE_COARSE_SUB_COUNT] += bins[i].count;
+            added += bins[i].count;
+        }
+    }
+    acc->rtt.total += added;
+}
+
+// Percentiles are read from coarse buckets, whose midpoints can lie outside
+// the exact min and max; keep them inside
+static void clamp_percentiles(rollup_point_t *out) {
+    double *values[3] = { &out->p50_ms, &out->p95_ms, &out->p99_ms };
+    for (int i = 0; i < 3; i++) {
+        if (*values[i] > out->max_ms) {
+            *values[i] = out->max_ms;
+        }
+        if (*values[i] < out->min_ms) {
+            *values[i] = out->min_ms;
+        }
+    }
+}
+
+void rollup_accum_point(const rollup_accum_t *acc, uint64_t start_ms, rollup_point_t *out) {
+    if (acc == NULL || out == NULL) {
+        return;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->start_ms = start_ms;
+    out->count = (uint32_t)acc->count;
+    out->failures = (uint32_t)acc->failures;
+    if (acc->count == 0) {
+        return;
+    }
+
+    out->loss_pct = (double)acc->failures * 100.0 / (double)acc->count;
+    uint64_t ok = acc->count - acc->failures;
+    if (ok > 0) {
+        out->min_ms = acc->min_rtt_ms;
+        out->max_ms = acc->max_rtt_ms;
+        out->mean_ms = acc->sum_rtt_ms / (double)ok;
+        static const double percentiles[3] = { 50.0, 95.0, 99.0 };
+        double values[3];
+        quantile_coarse_sum_percentiles(&acc->rtt, percentiles, 3, values);
+        out->p50_ms = values[0];
+        out->p95_ms = values[1];
+        out->p99_ms = values[2];
+        clamp_percentiles(out);
+    }
+}
+
+void rollup_record_point(const rollup_record_t *record, uint64_t start_ms, rollup_point_t *out) {
+    if (record == NULL || out == NULL) {
+        return;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->start_ms = start_ms;
+    out->count = record->count;
+    out->failures = record->failures;
+    if (record->count == 0) {
+        return;
+    }
+
+    out->loss_pct = (double)record->failures * 100.0 / (double)record->count;
+    uint32_t ok = record->count - record->failures;
+    if (ok == 0) {
+        return;
+    }
+    out->min_ms = record->min_rtt_ms;
+    out->max_ms = record->max_rtt_ms;
+    out->mean_ms = record->sum_rtt_ms / (double)ok;
+    out->p50_ms = record->p50_ms;
+    out->p95_ms = record->p95_ms;
+    out->p99_ms = record->p99_ms;
+    clamp_percentiles(out);
+}
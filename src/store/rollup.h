@@ -0,0 +1,148 @@
+#ifndef NETPULSE_ROLLUP_H
+#define NETPULSE_ROLLUP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "core/stats.h"
+#include "core/quantile.h"
+
+/*
+ * Rollups: per-series aggregates over fixed wall-clock buckets
+ *
+ *   raw samples -> 10 s -> 1 min -> 1 h
+ *
+ * Samples are counted into the open 10 s bucket. When a bucket closes it is
+ * emitted as a record and merged into the open bucket of the next tier, so
+ * 1 min buckets are built from 10 s ones and 1 h buckets from 1 min ones.
+ * A sample costs one bucket update (O(1)); closing a bucket costs a walk of
+ * its sketch and happens once per bucket.
+ *
+ * A record holds the sample count, failures, min/max/sum of successful RTTs
+ * and their sketch as sparse (bin, count) pairs of a quantile_coarse_t, so
+ * records of any tier merge into percentiles within 3.1% (core/quantile.h).
+ * The record's own p50/p95/p99 are kept alongside for single-record reads.
+ */
+
+typedef enum {
+    ROLLUP_10S,
+    ROLLUP_1M,
+    ROLLUP_1H,
+    ROLLUP_TIER_COUNT
+} rollup_tier_t;
+
+// Bucket width of a tier in milliseconds
+uint64_t rollup_tier_width_ms(rollup_tier_t tier);
+
+// Short name of a tier ("10s", "1m", "1h")
+const char *rollup_tier_name(rollup_tier_t tier);
+
+// One non-empty bin of a record's RTT sketch
+typedef struct {
+    uint16_t index;             // Bin in quantile_coarse_t
+    uint16_t count;
+} rollup_bin_t;
+
+/*
+ * Closed bucket as stored: this header, then bin_count rollup_bin_t
+ * (rollup_record_size bytes in all)
+ */
+typedef struct {
+    uint64_t start_ms;          // Bucket start (wall clock)
+    uint32_t count;             // Samples
+    uint32_t failures;          // Failed samples
+    float min_rtt_ms;           // Successful RTTs
+    float max_rtt_ms;
+    double sum_rtt_ms;
+    float p50_ms;               // Percentiles of the bins, taken when the
+    float p95_ms;               // bucket closes so a record reads as a
+    float p99_ms;               // point without walking them
+    uint16_t bin_count;
+    uint16_t reserved;
+} rollup_record_t;
+
+#define ROLLUP_RECORD_MAX   (sizeof(rollup_record_t) + QUANTILE_COARSE_BUCKETS * sizeof(rollup_bin_t))
+
+// Bytes of a record with bin_count bins, padded to 8
+static inline size_t rollup_record_size(uint16_t bin_count) {
+    return (sizeof(rollup_record_t) + (size_t)bin_count * sizeof(rollup_bin_t) + 7) & ~(size_t)7;
+}
+
+static inline const rollup_bin_t *rollup_record_bins(const rollup_record_t *record) {
+    return (const rollup_bin_t *)(record + 1);
+}
+
+/*
+ * Open buckets of one series (zeroed = empty)
+ */
+typedef struct {
+    uint64_t index;             // start_ms / tier width
+    uint32_t count;             // Samples (0 = bucket empty)
+    uint32_t failures;
+    double min_rtt_ms;
+    double max_rtt_ms;
+    double sum_rtt_ms;
+    quantile_coarse_t rtt;
+} rollup_bucket_t;
+
+typedef struct {
+    rollup_bucket_t open[ROLLUP_TIER_COUNT];
+} rollup_series_t;
+
+// Called with each closed bucket (record is followed by its bins)
+typedef void (*rollup_emit_cb_t)(rollup_tier_t tier, const rollup_record_t *record, void *ctx);
+
+// Count a sample, closing the buckets it moves past
+void rollup_push(rollup_series_t *rs, const sample_t *sample, rollup_emit_cb_t emit, void *ctx);
+
+// Close buckets that ended at or before now_wall_ms
+void rollup_advance(rollup_series_t *rs, uint64_t now_wall_ms, rollup_emit_cb_t emit, void *ctx);
+
+// Close every open bucket, partial ones included (e.g. at shutdown)
+void rollup_flush(rollup_series_t *rs, rollup_emit_cb_t emit, void *ctx);
+
+// The open bucket of a tier, with the lower tiers' open buckets of the same
+// period merged in, as a record in out (ROLLUP_RECORD_MAX bytes, 8-aligned).
+// Returns false if it holds no samples.
+bool rollup_open_record(const rollup_series_t *rs, rollup_tier_t tier, rollup_record_t *out);
+
+/*
+ * Aggregation for queries: samples or records in, one point out
+ */
+typedef struct {
+    uint64_t start_ms;
+    uint32_t count;             // Samples
+    uint32_t failures;
+    double loss_pct;
+    double min_ms;              // Successful RTTs (0 if none)
+    double mean_ms;
+    double p50_ms;
+    double p95_ms;
+    double p99_ms;
+    double max_ms;
+} rollup_point_t;
+
+typedef struct {
+    uint64_t count;
+    uint64_t failures;
+    double min_rtt_ms;
+    double max_rtt_ms;
+    double sum_rtt_ms;
+    quantile_coarse_sum_t rtt;
+} rollup_accum_t;
+
+// Empty an accumulator. It must start zeroed (calloc or = {0}); clearing
+// then costs only the sketch groups that were used.
+void rollup_accum_clear(rollup_accum_t *acc);
+void rollup_accum_add_sample(rollup_accum_t *acc, const sample_t *sample);
+void rollup_accum_add_record(rollup_accum_t *acc, const rollup_record_t *record);
+
+// Point for start_ms from what was added. Percentiles are kept within
+// [min_ms, max_ms].
+void rollup_accum_point(const rollup_accum_t *acc, uint64_t start_ms, rollup_point_t *out);
+
+// Point for start_ms from one record alone (as accumulating it would give,
+// percentiles to float precision)
+void rollup_record_point(const rollup_record_t *record, uint64_t start_ms, rollup_point_t *out);
+
+#endif // NETPULSE_ROLLUP_H
@@ -0,0 +1,794 @@
+#include "store/sample_store.h"
+#include "store/gorilla.h"
+#include "store/segment_log.h"
+#include "platform/platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define STORE_SUBDIR            "samples"
+#define BLOCK_MAGIC             0x4C52474EU     // "NGRL"
+#define ROLLUP_MAGIC            0x324C524EU     // "NRL2" (records with percentiles)
+#define STORE_FLUSH_SOON        65536           // Staged samples that wake the writer early
+#define RETENTION_CHECK_MS      60000
+
+/*
+ * Rollup tiers on disk: directory, wall-clock span of a segment and the
+ * shortest retention (the sample retention is used if it is longer)
+ */
+typedef struct {
+    const char *subdir;
+    uint64_t span_ms;
+    uint64_t retention_ms;
+} tier_layout_t;
+
+static const tier_layout_t g_tiers[ROLLUP_TIER_COUNT] = {
+    { "rollup-10s", 6ULL * 3600000ULL,   7ULL * 86400000ULL },
+    { "rollup-1m",  86400000ULL,         30ULL * 86400000ULL },
+    { "rollup-1h",  7ULL * 86400000ULL,  365ULL * 86400000ULL },
+};
+
+/*
+ * Sample block: this header, the series id (padded to 8), then the Gorilla
+ * stream and success runs (see store/gorilla.h), padded to 8
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t id_len;
+    uint16_t count;
+    uint32_t stream_bytes;
+    uint16_t runs_bytes;
+    uint8_t first_ok;
+    uint8_t reserved;
+    uint64_t first_ts_ms;
+    uint64_t last_ts_ms;
+} block_header_t;
+
+/*
+ * Rollup block: this header, the series id (padded to 8), then count records
+ * of one tier (rollup_record_size bytes each)
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t id_len;
+    uint16_t reserved;
+    uint32_t count;
+    uint32_t bytes;             // Record bytes
+    uint64_t first_ts_ms;       // Oldest bucket start
+    uint64_t last_ts_ms;        // Newest bucket end - 1
+} rollup_header_t;
+
+// Closed records of one tier not written yet
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t capacity;
+    uint32_t count;
+    uint64_t first_ts_ms;
+    uint64_t last_ts_ms;
+    uint64_t since_ms;          // When the oldest arrived (monotonic)
+} pending_t;
+
+typedef struct {
+    char id[SAMPLE_STORE_MAX_ID];
+    gorilla_encoder_t staged;   // Samples not written yet, compressed
+    uint64_t staged_since_ms;   // When the oldest staged sample arrived (monotonic)
+    rollup_series_t rollup;     // Open buckets
+    pending_t pending[ROLLUP_TIER_COUNT];
+} series_t;
+
+/*
+ * Everything below is guarded by lock. The writer thread encodes nothing
+ * itself (appends compress and aggregate as they go); it copies finished
+ * blocks into the mapped segments, which is cheap enough to do under the
+ * lock. That lets a scan take one consistent cut: segments up to their
+ * current size plus what is staged.
+ */
+struct sample_store {
+    uint64_t retention_ms;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;        // Writer: work, flush or stop
+    pthread_cond_t flushed;     // Flush waiters
+    pthread_t writer;
+    bool stop;
+    uint64_t flush_requested;
+    uint64_t flush_done;
+    series_t **series;          // Stable pointers, index = handle
+    size_t series_count;
+    size_t series_capacity;
+    size_t staged_total;
+    sample_store_stats_t stats;
+
+    segment_log_t *samples;
+    segment_log_t *rollups[ROLLUP_TIER_COUNT];
+    uint64_t rollup_retention_ms[ROLLUP_TIER_COUNT];
+    uint64_t last_retention_ms;
+};
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+/*
+ * Sample blocks
+ */
+
+// Length of a block from its header
+static size_t block_length(const block_header_t *bh) {
+    return align8(sizeof(*bh) + align8(bh->id_len) + bh->stream_bytes + bh->runs_bytes);
+}
+
+// Header of the block a series' staged samples make
+static block_header_t staged_block_header(const series_t *s) {
+    block_header_t bh = {
+        .magic = BLOCK_MAGIC,
+        .id_len = (uint16_t)strlen(s->id),
+        .count = (uint16_t)s->staged.count,
+        .stream_bytes = (uint32_t)gorilla_encoder_stream_bytes(&s->staged),
+        .runs_bytes = (uint16_t)gorilla_encoder_runs_bytes(&s->staged),
+        .first_ok = s->staged.first_ok ? 1 : 0,
+        .first_ts_ms = s->staged.first_ts_ms,
+        .last_ts_ms = s->staged.last_ts_ms,
+    };
+    return bh;
+}
+
+// Write a series' staged samples as a block at dst (block_length bytes)
+static void write_staged_block(const series_t *s, const block_header_t *bh, uint8_t *dst) {
+    size_t len = block_length(bh);
+    memset(dst, 0, len);
+    memcpy(dst, bh, sizeof(*bh));
+    memcpy(dst + sizeof(*bh), s->id, bh->id_len);
+
+    uint8_t *stream = dst + sizeof(*bh) + align8(bh->id_len);
+    gorilla_encoder_finish(&s->staged, stream, stream + bh->stream_bytes);
+}
+
+// Move a series' staged samples into the sample log (lock held)
+static void write_series(sample_store_t *store, series_t *s, uint64_t now_wall_ms) {
+    block_header_t bh = staged_block_header(s);
+    size_t len = block_length(&bh);
+
+    uint8_t *dst = segment_log_reserve(store->samples, len, now_wall_ms);
+    if (dst == NULL) {
+        store->stats.samples_dropped += s->staged.count;
+    } else {
+        write_staged_block(s, &bh, dst);
+        segment_log_commit(store->samples, len, bh.first_ts_ms, bh.last_ts_ms);
+        store->stats.samples_written += bh.count;
+        store->stats.blocks_written++;
+        store->stats.bytes_written += len;
+    }
+    store->staged_total -= s->staged.count;
+    gorilla_encoder_reset(&s->staged);
+}
+
+/*
+ * Rollup blocks
+ */
+
+static size_t rollup_block_length(size_t id_len, size_t record_bytes) {
+    return sizeof(rollup_header_t) + align8(id_len) + record_bytes;
+}
+
+// Write records as a rollup block at dst (rollup_block_length bytes)
+static void write_rollup_block(const char *id, const uint8_t *records, size_t bytes, uint32_t count,
+                               uint64_t first_ts_ms, uint64_t last_ts_ms, uint8_t *dst) {
+    rollup_header_t rh = {
+        .magic = ROLLUP_MAGIC,
+        .id_len = (uint16_t)strlen(id),
+        .count = count,
+        .bytes = (uint32_t)bytes,
+        .first_ts_ms = first_ts_ms,
+        .last_ts_ms = last_ts_ms,
+    };
+    size_t id_bytes = align8(rh.id_len);
+    memcpy(dst, &rh, sizeof(rh));
+    memset(dst + sizeof(rh), 0, id_bytes);
+    memcpy(dst + sizeof(rh), id, rh.id_len);
+    memcpy(dst + sizeof(rh) + id_bytes, records, bytes);
+}
+
+typedef struct {
+    sample_store_t *store;
+    series_t *series;
+} emit_ctx_t;
+
+// rollup_emit_cb_t: queue a closed record for writing (lock held)
+static void queue_record(rollup_tier_t tier, const rollup_record_t *record, void *arg) {
+    emit_ctx_t *ctx = arg;
+    pending_t *p = &ctx->series->pending[tier];
+    size_t size = rollup_record_size(record->bin_count);
+
+    if (p->len + size > p->capacity) {
+        size_t new_capacity = p->capacity > 0 ? p->capacity * 2 : 1024;
+        while (new_capacity < p->len + size) {
+            new_capacity *= 2;
+        }
+        uint8_t *grown = realloc(p->data, new_capacity);
+        if (grown == NULL) {
+            ctx->store->stats.rollups_dropped++;
+            return;
+        }
+        p->data = grown;
+        p->capacity = new_capacity;
+    }
+
+    memset(p->data + p->len, 0, size);
+    memcpy(p->data + p->len, record,
+           sizeof(*record) + (size_t)record->bin_count * sizeof(rollup_bin_t));
+    p->len += size;
+
+    uint64_t last_ts_ms = record->start_ms + rollup_tier_width_ms(tier) - 1;
+    if (p->count == 0) {
+        p->first_ts_ms = record->start_ms;
+        p->last_ts_ms = last_ts_ms;
+        p->since_ms = now_ms();
+    } else {
+        if (record->start_ms < p->first_ts_ms) {
+            p->first_ts_ms = record->start_ms;
+        }
+        if (last_ts_ms > p->last_ts_ms) {
+            p->last_ts_ms = last_ts_ms;
+        }
+    }
+    p->count++;
+}
+
+// Move a series' closed records of one tier into its log (lock held)
+static void write_rollups(sample_store_t *store, series_t *s, rollup_tier_t tier, uint64_t now_wall_ms) {
+    pending_t *p = &s->pending[tier];
+    size_t len = rollup_block_length(strlen(s->id), p->len);
+
+    uint8_t *dst = segment_log_reserve(store->rollups[tier], len, now_wall_ms);
+    if (dst == NULL) {
+        store->stats.rollups_dropped += p->count;
+    } else {
+        write_rollup_block(s->id, p->data, p->len, p->count, p->first_ts_ms, p->last_ts_ms, dst);
+        segment_log_commit(store->rollups[tier], len, p->first_ts_ms, p->last_ts_ms);
+        store->stats.rollups_written += p->count;
+        store->stats.blocks_written++;
+        store->stats.bytes_written += len;
+    }
+    p->len = 0;
+    p->count = 0;
+}
+
+/*
+ * Writer thread
+ */
+
+// Write what is due for one series, or everything if take_all (lock held)
+static void write_due(sample_store_t *store, series_t *s, bool take_all, uint64_t now, uint64_t now_wall_ms) {
+    uint32_t count = s->staged.count;
+    if (count > 0 &&
+        (take_all || count >= SAMPLE_STORE_BLOCK_MIN || now - s->staged_since_ms >= SAMPLE_STORE_MAX_AGE_MS)) {
+        write_series(store, s, now_wall_ms);
+    }
+
+    for (int t = 0; t < ROLLUP_TIER_COUNT; t++) {
+        const pending_t *p = &s->pending[t];
+        if (p->count > 0 &&
+            (take_all || p->count >= SAMPLE_STORE_ROLLUP_BLOCK || now - p->since_ms >= SAMPLE_STORE_ROLLUP_AGE_MS)) {
+            write_rollups(store, s, (rollup_tier_t)t, now_wall_ms);
+        }
+    }
+}
+
+static void *writer_main(void *arg) {
+    sample_store_t *store = arg;
+
+    pthread_mutex_lock(&store->lock);
+    for (;;) {
+        if (!store->stop && store->staged_total < STORE_FLUSH_SOON &&
+            store->flush_requested == store->flush_done) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += SAMPLE_STORE_FLUSH_MS / 1000;
+            deadline.tv_nsec += (long)(SAMPLE_STORE_FLUSH_MS % 1000) * 1000000L;
+            if (deadline.tv_nsec >= 1000000000L) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&store->wake, &store->lock, &deadline);
+        }
+
+        // Close the buckets time has passed, then write what is due (or all of it)
+        uint64_t generation = store->flush_requested;
+        bool stopping = store->stop;
+        bool take_all = stopping || generation != store->flush_done ||
+                        store->staged_total >= STORE_FLUSH_SOON;
+        uint64_t now = now_ms();
+        uint64_t now_wall_ms = wall_clock_ms();
+        for (size_t i = 0; i < store->series_count; i++) {
+            series_t *s = store->series[i];
+            emit_ctx_t ctx = { store, s };
+            if (stopping) {
+                rollup_flush(&s->rollup, queue_record, &ctx);
+            } else if (now_wall_ms > SAMPLE_STORE_ROLLUP_GRACE_MS) {
+                rollup_advance(&s->rollup, now_wall_ms - SAMPLE_STORE_ROLLUP_GRACE_MS, queue_record, &ctx);
+            }
+            write_due(store, s, take_all, now, now_wall_ms);
+        }
+        store->flush_done = generation;
+        pthread_cond_broadcast(&store->flushed);
+
+        if (stopping) {
+            break;
+        }
+
+        // Retention runs without the lock, sparing each log's current segment
+        if (now_wall_ms - store->last_retention_ms >= RETENTION_CHECK_MS) {
+            char current[1 + ROLLUP_TIER_COUNT][SEGMENT_LOG_NAME_MAX];
+            segment_log_current(store->samples, current[0]);
+            for (int t = 0; t < ROLLUP_TIER_COUNT; t++) {
+                segment_log_current(store->rollups[t], current[1 + t]);
+            }
+            store->last_retention_ms = now_wall_ms;
+
+            pthread_mutex_unlock(&store->lock);
+            uint64_t removed = segment_log_expire(store->samples, current[0], now_wall_ms);
+            for (int t = 0; t < ROLLUP_TIER_COUNT; t++) {
+                removed += segment_log_expire(store->rollups[t], current[1 + t], now_wall_ms);
+            }
+            pthread_mutex_lock(&store->lock);
+            store->stats.segments_removed += removed;
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+    return NULL;
+}
+
+/*
+ * Public API
+ */
+
+static void close_logs(sample_store_t *store) {
+    segment_log_close(store->samples);
+    for (int t = 0; t < ROLLUP_TIER_COUNT; t++) {
+        segment_log_close(store->rollups[t]);
+    }
+}
+
+sample_store_t *sample_store_open(const char *data_dir, uint64_t retention_ms) {
+    if (data_dir == NULL) {
+        return NULL;
+    }
+
+    sample_store_t *store = calloc(1, sizeof(*store));
+    if (store == NULL) {
+        return NULL;
+    }
+    store->retention_ms = retention_ms;
+
+    char dir[4096];
+    snprintf(dir, sizeof(dir), "%s/" STORE_SUBDIR, data_dir);
+    store->samples = segment_log_open(dir, SAMPLE_STORE_SEGMENT_BYTES, SAMPLE_STORE_SEGMENT_SPAN, retention_ms);
+    bool ok = store->samples != NULL;
+    for (int t = 0; t < ROLLUP_TIER_COUNT && ok; t++) {
+        uint64_t tier_retention_ms = g_tiers[t].retention_ms > retention_ms ? g_tiers[t].retention_ms : retention_ms;
+        snprintf(dir, sizeof(dir), "%s/%s", data_dir, g_tiers[t].subdir);
+        store->rollups[t] = segment_log_open(dir, SAMPLE_STORE_SEGMENT_BYTES, g_tiers[t].span_ms, tier_retention_ms);
+        store->rollup_retention_ms[t] = tier_retention_ms;
+        ok = store->rollups[t] != NULL;
+    }
+    if (!ok) {
+        close_logs(store);
+        free(store);
+        return NULL;
+    }
+
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_cond_init(&store->wake, NULL);
+    pthread_cond_init(&store->flushed, NULL);
+
+    if (pthread_create(&store->writer, NULL, writer_main, store) != 0) {
+        pthread_cond_destroy(&store->flushed);
+        pthread_cond_destroy(&store->wake);
+        pthread_mutex_destroy(&store->lock);
+        close_logs(store);
+        free(store);
+        return NULL;
+    }
+
+    printf("[store] Samples in %s/" STORE_SUBDIR " (retention %llu h), rollups 10s/1m/1h (%llu/%llu/%llu d)\n",
+           data_dir, (unsigned long long)(retention_ms / 3600000ULL),
+           (unsigned long long)(store->rollup_retention_ms[ROLLUP_10S] / 86400000ULL),
+           (unsigned long long)(store->rollup_retention_ms[ROLLUP_1M] / 86400000ULL),
+           (unsigned long long)(store->rollup_retention_ms[ROLLUP_1H] / 86400000ULL));
+    return store;
+}
+
+void sample_store_close(sample_store_t *store) {
+    if (store == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&store->lock);
+    store->stop = true;
+    pthread_cond_signal(&store->wake);
+    pthread_mutex_unlock(&store->lock);
+    pthread_join(store->writer, NULL);
+
+    printf("[store] Closed: %llu samples written, %llu dropped, %llu rollup records\n",
+           (unsigned long long)store->stats.samples_written,
+           (unsigned long long)store->stats.samples_dropped,
+           (unsigned long long)store->stats.rollups_written);
+
+    for (size_t i = 0; i < store->series_count; i++) {
+        series_t *s = store->series[i];
+        gorilla_encoder_free(&s->staged);
+        for (int t = 0; t < ROLLUP_TIER_COUNT; t++) {
+            free(s->pending[t].data);
+        }
+        free(s);
+    }
+    free(store->series);
+    close_logs(store);
+    pthread_cond_destroy(&store->flushed);
+    pthread_cond_destroy(&store->wake);
+    pthread_mutex_destroy(&store->lock);
+    free(store);
+}
+
+int sample_store_series(sample_store_t *store, const char *series_id) {
+    if (store == NULL || series_id == NULL || strlen(series_id) >= SAMPLE_STORE_MAX_ID) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&store->lock);
+    for (size_t i = 0; i < store->series_count; i++) {
+        if (strcmp(store->series[i]->id, series_id) == 0) {
+            pthread_mutex_unlock(&store->lock);
+            return (int)i;
+        }
+    }
+
+    if (store->series_count == store->series_capacity) {
+        size_t new_capacity = store->series_capacity > 0 ? store->series_capacity * 2 : 64;
+        series_t **grown = realloc(store->series, new_capacity * sizeof(*grown));
+        if (grown == NULL) {
+            pthread_mutex_unlock(&store->lock);
+            return -1;
+        }
+        store->series = grown;
+        store->series_capacity = new_capacity;
+    }
+
+    series_t *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        pthread_mutex_unlock(&store->lock);
+        return -1;
+    }
+    strcpy(s->id, series_id);
+    gorilla_encoder_init(&s->staged);
+    int handle = (int)store->series_count;
+    store->series[store->series_count++] = s;
+    pthread_mutex_unlock(&store->lock);
+    return handle;
+}
+
+int sample_store_append(sample_store_t *store, int series, const sample_t *sample) {
+    if (store == NULL || series < 0 || sample == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&store->lock);
+    if ((size_t)series >= store->series_count) {
+        pthread_mutex_unlock(&store->lock);
+        return -1;
+    }
+
+    // A full tail is written out here rather than waiting for the writer
+    series_t *s = store->series[series];
+    if (s->staged.count >= SAMPLE_STORE_BLOCK_MAX) {
+        write_series(store, s, wall_clock_ms());
+    }
+    if (store->staged_total >= SAMPLE_STORE_MAX_STAGED || gorilla_encoder_append(&s->staged, sample) != 0) {
+        store->stats.samples_dropped++;
+        pthread_cond_signal(&store->wake);
+        pthread_mutex_unlock(&store->lock);
+        return -1;
+    }
+
+    emit_ctx_t ctx = { store, s };
+    rollup_push(&s->rollup, sample, queue_record, &ctx);
+
+    if (s->staged.count == 1) {
+        s->staged_since_ms = now_ms();
+    }
+    if (++store->staged_total == STORE_FLUSH_SOON) {
+        pthread_cond_signal(&store->wake);
+    }
+    pthread_mutex_unlock(&store->lock);
+    return 0;
+}
+
+void sample_store_flush(sample_store_t *store) {
+    if (store == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&store->lock);
+    uint64_t generation = ++store->flush_requested;
+    pthread_cond_signal(&store->wake);
+    while (store->flush_done < generation && !store->stop) {
+        pthread_cond_wait(&store->flushed, &store->lock);
+    }
+    pthread_mutex_unlock(&store->lock);
+}
+
+/*
+ * Sample scans
+ */
+
+typedef struct {
+    const char *series_id;      // NULL = all
+    size_t id_len;
+    uint64_t from_ms;
+    uint64_t to_ms;
+    sample_t *decoded;          // SAMPLE_STORE_BLOCK_MAX entries
+    sample_store_scan_cb_t cb;
+    void *ctx;
+} scan_t;
+
+// segment_log_scan_cb_t: decode the matching sample blocks in data[pos, end)
+static void scan_blocks(const uint8_t *data, size_t pos, size_t end, void *arg) {
+    const scan_t *scan = arg;
+    char id[SAMPLE_STORE_MAX_ID];
+
+    while (pos + sizeof(block_header_t) <= end) {
+        block_header_t bh;
+        memcpy(&bh, data + pos, sizeof(bh));
+        if (bh.magic != BLOCK_MAGIC || bh.id_len >= SAMPLE_STORE_MAX_ID ||
+            bh.count == 0 || bh.count > SAMPLE_STORE_BLOCK_MAX) {
+            break;
+        }
+        size_t len = block_length(&bh);
+        if (pos + len > end) {
+            break;
+        }
+
+        const uint8_t *block = data + pos;
+        pos += len;
+        if (scan->series_id != NULL &&
+            (bh.id_len != scan->id_len || memcmp(block + sizeof(bh), scan->series_id, scan->id_len) != 0)) {
+            continue;
+        }
+        if (bh.first_ts_ms >= scan->to_ms || bh.last_ts_ms < scan->from_ms) {
+            continue;
+        }
+
+        const uint8_t *stream = block + sizeof(bh) + align8(bh.id_len);
+        gorilla_block_t gb = {
+            .stream = stream,
+            .stream_bytes = bh.stream_bytes,
+            .runs = stream + bh.stream_bytes,
+            .runs_bytes = bh.runs_bytes,
+            .first_ts_ms = bh.first_ts_ms,
+            .count = bh.count,
+            .first_ok = bh.first_ok != 0,
+        };
+        size_t count = gorilla_decode(&gb, scan->decoded);
+        size_t start = 0;
+        while (start < count && scan->decoded[start].timestamp_ms < scan->from_ms) {
+            start++;
+        }
+        size_t stop = start;
+        while (stop < count && scan->decoded[stop].timestamp_ms < scan->to_ms) {
+            stop++;
+        }
+        if (stop > start) {
+            memcpy(id, block + sizeof(bh), bh.id_len);
+            id[bh.id_len] = '\0';
+            scan->cb(id, scan->decoded + start, stop - start, scan->ctx);
+        }
+    }
+}
+
+int sample_store_scan(sample_store_t *store, const char *series_id,
+                      uint64_t from_ms, uint64_t to_ms,
+                      sample_store_scan_cb_t cb, void *ctx) {
+    if (store == NULL || cb == NULL) {
+        return -1;
+    }
+
+    scan_t scan = {
+        .series_id = series_id,
+        .id_len = series_id != NULL ? strlen(series_id) : 0,
+        .from_ms = from_ms,
+        .to_ms = to_ms,
+        .decoded = malloc(SAMPLE_STORE_BLOCK_MAX * sizeof(sample_t)),
+        .cb = cb,
+        .ctx = ctx,
+    };
+    if (scan.decoded == NULL) {
+        return -1;
+    }
+
+    // One cut under the lock: the segments as they are now and copies of
+    // the staged tails, so every sample is seen exactly once
+    pthread_mutex_lock(&store->lock);
+    segment_log_cut_t cut;
+    segment_log_cut(store->samples, &cut);
+
+    size_t tail_bytes = 0;
+    for (size_t i = 0; i < store->series_count; i++) {
+        const series_t *s = store->series[i];
+        if (s->staged.count > 0 && (series_id == NULL || strcmp(s->id, series_id) == 0)) {
+            block_header_t bh = staged_block_header(s);
+            tail_bytes += block_length(&bh);
+        }
+    }
+    uint8_t *tail = tail_bytes > 0 ? malloc(tail_bytes) : NULL;
+    size_t tail_len = 0;
+    if (tail != NULL) {
+        for (size_t i = 0; i < store->series_count; i++) {
+            const series_t *s = store->series[i];
+            if (s->staged.count > 0 && (series_id == NULL || strcmp(s->id, series_id) == 0)) {
+                block_header_t bh = staged_block_header(s);
+                write_staged_block(s, &bh, tail + tail_len);
+                tail_len += block_length(&bh);
+            }
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    segment_log_scan(store->samples, &cut, from_ms, to_ms, scan_blocks, &scan);
+    scan_blocks(tail, 0, tail_len, &scan);
+
+    free(tail);
+    segment_log_cut_free(&cut);
+    free(scan.decoded);
+    return 0;
+}
+
+/*
+ * Rollup scans
+ */
+
+typedef struct {
+    const char *series_id;      // NULL = all
+    size_t id_len;
+    uint64_t from_ms;
+    uint64_t to_ms;
+    sample_store_rollup_cb_t cb;
+    void *ctx;
+} rollup_scan_t;
+
+// segment_log_scan_cb_t: hand out the matching records in data[pos, end)
+static void scan_rollup_blocks(const uint8_t *data, size_t pos, size_t end, void *arg) {
+    const rollup_scan_t *scan = arg;
+    char id[SAMPLE_STORE_MAX_ID];
+
+    while (pos + sizeof(rollup_header_t) <= end) {
+        rollup_header_t rh;
+        memcpy(&rh, data + pos, sizeof(rh));
+        if (rh.magic != ROLLUP_MAGIC || rh.id_len >= SAMPLE_STORE_MAX_ID || rh.count == 0) {
+            break;
+        }
+        size_t len = rollup_block_length(rh.id_len, rh.bytes);
+        if (pos + len > end) {
+            break;
+        }
+
+        const uint8_t *block = data + pos;
+        pos += len;
+        if (scan->series_id != NULL &&
+            (rh.id_len != scan->id_len || memcmp(block + sizeof(rh), scan->series_id, scan->id_len) != 0)) {
+            continue;
+        }
+        if (rh.first_ts_ms >= scan->to_ms || rh.last_ts_ms < scan->from_ms) {
+            continue;
+        }
+
+        memcpy(id, block + sizeof(rh), rh.id_len);
+        id[rh.id_len] = '\0';
+
+        // Blocks and records are 8-aligned, so records are read in place
+        const uint8_t *rec = block + sizeof(rh) + align8(rh.id_len);
+        const uint8_t *rec_end = rec + rh.bytes;
+        for (uint32_t i = 0; i < rh.count && rec + sizeof(rollup_record_t) <= rec_end; i++) {
+            const rollup_record_t *record = (const rollup_record_t *)rec;
+            size_t size = rollup_record_size(record->bin_count);
+            if (rec + size > rec_end) {
+                break;
+            }
+            if (record->start_ms >= scan->from_ms && record->start_ms < scan->to_ms) {
+                scan->cb(id, record, scan->ctx);
+            }
+            rec += size;
+        }
+    }
+}
+
+int sample_store_scan_rollups(sample_store_t *store, rollup_tier_t tier, const char *series_id,
+                              uint64_t from_ms, uint64_t to_ms,
+                              sample_store_rollup_cb_t cb, void *ctx) {
+    if (store == NULL || tier >= ROLLUP_TIER_COUNT || cb == NULL) {
+        return -1;
+    }
+
+    rollup_scan_t scan = {
+        .series_id = series_id,
+        .id_len = series_id != NULL ? strlen(series_id) : 0,
+        .from_ms = from_ms,
+        .to_ms = to_ms,
+        .cb = cb,
+        .ctx = ctx,
+    };
+
+    uint64_t record_buf[ROLLUP_RECORD_MAX / sizeof(uint64_t) + 1];
+    rollup_record_t *open_record = (rollup_record_t *)record_buf;
+    uint64_t width_ms = rollup_tier_width_ms(tier);
+
+    // One cut under the lock, as for samples: the segments, then copies of
+    // the closed records not written yet and of the open buckets
+    pthread_mutex_lock(&store->lock);
+    segment_log_cut_t cut;
+    segment_log_cut(store->rollups[tier], &cut);
+
+    size_t tail_bytes = 0;
+    for (size_t i = 0; i < store->series_count; i++) {
+        const series_t *s = store->series[i];
+        if (series_id == NULL || strcmp(s->id, series_id) == 0) {
+            size_t id_len = strlen(s->id);
+            tail_bytes += rollup_block_length(id_len, s->pending[tier].len) +
+                          rollup_block_length(id_len, ROLLUP_RECORD_MAX);
+        }
+    }
+    uint8_t *tail = tail_bytes > 0 ? malloc(tail_bytes) : NULL;
+    size_t tail_len = 0;
+    if (tail != NULL) {
+        for (size_t i = 0; i < store->series_count; i++) {
+            const series_t *s = store->series[i];
+            if (series_id != NULL && strcmp(s->id, series_id) != 0) {
+                continue;
+            }
+            const pending_t *p = &s->pending[tier];
+            if (p->count > 0) {
+                write_rollup_block(s->id, p->data, p->len, p->count, p->first_ts_ms, p->last_ts_ms,
+                                   tail + tail_len);
+                tail_len += rollup_block_length(strlen(s->id), p->len);
+            }
+            if (rollup_open_record(&s->rollup, tier, open_record)) {
+                size_t size = rollup_record_size(open_record->bin_count);
+                write_rollup_block(s->id, (const uint8_t *)open_record, size, 1, open_record->start_ms,
+                                   open_record->start_ms + width_ms - 1, tail + tail_len);
+                tail_len += rollup_block_length(strlen(s->id), size);
+            }
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+
+    segment_log_scan(store->rollups[tier], &cut, from_ms, to_ms, scan_rollup_blocks, &scan);
+    scan_rollup_blocks(tail, 0, tail_len, &scan);
+
+    free(tail);
+    segment_log_cut_free(&cut);
+    return 0;
+}
+
+uint64_t sample_store_rollup_retention_ms(const sample_store_t *store, rollup_tier_t tier) {
+    if (store == NULL || tier >= ROLLUP_TIER_COUNT) {
+        return 0;
+    }
+    return store->rollup_retention_ms[tier];
+}
+
+void sample_store_get_stats(sample_store_t *store, sample_store_stats_t *stats) {
+    if (store == NULL || stats == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&store->lock);
+    *stats = store->stats;
+    stats->segments_created = segment_log_segments_created(store->samples);
+    for (int t = 0; t < ROLLUP_TIER_COUNT; t++) {
+        stats->segments_created += segment_log_segments_created(store->rollups[t]);
+    }
+    pthread_mutex_unlock(&store->lock);
+}
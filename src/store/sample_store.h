@@ -0,0 +1,117 @@
+#ifndef NETPULSE_SAMPLE_STORE_H
+#define NETPULSE_SAMPLE_STORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "core/stats.h"
+#include "store/rollup.h"
+
+/*
+ * Persistent sample store
+ *
+ * Samples are appended per series (one per target id) and compressed as
+ * they arrive (see store/gorilla.h: delta-of-delta timestamps, XORed RTTs,
+ * run-length success flags), so each series' in-memory tail of unwritten
+ * samples costs a few bytes per sample. A writer thread checks the tails
+ * once a second and writes a series' tail out as one block once it holds
+ * SAMPLE_STORE_BLOCK_MIN samples or its oldest sample has waited
+ * SAMPLE_STORE_MAX_AGE_MS (so a crash loses at most that much):
+ *
+ *   header | series id | Gorilla stream | success runs
+ *
+ * Blocks are appended to fixed-size segment files (SAMPLE_STORE_SEGMENT_BYTES)
+ * under <data dir>/samples/, each mapped with mmap while it is written. A
+ * segment holds one wall-clock hour at most; the writer starts a new one on
+ * the hour, when it fills up, and on every open (old segments are never
+ * appended to). Retention drops whole segments whose newest sample is older
+ * than the retention period.
+ *
+ * Every sample is also counted into its series' rollups (store/rollup.h):
+ * 10 s, 1 min and 1 h buckets, built one from the other. The writer closes
+ * buckets as wall-clock time passes them and writes the closed records out
+ * in blocks of their own, one segment log per tier under
+ * <data dir>/rollup-10s/, rollup-1m/ and rollup-1h/, each with a longer
+ * retention than the one below:
+ *
+ *   header | series id | records (each: aggregates, sparse RTT sketch)
+ *
+ * Appends take a mutex, encode one sample and update one 10 s bucket (and
+ * write the tail if it is full); segment files are otherwise written and
+ * removed on the writer thread. Reads (sample_store_scan,
+ * sample_store_scan_rollups) can run on any thread while the writer is
+ * active and include what is not written yet, open buckets included.
+ */
+
+#define SAMPLE_STORE_SEGMENT_BYTES  (16u << 20)     // Size of every segment file
+#define SAMPLE_STORE_SEGMENT_SPAN   3600000ULL      // Wall-clock span of a segment (ms)
+#define SAMPLE_STORE_BLOCK_MAX      4096            // Samples per block (a full tail is written by the appender)
+#define SAMPLE_STORE_MAX_ID         64              // Longest series id (incl. NUL)
+#define SAMPLE_STORE_BLOCK_MIN      256             // Staged samples that make a block
+#define SAMPLE_STORE_MAX_AGE_MS     30000           // Longest a sample stays staged
+#define SAMPLE_STORE_FLUSH_MS       1000            // Writer wakeup interval
+#define SAMPLE_STORE_MAX_STAGED     (4u << 20)      // Samples held before appends drop
+#define SAMPLE_STORE_ROLLUP_BLOCK   64              // Closed records that make a rollup block
+#define SAMPLE_STORE_ROLLUP_AGE_MS  300000          // Longest a closed record stays unwritten
+#define SAMPLE_STORE_ROLLUP_GRACE_MS 2000           // Late samples a bucket waits for before closing
+
+typedef struct sample_store sample_store_t;
+
+// Called with consecutive samples of one series, oldest first
+typedef void (*sample_store_scan_cb_t)(const char *series_id, const sample_t *samples,
+                                       size_t count, void *ctx);
+
+// Open the store in <data_dir>/samples and start its writer thread.
+// Returns NULL on error.
+sample_store_t *sample_store_open(const char *data_dir, uint64_t retention_ms);
+
+// Close the open rollup buckets, write out everything staged, stop the
+// writer and unmap segments
+void sample_store_close(sample_store_t *store);
+
+// Handle for a series id, created on first use. Returns -1 on error.
+int sample_store_series(sample_store_t *store, const char *series_id);
+
+// Stage a sample for writing. Returns 0, or -1 if staging is full (dropped).
+int sample_store_append(sample_store_t *store, int series, const sample_t *sample);
+
+// Write out everything staged now and wait for it (e.g. before a scan)
+void sample_store_flush(sample_store_t *store);
+
+// Call cb for the stored samples of series_id (NULL = every series) with
+// from_ms <= timestamp_ms < to_ms, segment by segment in time order.
+// Returns 0 on success, -1 on error.
+int sample_store_scan(sample_store_t *store, const char *series_id,
+                      uint64_t from_ms, uint64_t to_ms,
+                      sample_store_scan_cb_t cb, void *ctx);
+
+// Called with one rollup record of a series (followed by its bins)
+typedef void (*sample_store_rollup_cb_t)(const char *series_id, const rollup_record_t *record,
+                                         void *ctx);
+
+// Call cb for the rollup records of a tier for series_id (NULL = every
+// series) with from_ms <= start_ms < to_ms, segment by segment in time order,
+// then the closed records not written yet and the open buckets.
+// Returns 0 on success, -1 on error.
+int sample_store_scan_rollups(sample_store_t *store, rollup_tier_t tier, const char *series_id,
+                              uint64_t from_ms, uint64_t to_ms,
+                              sample_store_rollup_cb_t cb, void *ctx);
+
+// Retention of a rollup tier in milliseconds
+uint64_t sample_store_rollup_retention_ms(const sample_store_t *store, rollup_tier_t tier);
+
+// Counters since open
+typedef struct {
+    uint64_t samples_written;
+    uint64_t samples_dropped;
+    uint64_t blocks_written;
+    uint64_t bytes_written;     // Block bytes (samples and rollups), excluding segment headers
+    uint64_t rollups_written;   // Rollup records
+    uint64_t rollups_dropped;
+    uint64_t segments_created;
+    uint64_t segments_removed;
+} sample_store_stats_t;
+
+void sample_store_get_stats(sample_store_t *store, sample_store_stats_t *stats);
+
+#endif // NETPULSE_SAMPLE_STORE_H
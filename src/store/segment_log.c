@@ -0,0 +1,356 @@
+#include "store/segment_log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SEGMENT_MAGIC   "NPSEG01"
+#define SEGMENT_SUFFIX  ".seg"
+
+/*
+ * Segment header. used is stored last (with release ordering) so readers
+ * never see a partial block.
+ */
+typedef struct {
+    char magic[8];
+    uint64_t size;              // File size
+    uint64_t used;              // Header plus complete blocks
+    uint64_t first_ts_ms;       // Oldest block time (0 = no blocks)
+    uint64_t last_ts_ms;        // Newest block time
+    uint64_t block_count;
+    uint64_t reserved[2];
+} segment_header_t;
+
+struct segment_log {
+    char *dir;
+    size_t segment_bytes;
+    uint64_t span_ms;
+    uint64_t retention_ms;
+
+    int fd;
+    uint8_t *map;               // Current segment (NULL = none)
+    uint64_t span_index;        // Wall-clock span it was opened in
+    char name[SEGMENT_LOG_NAME_MAX];
+    unsigned seq;
+    uint64_t segments_created;
+};
+
+static void close_segment(segment_log_t *log) {
+    if (log->map != NULL) {
+        msync(log->map, log->segment_bytes, MS_ASYNC);
+        munmap(log->map, log->segment_bytes);
+        log->map = NULL;
+    }
+    if (log->fd >= 0) {
+        close(log->fd);
+        log->fd = -1;
+    }
+    log->name[0] = '\0';
+}
+
+static int open_segment(segment_log_t *log, uint64_t now_wall_ms) {
+    close_segment(log);
+
+    char path[4096];
+    int fd = -1;
+    for (int attempt = 0; attempt < 100 && fd < 0; attempt++) {
+        snprintf(log->name, sizeof(log->name), "%013llu-%04u" SEGMENT_SUFFIX,
+                 (unsigned long long)now_wall_ms, log->seq++ % 10000);
+        snprintf(path, sizeof(path), "%s/%s", log->dir, log->name);
+        fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0 && errno != EEXIST) {
+            break;
+        }
+    }
+    if (fd < 0) {
+        fprintf(stderr, "[store] Cannot create segment in %s: %s\n", log->dir, strerror(errno));
+        log->name[0] = '\0';
+        return -1;
+    }
+
+    if (ftruncate(fd, (off_t)log->segment_bytes) != 0) {
+        close(fd);
+        unlink(path);
+        log->name[0] = '\0';
+        return -1;
+    }
+
+    void *map = mmap(NULL, log->segment_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        unlink(path);
+        log->name[0] = '\0';
+        return -1;
+    }
+
+    segment_header_t *hdr = map;
+    memcpy(hdr->magic, SEGMENT_MAGIC, sizeof(hdr->magic));
+    hdr->size = log->segment_bytes;
+    hdr->first_ts_ms = 0;
+    hdr->last_ts_ms = 0;
+    hdr->block_count = 0;
+    __atomic_store_n(&hdr->used, sizeof(*hdr), __ATOMIC_RELEASE);
+
+    log->fd = fd;
+    log->map = map;
+    log->span_index = now_wall_ms / log->span_ms;
+    log->segments_created++;
+    return 0;
+}
+
+segment_log_t *segment_log_open(const char *dir, size_t segment_bytes,
+                                uint64_t span_ms, uint64_t retention_ms) {
+    if (dir == NULL || segment_bytes < 2 * sizeof(segment_header_t) || span_ms == 0) {
+        return NULL;
+    }
+
+    segment_log_t *log = calloc(1, sizeof(*log));
+    if (log == NULL) {
+        return NULL;
+    }
+    log->dir = strdup(dir);
+    if (log->dir == NULL) {
+        free(log);
+        return NULL;
+    }
+    if (mkdir(log->dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "[store] Cannot create %s: %s\n", log->dir, strerror(errno));
+        free(log->dir);
+        free(log);
+        return NULL;
+    }
+
+    log->segment_bytes = segment_bytes;
+    log->span_ms = span_ms;
+    log->retention_ms = retention_ms;
+    log->fd = -1;
+    return log;
+}
+
+void segment_log_close(segment_log_t *log) {
+    if (log == NULL) {
+        return;
+    }
+
+    close_segment(log);
+    free(log->dir);
+    free(log);
+}
+
+uint8_t *segment_log_reserve(segment_log_t *log, size_t len, uint64_t now_wall_ms) {
+    if (log == NULL || len > log->segment_bytes - sizeof(segment_header_t)) {
+        return NULL;
+    }
+
+    segment_header_t *hdr = (segment_header_t *)log->map;
+    if (hdr == NULL || now_wall_ms / log->span_ms != log->span_index ||
+        hdr->used + len > log->segment_bytes) {
+        if (open_segment(log, now_wall_ms) != 0) {
+            return NULL;
+        }
+        hdr = (segment_header_t *)log->map;
+    }
+    return log->map + hdr->used;
+}
+
+void segment_log_commit(segment_log_t *log, size_t len, uint64_t first_ts_ms, uint64_t last_ts_ms) {
+    if (log == NULL || log->map == NULL) {
+        return;
+    }
+
+    segment_header_t *hdr = (segment_header_t *)log->map;
+    if (hdr->first_ts_ms == 0 || first_ts_ms < hdr->first_ts_ms) {
+        hdr->first_ts_ms = first_ts_ms;
+    }
+    if (last_ts_ms > hdr->last_ts_ms) {
+        hdr->last_ts_ms = last_ts_ms;
+    }
+    hdr->block_count++;
+    __atomic_store_n(&hdr->used, hdr->used + len, __ATOMIC_RELEASE);
+}
+
+/*
+ * Listing
+ */
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static void free_names(char **names, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(names[i]);
+    }
+    free(names);
+}
+
+// Sorted list of segment file names. Caller frees with free_names.
+static char **list_segments(const char *dir, size_t *count) {
+    *count = 0;
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        return NULL;
+    }
+
+    char **names = NULL;
+    size_t capacity = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        size_t len = strlen(de->d_name);
+        size_t suffix = strlen(SEGMENT_SUFFIX);
+        if (len <= suffix || strcmp(de->d_name + len - suffix, SEGMENT_SUFFIX) != 0) {
+            continue;
+        }
+        if (*count == capacity) {
+            size_t new_capacity = capacity > 0 ? capacity * 2 : 64;
+            char **grown = realloc(names, new_capacity * sizeof(*grown));
+            if (grown == NULL) {
+                break;
+            }
+            names = grown;
+            capacity = new_capacity;
+        }
+        names[*count] = strdup(de->d_name);
+        if (names[*count] != NULL) {
+            (*count)++;
+        }
+    }
+    closedir(d);
+
+    // Names start with a fixed-width creation time, so this is time order
+    if (*count > 1) {
+        qsort(names, *count, sizeof(*names), compare_names);
+    }
+    return names;
+}
+
+int segment_log_cut(const segment_log_t *log, segment_log_cut_t *cut) {
+    if (log == NULL || cut == NULL) {
+        return -1;
+    }
+
+    memset(cut, 0, sizeof(*cut));
+    cut->names = list_segments(log->dir, &cut->count);
+    memcpy(cut->current, log->name, sizeof(cut->current));
+    cut->current_used = log->map != NULL ? ((const segment_header_t *)log->map)->used : 0;
+    return 0;
+}
+
+void segment_log_cut_free(segment_log_cut_t *cut) {
+    if (cut == NULL) {
+        return;
+    }
+
+    free_names(cut->names, cut->count);
+    cut->names = NULL;
+    cut->count = 0;
+}
+
+/*
+ * Scans
+ */
+
+// Map one segment and hand its blocks to cb, up to limit bytes
+static void scan_segment(const char *path, size_t limit, uint64_t from_ms, uint64_t to_ms,
+                         segment_log_scan_cb_t cb, void *ctx) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return;     // Removed by retention since the cut
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(segment_header_t)) {
+        close(fd);
+        return;
+    }
+    size_t size = (size_t)st.st_size;
+    uint8_t *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return;
+    }
+
+    const segment_header_t *hdr = (const segment_header_t *)map;
+    size_t used = __atomic_load_n(&hdr->used, __ATOMIC_ACQUIRE);
+    if (used > size) {
+        used = size;
+    }
+    if (used > limit) {
+        used = limit;
+    }
+    if (memcmp(hdr->magic, SEGMENT_MAGIC, sizeof(hdr->magic)) == 0 && hdr->first_ts_ms != 0 &&
+        hdr->first_ts_ms < to_ms && hdr->last_ts_ms >= from_ms) {
+        cb(map, sizeof(*hdr), used, ctx);
+    }
+    munmap(map, size);
+}
+
+void segment_log_scan(const segment_log_t *log, const segment_log_cut_t *cut,
+                      uint64_t from_ms, uint64_t to_ms, segment_log_scan_cb_t cb, void *ctx) {
+    if (log == NULL || cut == NULL || cb == NULL) {
+        return;
+    }
+
+    for (size_t i = 0; i < cut->count; i++) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", log->dir, cut->names[i]);
+        bool current = strcmp(cut->names[i], cut->current) == 0;
+        scan_segment(path, current ? cut->current_used : SIZE_MAX, from_ms, to_ms, cb, ctx);
+    }
+}
+
+/*
+ * Retention
+ */
+
+void segment_log_current(const segment_log_t *log, char name[SEGMENT_LOG_NAME_MAX]) {
+    if (log == NULL) {
+        name[0] = '\0';
+        return;
+    }
+    memcpy(name, log->name, SEGMENT_LOG_NAME_MAX);
+}
+
+uint64_t segment_log_expire(const segment_log_t *log, const char *current, uint64_t now_wall_ms) {
+    if (log == NULL) {
+        return 0;
+    }
+
+    size_t count;
+    char **names = list_segments(log->dir, &count);
+    uint64_t removed = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        if (current != NULL && strcmp(names[i], current) == 0) {
+            continue;
+        }
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", log->dir, names[i]);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            continue;
+        }
+        segment_header_t hdr;
+        ssize_t n = pread(fd, &hdr, sizeof(hdr), 0);
+        close(fd);
+
+        // Empty or unreadable segments are leftovers; otherwise go by the newest block
+        bool expired = n != (ssize_t)sizeof(hdr) || memcmp(hdr.magic, SEGMENT_MAGIC, sizeof(hdr.magic)) != 0 ||
+                       hdr.last_ts_ms == 0 || hdr.last_ts_ms + log->retention_ms < now_wall_ms;
+        if (expired && unlink(path) == 0) {
+            removed++;
+        }
+    }
+    free_names(names, count);
+    return removed;
+}
+
+uint64_t segment_log_segments_created(const segment_log_t *log) {
+    return log != NULL ? log->segments_created : 0;
+}
@@ -0,0 +1,72 @@
+#ifndef NETPULSE_SEGMENT_LOG_H
+#define NETPULSE_SEGMENT_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Append-only log of blocks in memory-mapped segment files
+ *
+ * A log is a directory of fixed-size segment files named by creation time
+ * (so name order is time order). Each starts with a header recording how
+ * many bytes hold complete blocks and the time range they cover; blocks are
+ * opaque to the log except that the caller passes their time range. The
+ * segment being written stays mapped; a new one is started when the
+ * wall-clock span changes, when the block doesn't fit, and on every open.
+ * Retention unlinks whole segments whose newest block has expired.
+ *
+ * A log does no locking. Appends and cuts must be serialized by the caller;
+ * scanning a cut and segment_log_expire can run concurrently with them.
+ */
+
+#define SEGMENT_LOG_NAME_MAX    32
+
+typedef struct segment_log segment_log_t;
+
+// Open (creating the directory if needed). Returns NULL on error.
+segment_log_t *segment_log_open(const char *dir, size_t segment_bytes,
+                                uint64_t span_ms, uint64_t retention_ms);
+
+// Unmap the current segment and free the log
+void segment_log_close(segment_log_t *log);
+
+// Room for a block of len bytes (a multiple of 8) in the current segment,
+// or NULL if no segment could be created
+uint8_t *segment_log_reserve(segment_log_t *log, size_t len, uint64_t now_wall_ms);
+
+// Publish the block written at the last reserved pointer
+void segment_log_commit(segment_log_t *log, size_t len, uint64_t first_ts_ms, uint64_t last_ts_ms);
+
+/*
+ * A consistent view of the log: the segment files at one moment and how
+ * far the current one was written
+ */
+typedef struct {
+    char **names;
+    size_t count;
+    char current[SEGMENT_LOG_NAME_MAX];
+    size_t current_used;
+} segment_log_cut_t;
+
+// Take a cut. Returns 0, or -1 on error.
+int segment_log_cut(const segment_log_t *log, segment_log_cut_t *cut);
+void segment_log_cut_free(segment_log_cut_t *cut);
+
+// Called with the complete blocks of one segment, data[pos, end)
+typedef void (*segment_log_scan_cb_t)(const uint8_t *data, size_t pos, size_t end, void *ctx);
+
+// Call cb for each segment of the cut whose time range overlaps [from_ms, to_ms)
+void segment_log_scan(const segment_log_t *log, const segment_log_cut_t *cut,
+                      uint64_t from_ms, uint64_t to_ms, segment_log_scan_cb_t cb, void *ctx);
+
+// Name of the segment being written ("" if none)
+void segment_log_current(const segment_log_t *log, char name[SEGMENT_LOG_NAME_MAX]);
+
+// Remove expired segments other than current. Returns how many were removed.
+uint64_t segment_log_expire(const segment_log_t *log, const char *current, uint64_t now_wall_ms);
+
+// Segment files created since open
+uint64_t segment_log_segments_created(const segment_log_t *log);
+
+#endif // NETPULSE_SEGMENT_LOG_H
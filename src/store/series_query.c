@@ -0,0 +1,248 @@
+#include "store/series_query.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Scans hand out each series' data in time order (segments are scanned in
+ * creation order, then what is not written yet), so every requested series
+ * folds its data into the step it is building and closes the step into a
+ * point when its data moves past it. Nothing is copied except a step's
+ * first record: a step made of one record (the common case, step = tier
+ * width) is read straight from its sparse bins. Data older than the step
+ * being built (the wall clock stepped back) counts in that step, as it does
+ * in the rollups themselves.
+ */
+typedef struct query_series {
+    const char *id;
+    const struct query_series *alias;   // Earlier request for the same id
+    uint64_t step_index;        // Step being built (UINT64_MAX = none)
+    uint32_t step_records;      // Records in it so far
+    rollup_record_t *held;      // Its first record (ROLLUP_RECORD_MAX bytes)
+    rollup_accum_t *acc;        // Its data when that is not one record
+    rollup_point_t *points;
+    size_t count;
+    size_t capacity;
+} query_series_t;
+
+typedef struct {
+    query_series_t **sorted;    // By id, repeats left out
+    size_t count;
+    query_series_t *last;       // Found last (a block is one series)
+    uint64_t from_ms;
+    uint64_t step_ms;
+    bool failed;                // Out of memory
+} query_t;
+
+int series_query_source(uint64_t step_ms) {
+    for (int t = ROLLUP_TIER_COUNT - 1; t >= 0; t--) {
+        uint64_t width_ms = rollup_tier_width_ms((rollup_tier_t)t);
+        if (step_ms >= width_ms && step_ms % width_ms == 0) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+static int compare_series(const void *a, const void *b) {
+    return strcmp((*(const query_series_t *const *)a)->id, (*(const query_series_t *const *)b)->id);
+}
+
+static query_series_t *find_series(query_t *q, const char *id) {
+    if (q->last != NULL && strcmp(id, q->last->id) == 0) {
+        return q->last;
+    }
+
+    size_t lo = 0;
+    size_t hi = q->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int cmp = strcmp(id, q->sorted[mid]->id);
+        if (cmp == 0) {
+            q->last = q->sorted[mid];
+            return q->last;
+        }
+        if (cmp < 0) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Steps
+ */
+
+// Close the step being built, if any, into a point
+static void finish_step(query_t *q, query_series_t *qs) {
+    if (qs->step_index == UINT64_MAX) {
+        return;
+    }
+
+    if (qs->count == qs->capacity) {
+        size_t new_capacity = qs->capacity > 0 ? qs->capacity * 2 : 256;
+        rollup_point_t *grown = realloc(qs->points, new_capacity * sizeof(*grown));
+        if (grown == NULL) {
+            q->failed = true;
+            return;
+        }
+        qs->points = grown;
+        qs->capacity = new_capacity;
+    }
+
+    uint64_t start_ms = q->from_ms + qs->step_index * q->step_ms;
+    if (qs->step_records == 1) {
+        rollup_record_point(qs->held, start_ms, &qs->points[qs->count++]);
+    } else if (qs->acc->count > 0) {
+        rollup_accum_point(qs->acc, start_ms, &qs->points[qs->count++]);
+        rollup_accum_clear(qs->acc);
+    }
+    qs->step_index = UINT64_MAX;
+    qs->step_records = 0;
+}
+
+// Make the step holding ts_ms the one being built (an older one counts as
+// the current step)
+static void enter_step(query_t *q, query_series_t *qs, uint64_t ts_ms) {
+    uint64_t index = (ts_ms - q->from_ms) / q->step_ms;
+    if (qs->step_index == UINT64_MAX || index > qs->step_index) {
+        finish_step(q, qs);
+        qs->step_index = index;
+    }
+}
+
+// Per-series buffers, allocated on first data. Returns false if out of memory.
+static bool prepare_series(query_t *q, query_series_t *qs, bool records) {
+    if (qs->acc == NULL) {
+        qs->acc = calloc(1, sizeof(*qs->acc));
+    }
+    if (records && qs->held == NULL) {
+        qs->held = malloc(ROLLUP_RECORD_MAX);
+    }
+    if (qs->acc == NULL || (records && qs->held == NULL)) {
+        q->failed = true;
+        return false;
+    }
+    return true;
+}
+
+// sample_store_scan_cb_t
+static void fold_samples(const char *series_id, const sample_t *samples, size_t count, void *arg) {
+    query_t *q = arg;
+    query_series_t *qs = find_series(q, series_id);
+    if (qs == NULL || !prepare_series(q, qs, false)) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        enter_step(q, qs, samples[i].timestamp_ms);
+        rollup_accum_add_sample(qs->acc, &samples[i]);
+    }
+}
+
+// sample_store_rollup_cb_t
+static void fold_record(const char *series_id, const rollup_record_t *record, void *arg) {
+    query_t *q = arg;
+    query_series_t *qs = find_series(q, series_id);
+    if (qs == NULL || !prepare_series(q, qs, true)) {
+        return;
+    }
+
+    enter_step(q, qs, record->start_ms);
+    if (qs->step_records == 0) {
+        memcpy(qs->held, record, sizeof(*record) + (size_t)record->bin_count * sizeof(rollup_bin_t));
+    } else {
+        if (qs->step_records == 1) {
+            rollup_accum_add_record(qs->acc, qs->held);
+        }
+        rollup_accum_add_record(qs->acc, record);
+    }
+    qs->step_records++;
+}
+
+// Index the requested ids, fold their data and hand out their points
+static int run_query(sample_store_t *store, int source, query_series_t *entries, size_t series_count,
+                     query_t *q, uint64_t to_ms, series_query_cb_t cb, void *ctx) {
+    // Sorted ids for dispatching scan results; repeats get the first one's points
+    for (size_t i = 0; i < series_count; i++) {
+        q->sorted[i] = &entries[i];
+    }
+    if (series_count > 1) {
+        qsort(q->sorted, series_count, sizeof(*q->sorted), compare_series);
+    }
+    for (size_t i = 0; i < series_count; i++) {
+        if (q->count > 0 && strcmp(q->sorted[q->count - 1]->id, q->sorted[i]->id) == 0) {
+            q->sorted[i]->alias = q->sorted[q->count - 1];
+            continue;
+        }
+        q->sorted[q->count++] = q->sorted[i];
+    }
+
+    // A single series is filtered by the scan itself
+    const char *only = q->count == 1 ? q->sorted[0]->id : NULL;
+    if (q->count > 0) {
+        if (source < 0) {
+            sample_store_scan(store, only, q->from_ms, to_ms, fold_samples, q);
+        } else {
+            sample_store_scan_rollups(store, (rollup_tier_t)source, only, q->from_ms, to_ms, fold_record, q);
+        }
+    }
+    for (size_t i = 0; i < q->count; i++) {
+        finish_step(q, q->sorted[i]);
+    }
+    if (q->failed) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < series_count; i++) {
+        const query_series_t *qs = entries[i].alias != NULL ? entries[i].alias : &entries[i];
+        cb(entries[i].id, qs->points, qs->count, ctx);
+    }
+    return 0;
+}
+
+/*
+ * Public API
+ */
+
+int series_query_run(sample_store_t *store, const char *const *series_ids, size_t series_count,
+                     uint64_t from_ms, uint64_t to_ms, uint64_t step_ms,
+                     series_query_cb_t cb, void *ctx) {
+    if (store == NULL || series_ids == NULL || cb == NULL || step_ms == 0) {
+        return -1;
+    }
+
+    int source = series_query_source(step_ms);
+    if (source >= 0) {
+        from_ms -= from_ms % rollup_tier_width_ms((rollup_tier_t)source);
+    }
+    if (to_ms <= from_ms || (to_ms - from_ms + step_ms - 1) / step_ms > SERIES_QUERY_MAX_POINTS) {
+        return -1;
+    }
+
+    size_t slots = series_count > 0 ? series_count : 1;
+    query_series_t *entries = calloc(slots, sizeof(*entries));
+    query_t q = {
+        .sorted = malloc(slots * sizeof(*q.sorted)),
+        .from_ms = from_ms,
+        .step_ms = step_ms,
+    };
+
+    int result = -1;
+    if (entries != NULL && q.sorted != NULL) {
+        for (size_t i = 0; i < series_count; i++) {
+            entries[i].id = series_ids[i] != NULL ? series_ids[i] : "";
+            entries[i].step_index = UINT64_MAX;
+        }
+        result = run_query(store, source, entries, series_count, &q, to_ms, cb, ctx);
+        for (size_t i = 0; i < series_count; i++) {
+            free(entries[i].held);
+            free(entries[i].acc);
+            free(entries[i].points);
+        }
+    }
+    free(entries);
+    free(q.sorted);
+    return result;
+}
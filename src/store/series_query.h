@@ -0,0 +1,36 @@
+#ifndef NETPULSE_SERIES_QUERY_H
+#define NETPULSE_SERIES_QUERY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "store/sample_store.h"
+#include "store/rollup.h"
+
+/*
+ * Time-series queries over the sample store
+ *
+ * A query asks for [from_ms, to_ms) of some series in steps of step_ms and
+ * gets one rollup_point_t per non-empty step. It reads the coarsest source
+ * whose bucket width divides the step (1 h, 1 min, 10 s rollups, else raw
+ * samples), so a day at one-minute steps reads 1440 records per series
+ * rather than every sample. from_ms is rounded down to the source's width,
+ * and the points start at from_ms + k * step_ms.
+ */
+
+#define SERIES_QUERY_MAX_POINTS 20000       // Steps per query
+
+// Source a query with step_ms reads: a tier, or -1 for raw samples
+int series_query_source(uint64_t step_ms);
+
+// Called once per requested series, in request order, with its points
+// (count may be 0)
+typedef void (*series_query_cb_t)(const char *series_id, const rollup_point_t *points,
+                                  size_t count, void *ctx);
+
+// Run a query for series_count series. Returns 0, or -1 if the range or
+// step is invalid (empty, step 0, too many points) or memory runs out.
+int series_query_run(sample_store_t *store, const char *const *series_ids, size_t series_count,
+                     uint64_t from_ms, uint64_t to_ms, uint64_t step_ms,
+                     series_query_cb_t cb, void *ctx);
+
+#endif // NETPULSE_SERIES_QUERY_H